@@ -19,18 +19,28 @@
 
 #include "chess/Bcgn.h"
 #include "chess/GameClassification.h"
+#include "chess/OpeningTrie.h"
 #include "chess/Pgn.h"
+#include "chess/PgnToBcgn.h"
 #include "chess/San.h"
 
 #include "enum/EnumArray.h"
 
+#include "external_storage/External.h"
+
+#include "intrin/Intrinsics.h"
+
 #include "persistence/pos_db/beta/DatabaseFormatBeta.h"
 #include "persistence/pos_db/delta/DatabaseFormatDelta.h"
+#include "persistence/pos_db/delta/DatabaseFormatDeltaPax.h"
 #include "persistence/pos_db/delta/DatabaseFormatDeltaSmeared.h"
 #include "persistence/pos_db/epsilon/DatabaseFormatEpsilon.h"
+#include "persistence/pos_db/epsilon/DatabaseFormatEpsilonCompressed.h"
 #include "persistence/pos_db/epsilon/DatabaseFormatEpsilonSmeared.h"
 #include "persistence/pos_db/Database.h"
 #include "persistence/pos_db/DatabaseFactory.h"
+#include "persistence/pos_db/HashPrefixScan.h"
+#include "persistence/pos_db/IndexCache.h"
 #include "persistence/pos_db/Query.h"
 
 #include "util/MemoryAmount.h"
@@ -41,17 +51,23 @@
 #include "ConsoleApp.h"
 
 #include <algorithm>
+#include <array>
+#include <chrono>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <map>
 #include <memory>
 #include <queue>
+#include <random>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 #include "args/args.hxx"
@@ -127,8 +143,10 @@ namespace command_line_app
 
         g_factory.registerDatabaseSchema<persistence::db_beta::Database>();
         g_factory.registerDatabaseSchema<persistence::db_delta::Database>();
+        g_factory.registerDatabaseSchema<persistence::db_delta_pax::Database>();
         g_factory.registerDatabaseSchema<persistence::db_delta_smeared::Database>();
         g_factory.registerDatabaseSchema<persistence::db_epsilon::Database>();
+        g_factory.registerDatabaseSchema<persistence::db_epsilon_compressed::Database>();
         g_factory.registerDatabaseSchema<persistence::db_epsilon_smeared::Database>();
 
         return g_factory;
@@ -973,6 +991,86 @@ namespace command_line_app
         sendMessage(session, responseStr);
     }
 
+    static void handleTcpCommandGamesByName(
+        std::unique_ptr<persistence::Database>& db,
+        const TcpConnection::Ptr& session,
+        const nlohmann::json& json
+    )
+    {
+        assertDatabaseOpen(db);
+
+        query::GamesByNameRequest request = json["query"];
+        if (!request.isValid())
+        {
+            throw std::runtime_error("Invalid request.");
+        }
+
+        auto response = db->queryGamesByName(request);
+        auto responseStr = nlohmann::json(response).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+
+        sendMessage(session, responseStr);
+    }
+
+    static void handleTcpCommandGamesByPosition(
+        std::unique_ptr<persistence::Database>& db,
+        const TcpConnection::Ptr& session,
+        const nlohmann::json& json
+    )
+    {
+        assertDatabaseOpen(db);
+
+        query::GamesByPositionRequest request = json["query"];
+        if (!request.isValid())
+        {
+            throw std::runtime_error("Invalid request.");
+        }
+
+        auto response = db->queryGamesByPosition(request);
+        auto responseStr = nlohmann::json(response).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+
+        sendMessage(session, responseStr);
+    }
+
+    static void handleTcpCommandMaterialStats(
+        std::unique_ptr<persistence::Database>& db,
+        const TcpConnection::Ptr& session,
+        const nlohmann::json& json
+    )
+    {
+        assertDatabaseOpen(db);
+
+        query::MaterialStatsRequest request = json["query"];
+        if (!request.isValid())
+        {
+            throw std::runtime_error("Invalid request.");
+        }
+
+        auto response = db->queryMaterialStats(request);
+        auto responseStr = nlohmann::json(response).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+
+        sendMessage(session, responseStr);
+    }
+
+    static void handleTcpCommandNovelty(
+        std::unique_ptr<persistence::Database>& db,
+        const TcpConnection::Ptr& session,
+        const nlohmann::json& json
+    )
+    {
+        assertDatabaseOpen(db);
+
+        query::NoveltyRequest request = json["query"];
+        if (!request.isValid())
+        {
+            throw std::runtime_error("Invalid request.");
+        }
+
+        auto response = db->queryNovelty(request);
+        auto responseStr = nlohmann::json(response).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+
+        sendMessage(session, responseStr);
+    }
+
     static void handleTcpCommandStats(
         std::unique_ptr<persistence::Database>& db,
         const TcpConnection::Ptr& session,
@@ -1262,6 +1360,9 @@ namespace command_line_app
         static const MemoryAmount pgnParserMemory = cfg::g_config["command_line_app"]["dump"]["pgn_parser_memory"].get<MemoryAmount>();
         static const MemoryAmount bcgnParserMemory = cfg::g_config["command_line_app"]["dump"]["bcgn_parser_memory"].get<MemoryAmount>();
         static const MemoryAmount importMemory = cfg::g_config["command_line_app"]["dump"]["import_memory"].get<MemoryAmount>();
+        static const bool useOpeningTrie = cfg::g_config["command_line_app"]["dump"]["opening_trie"].get<bool>();
+        static const MemoryAmount openingTrieMemory = cfg::g_config["command_line_app"]["dump"]["opening_trie_memory"].get<MemoryAmount>();
+        static const std::size_t openingTrieMaxPlies = cfg::g_config["command_line_app"]["dump"]["opening_trie_max_plies"].get<std::size_t>();
 
         if (temps.empty())
         {
@@ -1276,6 +1377,7 @@ namespace command_line_app
         std::size_t numPosOut = 0;
         std::size_t numPosIn = 0;
         std::size_t numGamesIn = 0;
+        std::size_t numPosCached = 0;
 
         // this has to be destroyed last
         ext::TemporaryPaths tempPaths(temps[0]);
@@ -1306,6 +1408,37 @@ namespace command_line_app
                 std::size_t i = 0;
                 auto positions = pipeline.getEmptyBuffer();
 
+                pgn::OpeningTrie openingTrie(useOpeningTrie ? openingTrieMemory.bytes() : 0, openingTrieMaxPlies);
+
+                // Returns false when the rest of the game should be skipped.
+                auto processPosition = [&](const Position& position, std::optional<GameResult> result, std::size_t& numPly)
+                {
+                    ++numPosIn;
+                    ++numPly;
+
+                    if (position.piecesBB().count() < filterParams.minPieces)
+                    {
+                        return false;
+                    }
+
+                    positions.emplace_back(
+                        position.compress(), 
+                        result == GameResult::WhiteWin,
+                        result == GameResult::Draw,
+                        result == GameResult::BlackWin
+                    );
+
+                    if (positions.size() == positions.capacity())
+                    {
+                        auto path = tempPaths.next();
+                        futureParts.emplace_back(pipeline.scheduleUnordered(path, std::move(positions)));
+                        positions = pipeline.getEmptyBuffer();
+                        Logger::instance().logInfo("Created temp file ", path);
+                    }
+
+                    return numPly < filterParams.maxPly;
+                };
+
                 auto processGame = [&](auto& reader)
                 {
                     for (auto&& game : reader)
@@ -1317,30 +1450,50 @@ namespace command_line_app
 
                         for (auto&& position : game.positions())
                         {
-                            ++numPosIn;
-                            ++numPly;
-
-                            if (position.piecesBB().count() < filterParams.minPieces)
+                            if (!processPosition(position, result, numPly))
                             {
                                 break;
                             }
+                        }
+                    }
+                };
 
-                            positions.emplace_back(
-                                position.compress(), 
-                                result == GameResult::WhiteWin,
-                                result == GameResult::Draw,
-                                result == GameResult::BlackWin
-                            );
+                // PGN games go through the opening trie so that
+                // the shared first moves are not decoded again.
+                auto processPgnGame = [&](pgn::LazyPgnFileReader& reader)
+                {
+                    for (auto&& game : reader)
+                    {
+                        ++numGamesIn;
 
-                            if (positions.size() == positions.capacity())
+                        std::size_t numPly = 0;
+                        const pgn::ParsedGameTags tags = game.parseTags<pgn::TagSet::Positions>();
+                        const auto result = tags.result();
+
+                        PositionWithZobrist position = tags.startPositionWithZobrist();
+                        ReverseMove reverseMove{};
+                        if (!processPosition(position, result, numPly))
+                        {
+                            continue;
+                        }
+
+                        auto cursor =
+                            tags.hasCustomStartPosition()
+                            ? pgn::OpeningTrie::Cursor{}
+                            : openingTrie.root();
+                        for (auto& san : game.moves())
+                        {
+                            const auto moveResult = openingTrie.doMove(cursor, position, reverseMove, san);
+                            if (moveResult == pgn::OpeningTrie::MoveResult::Illegal)
+                            {
+                                break;
+                            }
+                            else if (moveResult == pgn::OpeningTrie::MoveResult::Cached)
                             {
-                                auto path = tempPaths.next();
-                                futureParts.emplace_back(pipeline.scheduleUnordered(path, std::move(positions)));
-                                positions = pipeline.getEmptyBuffer();
-                                Logger::instance().logInfo("Created temp file ", path);
+                                ++numPosCached;
                             }
 
-                            if (numPly >= filterParams.maxPly)
+                            if (!processPosition(position, result, numPly))
                             {
                                 break;
                             }
@@ -1355,7 +1508,7 @@ namespace command_line_app
                     if (extension == ".pgn")
                     {
                         pgn::LazyPgnFileReader reader(pgn, pgnParserMemory.bytes());
-                        processGame(reader);
+                        processPgnGame(reader);
                     }
                     else if (extension == ".bcgn")
                     {
@@ -1512,6 +1665,7 @@ namespace command_line_app
             auto stats = nlohmann::json{
                 { "num_games", numGamesIn },
                 { "num_in_positions", numPosIn },
+                { "num_cached_positions", numPosCached },
                 { "num_out_positions", numPosOut }
             };
             sendProgressFinished(session, "dump", stats);
@@ -1644,6 +1798,23 @@ namespace command_line_app
         sendMessage(session, responseStr);
     }
 
+    static void handleTcpCommandIndexCacheStats(
+        std::unique_ptr<persistence::Database>& db,
+        const TcpConnection::Ptr& session,
+        const nlohmann::json& json
+    )
+    {
+        // The cache is shared by all databases so none has to be open.
+        auto stats = persistence::IndexCache::instance().stats();
+
+        auto response = nlohmann::json{
+            { "index_cache_stats", nlohmann::json(stats) }
+        };
+
+        auto responseStr = nlohmann::json(response).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+        sendMessage(session, responseStr);
+    }
+
     static bool handleTcpCommand(
         std::unique_ptr<persistence::Database>& db,
         const TcpConnection::Ptr& session,
@@ -1658,11 +1829,16 @@ namespace command_line_app
             { "open", handleTcpCommandOpen },
             { "close", handleTcpCommandClose },
             { "query", handleTcpCommandQuery },
+            { "games_by_name", handleTcpCommandGamesByName },
+            { "games_by_position", handleTcpCommandGamesByPosition },
+            { "material_stats", handleTcpCommandMaterialStats },
+            { "novelty", handleTcpCommandNovelty },
             { "stats", handleTcpCommandStats },
             { "dump", handleTcpCommandDump },
             { "support", handleTcpCommandSupport },
             { "manifest", handleTcpCommandManifest },
-            { "mergable_files", handleTcpCommandMergableFiles }
+            { "mergable_files", handleTcpCommandMergableFiles },
+            { "index_cache_stats", handleTcpCommandIndexCacheStats }
         };
 
         auto datastr = std::string(data, len);
@@ -1820,99 +1996,31 @@ namespace command_line_app
     static void convertPgnToBcgnImpl(
         const std::filesystem::path& pgn, 
         const std::filesystem::path& bcgn,
-        const bcgn::BcgnFileHeader& header,
-        bcgn::BcgnFileWriter::FileOpenMode mode)
+        const bcgn::PgnToBcgnConversionParams& params)
     {
-        pgn::LazyPgnFileReader pgnReader(pgn, pgnParserMemory.bytes());
-        bcgn::BcgnFileWriter bcgnWriter(bcgn, header, mode, bcgnParserMemory.bytes());
-
         constexpr std::size_t reportEvery = 100'000;
 
-        std::size_t nextReport = 0;
-        std::size_t totalCount = 0;
-        for (auto&& game : pgnReader)
-        {
-            const std::string_view fenTag = game.tag("FEN");
-            const bool hasCustomStartpos = !fenTag.empty();
-
-            Position pos = 
-                hasCustomStartpos
-                ? Position::fromFen(fenTag.data())
-                : Position::startPosition();
-
-            bcgnWriter.beginGame();
-
-            if (header.isHeaderless)
-            {
-                const auto result = game.result();
-                if (result.has_value())
-                {
-                    bcgnWriter.setResult(*result);
-                }
-            }
-            else
-            {
-                std::optional<GameResult> result;
-                Date date;
-                Eco eco;
-                std::string_view event;
-                std::string_view white;
-                std::string_view black;
-                game.getResultDateEcoEventWhiteBlack(
-                    result,
-                    date,
-                    eco,
-                    event,
-                    white,
-                    black
-                    );
-
-                bcgnWriter.setWhiteElo(game.whiteElo());
-                bcgnWriter.setBlackElo(game.blackElo());
-                bcgnWriter.setDate(date);
-                bcgnWriter.setEco(eco);
-                bcgnWriter.setRound(game.round());
-                bcgnWriter.setWhitePlayer(white);
-                bcgnWriter.setBlackPlayer(black);
-                bcgnWriter.setEvent(event);
-                bcgnWriter.setSite(game.tag("Site"sv));
-                if (result.has_value())
-                {
-                    bcgnWriter.setResult(*result);
-                }
-            }
-
-            if (hasCustomStartpos && pos != Position::startPosition())
-            {
-                bcgnWriter.setCustomStartPos(pos);
-            }
-
-            for (auto&& san : game.moves())
-            {
-                const auto move = san::sanToMove(pos, san);
-
-                bcgnWriter.addMove(pos, move);
-
-                pos.doMove(move);
-            }
-
-            bcgnWriter.endGame();
-
-            ++totalCount;
+        std::size_t nextReport = reportEvery;
+        const auto stats = bcgn::convertPgnToBcgn(pgn, bcgn, params, [&nextReport](std::size_t totalCount) {
             if (totalCount >= nextReport)
             {
                 std::cout << "Converted " << totalCount << " games...\n";
-                nextReport += reportEvery;
+                nextReport = (totalCount / reportEvery + 1) * reportEvery;
             }
-        }
-        std::cout << "Converted " << totalCount << " games...\n";
+        });
+        std::cout << "Converted " << stats.numGames << " games into " << stats.outputPaths.size() << " file(s).\n";
     }
 
     static void convert(args::Subparser& parser)
     {
         args::Flag headerless(parser, "headerless", "Only store critical information in the game headers", { 'h', "headerless" });
         args::Flag append(parser, "append", "Append to an already existing file.", { 'a', "append" });
+        args::Flag offsetDirectory(parser, "offset_directory", "Maintain a game offset directory in <output>.offsets for random access and parallel reading. When appending the existing file decides.", { "offset_directory" });
         args::ValueFlag<std::uint32_t> compressionLevel(parser, "compression", "The compression level to use for BCGN files. Currently supports 0, 1, or 2. For further info see BCGN documentation.", { 'c', "compression" }, 0u);
+        args::ValueFlag<std::uint32_t> auxCompression(parser, "aux_compression", "The compression of blocks of games on top of the compression level. Currently supports 0 (none) or 1 (zstd). When appending the existing file decides.", { "aux_compression" }, 0u);
+        args::Flag positionKeys(parser, "position_keys", "Also write the keys of all positions to <output>.keys. Imports of the output into the beta and delta formats then don't have to decode the moves. The keys take 20 bytes per position, about 20x the size of a c2 file. Not supported when appending.", { "position_keys" });
+        args::ValueFlag<std::size_t> numThreads(parser, "count", "The number of threads parsing and encoding games. Defaults to the number of hardware threads.", { 't', "threads" }, std::max(std::thread::hardware_concurrency(), 1u));
+        args::ValueFlag<std::string> shardSize(parser, "memory", "Split the output into files of at most this size, named <output>_<i>.bcgn. For example \"4GiB\"", { "shard_size" });
 
         args::Group requiredArgs(parser, "required arguments", args::Group::Validators::All);
         args::Positional<std::string> input(requiredArgs, "input path", "File to convert from.");
@@ -1925,35 +2033,78 @@ namespace command_line_app
 
         if (from.extension() == ".pgn" && to.extension() == ".bcgn")
         {
-            bcgn::BcgnFileHeader header{};
-            auto mode = bcgn::BcgnFileWriter::FileOpenMode::Truncate;
+            bcgn::PgnToBcgnConversionParams params{};
+            params.pgnParserMemory = pgnParserMemory.bytes();
+            params.bcgnWriterMemory = bcgnParserMemory.bytes();
+            params.numThreads = args::get(numThreads);
 
             switch (args::get(compressionLevel))
             {
             case 0:
-                header.compressionLevel = bcgn::BcgnCompressionLevel::Level_0;
+                params.header.compressionLevel = bcgn::BcgnCompressionLevel::Level_0;
                 break;
 
             case 1:
-                header.compressionLevel = bcgn::BcgnCompressionLevel::Level_1;
+                params.header.compressionLevel = bcgn::BcgnCompressionLevel::Level_1;
                 break;
 
             case 2:
-                header.compressionLevel = bcgn::BcgnCompressionLevel::Level_2;
+                params.header.compressionLevel = bcgn::BcgnCompressionLevel::Level_2;
                 break;
             }
 
+            switch (args::get(auxCompression))
+            {
+            case 0:
+                params.header.auxCompression = bcgn::BcgnAuxCompression::None;
+                break;
+
+            case 1:
+                params.header.auxCompression = bcgn::BcgnAuxCompression::Zstd;
+                break;
+
+            default:
+                throwInvalidArguments();
+            }
+
             if (headerless)
             {
-                header.isHeaderless = true;
+                params.header.isHeaderless = true;
+            }
+
+            if (offsetDirectory)
+            {
+                params.header.hasGameOffsetDirectory = true;
+            }
+
+            if (shardSize)
+            {
+                if (append)
+                {
+                    std::cout << "Appending to split output is not supported.\n";
+                    return;
+                }
+
+                params.maxShardSize = MemoryAmount(args::get(shardSize)).bytes();
+            }
+
+            if (positionKeys)
+            {
+                if (append)
+                {
+                    std::cout << "Appending with position keys is not supported.\n";
+                    return;
+                }
+
+                params.writePositionKeys = true;
             }
 
             if (append)
             {
-                mode = bcgn::BcgnFileWriter::FileOpenMode::Append;
+                params.mode = bcgn::BcgnFileWriter::FileOpenMode::Append;
             }
             
-            convertPgnToBcgnImpl(from, to, header, mode);
+            convertPgnToBcgnImpl(from, to, params);
         }
         else
         {
@@ -2024,7 +2175,7 @@ namespace command_line_app
     }
 
     template <typename ReaderT>
-    static void benchReader(const std::filesystem::path& path, std::size_t memory)
+    static void benchReader(const std::filesystem::path& path, std::size_t memory, typename ReaderT::ReadMode mode)
     {
         const auto size = std::filesystem::file_size(path);
         std::cout << "File size: " << size << '\n';
@@ -2032,7 +2183,7 @@ namespace command_line_app
         for (int i = 0; i < 2; ++i)
         {
             // warmup
-            ReaderT reader(path, memory);
+            ReaderT reader(path, memory, mode);
             for (auto&& game : reader);
             std::cout << "warmup " << i << " finished\n";
         }
@@ -2040,7 +2191,7 @@ namespace command_line_app
         std::this_thread::sleep_for(std::chrono::seconds{ 1 });
 
         const auto t0 = std::chrono::high_resolution_clock::now();
-        ReaderT reader(path, memory);
+        ReaderT reader(path, memory, mode);
         std::size_t numGames = 0;
         std::size_t numPositions = 0;
         for (auto&& game : reader)
@@ -2061,31 +2212,34 @@ namespace command_line_app
         std::cout << "Throughput of " << size / time / 1e6 << " MB/s\n";
     }
 
-    static void benchPgn(const std::filesystem::path& path)
+    static void benchPgn(const std::filesystem::path& path, bool mapped)
     {
-        benchReader<pgn::LazyPgnFileReader>(path, pgnParserMemory.bytes());
+        using ReadMode = pgn::LazyPgnFileReader::ReadMode;
+        benchReader<pgn::LazyPgnFileReader>(path, pgnParserMemory.bytes(), mapped ? ReadMode::MemoryMapped : ReadMode::Buffered);
     }
 
-    static void benchBcgn(const std::filesystem::path& path)
+    static void benchBcgn(const std::filesystem::path& path, bool mapped)
     {
-        benchReader<bcgn::BcgnFileReader>(path, bcgnParserMemory.bytes());
+        using ReadMode = bcgn::BcgnFileReader::ReadMode;
+        benchReader<bcgn::BcgnFileReader>(path, bcgnParserMemory.bytes(), mapped ? ReadMode::MemoryMapped : ReadMode::Buffered);
     }
 
     static void bench(args::Subparser& parser)
     {
         args::Group requiredArgs(parser, "required arguments", args::Group::Validators::All);
         args::Positional<std::string> input(requiredArgs, "input path", "The path to a PGN or BCGN file.");
+        args::Flag mmap(parser, "mmap", "Read the file through a memory mapping.", { "mmap" });
 
         parser.Parse();
 
         const std::filesystem::path path = args::get(input);
         if (path.extension() == ".pgn")
         {
-            benchPgn(path);
+            benchPgn(path, mmap);
         }
         else if (path.extension() == ".bcgn")
         {
-            benchBcgn(path);
+            benchBcgn(path, mmap);
         }
         else
         {
@@ -2093,6 +2247,286 @@ namespace command_line_app
         }
     }
 
+    // Returns the number of positions per second.
+    [[nodiscard]] static double benchBcgnPositions(const std::filesystem::path& path, std::size_t numRuns)
+    {
+        double bestTime = std::numeric_limits<double>::max();
+        std::size_t numPositions = 0;
+        for (std::size_t i = 0; i < numRuns; ++i)
+        {
+            const auto t0 = std::chrono::high_resolution_clock::now();
+            bcgn::BcgnFileReader reader(path, bcgnParserMemory.bytes());
+            numPositions = 0;
+            for (auto&& game : reader)
+            {
+                for (auto&& position : game.positions())
+                {
+                    numPositions += 1;
+                }
+            }
+            const auto t1 = std::chrono::high_resolution_clock::now();
+            bestTime = std::min(bestTime, (t1 - t0).count() / 1e9);
+        }
+
+        return numPositions / bestTime;
+    }
+
+    static void benchBcgnCompressionImpl(const std::filesystem::path& pgn, std::size_t numRuns)
+    {
+        const auto dir = std::filesystem::temp_directory_path() / ext::uniquePath();
+        std::filesystem::create_directories(dir);
+
+        double baseline = 0.0;
+        for (auto compressionLevel : { bcgn::BcgnCompressionLevel::Level_0, bcgn::BcgnCompressionLevel::Level_1, bcgn::BcgnCompressionLevel::Level_2 })
+        {
+            const auto level = static_cast<unsigned>(compressionLevel);
+            const auto path = dir / ("c" + std::to_string(level) + ".bcgn");
+
+            bcgn::PgnToBcgnConversionParams params{};
+            params.header.compressionLevel = compressionLevel;
+            params.numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+            (void)bcgn::convertPgnToBcgn(pgn, path, params);
+
+            const double positionsPerSecond = benchBcgnPositions(path, numRuns);
+            if (compressionLevel == bcgn::BcgnCompressionLevel::Level_0)
+            {
+                baseline = positionsPerSecond;
+            }
+
+            std::cout
+                << "c" << level << ": "
+                << std::filesystem::file_size(path) << " bytes, "
+                << (std::uint64_t)positionsPerSecond << " positions/s, "
+                << positionsPerSecond / baseline << "x of c0\n";
+        }
+
+        std::filesystem::remove_all(dir);
+    }
+
+    static void benchBcgnCompression(args::Subparser& parser)
+    {
+        args::ValueFlag<std::size_t> numRuns(parser, "count", "The number of runs per compression level. The best one is reported.", { "runs" }, 3u);
+
+        args::Group requiredArgs(parser, "required arguments", args::Group::Validators::All);
+        args::Positional<std::string> input(requiredArgs, "input path", "The path to a PGN file.");
+
+        parser.Parse();
+
+        const std::filesystem::path path = args::get(input);
+        if (path.extension() != ".pgn" || args::get(numRuns) == 0)
+        {
+            throwInvalidArguments();
+        }
+
+        benchBcgnCompressionImpl(path, args::get(numRuns));
+    }
+
+    template <typename KeyT, typename LookupT>
+    static void benchIndexLookups(const char* name, const std::vector<KeyT>& keys, LookupT&& lookup)
+    {
+        // Accumulate something from the results so the lookups are not optimized away.
+        std::size_t checksum = 0;
+        std::size_t numEntries = 0;
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        for (auto&& key : keys)
+        {
+            const auto [a, b] = lookup(key);
+            checksum += a ^ b;
+            numEntries += b - a;
+        }
+        const auto t1 = std::chrono::high_resolution_clock::now();
+        const double time = (t1 - t0).count() / 1e9;
+
+        std::cout << name << ": " << keys.size() << " lookups in " << time << "s\n";
+        std::cout << name << ": " << (time / keys.size() * 1e9) << " ns/lookup\n";
+        std::cout << name << ": " << (static_cast<double>(numEntries) / keys.size()) << " entries/lookup\n";
+        std::cout << name << ": checksum " << checksum << "\n";
+    }
+
+    // Compares lookup speed of different index layouts on synthetic data.
+    // Keys are 16 bytes, like in most formats, and uniformly distributed, like the hashes.
+    // Each range covers `granularity` entries.
+    static void benchIndexImpl(std::size_t numRanges, std::size_t numQueries, std::size_t granularity, std::size_t radixBits)
+    {
+        using KeyType = std::array<std::uint64_t, 2>;
+        using CompareType = std::less<>;
+
+        std::mt19937_64 rng(numRanges);
+
+        std::vector<KeyType> values(numRanges * 2);
+        for (auto& v : values)
+        {
+            v = { rng(), rng() };
+        }
+        std::sort(values.begin(), values.end());
+
+        std::vector<ext::RangeIndexEntry<KeyType, CompareType>> entries(numRanges);
+        for (std::size_t i = 0; i < numRanges; ++i)
+        {
+            entries[i].low = i * granularity;
+            entries[i].high = (i + 1) * granularity - 1;
+            entries[i].lowValue = values[i * 2];
+            entries[i].highValue = values[i * 2 + 1];
+        }
+
+        const ext::RangeIndex<KeyType, CompareType> index(std::move(entries));
+        const ext::EytzingerRangeIndex<KeyType, CompareType> eytzinger(index);
+
+        // All entries of a range are assumed to have the low value of the range,
+        // so it's enough to append one key per range and scale the offsets.
+        ext::RadixIndexBuilder radixBuilder(radixBits);
+        for (std::size_t i = 0; i < numRanges; ++i)
+        {
+            radixBuilder.append(values[i * 2][0]);
+        }
+        const ext::RadixIndex radix = radixBuilder.end();
+
+        // Half of the keys hit the bounds of ranges, half is random.
+        std::vector<KeyType> keys(numQueries);
+        for (std::size_t i = 0; i < numQueries; ++i)
+        {
+            if (i % 2 == 0) keys[i] = values[rng() % values.size()];
+            else keys[i] = { rng(), rng() };
+        }
+
+        std::cout << "Ranges: " << numRanges << ", entries: " << numRanges * granularity << '\n';
+        std::cout << "Index size: " << index.size() * sizeof(ext::RangeIndexEntry<KeyType, CompareType>) << " B (sorted), "
+            << eytzinger.memoryUsage() << " B (eytzinger), "
+            << radix.memoryUsage() << " B (radix, " << radixBits << " bits)\n";
+
+        auto lookupSorted = [&index](const KeyType& key) {
+            const auto [a, b] = index.equal_range(key);
+            return std::make_pair(a.it, b.it);
+        };
+        auto lookupEytzinger = [&eytzinger](const KeyType& key) {
+            const auto [a, b] = eytzinger.equal_range(key);
+            return std::make_pair(a.it, b.it);
+        };
+        auto lookupRadix = [&radix, granularity](const KeyType& key) {
+            const auto [a, b] = radix.equal_range(key[0]);
+            return std::make_pair(a * granularity, b * granularity);
+        };
+
+        for (int i = 0; i < 2; ++i)
+        {
+            benchIndexLookups("sorted   ", keys, lookupSorted);
+            benchIndexLookups("eytzinger", keys, lookupEytzinger);
+            benchIndexLookups("radix    ", keys, lookupRadix);
+        }
+    }
+
+    static void benchIndex(args::Subparser& parser)
+    {
+        args::ValueFlag<std::size_t> numRanges(parser, "count", "The number of ranges in the index.", { "ranges" }, 1u << 22u);
+        args::ValueFlag<std::size_t> numQueries(parser, "count", "The number of lookups to perform.", { "queries" }, 1u << 22u);
+        args::ValueFlag<std::size_t> granularity(parser, "count", "The number of entries in each range.", { "granularity" }, 1024u);
+        args::ValueFlag<std::size_t> radixBits(parser, "count", "The number of bits used by the radix index.", { "radix_bits" }, 22u);
+
+        parser.Parse();
+
+        benchIndexImpl(args::get(numRanges), args::get(numQueries), args::get(granularity), std::min(args::get(radixBits), ext::RadixIndex::maxNumBits));
+    }
+
+    template <typename ScanT>
+    static void benchScanBlocks(const char* name, const std::vector<std::byte>& data, std::size_t stride, std::size_t blockSize, const std::vector<std::uint64_t>& prefixes, ScanT&& scan)
+    {
+        const std::size_t numBlocks = data.size() / stride / blockSize;
+
+        // Accumulate something from the results so the scans are not optimized away.
+        std::size_t checksum = 0;
+        std::size_t numMatches = 0;
+        std::vector<std::size_t> matching;
+        const auto t0 = std::chrono::high_resolution_clock::now();
+        for (std::size_t i = 0; i < prefixes.size(); ++i)
+        {
+            matching.clear();
+            scan(data.data() + (i % numBlocks) * blockSize * stride, stride, blockSize, prefixes[i], matching);
+            for (auto idx : matching) checksum += idx;
+            numMatches += matching.size();
+        }
+        const auto t1 = std::chrono::high_resolution_clock::now();
+        const double time = (t1 - t0).count() / 1e9;
+
+        std::cout << name << ": " << prefixes.size() << " scans in " << time << "s\n";
+        std::cout << name << ": " << (time / prefixes.size() * 1e9) << " ns/block\n";
+        std::cout << name << ": " << (static_cast<double>(numMatches) / prefixes.size()) << " matches/block\n";
+        std::cout << name << ": checksum " << checksum << "\n";
+    }
+
+    // Compares the speed of finding the entries of a position in a block
+    // with the scalar and the SIMD hash prefix scan, see HashPrefixScan.h.
+    // Each position has on average `numPerPosition` consecutive entries, like after sorting.
+    static void benchScanImpl(std::size_t stride, std::size_t blockSize, std::size_t numBlocks, std::size_t numScans, std::size_t numPerPosition)
+    {
+        std::mt19937_64 rng(stride * blockSize);
+
+        std::vector<std::byte> data(stride * blockSize * numBlocks);
+        for (auto& b : data)
+        {
+            b = static_cast<std::byte>(rng());
+        }
+
+        std::uint64_t prefix = rng();
+        for (std::size_t i = 0; i < blockSize * numBlocks; ++i)
+        {
+            if (rng() % numPerPosition == 0)
+            {
+                prefix = rng();
+            }
+
+            std::memcpy(data.data() + i * stride, &prefix, sizeof(prefix));
+        }
+
+        // Half of the scans look for a position present in the block, half for a random one.
+        std::vector<std::uint64_t> prefixes(numScans);
+        for (std::size_t i = 0; i < numScans; ++i)
+        {
+            if (i % 2 == 0)
+            {
+                const std::size_t block = i % numBlocks;
+                const std::size_t entry = block * blockSize + rng() % blockSize;
+                std::memcpy(&prefixes[i], data.data() + entry * stride, sizeof(std::uint64_t));
+            }
+            else
+            {
+                prefixes[i] = rng();
+            }
+        }
+
+        std::cout << "Entry size: " << stride << " B, entries per block: " << blockSize << ", blocks: " << numBlocks << '\n';
+
+        for (int i = 0; i < 2; ++i)
+        {
+            benchScanBlocks("scalar", data, stride, blockSize, prefixes, persistence::detail::findHashPrefixesScalar);
+            if (intrin::hasAvx2())
+            {
+                benchScanBlocks("avx2  ", data, stride, blockSize, prefixes, persistence::detail::findHashPrefixesAvx2);
+            }
+            else
+            {
+                std::cout << "avx2  : not supported\n";
+            }
+        }
+    }
+
+    static void benchScan(args::Subparser& parser)
+    {
+        args::ValueFlag<std::size_t> entrySize(parser, "bytes", "The size of a single entry. At least 8.", { "entry_size" }, 32u);
+        args::ValueFlag<std::size_t> blockSize(parser, "count", "The number of entries in each block.", { "block_size" }, 1024u);
+        args::ValueFlag<std::size_t> numBlocks(parser, "count", "The number of blocks to scan.", { "blocks" }, 1024u);
+        args::ValueFlag<std::size_t> numScans(parser, "count", "The number of scans to perform.", { "scans" }, 1u << 20u);
+        args::ValueFlag<std::size_t> numPerPosition(parser, "count", "The average number of entries of one position.", { "per_position" }, 4u);
+
+        parser.Parse();
+
+        if (args::get(entrySize) < sizeof(std::uint64_t) || args::get(blockSize) == 0 || args::get(numBlocks) == 0 || args::get(numPerPosition) == 0)
+        {
+            throwInvalidArguments();
+        }
+
+        benchScanImpl(args::get(entrySize), args::get(blockSize), args::get(numBlocks), args::get(numScans), args::get(numPerPosition));
+    }
+
     template <typename ReaderT>
     static void statsImpl(const std::filesystem::path& path, std::size_t memory)
     {
@@ -2516,6 +2950,9 @@ namespace command_line_app
         args::Command countGames(commands, "count_games", "Count games in a PGN/BCGN file", &countGames);
         args::Command stats(commands, "stats", "Calculate statistics for a PGN/BCGN file", &stats);
         args::Command bench(commands, "bench", "Benchmark processing speed of PGN/BCGN file", &bench);
+        args::Command benchBcgnCompression(commands, "bench_bcgn", "Benchmark reading positions from BCGN files of each compression level converted from a PGN file", &benchBcgnCompression);
+        args::Command benchIndex(commands, "bench_index", "Benchmark lookups in different layouts of the range index", &benchIndex);
+        args::Command benchScan(commands, "bench_scan", "Benchmark finding the entries of a position in a block", &benchScan);
         args::Command interactive(commands, "interactive", "Launch an interactive, stateful command line for extended operation.", &interactive);
         args::Command verify(commands, "verify", "Very a PGN/BCGN file.", &verify);
         args::Command epdDump(commands, "epd_dump", "Various stuff about EPD position files", &epdDump);
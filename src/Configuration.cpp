@@ -110,6 +110,12 @@ namespace cfg
         return s_instance;
     }
 
+    void Configuration::patch(const nlohmann::json& values)
+    {
+        // The instance itself is not const.
+        const_cast<Configuration&>(instance()).m_json.merge_patch(values);
+    }
+
     void Configuration::print(std::ostream& out) const
     {
         out << m_json.dump(4);
@@ -144,9 +150,21 @@ namespace cfg
 
 "persistence" : {
     "header_writer_memory" : "16MiB",
+    "index_cache_memory" : "4GiB",
+    "header_cache_size" : 4096,
+    "name_index" : false,
+    "material_index" : false,
+    "memory_mapped_import" : false,
+    "bcgn_import_threads" : 0,
+    "opening_trie" : false,
+    "opening_trie_memory" : "1MiB",
+    "opening_trie_max_plies" : 20,
 
     "db_beta" : {
         "index_granularity" : 1024,
+        "index_radix_bits" : 0,
+        "eytzinger_index" : false,
+        "game_lists" : false,
         "merge_writer_buffer_size" : "4MiB",
         "pgn_parser_memory" : "4MiB",
         "bcgn_parser_memory" : "4MiB"
@@ -154,6 +172,29 @@ namespace cfg
 
     "db_delta" : {
         "index_granularity" : 1024,
+        "index_radix_bits" : 0,
+        "eytzinger_index" : false,
+        "game_lists" : false,
+        "merge_writer_buffer_size" : "4MiB",
+        "pgn_parser_memory" : "4MiB",
+        "bcgn_parser_memory" : "4MiB"
+    },
+
+    "db_delta_pax" : {
+        "index_granularity" : 1024,
+        "index_radix_bits" : 0,
+        "eytzinger_index" : false,
+        "block_size" : 1024,
+        "game_lists" : false,
+        "merge_writer_buffer_size" : "4MiB",
+        "pgn_parser_memory" : "4MiB",
+        "bcgn_parser_memory" : "4MiB"
+    },
+
+    "db_delta_smeared" : {
+        "index_granularity" : 1024,
+        "index_radix_bits" : 0,
+        "eytzinger_index" : false,
         "merge_writer_buffer_size" : "4MiB",
         "pgn_parser_memory" : "4MiB",
         "bcgn_parser_memory" : "4MiB"
@@ -161,6 +202,27 @@ namespace cfg
 
     "db_epsilon" : {
         "index_granularity" : 1024,
+        "index_radix_bits" : 0,
+        "eytzinger_index" : false,
+        "merge_writer_buffer_size" : "4MiB",
+        "pgn_parser_memory" : "4MiB",
+        "bcgn_parser_memory" : "4MiB"
+    },
+
+    "db_epsilon_compressed" : {
+        "index_granularity" : 1024,
+        "index_radix_bits" : 0,
+        "eytzinger_index" : false,
+        "block_size" : 256,
+        "merge_writer_buffer_size" : "4MiB",
+        "pgn_parser_memory" : "4MiB",
+        "bcgn_parser_memory" : "4MiB"
+    },
+
+    "db_epsilon_smeared_a" : {
+        "index_granularity" : 1024,
+        "index_radix_bits" : 0,
+        "eytzinger_index" : false,
         "merge_writer_buffer_size" : "4MiB",
         "pgn_parser_memory" : "4MiB",
         "bcgn_parser_memory" : "4MiB"
@@ -168,6 +230,8 @@ namespace cfg
 
     "db_epsilon_smeared_b" : {
         "index_granularity" : 1024,
+        "index_radix_bits" : 0,
+        "eytzinger_index" : false,
         "merge_writer_buffer_size" : "4MiB",
         "pgn_parser_memory" : "4MiB",
         "bcgn_parser_memory" : "4MiB"
@@ -181,7 +245,10 @@ namespace cfg
     "dump" : {
         "import_memory" : "2GiB",
         "pgn_parser_memory" : "4MiB",
-        "bcgn_parser_memory" : "4MiB"
+        "bcgn_parser_memory" : "4MiB",
+        "opening_trie" : false,
+        "opening_trie_memory" : "1MiB",
+        "opening_trie_max_plies" : 20
     }
 },
 
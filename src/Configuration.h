@@ -19,6 +19,11 @@ namespace cfg
 
         void print(std::ostream& out) const;
 
+        // Merges the values over the current configuration.
+        // Options that are read once at startup don't see the change.
+        // Meant for tests.
+        static void patch(const nlohmann::json& values);
+
     private:
         nlohmann::json m_json;
 
@@ -10,22 +10,360 @@
 
 #include "enum/EnumArray.h"
 
+#include "intrin/Intrinsics.h"
+
 #include "util/ArithmeticUtility.h"
 #include "util/UnsignedCharBufferView.h"
 #include "util/Buffer.h"
 
+#include "zstd/zstd.h"
+
 #include <algorithm>
 #include <array>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <filesystem>
 #include <future>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
 #include <vector>
 
 namespace bcgn
 {
+    namespace detail
+    {
+        static void seekFile(FILE* file, std::uint64_t offset)
+        {
+#if defined(_WIN32)
+            const int result = _fseeki64(file, static_cast<std::int64_t>(offset), SEEK_SET);
+#else
+            const int result = fseeko(file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+            if (result != 0)
+            {
+                throw std::runtime_error("Cannot seek in BCGN file.");
+            }
+        }
+
+        // Returns 0 if there is no game entry at the offset.
+        [[nodiscard]] static std::size_t readGameEntrySize(FILE* file, std::uint64_t offset)
+        {
+            seekFile(file, offset);
+
+            unsigned char data[2];
+            if (std::fread(data, 1, 2, file) != 2)
+            {
+                return 0;
+            }
+
+            return (data[0] << 8) | data[1];
+        }
+
+        static void writeBigEndian64(unsigned char*& data, std::uint64_t value)
+        {
+            for (int i = 7; i >= 0; --i)
+            {
+                *data++ = static_cast<unsigned char>(value >> (i * 8));
+            }
+        }
+
+        [[nodiscard]] static std::uint64_t readBigEndian64(const unsigned char*& data)
+        {
+            std::uint64_t value = 0;
+            for (int i = 0; i < 8; ++i)
+            {
+                value = (value << 8) | *data++;
+            }
+            return value;
+        }
+
+        static void writeBigEndian32(unsigned char*& data, std::uint32_t value)
+        {
+            for (int i = 3; i >= 0; --i)
+            {
+                *data++ = static_cast<unsigned char>(value >> (i * 8));
+            }
+        }
+
+        [[nodiscard]] static std::uint32_t readBigEndian32(const unsigned char*& data)
+        {
+            std::uint32_t value = 0;
+            for (int i = 0; i < 4; ++i)
+            {
+                value = (value << 8) | *data++;
+            }
+            return value;
+        }
+
+        // FNV-1a of the first and the last bytes of a file, which include the BCGN header.
+        // Ties the position key file to the contents of the BCGN file, not just its size.
+        // Empty if the file cannot be read.
+        [[nodiscard]] static std::optional<std::uint64_t> computeFileFingerprint(const std::filesystem::path& path, std::uint64_t fileSize)
+        {
+            constexpr std::size_t maxNumBytesHashed = 64 * 1024;
+
+            std::unique_ptr<FILE, decltype(&std::fclose)> file(std::fopen(path.string().c_str(), "rb"), &std::fclose);
+            if (file == nullptr)
+            {
+                return {};
+            }
+
+            std::uint64_t hash = 0xcbf29ce484222325ull;
+            std::vector<unsigned char> data(static_cast<std::size_t>(std::min<std::uint64_t>(fileSize, maxNumBytesHashed)));
+            for (const std::uint64_t offset : { std::uint64_t(0), fileSize - data.size() })
+            {
+                seekFile(file.get(), offset);
+                if (std::fread(data.data(), 1, data.size(), file.get()) != data.size())
+                {
+                    return {};
+                }
+
+                for (const unsigned char c : data)
+                {
+                    hash = (hash ^ c) * 0x100000001b3ull;
+                }
+            }
+
+            return hash;
+        }
+
+        // Favours speed, the movetext doesn't compress much better at higher levels.
+        static constexpr int zstdCompressionLevel = 3;
+
+        struct BlockHeader
+        {
+            std::uint32_t compressedLength;
+            std::uint32_t uncompressedLength;
+            std::uint32_t numGames;
+
+            [[nodiscard]] static BlockHeader readFrom(const unsigned char* data)
+            {
+                BlockHeader header;
+                header.compressedLength = readBigEndian32(data);
+                header.uncompressedLength = readBigEndian32(data);
+                header.numGames = readBigEndian32(data);
+                return header;
+            }
+
+            void writeTo(unsigned char* data) const
+            {
+                writeBigEndian32(data, compressedLength);
+                writeBigEndian32(data, uncompressedLength);
+                writeBigEndian32(data, numGames);
+            }
+        };
+
+        // Blocks being compressed at the same time by one writer.
+        [[nodiscard]] static std::size_t maxNumBlocksInFlight()
+        {
+            return std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        // Blocks being decompressed at the same time by one reader.
+        [[nodiscard]] static std::size_t maxNumBlocksDecompressedInParallel()
+        {
+            return std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        // No valid block is longer, anything above is a corrupted header.
+        static constexpr std::size_t maxCompressedBlockLength = ZSTD_COMPRESSBOUND(traits::maxAuxCompressionBlockLength);
+
+        // Returns the block with its header.
+        [[nodiscard]] static std::vector<unsigned char> compressBlock(
+            BcgnAuxCompression auxCompression,
+            const std::vector<unsigned char>& games,
+            std::size_t numGames
+            )
+        {
+            constexpr std::size_t headerLength = traits::auxCompressionBlockHeaderLength;
+
+            std::vector<unsigned char> block;
+            switch (auxCompression)
+            {
+            case BcgnAuxCompression::Zstd:
+            {
+                block.resize(headerLength + ZSTD_compressBound(games.size()));
+                const std::size_t compressedLength = ZSTD_compress(
+                    block.data() + headerLength,
+                    block.size() - headerLength,
+                    games.data(),
+                    games.size(),
+                    zstdCompressionLevel
+                );
+                if (ZSTD_isError(compressedLength))
+                {
+                    throw std::runtime_error("Cannot compress block.");
+                }
+
+                block.resize(headerLength + compressedLength);
+                break;
+            }
+
+            default:
+                ASSERT(false);
+            }
+
+            BlockHeader header;
+            header.compressedLength = static_cast<std::uint32_t>(block.size() - headerLength);
+            header.uncompressedLength = static_cast<std::uint32_t>(games.size());
+            header.numGames = static_cast<std::uint32_t>(numGames);
+            header.writeTo(block.data());
+
+            return block;
+        }
+
+        [[nodiscard]] static std::vector<unsigned char> decompressBlock(
+            BcgnAuxCompression auxCompression,
+            const std::vector<unsigned char>& compressed,
+            std::size_t uncompressedLength
+            )
+        {
+            std::vector<unsigned char> games(uncompressedLength);
+            switch (auxCompression)
+            {
+            case BcgnAuxCompression::Zstd:
+            {
+                const std::size_t length = ZSTD_decompress(
+                    games.data(),
+                    games.size(),
+                    compressed.data(),
+                    compressed.size()
+                );
+                if (ZSTD_isError(length) || length != uncompressedLength)
+                {
+                    throw std::runtime_error("Invalid compressed block.");
+                }
+
+                break;
+            }
+
+            default:
+                ASSERT(false);
+            }
+
+            return games;
+        }
+
+        // Splits at the entries of a game offset directory or a block index.
+        // firstGameIdx(i) is the index of the game at offsets[i].
+        template <typename FuncT>
+        [[nodiscard]] static std::vector<BcgnGameRange> splitIntoRanges(
+            const std::vector<std::uint64_t>& offsets,
+            FuncT&& firstGameIdx,
+            std::size_t numGames,
+            std::uint64_t endOffset,
+            std::size_t n
+            )
+        {
+            std::vector<BcgnGameRange> ranges;
+            if (offsets.empty())
+            {
+                return ranges;
+            }
+
+            n = std::max<std::size_t>(n, 1);
+
+            const std::uint64_t beginOffset = offsets.front();
+            const std::uint64_t numBytes = endOffset - beginOffset;
+            std::size_t firstEntryIdx = 0;
+            for (std::size_t i = 1; i <= n; ++i)
+            {
+                // The first entry at or after the split point ends the range.
+                const std::size_t endEntryIdx =
+                    i == n
+                    ? offsets.size()
+                    : static_cast<std::size_t>(std::lower_bound(
+                        offsets.begin() + firstEntryIdx,
+                        offsets.end(),
+                        beginOffset + numBytes / n * i
+                    ) - offsets.begin());
+
+                if (endEntryIdx <= firstEntryIdx)
+                {
+                    continue;
+                }
+
+                const std::size_t firstGameIdx_ = firstGameIdx(firstEntryIdx);
+                const std::size_t endGameIdx = endEntryIdx < offsets.size() ? firstGameIdx(endEntryIdx) : numGames;
+                ranges.emplace_back(BcgnGameRange{
+                    firstGameIdx_,
+                    endGameIdx - firstGameIdx_,
+                    offsets[firstEntryIdx],
+                    endEntryIdx < offsets.size() ? offsets[endEntryIdx] : endOffset
+                });
+
+                firstEntryIdx = endEntryIdx;
+            }
+
+            return ranges;
+        }
+
+        // The number of bits used to encode an index when there are n choices.
+        [[nodiscard]] constexpr std::array<std::uint8_t, 64> makeLevel2NumBits()
+        {
+            std::array<std::uint8_t, 64> numBits{};
+
+            for (std::size_t n = 2; n < numBits.size(); ++n)
+            {
+                numBits[n] = numBits[n - 1] + ((n - 1) & (n - 2) ? 0 : 1);
+            }
+
+            return numBits;
+        }
+
+        constexpr auto level2NumBits = makeLevel2NumBits();
+
+        static_assert(level2NumBits[1] == 0);
+        static_assert(level2NumBits[2] == 1);
+        static_assert(level2NumBits[16] == 4);
+        static_assert(level2NumBits[17] == 5);
+        static_assert(level2NumBits[27] == 5);
+
+        // Pawn captures, knight and king moves, so that level 2 decoding
+        // doesn't call into Bitboard.cpp for them. Nothing for sliders.
+        [[nodiscard]] static const EnumArray2<Piece, Square, Bitboard>& level2LeaperAttacks()
+        {
+            // Local because it's built from tables in another translation unit.
+            static const EnumArray2<Piece, Square, Bitboard> attacks = []() {
+                EnumArray2<Piece, Square, Bitboard> attacks{};
+
+                for (Square sq = ::a1; sq != Square::none(); ++sq)
+                {
+                    for (Color color : { Color::White, Color::Black })
+                    {
+                        attacks[PieceType::Pawn | color][sq] = bb::pawnAttacks(Bitboard::square(sq), color);
+                        attacks[PieceType::Knight | color][sq] = bb::pseudoAttacks<PieceType::Knight>(sq);
+                        attacks[PieceType::King | color][sq] = bb::pseudoAttacks<PieceType::King>(sq);
+                    }
+                }
+
+                return attacks;
+            }();
+
+            return attacks;
+        }
+
+        // The n most significant bits. n must be less than 64.
+        [[nodiscard]] FORCEINLINE std::uint64_t topBits(std::uint64_t bits, std::size_t n)
+        {
+            return (bits >> 1) >> (63 - n);
+        }
+
+        [[nodiscard]] FORCEINLINE std::uint64_t rotateLeft(std::uint64_t bits, int n)
+        {
+            return (bits << n) | (bits >> (64 - n));
+        }
+    }
+
     void BcgnFileHeader::readFrom(const unsigned char* str)
     {
         if (str[0] != 'B'
@@ -59,6 +397,7 @@ namespace bcgn
         compressionLevel = static_cast<BcgnCompressionLevel>(compressionLevel_);
         auxCompression = static_cast<BcgnAuxCompression>(auxCompression_);
         isHeaderless = str[7] & 0x80;
+        hasGameOffsetDirectory = str[7] & 0x40;
     }
 
     [[nodiscard]] std::size_t BcgnFileHeader::writeTo(unsigned char* data)
@@ -72,14 +411,525 @@ namespace bcgn
         *data++ = static_cast<unsigned char>(version);
         *data++ = static_cast<unsigned char>(compressionLevel);
         *data++ = static_cast<unsigned char>(auxCompression);
-        *data++ = ((std::uint8_t)isHeaderless) << 7;
+        *data++ = (((std::uint8_t)isHeaderless) << 7) | (((std::uint8_t)hasGameOffsetDirectory) << 6);
+
+        return traits::bcgnFileHeaderLength;
+    }
+
+    [[noreturn]] void BcgnFileHeader::invalidHeader() const
+    {
+        throw std::runtime_error("Invalid header.");
+    }
+
+    BcgnGameOffsetDirectory::BcgnGameOffsetDirectory(std::size_t interval) :
+        m_interval(std::max<std::size_t>(interval, 1)),
+        m_numGames(0),
+        m_endOffset(0),
+        m_offsets{}
+    {
+    }
+
+    [[nodiscard]] std::filesystem::path BcgnGameOffsetDirectory::pathFor(const std::filesystem::path& bcgnPath)
+    {
+        auto path = bcgnPath;
+        path += ".offsets";
+        return path;
+    }
+
+    [[nodiscard]] std::optional<BcgnGameOffsetDirectory> BcgnGameOffsetDirectory::load(const std::filesystem::path& bcgnPath)
+    {
+        const auto path = pathFor(bcgnPath);
+
+        std::error_code ec;
+        const auto fileSize = std::filesystem::file_size(path, ec);
+        const auto bcgnFileSize = std::filesystem::file_size(bcgnPath, ec);
+        if (ec || fileSize < traits::gameOffsetDirectoryHeaderLength)
+        {
+            return {};
+        }
+
+        std::unique_ptr<FILE, decltype(&std::fclose)> file(std::fopen(path.string().c_str(), "rb"), &std::fclose);
+        if (file == nullptr)
+        {
+            return {};
+        }
+
+        std::vector<unsigned char> data(fileSize);
+        if (std::fread(data.data(), 1, data.size(), file.get()) != data.size())
+        {
+            return {};
+        }
+
+        const unsigned char* ptr = data.data();
+        if (ptr[0] != 'B' || ptr[1] != 'C' || ptr[2] != 'G' || ptr[3] != 'O' || ptr[4] != 0)
+        {
+            return {};
+        }
+        ptr += 8;
+
+        const std::size_t interval = (ptr[0] << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3];
+        ptr += 8;
+        if (interval == 0)
+        {
+            return {};
+        }
+
+        BcgnGameOffsetDirectory directory(interval);
+        directory.m_numGames = detail::readBigEndian64(ptr);
+        directory.m_endOffset = detail::readBigEndian64(ptr);
+
+        const std::size_t numOffsets = (directory.m_numGames + interval - 1) / interval;
+        if (directory.m_endOffset != bcgnFileSize
+            || fileSize != traits::gameOffsetDirectoryHeaderLength + numOffsets * 8)
+        {
+            return {};
+        }
+
+        directory.m_offsets.resize(numOffsets);
+        for (auto& offset : directory.m_offsets)
+        {
+            offset = detail::readBigEndian64(ptr);
+        }
+
+        return directory;
+    }
+
+    [[nodiscard]] BcgnGameOffsetDirectory BcgnGameOffsetDirectory::build(
+        const std::filesystem::path& bcgnPath,
+        std::size_t interval
+        )
+    {
+        BcgnGameOffsetDirectory directory(interval);
+
+        const auto fileSize = std::filesystem::file_size(bcgnPath);
+        std::unique_ptr<FILE, decltype(&std::fclose)> file(std::fopen(bcgnPath.string().c_str(), "rb"), &std::fclose);
+        if (file == nullptr)
+        {
+            throw std::runtime_error("Cannot open file " + bcgnPath.string());
+        }
+
+        std::uint64_t offset = traits::bcgnFileHeaderLength;
+        while (offset < fileSize)
+        {
+            const std::size_t size = detail::readGameEntrySize(file.get(), offset);
+            if (size == 0 || offset + size > fileSize)
+            {
+                throw std::runtime_error("Invalid game entry in " + bcgnPath.string());
+            }
+
+            directory.addGame(offset);
+            offset += size;
+        }
+
+        directory.setEndOffset(offset);
+
+        return directory;
+    }
+
+    void BcgnGameOffsetDirectory::save(const std::filesystem::path& bcgnPath) const
+    {
+        std::vector<unsigned char> data(traits::gameOffsetDirectoryHeaderLength + m_offsets.size() * 8, 0);
+
+        unsigned char* ptr = data.data();
+        *ptr++ = 'B';
+        *ptr++ = 'C';
+        *ptr++ = 'G';
+        *ptr++ = 'O';
+        ptr += 4;
+        *ptr++ = static_cast<unsigned char>(m_interval >> 24);
+        *ptr++ = static_cast<unsigned char>(m_interval >> 16);
+        *ptr++ = static_cast<unsigned char>(m_interval >> 8);
+        *ptr++ = static_cast<unsigned char>(m_interval);
+        ptr += 4;
+        detail::writeBigEndian64(ptr, m_numGames);
+        detail::writeBigEndian64(ptr, m_endOffset);
+        for (const auto offset : m_offsets)
+        {
+            detail::writeBigEndian64(ptr, offset);
+        }
+
+        const auto path = pathFor(bcgnPath);
+        std::unique_ptr<FILE, decltype(&std::fclose)> file(std::fopen(path.string().c_str(), "wb"), &std::fclose);
+        if (file == nullptr || std::fwrite(data.data(), 1, data.size(), file.get()) != data.size())
+        {
+            throw std::runtime_error("Cannot write file " + path.string());
+        }
+    }
+
+    void BcgnGameOffsetDirectory::addGame(std::uint64_t offset)
+    {
+        if (m_numGames % m_interval == 0)
+        {
+            m_offsets.emplace_back(offset);
+        }
+
+        m_numGames += 1;
+    }
+
+    void BcgnGameOffsetDirectory::setEndOffset(std::uint64_t offset)
+    {
+        m_endOffset = offset;
+    }
+
+    [[nodiscard]] std::size_t BcgnGameOffsetDirectory::interval() const
+    {
+        return m_interval;
+    }
+
+    [[nodiscard]] std::size_t BcgnGameOffsetDirectory::numGames() const
+    {
+        return m_numGames;
+    }
+
+    [[nodiscard]] std::uint64_t BcgnGameOffsetDirectory::endOffset() const
+    {
+        return m_endOffset;
+    }
+
+    [[nodiscard]] const std::vector<std::uint64_t>& BcgnGameOffsetDirectory::offsets() const
+    {
+        return m_offsets;
+    }
+
+    BcgnBlockIndex::BcgnBlockIndex() :
+        m_numGames(0),
+        m_endOffset(0),
+        m_entries{}
+    {
+    }
+
+    [[nodiscard]] std::filesystem::path BcgnBlockIndex::pathFor(const std::filesystem::path& bcgnPath)
+    {
+        auto path = bcgnPath;
+        path += ".blocks";
+        return path;
+    }
+
+    [[nodiscard]] std::optional<BcgnBlockIndex> BcgnBlockIndex::load(const std::filesystem::path& bcgnPath)
+    {
+        const auto path = pathFor(bcgnPath);
+
+        std::error_code ec;
+        const auto fileSize = std::filesystem::file_size(path, ec);
+        const auto bcgnFileSize = std::filesystem::file_size(bcgnPath, ec);
+        if (ec || fileSize < traits::blockIndexHeaderLength)
+        {
+            return {};
+        }
+
+        std::unique_ptr<FILE, decltype(&std::fclose)> file(std::fopen(path.string().c_str(), "rb"), &std::fclose);
+        if (file == nullptr)
+        {
+            return {};
+        }
+
+        std::vector<unsigned char> data(fileSize);
+        if (std::fread(data.data(), 1, data.size(), file.get()) != data.size())
+        {
+            return {};
+        }
+
+        const unsigned char* ptr = data.data();
+        if (ptr[0] != 'B' || ptr[1] != 'C' || ptr[2] != 'G' || ptr[3] != 'B' || ptr[4] != 0)
+        {
+            return {};
+        }
+        ptr += 8;
+
+        BcgnBlockIndex index;
+        const std::uint64_t numBlocks = detail::readBigEndian64(ptr);
+        index.m_numGames = detail::readBigEndian64(ptr);
+        index.m_endOffset = detail::readBigEndian64(ptr);
+
+        if (index.m_endOffset != bcgnFileSize
+            || fileSize != traits::blockIndexHeaderLength + numBlocks * 16)
+        {
+            return {};
+        }
+
+        index.m_entries.resize(numBlocks);
+        for (auto& entry : index.m_entries)
+        {
+            entry.offset = detail::readBigEndian64(ptr);
+            entry.firstGameIdx = detail::readBigEndian64(ptr);
+        }
+
+        return index;
+    }
+
+    [[nodiscard]] BcgnBlockIndex BcgnBlockIndex::build(const std::filesystem::path& bcgnPath)
+    {
+        BcgnBlockIndex index;
+
+        const auto fileSize = std::filesystem::file_size(bcgnPath);
+        std::unique_ptr<FILE, decltype(&std::fclose)> file(std::fopen(bcgnPath.string().c_str(), "rb"), &std::fclose);
+        if (file == nullptr)
+        {
+            throw std::runtime_error("Cannot open file " + bcgnPath.string());
+        }
+
+        std::uint64_t offset = traits::bcgnFileHeaderLength;
+        while (offset < fileSize)
+        {
+            unsigned char data[traits::auxCompressionBlockHeaderLength];
+            detail::seekFile(file.get(), offset);
+            if (std::fread(data, 1, sizeof(data), file.get()) != sizeof(data))
+            {
+                throw std::runtime_error("Invalid block in " + bcgnPath.string());
+            }
+
+            const auto header = detail::BlockHeader::readFrom(data);
+            const std::uint64_t size = traits::auxCompressionBlockHeaderLength + header.compressedLength;
+            if (offset + size > fileSize)
+            {
+                throw std::runtime_error("Invalid block in " + bcgnPath.string());
+            }
+
+            index.addBlock(offset, header.numGames);
+            offset += size;
+        }
+
+        index.setEndOffset(offset);
+
+        return index;
+    }
+
+    void BcgnBlockIndex::save(const std::filesystem::path& bcgnPath) const
+    {
+        std::vector<unsigned char> data(traits::blockIndexHeaderLength + m_entries.size() * 16, 0);
+
+        unsigned char* ptr = data.data();
+        *ptr++ = 'B';
+        *ptr++ = 'C';
+        *ptr++ = 'G';
+        *ptr++ = 'B';
+        ptr += 4;
+        detail::writeBigEndian64(ptr, m_entries.size());
+        detail::writeBigEndian64(ptr, m_numGames);
+        detail::writeBigEndian64(ptr, m_endOffset);
+        for (const auto& entry : m_entries)
+        {
+            detail::writeBigEndian64(ptr, entry.offset);
+            detail::writeBigEndian64(ptr, entry.firstGameIdx);
+        }
+
+        const auto path = pathFor(bcgnPath);
+        std::unique_ptr<FILE, decltype(&std::fclose)> file(std::fopen(path.string().c_str(), "wb"), &std::fclose);
+        if (file == nullptr || std::fwrite(data.data(), 1, data.size(), file.get()) != data.size())
+        {
+            throw std::runtime_error("Cannot write file " + path.string());
+        }
+    }
+
+    void BcgnBlockIndex::addBlock(std::uint64_t offset, std::size_t numGames)
+    {
+        m_entries.emplace_back(Entry{ offset, m_numGames });
+        m_numGames += numGames;
+    }
+
+    void BcgnBlockIndex::setEndOffset(std::uint64_t offset)
+    {
+        m_endOffset = offset;
+    }
+
+    [[nodiscard]] std::size_t BcgnBlockIndex::numGames() const
+    {
+        return m_numGames;
+    }
+
+    [[nodiscard]] std::uint64_t BcgnBlockIndex::endOffset() const
+    {
+        return m_endOffset;
+    }
+
+    [[nodiscard]] const std::vector<BcgnBlockIndex::Entry>& BcgnBlockIndex::entries() const
+    {
+        return m_entries;
+    }
+
+    BcgnPositionKeyFileWriter::BcgnPositionKeyFileWriter(const std::filesystem::path& bcgnPath) :
+        m_bcgnPath(bcgnPath),
+        m_file(nullptr, &std::fclose),
+        m_numGames(0),
+        m_numPositions(0)
+    {
+        const auto path = BcgnPositionKeyFileReader::pathFor(bcgnPath);
+        m_file.reset(std::fopen(path.string().c_str(), "wb"));
+
+        // The header is written by finalize, an unfinished file is never valid.
+        const unsigned char header[traits::positionKeyFileHeaderLength]{};
+        if (m_file == nullptr || std::fwrite(header, 1, sizeof(header), m_file.get()) != sizeof(header))
+        {
+            throw std::runtime_error("Cannot write file " + path.string());
+        }
+    }
+
+    void BcgnPositionKeyFileWriter::encodeGame(std::vector<unsigned char>& data, const std::vector<BcgnPositionKey>& keys)
+    {
+        ASSERT(!keys.empty() && keys.size() <= 256 * 256);
+
+        const std::size_t begin = data.size();
+        data.resize(begin + 2 + keys.size() * traits::positionKeyLength);
+
+        unsigned char* ptr = data.data() + begin;
+        const std::size_t numPlies = keys.size() - 1;
+        *ptr++ = static_cast<unsigned char>(numPlies >> 8);
+        *ptr++ = static_cast<unsigned char>(numPlies);
+        for (auto&& key : keys)
+        {
+            detail::writeBigEndian64(ptr, key.zobrist.high);
+            detail::writeBigEndian64(ptr, key.zobrist.low);
+            detail::writeBigEndian32(ptr, key.packedReverseMove.packed());
+        }
+    }
+
+    void BcgnPositionKeyFileWriter::writeEncodedGames(const unsigned char* data, std::size_t length, std::size_t numGames)
+    {
+        if (std::fwrite(data, 1, length, m_file.get()) != length)
+        {
+            throw std::runtime_error("Cannot write file " + BcgnPositionKeyFileReader::pathFor(m_bcgnPath).string());
+        }
+
+        m_numGames += numGames;
+        m_numPositions += (length - numGames * 2) / traits::positionKeyLength;
+    }
+
+    void BcgnPositionKeyFileWriter::finalize()
+    {
+        unsigned char header[traits::positionKeyFileHeaderLength]{};
+
+        unsigned char* ptr = header;
+        *ptr++ = 'B';
+        *ptr++ = 'C';
+        *ptr++ = 'G';
+        *ptr++ = 'K';
+        *ptr++ = positionKeyFileVersion;
+        ptr += 3;
+        const std::uint64_t bcgnFileSize = std::filesystem::file_size(m_bcgnPath);
+        const auto fingerprint = detail::computeFileFingerprint(m_bcgnPath, bcgnFileSize);
+        if (!fingerprint.has_value())
+        {
+            throw std::runtime_error("Cannot read file " + m_bcgnPath.string());
+        }
+        detail::writeBigEndian64(ptr, m_numGames);
+        detail::writeBigEndian64(ptr, m_numPositions);
+        detail::writeBigEndian64(ptr, bcgnFileSize);
+        detail::writeBigEndian64(ptr, *fingerprint);
+
+        detail::seekFile(m_file.get(), 0);
+        if (std::fwrite(header, 1, sizeof(header), m_file.get()) != sizeof(header)
+            || std::fflush(m_file.get()) != 0)
+        {
+            throw std::runtime_error("Cannot write file " + BcgnPositionKeyFileReader::pathFor(m_bcgnPath).string());
+        }
+    }
+
+    BcgnPositionKeyFileReader::BcgnPositionKeyFileReader(
+        std::unique_ptr<char[]> fileBuffer,
+        std::unique_ptr<FILE, decltype(&std::fclose)> file,
+        std::size_t numGames
+        ) :
+        m_fileBuffer(std::move(fileBuffer)),
+        m_file(std::move(file)),
+        m_numGames(numGames),
+        m_data{},
+        m_keys{}
+    {
+    }
+
+    [[nodiscard]] std::filesystem::path BcgnPositionKeyFileReader::pathFor(const std::filesystem::path& bcgnPath)
+    {
+        auto path = bcgnPath;
+        path += ".keys";
+        return path;
+    }
+
+    [[nodiscard]] std::optional<BcgnPositionKeyFileReader> BcgnPositionKeyFileReader::open(const std::filesystem::path& bcgnPath)
+    {
+        // Keys are read a game at a time, the buffer avoids a syscall for each.
+        constexpr std::size_t fileBufferSize = 1024ull * 1024ull;
+
+        const auto path = pathFor(bcgnPath);
+
+        std::error_code ec;
+        const auto fileSize = std::filesystem::file_size(path, ec);
+        const auto bcgnFileSize = std::filesystem::file_size(bcgnPath, ec);
+        if (ec || fileSize < traits::positionKeyFileHeaderLength)
+        {
+            return {};
+        }
+
+        auto fileBuffer = std::make_unique<char[]>(fileBufferSize);
+        std::unique_ptr<FILE, decltype(&std::fclose)> file(std::fopen(path.string().c_str(), "rb"), &std::fclose);
+        if (file == nullptr || std::setvbuf(file.get(), fileBuffer.get(), _IOFBF, fileBufferSize) != 0)
+        {
+            return {};
+        }
+
+        unsigned char header[traits::positionKeyFileHeaderLength];
+        if (std::fread(header, 1, sizeof(header), file.get()) != sizeof(header))
+        {
+            return {};
+        }
+
+        const unsigned char* ptr = header;
+        if (ptr[0] != 'B' || ptr[1] != 'C' || ptr[2] != 'G' || ptr[3] != 'K' || ptr[4] != BcgnPositionKeyFileWriter::positionKeyFileVersion)
+        {
+            return {};
+        }
+        ptr += 8;
+
+        const std::uint64_t numGames = detail::readBigEndian64(ptr);
+        const std::uint64_t numPositions = detail::readBigEndian64(ptr);
+        const std::uint64_t endOffset = detail::readBigEndian64(ptr);
+        const std::uint64_t fingerprint = detail::readBigEndian64(ptr);
+
+        if (endOffset != bcgnFileSize
+            || fileSize != traits::positionKeyFileHeaderLength + numGames * 2 + numPositions * traits::positionKeyLength)
+        {
+            return {};
+        }
+
+        // A file rewritten with the same size.
+        if (detail::computeFileFingerprint(bcgnPath, bcgnFileSize) != fingerprint)
+        {
+            return {};
+        }
+
+        return BcgnPositionKeyFileReader(std::move(fileBuffer), std::move(file), numGames);
+    }
+
+    [[nodiscard]] std::size_t BcgnPositionKeyFileReader::numGames() const
+    {
+        return m_numGames;
+    }
+
+    [[nodiscard]] const std::vector<BcgnPositionKey>& BcgnPositionKeyFileReader::nextGame()
+    {
+        unsigned char numPliesData[2];
+        if (std::fread(numPliesData, 1, 2, m_file.get()) != 2)
+        {
+            throw std::runtime_error("Unexpected end of position key file.");
+        }
+
+        const std::size_t numKeys = ((numPliesData[0] << 8) | numPliesData[1]) + 1;
+        m_data.resize(numKeys * traits::positionKeyLength);
+        if (std::fread(m_data.data(), 1, m_data.size(), m_file.get()) != m_data.size())
+        {
+            throw std::runtime_error("Unexpected end of position key file.");
+        }
 
-        return traits::bcgnFileHeaderLength;
-    }
+        m_keys.clear();
+        const unsigned char* ptr = m_data.data();
+        for (std::size_t i = 0; i < numKeys; ++i)
+        {
+            const std::uint64_t high = detail::readBigEndian64(ptr);
+            const std::uint64_t low = detail::readBigEndian64(ptr);
+            const std::uint32_t packed = detail::readBigEndian32(ptr);
+            m_keys.push_back(BcgnPositionKey{ ZobristKey(high, low), PackedReverseMove(packed) });
+        }
 
-    [[noreturn]] void BcgnFileHeader::invalidHeader() const
-    {
-        throw std::runtime_error("Invalid header.");
+        return m_keys;
     }
 
     BcgnGameFlags::BcgnGameFlags() :
@@ -500,6 +1350,347 @@ namespace bcgn
 
             return length;
         }
+
+        void BcgnGameEntryBuffer::addMove(const Position& pos, const Move& move)
+        {
+            switch (m_header.compressionLevel)
+            {
+            case BcgnCompressionLevel::Level_0:
+                addCompressedMove(move.compress());
+                break;
+
+            case BcgnCompressionLevel::Level_1:
+                if (move_index::requiresLongMoveIndex(pos))
+                {
+                    addLongMove(move_index::moveToLongIndex(pos, move));
+                }
+                else
+                {
+                    addShortMove(move_index::moveToShortIndex(pos, move));
+                }
+
+                break;
+
+            case BcgnCompressionLevel::Level_2:
+            {
+                const Color sideToMove = pos.sideToMove();
+                const Bitboard ourPieces = pos.piecesBB(sideToMove);
+                const Bitboard theirPieces = pos.piecesBB(!sideToMove);
+                const Bitboard occupied = ourPieces | theirPieces;
+
+                const std::uint8_t pieceId = (pos.piecesBB(sideToMove) & bb::before(move.from)).count();
+                std::size_t numMoves = 0;
+                std::uint8_t moveId = 0;
+                const auto pt = pos.pieceAt(move.from).type();
+                switch (pt)
+                {
+                case PieceType::Pawn:
+                {
+                    const Rank secondToLastRank = pos.sideToMove() == Color::White ? rank7 : rank2;
+                    const Rank startRank = pos.sideToMove() == Color::White ? rank2 : rank7;
+                    const auto forward = sideToMove == Color::White ? FlatSquareOffset(0, 1) : FlatSquareOffset(0, -1);
+
+                    const Square epSquare = pos.epSquare();
+
+                    Bitboard attackTargets = theirPieces;
+                    if (epSquare != Square::none())
+                    {
+                        attackTargets |= epSquare;
+                    }
+
+                    Bitboard destinations = bb::pawnAttacks(Bitboard::square(move.from), sideToMove) & attackTargets;
+
+                    const Square sqForward = move.from + forward;
+                    if (!occupied.isSet(sqForward))
+                    {
+                        destinations |= sqForward;
+
+                        const Square sqForward2 = sqForward + forward;
+                        if (
+                            move.from.rank() == startRank 
+                            && !occupied.isSet(sqForward2)
+                            )
+                        {
+                            destinations |= sqForward2;
+                        }
+                    }
+
+                    moveId = (destinations & bb::before(move.to)).count();
+                    numMoves = destinations.count();
+                    if (move.from.rank() == secondToLastRank)
+                    {
+                        const auto promotionIndex = (ordinal(move.promotedPiece.type()) - ordinal(PieceType::Knight));
+                        moveId = moveId * 4 + promotionIndex;
+                        numMoves *= 4;
+                    }
+
+                    break;
+                }
+                case PieceType::King:
+                {
+                    const CastlingRights ourCastlingRightsMask = 
+                        sideToMove == Color::White 
+                        ? CastlingRights::White 
+                        : CastlingRights::Black;
+
+                    const CastlingRights castlingRights = pos.castlingRights();
+
+                    const Bitboard attacks = bb::pseudoAttacks<PieceType::King>(move.from) & ~ourPieces;
+                    const auto attacksSize = attacks.count();
+                    const auto numCastlingRights = intrin::popcount(ordinal(castlingRights & ourCastlingRightsMask));
+
+                    numMoves += attacksSize;
+                    numMoves += numCastlingRights;
+
+                    if (move.type == MoveType::Castle)
+                    {
+                        const auto longCastlingRights = CastlingTraits::castlingRights[sideToMove][CastleType::Long];
+
+                        moveId = attacksSize - 1;
+
+                        if (contains(castlingRights, longCastlingRights))
+                        {
+                            // We have to add one no matter if it's the used one or not.
+                            moveId += 1;
+                        }
+
+                        if (CastlingTraits::moveCastlingType(move) == CastleType::Short)
+                        {
+                            moveId += 1;
+                        }
+                    }
+                    else
+                    {
+                        moveId = (attacks & bb::before(move.to)).count();
+                    }
+                    break;
+                }
+                default:
+                {
+                    const Bitboard attacks = bb::attacks(pt, move.from, occupied) & ~ourPieces;
+
+                    moveId = (attacks & bb::before(move.to)).count();
+                    numMoves = attacks.count();
+                }
+                }
+
+                const std::size_t numPieces = ourPieces.count();
+                addBitsLE8x2(
+                    pieceId, util::usedBits(numPieces - 1u), 
+                    moveId, util::usedBits(numMoves - 1u)
+                );
+                break;
+            }
+            }
+        }
+    }
+
+    namespace detail
+    {
+        BcgnBlockDecompressor::BcgnBlockDecompressor(
+            FILE* file,
+            BcgnAuxCompression auxCompression,
+            std::uint64_t numBytesToRead
+            ) :
+            m_file(file),
+            m_auxCompression(auxCompression),
+            m_numBytesLeftToRead(numBytesToRead),
+            m_maxNumBlocksQueued(2 * maxNumBlocksDecompressedInParallel()),
+            m_decompressedBlocks{},
+            m_numBlocksRead(0),
+            m_numBlocksConsumed(0),
+            m_exception{},
+            m_exceptionBlockIdx(0),
+            m_hasFailed(false),
+            m_isEndReached(false),
+            m_isStopping(false),
+            m_currentBlock{}
+        {
+            const std::size_t numWorkers = maxNumBlocksDecompressedInParallel();
+            m_workers.reserve(numWorkers);
+            for (std::size_t i = 0; i < numWorkers; ++i)
+            {
+                m_workers.emplace_back([this]() { decompressAhead(); });
+            }
+        }
+
+        BcgnBlockDecompressor::~BcgnBlockDecompressor()
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_isStopping = true;
+            }
+            m_queueNotFull.notify_all();
+
+            for (auto& worker : m_workers)
+            {
+                worker.join();
+            }
+        }
+
+        [[nodiscard]] util::UnsignedCharBufferView BcgnBlockDecompressor::nextBlock()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_hasFailed)
+            {
+                m_currentBlock.clear();
+                return {};
+            }
+
+            auto isNextBlockFailed = [this]() {
+                return m_exception != nullptr && m_exceptionBlockIdx == m_numBlocksConsumed;
+            };
+
+            m_blockReady.wait(lock, [this, &isNextBlockFailed]() {
+                return m_decompressedBlocks.count(m_numBlocksConsumed) != 0
+                    || isNextBlockFailed()
+                    || (m_isEndReached && m_numBlocksConsumed == m_numBlocksRead);
+            });
+
+            auto it = m_decompressedBlocks.find(m_numBlocksConsumed);
+            if (it == m_decompressedBlocks.end())
+            {
+                m_currentBlock.clear();
+
+                if (isNextBlockFailed())
+                {
+                    m_hasFailed = true;
+                    std::rethrow_exception(std::exchange(m_exception, nullptr));
+                }
+
+                return {};
+            }
+
+            m_currentBlock = std::move(it->second);
+            m_decompressedBlocks.erase(it);
+            m_numBlocksConsumed += 1;
+
+            lock.unlock();
+            m_queueNotFull.notify_one();
+
+            return util::UnsignedCharBufferView(m_currentBlock.data(), m_currentBlock.size());
+        }
+
+        void BcgnBlockDecompressor::decompressAhead()
+        {
+            for (;;)
+            {
+                std::size_t blockIdx;
+                std::optional<CompressedBlock> compressed;
+
+                {
+                    std::unique_lock<std::mutex> fileLock(m_fileMutex);
+
+                    {
+                        std::unique_lock<std::mutex> lock(m_mutex);
+                        m_queueNotFull.wait(lock, [this]() {
+                            return m_numBlocksRead - m_numBlocksConsumed < m_maxNumBlocksQueued
+                                || m_isEndReached
+                                || m_isStopping;
+                        });
+
+                        if (m_isEndReached || m_isStopping)
+                        {
+                            return;
+                        }
+
+                        blockIdx = m_numBlocksRead;
+                    }
+
+                    try
+                    {
+                        compressed = readBlock();
+                    }
+                    catch (...)
+                    {
+                        std::unique_lock<std::mutex> lock(m_mutex);
+                        setException(blockIdx, std::current_exception());
+                    }
+
+                    {
+                        std::unique_lock<std::mutex> lock(m_mutex);
+                        if (!compressed.has_value())
+                        {
+                            m_isEndReached = true;
+                        }
+                        else
+                        {
+                            m_numBlocksRead += 1;
+                        }
+                    }
+
+                    if (!compressed.has_value())
+                    {
+                        m_queueNotFull.notify_all();
+                        m_blockReady.notify_one();
+                        return;
+                    }
+                }
+
+                try
+                {
+                    auto block = decompressBlock(m_auxCompression, compressed->data, compressed->uncompressedLength);
+
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_decompressedBlocks.emplace(blockIdx, std::move(block));
+                }
+                catch (...)
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    setException(blockIdx, std::current_exception());
+                }
+
+                m_blockReady.notify_one();
+            }
+        }
+
+        void BcgnBlockDecompressor::setException(std::size_t blockIdx, std::exception_ptr exception)
+        {
+            // Nothing after a failed block is read.
+            m_isEndReached = true;
+
+            if (m_exception == nullptr || blockIdx < m_exceptionBlockIdx)
+            {
+                m_exception = std::move(exception);
+                m_exceptionBlockIdx = blockIdx;
+            }
+        }
+
+        [[nodiscard]] std::optional<BcgnBlockDecompressor::CompressedBlock> BcgnBlockDecompressor::readBlock()
+        {
+            if (m_numBytesLeftToRead == 0)
+            {
+                return {};
+            }
+
+            unsigned char data[traits::auxCompressionBlockHeaderLength];
+            if (m_numBytesLeftToRead < sizeof(data)
+                || std::fread(data, 1, sizeof(data), m_file) != sizeof(data))
+            {
+                throw std::runtime_error("Truncated block header.");
+            }
+
+            m_numBytesLeftToRead -= sizeof(data);
+
+            const auto header = BlockHeader::readFrom(data);
+            if (header.uncompressedLength == 0
+                || header.uncompressedLength > traits::maxAuxCompressionBlockLength
+                || header.compressedLength > maxCompressedBlockLength)
+            {
+                throw std::runtime_error("Invalid block header.");
+            }
+
+            CompressedBlock block{ std::vector<unsigned char>(header.compressedLength), header.uncompressedLength };
+            if (m_numBytesLeftToRead < block.data.size()
+                || std::fread(block.data.data(), 1, block.data.size(), m_file) != block.data.size())
+            {
+                throw std::runtime_error("Truncated block.");
+            }
+
+            m_numBytesLeftToRead -= block.data.size();
+
+            return block;
+        }
     }
 
     BcgnFileWriter::BcgnFileWriter(
@@ -515,12 +1706,47 @@ namespace bcgn
         m_buffer(std::max(bufferSize, traits::minBufferSize)),
         m_numBytesUsedInFrontBuffer(0),
         m_numBytesBeingWritten(0),
-        m_future{}
+        m_future{},
+        m_directory{},
+        m_fileOffset(0),
+        m_block{},
+        m_numBytesUsedInBlock(0),
+        m_numGamesInBlock(0),
+        m_compressedBlocks{},
+        m_blockIndex{}
     {
         const bool needsHeader = 
             (mode != FileOpenMode::Append) 
             || !std::filesystem::exists(path);
 
+        if (!needsHeader)
+        {
+            prepareForAppend();
+        }
+        else
+        {
+            if (m_header.hasGameOffsetDirectory)
+            {
+                m_directory.emplace();
+            }
+
+            if (m_header.auxCompression != BcgnAuxCompression::None)
+            {
+                m_blockIndex.emplace();
+            }
+        }
+
+        if (m_header.auxCompression != BcgnAuxCompression::None)
+        {
+            // The block index takes the role of the game offset directory.
+            if (m_header.hasGameOffsetDirectory)
+            {
+                throw std::runtime_error("Game offset directory is not supported with aux compression.");
+            }
+
+            m_block.resize(traits::maxAuxCompressionBlockLength);
+        }
+
         auto strPath = path.string();
         m_file.reset(std::fopen(
             strPath.c_str(),
@@ -626,177 +1852,231 @@ namespace bcgn
 
     void BcgnFileWriter::addMove(const Position& pos, const Move& move)
     {
-        switch (m_header.compressionLevel)
+        m_game->addMove(pos, move);
+    }
+
+    void BcgnFileWriter::endGame()
+    {
+        writeCurrentGame();
+
+        // We don't know how much the next game will take
+        // and we don't want to compute the size before writing.
+        // So we ensure that we always have enough space in the buffer.
+        // The buffer is not big anyway so this shouldn't be an issue.
+        if (!enoughSpaceForNextGame())
         {
-        case BcgnCompressionLevel::Level_0:
-            m_game->addCompressedMove(move.compress());
-            break;
+            swapAndPersistFrontBuffer();
+        }
+    }
 
-        case BcgnCompressionLevel::Level_1:
-            if (move_index::requiresLongMoveIndex(pos))
+    void BcgnFileWriter::writeEncodedGames(const unsigned char* data, std::size_t size)
+    {
+        if (m_blockIndex.has_value())
+        {
+            // Blocks can only end between games.
+            while (size > 0)
             {
-                m_game->addLongMove(move_index::moveToLongIndex(pos, move));
+                const std::size_t gameSize = (data[0] << 8) | data[1];
+                addGameToBlock(data, gameSize);
+                data += gameSize;
+                size -= gameSize;
             }
-            else
+
+            return;
+        }
+
+        if (m_directory.has_value())
+        {
+            const std::uint64_t baseOffset = m_fileOffset + m_numBytesUsedInFrontBuffer;
+            for (std::size_t offset = 0; offset < size; offset += (data[offset] << 8) | data[offset + 1])
             {
-                m_game->addShortMove(move_index::moveToShortIndex(pos, move));
+                m_directory->addGame(baseOffset + offset);
             }
+        }
 
-            break;
-
-        case BcgnCompressionLevel::Level_2:
+        while (size > 0)
         {
-            const Color sideToMove = pos.sideToMove();
-            const Bitboard ourPieces = pos.piecesBB(sideToMove);
-            const Bitboard theirPieces = pos.piecesBB(!sideToMove);
-            const Bitboard occupied = ourPieces | theirPieces;
+            // Games may be split between buffers, they are written in order anyway.
+            const std::size_t numBytes = std::min(size, m_buffer.size() - m_numBytesUsedInFrontBuffer);
+            std::memcpy(m_buffer.data() + m_numBytesUsedInFrontBuffer, data, numBytes);
+            m_numBytesUsedInFrontBuffer += numBytes;
+            data += numBytes;
+            size -= numBytes;
 
-            const std::uint8_t pieceId = (pos.piecesBB(sideToMove) & bb::before(move.from)).count();
-            std::size_t numMoves = 0;
-            std::uint8_t moveId = 0;
-            const auto pt = pos.pieceAt(move.from).type();
-            switch (pt)
+            if (!enoughSpaceForNextGame())
             {
-            case PieceType::Pawn:
-            {
-                const Rank secondToLastRank = pos.sideToMove() == Color::White ? rank7 : rank2;
-                const Rank startRank = pos.sideToMove() == Color::White ? rank2 : rank7;
-                const auto forward = sideToMove == Color::White ? FlatSquareOffset(0, 1) : FlatSquareOffset(0, -1);
+                swapAndPersistFrontBuffer();
+            }
+        }
+    }
 
-                const Square epSquare = pos.epSquare();
+    void BcgnFileWriter::flush()
+    {
+        if (m_blockIndex.has_value())
+        {
+            submitBlock();
+            while (!m_compressedBlocks.empty())
+            {
+                writeOldestBlock();
+            }
+        }
 
-                Bitboard attackTargets = theirPieces;
-                if (epSquare != Square::none())
-                {
-                    attackTargets |= epSquare;
-                }
+        swapAndPersistFrontBuffer();
 
-                Bitboard destinations = bb::pawnAttacks(Bitboard::square(move.from), sideToMove) & attackTargets;
+        if (m_future.valid())
+        {
+            m_future.get();
+        }
 
-                const Square sqForward = move.from + forward;
-                if (!occupied.isSet(sqForward))
-                {
-                    destinations |= sqForward;
+        std::fflush(m_file.get());
 
-                    const Square sqForward2 = sqForward + forward;
-                    if (
-                        move.from.rank() == startRank 
-                        && !occupied.isSet(sqForward2)
-                        )
-                    {
-                        destinations |= sqForward2;
-                    }
-                }
+        if (m_directory.has_value())
+        {
+            // Saved only after the games it points to are in the file.
+            m_directory->setEndOffset(m_fileOffset);
+            m_directory->save(m_path);
+        }
 
-                moveId = (destinations & bb::before(move.to)).count();
-                numMoves = destinations.count();
-                if (move.from.rank() == secondToLastRank)
-                {
-                    const auto promotionIndex = (ordinal(move.promotedPiece.type()) - ordinal(PieceType::Knight));
-                    moveId = moveId * 4 + promotionIndex;
-                    numMoves *= 4;
-                }
+        if (m_blockIndex.has_value())
+        {
+            m_blockIndex->setEndOffset(m_fileOffset);
+            m_blockIndex->save(m_path);
+        }
+    }
 
-                break;
-            }
-            case PieceType::King:
-            {
-                const CastlingRights ourCastlingRightsMask = 
-                    sideToMove == Color::White 
-                    ? CastlingRights::White 
-                    : CastlingRights::Black;
+    BcgnFileWriter::~BcgnFileWriter()
+    {
+        flush();
+    }
 
-                const CastlingRights castlingRights = pos.castlingRights();
+    void BcgnFileWriter::prepareForAppend()
+    {
+        // The header of the existing file decides whether there is
+        // a directory and whether the games are in compressed blocks.
+        m_fileOffset = std::filesystem::file_size(m_path);
+        if (m_fileOffset < traits::bcgnFileHeaderLength)
+        {
+            return;
+        }
 
-                const Bitboard attacks = bb::pseudoAttacks<PieceType::King>(move.from) & ~ourPieces;
-                const auto attacksSize = attacks.count();
-                const auto numCastlingRights = intrin::popcount(ordinal(castlingRights & ourCastlingRightsMask));
+        unsigned char data[traits::bcgnFileHeaderLength];
+        {
+            std::unique_ptr<FILE, decltype(&std::fclose)> file(std::fopen(m_path.string().c_str(), "rb"), &std::fclose);
+            if (file == nullptr || std::fread(data, 1, traits::bcgnFileHeaderLength, file.get()) != traits::bcgnFileHeaderLength)
+            {
+                return;
+            }
+        }
 
-                numMoves += attacksSize;
-                numMoves += numCastlingRights;
+        BcgnFileHeader existingHeader{};
+        existingHeader.readFrom(data);
+        m_header.hasGameOffsetDirectory = existingHeader.hasGameOffsetDirectory;
+        m_header.auxCompression = existingHeader.auxCompression;
+        if (m_header.auxCompression != BcgnAuxCompression::None)
+        {
+            m_blockIndex = BcgnBlockIndex::load(m_path);
+            if (!m_blockIndex.has_value())
+            {
+                m_blockIndex = BcgnBlockIndex::build(m_path);
+            }
+        }
 
-                if (move.type == MoveType::Castle)
-                {
-                    const auto longCastlingRights = CastlingTraits::castlingRights[sideToMove][CastleType::Long];
+        if (m_header.hasGameOffsetDirectory)
+        {
+            // The file could have been appended to by a writer that didn't update the directory.
+            m_directory = BcgnGameOffsetDirectory::load(m_path);
+            if (!m_directory.has_value())
+            {
+                m_directory = BcgnGameOffsetDirectory::build(m_path);
+            }
+        }
+    }
 
-                    moveId = attacksSize - 1;
+    void BcgnFileWriter::writeFileHeader()
+    {
+        unsigned char* data = m_buffer.data();
+        m_numBytesUsedInFrontBuffer += m_header.writeTo(data);
+    }
 
-                    if (contains(castlingRights, longCastlingRights))
-                    {
-                        // We have to add one no matter if it's the used one or not.
-                        moveId += 1;
-                    }
+    void BcgnFileWriter::writeCurrentGame()
+    {
+        if (m_blockIndex.has_value())
+        {
+            const auto bytesWritten =
+                m_game->writeTo(m_block.data() + m_numBytesUsedInBlock);
+            m_numBytesUsedInBlock += bytesWritten;
+            m_numGamesInBlock += 1;
 
-                    if (CastlingTraits::moveCastlingType(move) == CastleType::Short)
-                    {
-                        moveId += 1;
-                    }
-                }
-                else
-                {
-                    moveId = (attacks & bb::before(move.to)).count();
-                }
-                break;
-            }
-            default:
+            if (m_numBytesUsedInBlock >= traits::auxCompressionBlockSize)
             {
-                const Bitboard attacks = bb::attacks(pt, move.from, occupied) & ~ourPieces;
-
-                moveId = (attacks & bb::before(move.to)).count();
-                numMoves = attacks.count();
-            }
+                submitBlock();
             }
 
-            const std::size_t numPieces = ourPieces.count();
-            m_game->addBitsLE8x2(
-                pieceId, util::usedBits(numPieces - 1u), 
-                moveId, util::usedBits(numMoves - 1u)
-            );
-            break;
+            return;
         }
+
+        if (m_directory.has_value())
+        {
+            m_directory->addGame(m_fileOffset + m_numBytesUsedInFrontBuffer);
         }
+
+        const auto bytesWritten = 
+            m_game->writeTo(m_buffer.data() + m_numBytesUsedInFrontBuffer);
+        m_numBytesUsedInFrontBuffer += bytesWritten;
     }
 
-    void BcgnFileWriter::endGame()
+    void BcgnFileWriter::addGameToBlock(const unsigned char* data, std::size_t size)
     {
-        writeCurrentGame();
+        std::memcpy(m_block.data() + m_numBytesUsedInBlock, data, size);
+        m_numBytesUsedInBlock += size;
+        m_numGamesInBlock += 1;
 
-        // We don't know how much the next game will take
-        // and we don't want to compute the size before writing.
-        // So we ensure that we always have enough space in the buffer.
-        // The buffer is not big anyway so this shouldn't be an issue.
-        if (!enoughSpaceForNextGame())
+        if (m_numBytesUsedInBlock >= traits::auxCompressionBlockSize)
         {
-            swapAndPersistFrontBuffer();
+            submitBlock();
         }
     }
 
-    void BcgnFileWriter::flush()
+    void BcgnFileWriter::submitBlock()
     {
-        swapAndPersistFrontBuffer();
+        if (m_numGamesInBlock == 0)
+        {
+            return;
+        }
 
-        if (m_future.valid())
+        m_compressedBlocks.emplace_back(std::async(
+            std::launch::async,
+            [auxCompression = m_header.auxCompression,
+            games = std::vector<unsigned char>(m_block.begin(), m_block.begin() + m_numBytesUsedInBlock),
+            numGames = m_numGamesInBlock]() {
+                return detail::compressBlock(auxCompression, games, numGames);
+            }));
+
+        m_numBytesUsedInBlock = 0;
+        m_numGamesInBlock = 0;
+
+        if (m_compressedBlocks.size() > detail::maxNumBlocksInFlight())
         {
-            m_future.get();
+            writeOldestBlock();
         }
     }
 
-    BcgnFileWriter::~BcgnFileWriter()
+    void BcgnFileWriter::writeOldestBlock()
     {
-        flush();
-    }
+        const std::vector<unsigned char> block = m_compressedBlocks.front().get();
+        m_compressedBlocks.pop_front();
 
-    void BcgnFileWriter::writeFileHeader()
-    {
-        unsigned char* data = m_buffer.data();
-        m_numBytesUsedInFrontBuffer += m_header.writeTo(data);
-    }
+        // The file header may still be in the buffer.
+        swapAndPersistFrontBuffer();
+        if (m_future.valid())
+        {
+            m_future.get();
+        }
 
-    void BcgnFileWriter::writeCurrentGame()
-    {
-        const auto bytesWritten = 
-            m_game->writeTo(m_buffer.data() + m_numBytesUsedInFrontBuffer);
-        m_numBytesUsedInFrontBuffer += bytesWritten;
+        m_blockIndex->addBlock(m_fileOffset, detail::BlockHeader::readFrom(block.data()).numGames);
+
+        std::fwrite(block.data(), 1, block.size(), m_file.get());
+        m_fileOffset += block.size();
     }
 
     [[nodiscard]] bool BcgnFileWriter::enoughSpaceForNextGame() const
@@ -818,6 +2098,7 @@ namespace bcgn
 
         m_buffer.swap();
         m_numBytesBeingWritten = m_numBytesUsedInFrontBuffer;
+        m_fileOffset += m_numBytesUsedInFrontBuffer;
         m_numBytesUsedInFrontBuffer = 0;
 
         m_future = std::async(std::launch::async, [this]() {
@@ -837,7 +2118,7 @@ namespace bcgn
         ) noexcept :
         m_header(header),
         m_encodedMovetext(movetext),
-        m_bitsLeft(8),
+        m_bitOffset(0),
         m_numMovesLeft(numMovesLeft)
     {
     }
@@ -881,150 +2162,163 @@ namespace bcgn
         }
 
         case BcgnCompressionLevel::Level_2:
-        {
-            const Color sideToMove = pos.sideToMove();
-            const Bitboard ourPieces = pos.piecesBB(sideToMove);
-            const Bitboard theirPieces = pos.piecesBB(!sideToMove);
-            const Bitboard occupied = ourPieces | theirPieces;
+            return nextLevel2(pos);
+        }
 
-            const auto pieceId = extractBitsLE8(util::usedBits(ourPieces.count() - 1ull));
-            const auto from = Square(nthSetBitIndex(ourPieces.bits(), pieceId));
+        ASSERT(false);
+        return Move::null();
+    }
 
-            const auto pt = pos.pieceAt(from).type();
-            switch (pt)
-            {
-            case PieceType::Pawn:
-            {
-                const Rank promotionRank = pos.sideToMove() == Color::White ? rank7 : rank2;
-                const Rank startRank = pos.sideToMove() == Color::White ? rank2 : rank7;
-                const auto forward = sideToMove == Color::White ? FlatSquareOffset(0, 1) : FlatSquareOffset(0, -1);
+    [[nodiscard]] Move UnparsedBcgnGameMoves::nextLevel2(const Position& pos)
+    {
+        const auto& leaperAttacks = detail::level2LeaperAttacks();
 
-                const Square epSquare = pos.epSquare();
+        const Color sideToMove = pos.sideToMove();
+        const Bitboard ourPieces = pos.piecesBB(sideToMove);
+        const Bitboard theirPieces = pos.piecesBB(!sideToMove);
+        const Bitboard occupied = ourPieces | theirPieces;
 
-                Bitboard attackTargets = theirPieces;
-                if (epSquare != Square::none())
-                {
-                    attackTargets |= epSquare;
-                }
+        // Both indices are read from one word. Together they take at most 4 + 5 bits.
+        std::uint64_t bits = peekBits();
 
-                Bitboard destinations = bb::pawnAttacks(Bitboard::square(from), sideToMove) & attackTargets;
+        const std::size_t numPieceBits = detail::level2NumBits[ourPieces.count()];
+        const std::size_t pieceId = detail::topBits(bits, numPieceBits);
+        bits <<= numPieceBits;
 
-                const Square sqForward = from + forward;
-                if (!occupied.isSet(sqForward))
-                {
-                    destinations |= sqForward;
+        auto readMoveId = [&](std::size_t numMoves) {
+            const std::size_t numMoveBits = detail::level2NumBits[numMoves];
+            skipBits(numPieceBits + numMoveBits);
+            return detail::topBits(bits, numMoveBits);
+        };
 
-                    const Square sqForward2 = sqForward + forward;
-                    if (
-                        from.rank() == startRank 
-                        && !occupied.isSet(sqForward2)
-                        )
-                    {
-                        destinations |= sqForward2;
-                    }
-                }
+        auto normalMove = [&](Square from, std::uint64_t destinations) {
+            const auto moveId = readMoveId(intrin::popcount(destinations));
+            return Move::normal(from, Square(nthSetBitIndex(destinations, moveId)));
+        };
 
-                const auto destinationsCount = destinations.count();
-                if (from.rank() == promotionRank)
-                {
-                    const auto moveId = extractBitsLE8(util::usedBits(destinationsCount * 4ull - 1ull));
-                    const Piece promotedPiece = Piece(
-                        fromOrdinal<PieceType>(ordinal(PieceType::Knight) + (moveId % 4ull)), 
-                        sideToMove
-                    );
-                    const auto to = Square(nthSetBitIndex(destinations.bits(), moveId / 4ull));
+        const Square from = Square(nthSetBitIndex(ourPieces.bits(), pieceId));
+        const Piece piece = pos.pieceAt(from);
+        const std::uint64_t notOurs = ~ourPieces.bits();
 
-                    return Move::promotion(from, to, promotedPiece);
-                }
-                else
-                {
-                    auto moveId = extractBitsLE8(util::usedBits(destinationsCount - 1ull));
-                    const auto to = Square(nthSetBitIndex(destinations.bits(), moveId));
-                    if (to == epSquare)
-                    {
-                        return Move::enPassant(from, to);
-                    }
-                    else
-                    {
-                        return Move::normal(from, to);
-                    }
-                }
+        switch (piece.type())
+        {
+        case PieceType::Pawn:
+        {
+            const Square epSquare = pos.epSquare();
+            Bitboard pawnTargets = theirPieces;
+            if (epSquare != Square::none())
+            {
+                pawnTargets |= epSquare;
             }
-            case PieceType::King:
+
+            // Pawns are never on the first or last rank so the pushes don't wrap around.
+            const std::uint64_t fromBits = Bitboard::square(from).bits();
+            const std::uint64_t empty = ~occupied.bits();
+            const int forwardShift = sideToMove == Color::White ? 8 : 56;
+            const std::uint64_t doublePushRank = (sideToMove == Color::White ? bb::rank(rank3) : bb::rank(rank6)).bits();
+            const std::uint64_t promotionRank = (sideToMove == Color::White ? bb::rank(rank7) : bb::rank(rank2)).bits();
+            const std::uint64_t singlePush = detail::rotateLeft(fromBits, forwardShift) & empty;
+            const std::uint64_t doublePush = detail::rotateLeft(singlePush & doublePushRank, forwardShift) & empty;
+
+            const std::uint64_t destinations =
+                (leaperAttacks[piece][from].bits() & pawnTargets.bits())
+                | singlePush
+                | doublePush;
+
+            if (fromBits & promotionRank)
             {
-                const CastlingRights ourCastlingRightsMask = 
-                    sideToMove == Color::White 
-                    ? CastlingRights::White 
-                    : CastlingRights::Black;
+                const auto moveId = readMoveId(intrin::popcount(destinations) * 4);
+                const Piece promotedPiece = Piece(
+                    fromOrdinal<PieceType>(ordinal(PieceType::Knight) + (moveId % 4ull)),
+                    sideToMove
+                );
+                const auto to = Square(nthSetBitIndex(destinations, moveId / 4ull));
 
-                const CastlingRights castlingRights = pos.castlingRights();
+                return Move::promotion(from, to, promotedPiece);
+            }
 
-                const Bitboard attacks = bb::pseudoAttacks<PieceType::King>(from) & ~ourPieces;
-                const std::size_t attacksSize = attacks.count();
-                const std::size_t numCastlings = intrin::popcount(ordinal(castlingRights & ourCastlingRightsMask));
+            const auto moveId = readMoveId(intrin::popcount(destinations));
+            const auto to = Square(nthSetBitIndex(destinations, moveId));
+            if (to == epSquare)
+            {
+                return Move::enPassant(from, to);
+            }
 
-                const auto moveId = extractBitsLE8(util::usedBits(attacksSize + numCastlings - 1ull));
+            return Move::normal(from, to);
+        }
 
-                if (moveId >= attacksSize)
-                {
-                    const std::size_t idx = moveId - attacksSize;
-
-                    const CastleType castleType =
-                        idx == 0 
-                        && contains(castlingRights, CastlingTraits::castlingRights[sideToMove][CastleType::Long])
-                        ? CastleType::Long
-                        : CastleType::Short;
-                 
-                    return Move::castle(castleType, sideToMove);
-                }
-                else
-                {
-                    auto to = Square(nthSetBitIndex(attacks.bits(), moveId));
-                    return Move::normal(from, to);
-                }
-                break;
-            }
-            default:
+        case PieceType::Knight:
+            return normalMove(from, leaperAttacks[piece][from].bits() & notOurs);
+
+        case PieceType::Bishop:
+            return normalMove(from, bb::fancy_magics::bishopAttacks(from, occupied).bits() & notOurs);
+
+        case PieceType::Rook:
+            return normalMove(from, bb::fancy_magics::rookAttacks(from, occupied).bits() & notOurs);
+
+        case PieceType::Queen:
+            return normalMove(
+                from,
+                (bb::fancy_magics::bishopAttacks(from, occupied) | bb::fancy_magics::rookAttacks(from, occupied)).bits() & notOurs
+            );
+
+        case PieceType::King:
+        {
+            const CastlingRights ourCastlingRightsMask =
+                sideToMove == Color::White
+                ? CastlingRights::White
+                : CastlingRights::Black;
+            const CastlingRights castlingRights = pos.castlingRights();
+
+            const std::uint64_t destinations = leaperAttacks[piece][from].bits() & notOurs;
+            const std::size_t numDestinations = intrin::popcount(destinations);
+            const std::size_t numCastlings = intrin::popcount(ordinal(castlingRights & ourCastlingRightsMask));
+
+            const auto moveId = readMoveId(numDestinations + numCastlings);
+            if (moveId >= numDestinations)
             {
-                const Bitboard attacks = bb::attacks(pt, from, occupied) & ~ourPieces;
-                const auto moveId = extractBitsLE8(util::usedBits(attacks.count() - 1ull));
-                auto to = Square(nthSetBitIndex(attacks.bits(), moveId));
-                return Move::normal(from, to);
-            }
+                const std::size_t idx = moveId - numDestinations;
+
+                const CastleType castleType =
+                    idx == 0
+                    && contains(castlingRights, CastlingTraits::castlingRights[sideToMove][CastleType::Long])
+                    ? CastleType::Long
+                    : CastleType::Short;
+
+                return Move::castle(castleType, sideToMove);
             }
-            break;
-        }
+
+            return Move::normal(from, Square(nthSetBitIndex(destinations, moveId)));
         }
 
-        ASSERT(false);
-        return Move::null();
+        default:
+            ASSERT(false);
+            return Move::null();
+        }
     }
 
-    [[nodiscard]] std::uint8_t UnparsedBcgnGameMoves::extractBitsLE8(std::size_t count)
+    [[nodiscard]] std::uint64_t UnparsedBcgnGameMoves::peekBits() const
     {
-        if (count == 0) return 0;
-
-        if (m_bitsLeft == 0)
+        // The movetext is read like a big endian number so that
+        // the first bit ends up being the most significant one.
+        std::uint64_t word = 0;
+        if (m_encodedMovetext.size() >= sizeof(word))
         {
-            m_encodedMovetext.remove_prefix(1);
-            m_bitsLeft = 8;
+            std::memcpy(&word, m_encodedMovetext.data(), sizeof(word));
         }
-
-        const std::uint8_t byte = m_encodedMovetext[0] << (8 - m_bitsLeft);
-        std::uint8_t bits = byte >> (8 - count);
-
-        if (count > m_bitsLeft)
+        else
         {
-            const auto spillCount = count - m_bitsLeft;
-            bits |= m_encodedMovetext[1] >> (8 - spillCount);
-
-            m_bitsLeft += 8;
-            m_encodedMovetext.remove_prefix(1);
+            std::memcpy(&word, m_encodedMovetext.data(), m_encodedMovetext.size());
         }
 
-        m_bitsLeft -= count;
+        return intrin::byteswap(word) << m_bitOffset;
+    }
 
-        return bits;
+    void UnparsedBcgnGameMoves::skipBits(std::size_t count)
+    {
+        const std::size_t numBits = m_bitOffset + count;
+        m_encodedMovetext.remove_prefix(numBits / 8);
+        m_bitOffset = numBits % 8;
     }
 
     UnparsedBcgnGamePositions::iterator::iterator(
@@ -1544,17 +2838,62 @@ namespace bcgn
 
     BcgnFileReader::iterator::iterator(
         const std::filesystem::path& path, 
-        std::size_t bufferSize
+        std::size_t bufferSize,
+        ReadMode mode,
+        const std::optional<BcgnGameRange>& range
         ) :
         m_header{},
         m_file(nullptr, &std::fclose),
         m_path(path),
-        m_buffer(bufferSize),
+        m_buffer{},
         m_bufferView{},
         m_future{},
+        m_mappedFile{},
+        m_numReleasedBytes(0),
+        m_numBytesLeftToRead(std::numeric_limits<std::uint64_t>::max()),
+        m_blocks{},
         m_game{},
         m_isEnd(false)
     {
+        if (mode == ReadMode::MemoryMapped)
+        {
+            m_mappedFile.emplace(path, ext::MemoryMappedFileAccess::Sequential);
+            const auto* data = reinterpret_cast<const unsigned char*>(m_mappedFile->data());
+            m_bufferView = util::UnsignedCharBufferView(data, m_mappedFile->size());
+
+            readFileHeader();
+            if (!isEnd() && m_header.auxCompression == BcgnAuxCompression::None)
+            {
+                m_game.setFileHeader(m_header);
+
+                if (range.has_value())
+                {
+                    if (range->beginOffset > range->endOffset || range->endOffset > m_mappedFile->size())
+                    {
+                        throw std::runtime_error("Game range outside of the file.");
+                    }
+
+                    m_bufferView = util::UnsignedCharBufferView(
+                        data + range->beginOffset,
+                        range->endOffset - range->beginOffset
+                    );
+                    m_numReleasedBytes = range->beginOffset;
+                }
+
+                prepareFirstGame();
+            }
+
+            if (isEnd() || m_header.auxCompression == BcgnAuxCompression::None)
+            {
+                return;
+            }
+
+            // The games have to be decompressed into memory anyway,
+            // so the file is read like in the buffered mode.
+            m_mappedFile.reset();
+            m_bufferView = {};
+        }
+
         auto strPath = path.string();
         m_file.reset(std::fopen(strPath.c_str(), "rb"));
 
@@ -1564,14 +2903,56 @@ namespace bcgn
             return;
         }
 
+        // The header is read separately because the games may
+        // not start right after it, or may be in compressed blocks.
+        unsigned char header[traits::bcgnFileHeaderLength];
+        if (std::fread(header, 1, traits::bcgnFileHeaderLength, m_file.get()) != traits::bcgnFileHeaderLength)
+        {
+            m_isEnd = true;
+            return;
+        }
+
+        m_header.readFrom(header);
+        m_game.setFileHeader(m_header);
+
+        if (m_header.auxCompression != BcgnAuxCompression::None)
+        {
+            startReadingBlocks(range);
+            return;
+        }
+
+        m_buffer.emplace(bufferSize);
+
+        if (range.has_value())
+        {
+            detail::seekFile(m_file.get(), range->beginOffset);
+            m_numBytesLeftToRead = range->endOffset - range->beginOffset;
+        }
+
         refillBuffer();
 
         if (!isEnd())
         {
-            readFileHeader();
+            prepareFirstGame();
+        }
+    }
+
+    void BcgnFileReader::iterator::startReadingBlocks(const std::optional<BcgnGameRange>& range)
+    {
+        // The file is positioned right after the file header.
+        std::uint64_t numBytesToRead = std::filesystem::file_size(m_path) - traits::bcgnFileHeaderLength;
+        if (range.has_value())
+        {
+            detail::seekFile(m_file.get(), range->beginOffset);
+            numBytesToRead = range->endOffset - range->beginOffset;
+        }
+
+        m_blocks = std::make_unique<detail::BcgnBlockDecompressor>(m_file.get(), m_header.auxCompression, numBytesToRead);
 
-            m_game.setFileHeader(m_header);
+        refillBuffer();
 
+        if (!isEnd())
+        {
             prepareFirstGame();
         }
     }
@@ -1608,8 +2989,44 @@ namespace bcgn
         return &m_game;
     }
 
+    [[nodiscard]] std::size_t BcgnFileReader::iterator::readIntoBackBuffer(std::size_t maxSize)
+    {
+        const std::size_t numBytesRead = std::fread(
+            m_buffer->back_data() + traits::maxGameLength,
+            1,
+            static_cast<std::size_t>(std::min<std::uint64_t>(maxSize, m_numBytesLeftToRead)),
+            m_file.get()
+            );
+        m_numBytesLeftToRead -= numBytesRead;
+        return numBytesRead;
+    }
+
     void BcgnFileReader::iterator::refillBuffer()
     {
+        if (m_blocks != nullptr)
+        {
+            // Blocks only contain whole games.
+            if (!m_bufferView.empty())
+            {
+                throw std::runtime_error("Block ends in the middle of a game.");
+            }
+
+            m_bufferView = m_blocks->nextBlock();
+            if (m_bufferView.empty())
+            {
+                m_isEnd = true;
+            }
+
+            return;
+        }
+
+        if (m_mappedFile.has_value())
+        {
+            // The whole file is already in the view.
+            m_isEnd = true;
+            return;
+        }
+
         // We know that the biggest possible unprocessed 
         // amount of bytes is traits::maxGameLength - 1.
         // Using this information we can only fill the buffer starting from 
@@ -1618,7 +3035,7 @@ namespace bcgn
         // This way we minimize copying between buffers.
 
         const std::size_t usableReadBufferSpace = 
-            m_buffer.size() - traits::maxGameLength;
+            m_buffer->size() - traits::maxGameLength;
 
         const std::size_t numUnprocessedBytes = m_bufferView.size();
         if (numUnprocessedBytes >= traits::maxGameLength)
@@ -1632,7 +3049,7 @@ namespace bcgn
         {
             // memcpy is safe because the buffers are disjoint.
             std::memcpy(
-                m_buffer.back_data() + freeSpace, 
+                m_buffer->back_data() + freeSpace, 
                 m_bufferView.data(), 
                 numUnprocessedBytes
                 );
@@ -1646,12 +3063,7 @@ namespace bcgn
         const auto numBytesRead =
             m_future.valid()
             ? m_future.get()
-            : std::fread(
-                m_buffer.back_data() + traits::maxGameLength, 
-                1, 
-                usableReadBufferSpace, 
-                m_file.get()
-                );
+            : readIntoBackBuffer(usableReadBufferSpace);
 
         if (numBytesRead == 0)
         {
@@ -1659,19 +3071,14 @@ namespace bcgn
             return;
         }
 
-        m_buffer.swap();
+        m_buffer->swap();
 
         m_future = std::async(std::launch::async, [this, usableReadBufferSpace]() {
-            return std::fread(
-                m_buffer.back_data() + traits::maxGameLength, 
-                1, 
-                usableReadBufferSpace, 
-                m_file.get()
-                );
+            return readIntoBackBuffer(usableReadBufferSpace);
             });
 
         m_bufferView = util::UnsignedCharBufferView(
-            m_buffer.data() + freeSpace, 
+            m_buffer->data() + freeSpace, 
             numBytesRead + numUnprocessedBytes
             );
     }
@@ -1713,6 +3120,11 @@ namespace bcgn
 
     void BcgnFileReader::iterator::prepareNextGame()
     {
+        if (m_mappedFile.has_value())
+        {
+            releaseProcessedPages();
+        }
+
         while (!isEnd())
         {
             if (m_bufferView.size() < 2)
@@ -1736,6 +3148,20 @@ namespace bcgn
         }
     }
 
+    void BcgnFileReader::iterator::releaseProcessedPages()
+    {
+        // Games already returned stay readable, the pages
+        // are loaded from the file again if they are accessed.
+        const std::size_t numProcessedBytes =
+            m_bufferView.data() - reinterpret_cast<const unsigned char*>(m_mappedFile->data());
+
+        if (numProcessedBytes - m_numReleasedBytes >= traits::mappedReleaseGranularity)
+        {
+            m_mappedFile->release(m_numReleasedBytes, numProcessedBytes - m_numReleasedBytes);
+            m_numReleasedBytes = numProcessedBytes;
+        }
+    }
+
     [[nodiscard]] bool BcgnFileReader::iterator::isEnd() const
     {
         return m_isEnd;
@@ -1747,13 +3173,39 @@ namespace bcgn
         return (m_bufferView[0] << 8) | m_bufferView[1];
     }
 
-    BcgnFileReader::BcgnFileReader(const std::filesystem::path& path, std::size_t bufferSize) :
+    BcgnFileReader::BcgnFileReader(const std::filesystem::path& path, std::size_t bufferSize, ReadMode mode) :
         m_file(nullptr, &std::fclose),
         m_path(path),
-        m_bufferSize(bufferSize)
+        m_bufferSize(bufferSize),
+        m_mode(mode),
+        m_directory{},
+        m_blockIndex{},
+        m_range{}
     {
         auto strPath = path.string();
         m_file.reset(std::fopen(strPath.c_str(), "rb"));
+
+        unsigned char data[traits::bcgnFileHeaderLength];
+        if (m_file != nullptr
+            && std::fread(data, 1, traits::bcgnFileHeaderLength, m_file.get()) == traits::bcgnFileHeaderLength)
+        {
+            BcgnFileHeader header{};
+            header.readFrom(data);
+            if (header.hasGameOffsetDirectory)
+            {
+                m_directory = BcgnGameOffsetDirectory::load(path);
+            }
+
+            if (header.auxCompression != BcgnAuxCompression::None)
+            {
+                // Building it only reads the block headers.
+                m_blockIndex = BcgnBlockIndex::load(path);
+                if (!m_blockIndex.has_value())
+                {
+                    m_blockIndex = BcgnBlockIndex::build(path);
+                }
+            }
+        }
     }
 
     [[nodiscard]] bool BcgnFileReader::isOpen() const
@@ -1761,13 +3213,108 @@ namespace bcgn
         return m_file != nullptr;
     }
 
+    [[nodiscard]] bool BcgnFileReader::hasGameOffsetDirectory() const
+    {
+        return m_directory.has_value();
+    }
+
+    [[nodiscard]] std::size_t BcgnFileReader::numGames() const
+    {
+        if (m_blockIndex.has_value())
+        {
+            return m_blockIndex->numGames();
+        }
+
+        return gameOffsetDirectory().numGames();
+    }
+
+    void BcgnFileReader::seekToGame(std::size_t gameIdx)
+    {
+        const auto& directory = gameOffsetDirectory();
+        if (gameIdx > directory.numGames())
+        {
+            throw std::out_of_range("Game index out of range.");
+        }
+
+        const std::size_t entryIdx = gameIdx / directory.interval();
+        std::uint64_t offset =
+            entryIdx < directory.offsets().size()
+            ? directory.offsets()[entryIdx]
+            : directory.endOffset();
+
+        for (std::size_t i = entryIdx * directory.interval(); i < gameIdx; ++i)
+        {
+            const std::size_t size = detail::readGameEntrySize(m_file.get(), offset);
+            if (size == 0)
+            {
+                throw std::runtime_error("Invalid game entry in " + m_path.string());
+            }
+
+            offset += size;
+        }
+
+        m_range = BcgnGameRange{
+            gameIdx,
+            directory.numGames() - gameIdx,
+            offset,
+            directory.endOffset()
+        };
+    }
+
+    [[nodiscard]] std::vector<BcgnGameRange> BcgnFileReader::splitIntoRanges(std::size_t n) const
+    {
+        if (m_blockIndex.has_value())
+        {
+            const auto& entries = m_blockIndex->entries();
+
+            std::vector<std::uint64_t> offsets;
+            offsets.reserve(entries.size());
+            for (const auto& entry : entries)
+            {
+                offsets.emplace_back(entry.offset);
+            }
+
+            return detail::splitIntoRanges(
+                offsets,
+                [&entries](std::size_t i) { return entries[i].firstGameIdx; },
+                m_blockIndex->numGames(),
+                m_blockIndex->endOffset(),
+                n
+            );
+        }
+
+        const auto& directory = gameOffsetDirectory();
+        return detail::splitIntoRanges(
+            directory.offsets(),
+            [&directory](std::size_t i) { return i * directory.interval(); },
+            directory.numGames(),
+            directory.endOffset(),
+            n
+        );
+    }
+
+    void BcgnFileReader::setRange(const BcgnGameRange& range)
+    {
+        m_range = range;
+    }
+
     [[nodiscard]] BcgnFileReader::iterator BcgnFileReader::begin()
     {
-        return iterator(m_path, m_bufferSize);
+        return iterator(m_path, m_bufferSize, m_mode, m_range);
     }
 
     [[nodiscard]] BcgnFileReader::iterator::sentinel BcgnFileReader::end() const
     {
         return {};
     }
+
+    [[nodiscard]] const BcgnGameOffsetDirectory& BcgnFileReader::gameOffsetDirectory() const
+    {
+        if (!m_directory.has_value())
+        {
+            throw std::runtime_error("File " + m_path.string() + " has no game offset directory.");
+        }
+
+        return *m_directory;
+    }
 }
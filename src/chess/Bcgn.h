@@ -9,16 +9,24 @@
 
 #include "enum/EnumArray.h"
 
+#include "external_storage/MemoryMappedFile.h"
+
 #include "util/UnsignedCharBufferView.h"
 #include "util/Buffer.h"
 
 #include <array>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdio>
+#include <deque>
+#include <exception>
 #include <filesystem>
 #include <future>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <thread>
 #include <vector>
 
 namespace bcgn
@@ -32,6 +40,23 @@ namespace bcgn
         constexpr std::size_t minBufferSize = 128ull * 1024ull;
         constexpr std::size_t minHeaderLength = 5; // in headerless
         constexpr std::size_t bcgnFileHeaderLength = 32;
+        constexpr std::size_t gameOffsetDirectoryHeaderLength = 32;
+
+        // Number of games between consecutive entries of the game offset directory.
+        constexpr std::size_t gameOffsetDirectoryInterval = 256;
+
+        // Bytes consumed by a memory mapped reader before the pages behind it are released.
+        constexpr std::size_t mappedReleaseGranularity = 16ull * 1024ull * 1024ull;
+
+        // With aux compression games are grouped into blocks that are compressed independently.
+        // A block is closed after the game that makes it at least this long.
+        constexpr std::size_t auxCompressionBlockSize = 4ull * 1024ull * 1024ull;
+        constexpr std::size_t maxAuxCompressionBlockLength = auxCompressionBlockSize + maxGameLength;
+        constexpr std::size_t auxCompressionBlockHeaderLength = 12;
+        constexpr std::size_t blockIndexHeaderLength = 32;
+
+        constexpr std::size_t positionKeyFileHeaderLength = 40;
+        constexpr std::size_t positionKeyLength = 20;
 
         // Because we always ensure the buffer can take another game
         // even if it would be the longest possible we don't want
@@ -58,6 +83,7 @@ namespace bcgn
     enum struct BcgnAuxCompression
     {
         None = 0,
+        Zstd = 1,
         SIZE
     };
 
@@ -68,6 +94,9 @@ namespace bcgn
         BcgnAuxCompression auxCompression = BcgnAuxCompression::None;
         bool isHeaderless = false;
 
+        // Whether the writer maintains a game offset directory next to the file.
+        bool hasGameOffsetDirectory = false;
+
         void readFrom(const unsigned char* str);
 
         [[nodiscard]] std::size_t writeTo(unsigned char* data);
@@ -76,6 +105,161 @@ namespace bcgn
         [[noreturn]] void invalidHeader() const;
     };
 
+    // A sidecar file with the address of every gameOffsetDirectoryInterval-th game
+    // of a BCGN file, so that games can be found without reading the ones before.
+    struct BcgnGameOffsetDirectory
+    {
+        explicit BcgnGameOffsetDirectory(std::size_t interval = traits::gameOffsetDirectoryInterval);
+
+        [[nodiscard]] static std::filesystem::path pathFor(const std::filesystem::path& bcgnPath);
+
+        // Empty if there is no directory or it doesn't match the size of the BCGN file,
+        // for example because games were appended without updating it.
+        [[nodiscard]] static std::optional<BcgnGameOffsetDirectory> load(const std::filesystem::path& bcgnPath);
+
+        // Goes through the game entries of an existing BCGN file.
+        [[nodiscard]] static BcgnGameOffsetDirectory build(
+            const std::filesystem::path& bcgnPath,
+            std::size_t interval = traits::gameOffsetDirectoryInterval
+            );
+
+        void save(const std::filesystem::path& bcgnPath) const;
+
+        // Must be called for every game in order, with the address of its entry.
+        void addGame(std::uint64_t offset);
+
+        // The address one past the last game, i.e. the size of the BCGN file.
+        void setEndOffset(std::uint64_t offset);
+
+        [[nodiscard]] std::size_t interval() const;
+
+        [[nodiscard]] std::size_t numGames() const;
+
+        [[nodiscard]] std::uint64_t endOffset() const;
+
+        // offsets()[i] is the address of the game with index i * interval().
+        [[nodiscard]] const std::vector<std::uint64_t>& offsets() const;
+
+    private:
+        std::size_t m_interval;
+        std::size_t m_numGames;
+        std::uint64_t m_endOffset;
+        std::vector<std::uint64_t> m_offsets;
+    };
+
+    // A sidecar file with the address of every block of a BCGN file with aux compression,
+    // so that blocks can be found, and decompressed, without reading the ones before.
+    struct BcgnBlockIndex
+    {
+        struct Entry
+        {
+            std::uint64_t offset;
+            std::uint64_t firstGameIdx;
+        };
+
+        BcgnBlockIndex();
+
+        [[nodiscard]] static std::filesystem::path pathFor(const std::filesystem::path& bcgnPath);
+
+        // Empty if there is no index or it doesn't match the size of the BCGN file.
+        [[nodiscard]] static std::optional<BcgnBlockIndex> load(const std::filesystem::path& bcgnPath);
+
+        // Goes through the block headers of an existing BCGN file.
+        [[nodiscard]] static BcgnBlockIndex build(const std::filesystem::path& bcgnPath);
+
+        void save(const std::filesystem::path& bcgnPath) const;
+
+        // Must be called for every block in order, with the address of its header.
+        void addBlock(std::uint64_t offset, std::size_t numGames);
+
+        // The address one past the last block, i.e. the size of the BCGN file.
+        void setEndOffset(std::uint64_t offset);
+
+        [[nodiscard]] std::size_t numGames() const;
+
+        [[nodiscard]] std::uint64_t endOffset() const;
+
+        [[nodiscard]] const std::vector<Entry>& entries() const;
+
+    private:
+        std::size_t m_numGames;
+        std::uint64_t m_endOffset;
+        std::vector<Entry> m_entries;
+    };
+
+    // The zobrist key of a position and the reverse move that lead to it.
+    struct BcgnPositionKey
+    {
+        ZobristKey zobrist;
+        PackedReverseMove packedReverseMove;
+    };
+
+    // Writes a sidecar file with the key of every position of every game
+    // of a BCGN file, in the order of the games, so that the positions
+    // can be imported again without decoding and playing the moves.
+    struct BcgnPositionKeyFileWriter
+    {
+        // Files of other versions are not read.
+        static constexpr std::uint8_t positionKeyFileVersion = 1;
+
+        // Truncates the sidecar of the BCGN file.
+        explicit BcgnPositionKeyFileWriter(const std::filesystem::path& bcgnPath);
+
+        // Appends the keys of a game, the first one being of the start position.
+        static void encodeGame(std::vector<unsigned char>& data, const std::vector<BcgnPositionKey>& keys);
+
+        // Games encoded with encodeGame, in the order they are in the BCGN file.
+        void writeEncodedGames(const unsigned char* data, std::size_t length, std::size_t numGames);
+
+        // Writes the header, which ties the sidecar to the current size
+        // and a fingerprint of the contents of the BCGN file.
+        // Must be called after the BCGN file is closed.
+        void finalize();
+
+    private:
+        std::filesystem::path m_bcgnPath;
+        std::unique_ptr<FILE, decltype(&std::fclose)> m_file;
+        std::uint64_t m_numGames;
+        std::uint64_t m_numPositions;
+    };
+
+    struct BcgnPositionKeyFileReader
+    {
+        [[nodiscard]] static std::filesystem::path pathFor(const std::filesystem::path& bcgnPath);
+
+        // Empty if there is no sidecar or it doesn't match the size
+        // or the fingerprint of the BCGN file.
+        [[nodiscard]] static std::optional<BcgnPositionKeyFileReader> open(const std::filesystem::path& bcgnPath);
+
+        [[nodiscard]] std::size_t numGames() const;
+
+        // The keys of the next game, valid until the next call.
+        [[nodiscard]] const std::vector<BcgnPositionKey>& nextGame();
+
+    private:
+        // Must outlive the file.
+        std::unique_ptr<char[]> m_fileBuffer;
+        std::unique_ptr<FILE, decltype(&std::fclose)> m_file;
+        std::size_t m_numGames;
+        std::vector<unsigned char> m_data;
+        std::vector<BcgnPositionKey> m_keys;
+
+        BcgnPositionKeyFileReader(
+            std::unique_ptr<char[]> fileBuffer,
+            std::unique_ptr<FILE, decltype(&std::fclose)> file,
+            std::size_t numGames
+            );
+    };
+
+    // Contiguous games of a BCGN file. The offsets are addresses in the file.
+    struct BcgnGameRange
+    {
+        std::size_t firstGameIdx = 0;
+        std::size_t numGames = 0;
+        std::uint64_t beginOffset = 0;
+        std::uint64_t endOffset = 0;
+    };
+
     struct BcgnGameFlags
     {
         BcgnGameFlags();
@@ -147,6 +331,9 @@ namespace bcgn
 
             void addBitsLE8x2(std::uint8_t bits0, std::size_t count0, std::uint8_t bits1, std::size_t count1);
 
+            // Encodes the move according to the compression level.
+            void addMove(const Position& pos, const Move& move);
+
             // returns number of bytes written
             [[nodiscard]] std::size_t writeTo(unsigned char* buffer);
 
@@ -187,6 +374,75 @@ namespace bcgn
 
             void addBitsLE8(std::uint8_t bits, std::size_t count);
         };
+
+        // Reads consecutive blocks of a file with aux compression.
+        // A single worker thread reads and decompresses the blocks
+        // after the current one into a bounded queue.
+        struct BcgnBlockDecompressor
+        {
+            // The file must be positioned at a block header and have
+            // at least numBytesToRead bytes after it.
+            BcgnBlockDecompressor(
+                FILE* file,
+                BcgnAuxCompression auxCompression,
+                std::uint64_t numBytesToRead
+                );
+
+            BcgnBlockDecompressor(const BcgnBlockDecompressor&) = delete;
+            BcgnBlockDecompressor& operator=(const BcgnBlockDecompressor&) = delete;
+
+            ~BcgnBlockDecompressor();
+
+            // The game entries of the next block. Empty after the last one.
+            // The view of the previous block is invalidated.
+            // Throws if the block is invalid or cut short.
+            [[nodiscard]] util::UnsignedCharBufferView nextBlock();
+
+        private:
+            struct CompressedBlock
+            {
+                std::vector<unsigned char> data;
+                std::size_t uncompressedLength;
+            };
+
+            FILE* m_file;
+            BcgnAuxCompression m_auxCompression;
+            std::uint64_t m_numBytesLeftToRead;
+            std::size_t m_maxNumBlocksQueued;
+
+            // Blocks are numbered in file order. The workers read them
+            // one at a time but decompress them in parallel, so they
+            // may finish out of order.
+            std::map<std::size_t, std::vector<unsigned char>> m_decompressedBlocks;
+            std::size_t m_numBlocksRead;
+            std::size_t m_numBlocksConsumed;
+            std::condition_variable m_blockReady;
+            std::condition_variable m_queueNotFull;
+            std::mutex m_mutex;
+
+            // Held while reading from the file, so that reads and numbering are in order.
+            std::mutex m_fileMutex;
+
+            // The first block that failed, it's rethrown when the consumer gets there.
+            std::exception_ptr m_exception;
+            std::size_t m_exceptionBlockIdx;
+            bool m_hasFailed;
+
+            bool m_isEndReached;
+            bool m_isStopping;
+
+            std::vector<unsigned char> m_currentBlock;
+
+            std::vector<std::thread> m_workers;
+
+            void decompressAhead();
+
+            // Empty after the last block.
+            [[nodiscard]] std::optional<CompressedBlock> readBlock();
+
+            // Must be called with m_mutex locked.
+            void setException(std::size_t blockIdx, std::exception_ptr exception);
+        };
     }
 
     struct BcgnFileWriter
@@ -242,6 +498,11 @@ namespace bcgn
 
         void endGame();
 
+        // Appends games encoded elsewhere with detail::BcgnGameEntryBuffer
+        // using the same file header. Must not be called between
+        // beginGame and endGame.
+        void writeEncodedGames(const unsigned char* data, std::size_t size);
+
         void flush();
 
         ~BcgnFileWriter();
@@ -255,11 +516,30 @@ namespace bcgn
         std::size_t m_numBytesUsedInFrontBuffer;
         std::size_t m_numBytesBeingWritten;
         std::future<std::size_t> m_future;
+        std::optional<BcgnGameOffsetDirectory> m_directory;
+        // The address in the file of the first byte in the front buffer.
+        std::uint64_t m_fileOffset;
+
+        // Only used with aux compression. Games are gathered in m_block
+        // and the blocks being compressed are written in order.
+        std::vector<unsigned char> m_block;
+        std::size_t m_numBytesUsedInBlock;
+        std::size_t m_numGamesInBlock;
+        std::deque<std::future<std::vector<unsigned char>>> m_compressedBlocks;
+        std::optional<BcgnBlockIndex> m_blockIndex;
+
+        void prepareForAppend();
 
         void writeFileHeader();
 
         void writeCurrentGame();
 
+        void addGameToBlock(const unsigned char* data, std::size_t size);
+
+        void submitBlock();
+
+        void writeOldestBlock();
+
         [[nodiscard]] bool enoughSpaceForNextGame() const;
 
         void swapAndPersistFrontBuffer();
@@ -280,10 +560,18 @@ namespace bcgn
     private:
         BcgnFileHeader m_header;
         util::UnsignedCharBufferView m_encodedMovetext;
-        std::size_t m_bitsLeft;
+        // Number of bits of the first byte of the movetext already read.
+        // Only used by compression level 2.
+        std::size_t m_bitOffset;
         std::size_t m_numMovesLeft;
 
-        [[nodiscard]] std::uint8_t extractBitsLE8(std::size_t count);
+        // The next 64 bits of the movetext, the first one being the most significant.
+        // Bits past the end of the movetext are 0.
+        [[nodiscard]] std::uint64_t peekBits() const;
+
+        void skipBits(std::size_t count);
+
+        [[nodiscard]] Move nextLevel2(const Position& pos);
     };
 
     struct UnparsedBcgnGamePositions
@@ -514,6 +802,17 @@ namespace bcgn
 
     struct BcgnFileReader
     {
+        enum struct ReadMode
+        {
+            // The file is read in chunks into a double buffer of the given size.
+            Buffered,
+
+            // The whole file is memory mapped and the games are views into
+            // the mapping, so nothing is copied. The buffer size is not used.
+            // Files with aux compression are decompressed block by block in either mode.
+            MemoryMapped
+        };
+
         struct iterator
         {
             struct sentinel {};
@@ -524,7 +823,12 @@ namespace bcgn
             using iterator_category = std::input_iterator_tag;
             using pointer = const UnparsedBcgnGame*;
 
-            iterator(const std::filesystem::path& path, std::size_t bufferSize);
+            iterator(
+                const std::filesystem::path& path,
+                std::size_t bufferSize,
+                ReadMode mode,
+                const std::optional<BcgnGameRange>& range
+                );
 
             const iterator& operator++();
 
@@ -540,14 +844,26 @@ namespace bcgn
             BcgnFileHeader m_header;
             std::unique_ptr<FILE, decltype(&std::fclose)> m_file;
             std::filesystem::path m_path;
-            util::DoubleBuffer<unsigned char> m_buffer;
+            std::optional<util::DoubleBuffer<unsigned char>> m_buffer;
             util::UnsignedCharBufferView m_bufferView;
             std::future<std::size_t> m_future;
+            std::optional<ext::MemoryMappedFile> m_mappedFile;
+            std::size_t m_numReleasedBytes;
+            // Bytes of the file not yet read into the buffer that belong to the range.
+            std::uint64_t m_numBytesLeftToRead;
+            // Used instead of the buffer for files with aux compression.
+            std::unique_ptr<detail::BcgnBlockDecompressor> m_blocks;
             UnparsedBcgnGame m_game;
             bool m_isEnd;
 
+            void startReadingBlocks(const std::optional<BcgnGameRange>& range);
+
+            [[nodiscard]] std::size_t readIntoBackBuffer(std::size_t maxSize);
+
             void refillBuffer();
 
+            void releaseProcessedPages();
+
             void readFileHeader();
 
             void prepareFirstGame();
@@ -563,11 +879,33 @@ namespace bcgn
 
         BcgnFileReader(
             const std::filesystem::path& path, 
-            std::size_t bufferSize = traits::minBufferSize
+            std::size_t bufferSize = traits::minBufferSize,
+            ReadMode mode = ReadMode::Buffered
             );
 
         [[nodiscard]] bool isOpen() const;
 
+        // Whether the file has an up to date game offset directory.
+        // It's required by seekToGame. numGames and splitIntoRanges
+        // use the block index instead for files with aux compression.
+        [[nodiscard]] bool hasGameOffsetDirectory() const;
+
+        [[nodiscard]] std::size_t numGames() const;
+
+        // Iterations started after this begin at the game with the given index.
+        // At most gameOffsetDirectoryInterval - 1 game entries are skipped.
+        void seekToGame(std::size_t gameIdx);
+
+        // Splits the games into at most n ranges of similar size in bytes,
+        // for example to be read by different threads, each with its own reader.
+        // Ranges begin at directory entries, or blocks with aux compression,
+        // so nothing is read from the BCGN file.
+        [[nodiscard]] std::vector<BcgnGameRange> splitIntoRanges(std::size_t n) const;
+
+        // Iterations started after this only go through the games in the range.
+        // The database import uses it to decode the games on several threads.
+        void setRange(const BcgnGameRange& range);
+
         [[nodiscard]] iterator begin();
 
         [[nodiscard]] iterator::sentinel end() const;
@@ -576,5 +914,11 @@ namespace bcgn
         std::unique_ptr<FILE, decltype(&std::fclose)> m_file;
         std::filesystem::path m_path;
         std::size_t m_bufferSize;
+        ReadMode m_mode;
+        std::optional<BcgnGameOffsetDirectory> m_directory;
+        std::optional<BcgnBlockIndex> m_blockIndex;
+        std::optional<BcgnGameRange> m_range;
+
+        [[nodiscard]] const BcgnGameOffsetDirectory& gameOffsetDirectory() const;
     };
 }
@@ -0,0 +1,141 @@
+#include "OpeningTrie.h"
+
+#include "San.h"
+
+#include "util/Assert.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace pgn
+{
+    OpeningTrie::OpeningTrie(std::size_t maxMemory, std::size_t maxPlies) :
+        m_maxNumNodes(std::min<std::size_t>(maxMemory / (sizeof(Node) + 2 * sizeof(Edge)), invalidNode / 2)),
+        m_maxPlies(maxPlies)
+    {
+        if (m_maxNumNodes == 0 || m_maxPlies == 0)
+        {
+            m_maxNumNodes = 0;
+            return;
+        }
+
+        // At most 2/3 of the edges are occupied.
+        std::size_t numEdges = 1;
+        while (numEdges < m_maxNumNodes + m_maxNumNodes / 2)
+        {
+            numEdges *= 2;
+        }
+        m_edges.resize(numEdges, Edge{ 0, invalidNode, invalidNode });
+
+        // Reserved upfront so that growing doesn't temporarily exceed the budget.
+        m_nodes.reserve(m_maxNumNodes);
+        m_nodes.push_back(Node{ PositionWithZobrist::startPosition(), ReverseMove{} });
+    }
+
+    [[nodiscard]] OpeningTrie::Cursor OpeningTrie::root() const
+    {
+        Cursor cursor{};
+        if (!m_nodes.empty())
+        {
+            cursor.m_node = 0;
+        }
+        return cursor;
+    }
+
+    [[nodiscard]] OpeningTrie::MoveResult OpeningTrie::doMove(
+        Cursor& cursor,
+        PositionWithZobrist& position,
+        ReverseMove& reverseMove,
+        std::string_view san
+    )
+    {
+        const std::optional<std::uint64_t> packedSan = cursor.isValid() ? packSan(san) : std::nullopt;
+        std::size_t edgeIdx = 0;
+        if (packedSan.has_value())
+        {
+            edgeIdx = edgeIndex(cursor.m_node, *packedSan);
+            const Edge& edge = m_edges[edgeIdx];
+            if (edge.child != invalidNode)
+            {
+                const Node& node = m_nodes[edge.child];
+                position = node.position;
+                reverseMove = node.reverseMove;
+                cursor.m_node = edge.child;
+                cursor.m_ply += 1;
+                return MoveResult::Cached;
+            }
+        }
+
+        const Move move = san::sanToMove(position, san);
+        if (move == Move::null())
+        {
+            return MoveResult::Illegal;
+        }
+
+        reverseMove = position.doMove(move);
+
+        if (packedSan.has_value() && cursor.m_ply < m_maxPlies && m_nodes.size() < m_maxNumNodes)
+        {
+            const auto child = static_cast<std::uint32_t>(m_nodes.size());
+            m_nodes.push_back(Node{ position, reverseMove });
+            m_edges[edgeIdx] = Edge{ *packedSan, cursor.m_node, child };
+
+            cursor.m_node = child;
+            cursor.m_ply += 1;
+        }
+        else
+        {
+            cursor = Cursor{};
+        }
+
+        return MoveResult::Decoded;
+    }
+
+    [[nodiscard]] std::size_t OpeningTrie::numNodes() const
+    {
+        return m_nodes.size();
+    }
+
+    [[nodiscard]] std::size_t OpeningTrie::maxNumNodes() const
+    {
+        return m_maxNumNodes;
+    }
+
+    [[nodiscard]] std::size_t OpeningTrie::maxPlies() const
+    {
+        return m_maxPlies;
+    }
+
+    [[nodiscard]] std::optional<std::uint64_t> OpeningTrie::packSan(std::string_view san)
+    {
+        if (san.empty() || san.size() > sizeof(std::uint64_t))
+        {
+            return {};
+        }
+
+        std::uint64_t packed = 0;
+        std::memcpy(&packed, san.data(), san.size());
+        return packed;
+    }
+
+    [[nodiscard]] std::size_t OpeningTrie::edgeIndex(std::uint32_t parent, std::uint64_t san) const
+    {
+        ASSERT(parent < m_nodes.size());
+
+        const std::size_t mask = m_edges.size() - 1;
+
+        // Returns the matching edge or the empty one where it would be inserted.
+        const std::uint64_t hash = (san ^ (static_cast<std::uint64_t>(parent) * 0x9E3779B97F4A7C15ull)) * 0xFF51AFD7ED558CCDull;
+        std::size_t idx = static_cast<std::size_t>(hash ^ (hash >> 32)) & mask;
+        for (;;)
+        {
+            const Edge& edge = m_edges[idx];
+            if (edge.child == invalidNode || (edge.san == san && edge.parent == parent))
+            {
+                return idx;
+            }
+
+            idx = (idx + 1) & mask;
+        }
+    }
+}
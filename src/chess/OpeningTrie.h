@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Chess.h"
+#include "Position.h"
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace pgn
+{
+    // Memoizes the decoding of the first moves of games starting from
+    // the standard position. Most games share their first 10-20 plies,
+    // so a path of SAN tokens is decoded once and the following games
+    // copy the resulting position (with its zobrist key) and reverse move
+    // from the node instead of decoding the move again.
+    // The trie only grows up to a fixed number of nodes and plies.
+    // After that the known prefixes are still used but nothing new is added.
+    struct OpeningTrie
+    {
+        // Identifies the node reached by the moves of a game so far.
+        // A default constructed cursor is not in the trie, it's used
+        // for games that left it or never entered it.
+        struct Cursor
+        {
+            [[nodiscard]] bool isValid() const
+            {
+                return m_node != invalidNode;
+            }
+
+        private:
+            std::uint32_t m_node = invalidNode;
+            std::uint32_t m_ply = 0;
+
+            friend struct OpeningTrie;
+        };
+
+        enum struct MoveResult
+        {
+            Illegal,
+            Decoded,
+            Cached
+        };
+
+        // `maxMemory` bounds the memory used by the nodes.
+        // When no node fits, or maxPlies is 0, the trie is disabled.
+        OpeningTrie(std::size_t maxMemory, std::size_t maxPlies);
+
+        // The cursor for a game starting from Position::startPosition().
+        // Invalid when the trie is disabled.
+        [[nodiscard]] Cursor root() const;
+
+        // Plays the move given by `san` on `position` and sets `reverseMove`.
+        // `position` must be the one reached by the cursor, if it's valid.
+        // Illegal moves leave all arguments unchanged.
+        [[nodiscard]] MoveResult doMove(
+            Cursor& cursor,
+            PositionWithZobrist& position,
+            ReverseMove& reverseMove,
+            std::string_view san
+        );
+
+        [[nodiscard]] std::size_t numNodes() const;
+
+        [[nodiscard]] std::size_t maxNumNodes() const;
+
+        [[nodiscard]] std::size_t maxPlies() const;
+
+    private:
+        static constexpr std::uint32_t invalidNode = std::numeric_limits<std::uint32_t>::max();
+
+        struct Node
+        {
+            PositionWithZobrist position;
+            ReverseMove reverseMove;
+        };
+
+        // Maps (parent, SAN token) to the child node. Kept apart from the nodes
+        // and open addressed so that a lookup usually touches one cache line.
+        struct Edge
+        {
+            // The SAN token of the move leading to the child, see packSan.
+            std::uint64_t san;
+            std::uint32_t parent;
+            std::uint32_t child;
+        };
+
+        std::vector<Node> m_nodes;
+        std::vector<Edge> m_edges;
+        std::size_t m_maxNumNodes;
+        std::size_t m_maxPlies;
+
+        // Tokens of at most 8 characters are packed into an integer
+        // to make comparisons cheap. Longer ones are never cached.
+        [[nodiscard]] static std::optional<std::uint64_t> packSan(std::string_view san);
+
+        [[nodiscard]] std::size_t edgeIndex(std::uint32_t parent, std::uint64_t san) const;
+    };
+}
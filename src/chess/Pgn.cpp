@@ -5,6 +5,7 @@
 #include "Date.h"
 #include "Eco.h"
 #include "GameClassification.h"
+#include "PgnScan.h"
 #include "Position.h"
 #include "San.h"
 
@@ -17,6 +18,8 @@
 #include <future>
 #include <memory>
 #include <optional>
+#include <stdexcept>
+#include <string>
 #include <string_view>
 #include <vector>
 
@@ -72,18 +75,21 @@ namespace pgn
 
             int numUnclosedParens = 1;
 
+            // `s` starts at a parenthesis that was already counted,
+            // or right after a comment.
+            std::size_t searchFrom = 1;
+
             while (numUnclosedParens)
             {
-                // a safer version with bounds would be nice
-                // but std::string_view::find_first_of is horrendously slow
-                const char* event = std::strpbrk(s.data() + 1u, "(){;");
-                if (event == nullptr || static_cast<std::size_t>(event - s.data()) > s.size())
+                const char* event = scan::findVariationEvent(s.data() + searchFrom, s.data() + s.size());
+                if (event == s.data() + s.size())
                 {
                     s.remove_prefix(s.size());
                     return;
                 }
 
                 s.remove_prefix(event - s.data());
+                searchFrom = 1;
 
                 switch (s[0])
                 {
@@ -94,6 +100,7 @@ namespace pgn
                     {
                         return;
                     }
+                    searchFrom = 0;
                     break;
 
                 case '(':
@@ -105,6 +112,9 @@ namespace pgn
                     break;
                 }
             }
+
+            // The closing parenthesis is not a part of the moves that follow.
+            s.remove_prefix(1);
         }
 
         namespace lookup::seekNextMove
@@ -533,6 +543,107 @@ namespace pgn
         return {};
     }
 
+    ParsedGameTags::ParsedGameTags() :
+        m_event{},
+        m_white{},
+        m_black{},
+        m_site{},
+        m_fen{},
+        m_result{},
+        m_date{},
+        m_eco('A', 0),
+        m_whiteElo(0),
+        m_blackElo(0),
+        m_round(0),
+        m_plyCount{}
+    {
+    }
+
+    [[nodiscard]] std::optional<GameResult> ParsedGameTags::result() const
+    {
+        return m_result;
+    }
+
+    [[nodiscard]] Date ParsedGameTags::date() const
+    {
+        return m_date;
+    }
+
+    [[nodiscard]] Eco ParsedGameTags::eco() const
+    {
+        return m_eco;
+    }
+
+    [[nodiscard]] std::string_view ParsedGameTags::event() const
+    {
+        return m_event;
+    }
+
+    [[nodiscard]] std::string_view ParsedGameTags::white() const
+    {
+        return m_white;
+    }
+
+    [[nodiscard]] std::string_view ParsedGameTags::black() const
+    {
+        return m_black;
+    }
+
+    [[nodiscard]] std::string_view ParsedGameTags::site() const
+    {
+        return m_site;
+    }
+
+    [[nodiscard]] std::int16_t ParsedGameTags::whiteElo() const
+    {
+        return m_whiteElo;
+    }
+
+    [[nodiscard]] std::int16_t ParsedGameTags::blackElo() const
+    {
+        return m_blackElo;
+    }
+
+    [[nodiscard]] std::int16_t ParsedGameTags::round() const
+    {
+        return m_round;
+    }
+
+    [[nodiscard]] std::uint16_t ParsedGameTags::plyCount() const
+    {
+        return m_plyCount.value_or(0);
+    }
+
+    [[nodiscard]] std::uint16_t ParsedGameTags::plyCount(std::uint16_t def) const
+    {
+        return m_plyCount.value_or(def);
+    }
+
+    [[nodiscard]] Position ParsedGameTags::startPosition() const
+    {
+        if (m_fen.empty())
+        {
+            return Position::startPosition();
+        }
+
+        return Position::fromFen(m_fen.data());
+    }
+
+    [[nodiscard]] PositionWithZobrist ParsedGameTags::startPositionWithZobrist() const
+    {
+        if (m_fen.empty())
+        {
+            return PositionWithZobrist::startPosition();
+        }
+
+        return PositionWithZobrist::fromFen(m_fen.data());
+    }
+
+    [[nodiscard]] bool ParsedGameTags::hasCustomStartPosition() const
+    {
+        return !m_fen.empty();
+    }
+
     UnparsedGame::UnparsedGame() :
         m_tagSection{},
         m_moveSection{}
@@ -556,36 +667,14 @@ namespace pgn
         std::string_view& black
     ) const
     {
-        // Eco is not a mandatory tag so may not be present
-        eco = Eco('A', 0);
-
-        for (auto&& tag : tags())
-        {
-            if (tag.key == "Event"sv)
-            {
-                event = tag.value;
-            }
-            else if (tag.key == "White"sv)
-            {
-                white = tag.value;
-            }
-            else if (tag.key == "Black"sv)
-            {
-                black = tag.value;
-            }
-            else if (tag.key == "Date"sv || tag.key == "UTCDate"sv)
-            {
-                date = detail::parseDate(tag.value);
-            }
-            else if (tag.key == "ECO"sv)
-            {
-                eco = Eco(tag.value);
-            }
-            else if (tag.key == "Result"sv)
-            {
-                result = detail::parseGameResult(tag.value);
-            }
-        }
+        const ParsedGameTags tags = parseTags<TagSet::Header>();
+
+        result = tags.result();
+        date = tags.date();
+        eco = tags.eco();
+        event = tags.event();
+        white = tags.white();
+        black = tags.black();
     }
 
     void UnparsedGame::getResultDateEcoEventWhiteBlackPlyCount(
@@ -598,42 +687,191 @@ namespace pgn
         std::uint16_t& plyCount
     ) const
     {
-        // Eco is not a mandatory tag so may not be present
-        eco = Eco('A', 0);
+        const ParsedGameTags tags = parseTags<TagSet::Header>();
+
+        result = tags.result();
+        date = tags.date();
+        eco = tags.eco();
+        event = tags.event();
+        white = tags.white();
+        black = tags.black();
+        plyCount = tags.plyCount(plyCount);
+    }
 
-        for (auto&& tag : tags())
-        {
-            if (tag.key == "Event"sv)
-            {
-                event = tag.value;
-            }
-            else if (tag.key == "White"sv)
-            {
-                white = tag.value;
-            }
-            else if (tag.key == "Black"sv)
+    template <TagSet TagsV>
+    [[nodiscard]] ParsedGameTags UnparsedGame::parseTags() const
+    {
+        ParsedGameTags parsed{};
+
+        // Date has priority over UTCDate regardless of the order.
+        std::string_view dateTag{};
+        std::string_view utcDateTag{};
+        bool hasUtcDate = false;
+
+        // When a tag repeats the first occurrence is used.
+        TagSet seen = TagSet::None;
+        const auto isFirst = [&seen](TagSet tag) {
+            if (contains(seen, tag))
             {
-                black = tag.value;
+                return false;
             }
-            else if (tag.key == "Date"sv || tag.key == "UTCDate"sv)
+            seen = seen | tag;
+            return true;
+        };
+
+        // Keys are dispatched on the first character so that
+        // each tag is compared with at most two names.
+        for (auto&& [key, value] : tags())
+        {
+            if (key.empty())
             {
-                date = detail::parseDate(tag.value);
+                continue;
             }
-            else if (tag.key == "ECO"sv)
+
+            switch (key[0])
             {
-                eco = Eco(tag.value);
+            case 'B':
+                if constexpr (contains(TagsV, TagSet::Black))
+                {
+                    if (key == "Black"sv && isFirst(TagSet::Black))
+                    {
+                        parsed.m_black = value;
+                    }
+                }
+                if constexpr (contains(TagsV, TagSet::BlackElo))
+                {
+                    if (key == "BlackElo"sv && isFirst(TagSet::BlackElo))
+                    {
+                        parsed.m_blackElo = value.size() < 3 ? 0 : parser_bits::parseUInt16(value);
+                    }
+                }
+                break;
+
+            case 'D':
+                if constexpr (contains(TagsV, TagSet::Date))
+                {
+                    if (key == "Date"sv && isFirst(TagSet::Date))
+                    {
+                        dateTag = value;
+                    }
+                }
+                break;
+
+            case 'E':
+                if constexpr (contains(TagsV, TagSet::Event))
+                {
+                    if (key == "Event"sv && isFirst(TagSet::Event))
+                    {
+                        parsed.m_event = value;
+                    }
+                }
+                if constexpr (contains(TagsV, TagSet::Eco))
+                {
+                    if (key == "ECO"sv && isFirst(TagSet::Eco))
+                    {
+                        parsed.m_eco = Eco(value);
+                    }
+                }
+                break;
+
+            case 'F':
+                if constexpr (contains(TagsV, TagSet::Fen))
+                {
+                    if (key == "FEN"sv && isFirst(TagSet::Fen))
+                    {
+                        parsed.m_fen = value;
+                    }
+                }
+                break;
+
+            case 'P':
+                if constexpr (contains(TagsV, TagSet::PlyCount))
+                {
+                    if (key == "PlyCount"sv && isFirst(TagSet::PlyCount))
+                    {
+                        parsed.m_plyCount = parser_bits::parseUInt16(value);
+                    }
+                }
+                break;
+
+            case 'R':
+                if constexpr (contains(TagsV, TagSet::Result))
+                {
+                    if (key == "Result"sv && isFirst(TagSet::Result))
+                    {
+                        parsed.m_result = detail::parseGameResult(value);
+                    }
+                }
+                if constexpr (contains(TagsV, TagSet::Round))
+                {
+                    if (key == "Round"sv && isFirst(TagSet::Round))
+                    {
+                        parsed.m_round = value.empty() ? 0 : parser_bits::parseUInt16(value);
+                    }
+                }
+                break;
+
+            case 'S':
+                if constexpr (contains(TagsV, TagSet::Site))
+                {
+                    if (key == "Site"sv && isFirst(TagSet::Site))
+                    {
+                        parsed.m_site = value;
+                    }
+                }
+                break;
+
+            case 'U':
+                if constexpr (contains(TagsV, TagSet::Date))
+                {
+                    if (key == "UTCDate"sv && !hasUtcDate)
+                    {
+                        utcDateTag = value;
+                        hasUtcDate = true;
+                    }
+                }
+                break;
+
+            case 'W':
+                if constexpr (contains(TagsV, TagSet::White))
+                {
+                    if (key == "White"sv && isFirst(TagSet::White))
+                    {
+                        parsed.m_white = value;
+                    }
+                }
+                if constexpr (contains(TagsV, TagSet::WhiteElo))
+                {
+                    if (key == "WhiteElo"sv && isFirst(TagSet::WhiteElo))
+                    {
+                        parsed.m_whiteElo = value.size() < 3 ? 0 : parser_bits::parseUInt16(value);
+                    }
+                }
+                break;
             }
-            else if (tag.key == "Result"sv)
+        }
+
+        if constexpr (contains(TagsV, TagSet::Date))
+        {
+            if (dateTag.empty())
             {
-                result = detail::parseGameResult(tag.value);
+                dateTag = utcDateTag;
             }
-            else if (tag.key == "PlyCount"sv)
+
+            if (!dateTag.empty())
             {
-                plyCount = parser_bits::parseUInt16(tag.value);
+                parsed.m_date = detail::parseDate(dateTag);
             }
         }
+
+        return parsed;
     }
 
+    template ParsedGameTags UnparsedGame::parseTags<TagSet::Positions>() const;
+    template ParsedGameTags UnparsedGame::parseTags<TagSet::Header>() const;
+    template ParsedGameTags UnparsedGame::parseTags<TagSet::Positions | TagSet::Header>() const;
+    template ParsedGameTags UnparsedGame::parseTags<TagSet::All>() const;
+
     [[nodiscard]] Position UnparsedGame::startPosition() const
     {
         const std::string_view fenTag = detail::findTagValue(m_tagSection, "FEN"sv);
@@ -781,21 +1019,39 @@ namespace pgn
         return UnparsedGameTags(m_tagSection);
     }
 
-    LazyPgnFileReader::LazyPgnFileReaderIterator::LazyPgnFileReaderIterator(const std::filesystem::path& path, std::size_t bufferSize) :
+    LazyPgnFileReader::LazyPgnFileReaderIterator::LazyPgnFileReaderIterator(const std::filesystem::path& path, std::size_t bufferSize, ReadMode mode) :
         m_file(nullptr, &std::fclose),
         m_bufferSize(bufferSize),
-        m_buffer(bufferSize + 1), // one spot for '\0',
-        m_auxBuffer(bufferSize),
+        m_buffer(mode == ReadMode::Buffered ? bufferSize + 1 : 0), // one spot for '\0',
+        m_auxBuffer(mode == ReadMode::Buffered ? bufferSize : 0),
         m_auxBufferLeft(0),
-        m_bufferView(m_buffer.data(), bufferSize),
-        m_game{}
+        m_bufferView(m_buffer.data(), m_buffer.size() ? bufferSize : 0),
+        m_mappedFile{},
+        m_numReleasedBytes(0),
+        m_lastGame{},
+        m_game{},
+        m_isEnd(false)
     {
+        if (mode == ReadMode::MemoryMapped)
+        {
+            m_mappedFile.emplace(path, ext::MemoryMappedFileAccess::Sequential);
+            m_bufferView = std::string_view(
+                reinterpret_cast<const char*>(m_mappedFile->data()),
+                m_mappedFile->size()
+            );
+
+            moveToNextGame();
+
+            return;
+        }
+
         auto strPath = path.string();
         m_file.reset(std::fopen(strPath.c_str(), "r"));
 
         if (m_file == nullptr)
         {
             m_buffer[0] = '\0';
+            m_isEnd = true;
             return;
         }
 
@@ -833,13 +1089,26 @@ namespace pgn
 
     [[nodiscard]] bool LazyPgnFileReader::LazyPgnFileReaderIterator::isEnd() const
     {
-        return m_buffer.front() == '\0';
+        return m_isEnd;
     }
 
     static const std::string tagSectionEndSequence = "\n\n";
     static const std::string moveSectionEndSequence = "\n\n";
 
     void LazyPgnFileReader::LazyPgnFileReaderIterator::moveToNextGame()
+    {
+        // A mapped file may have switched to buffered reading, see switchToBufferedReading.
+        if (m_file == nullptr)
+        {
+            moveToNextMappedGame();
+        }
+        else
+        {
+            moveToNextBufferedGame();
+        }
+    }
+
+    void LazyPgnFileReader::LazyPgnFileReaderIterator::moveToNextBufferedGame()
     {
         while (m_buffer.front() != '\0')
         {
@@ -861,8 +1130,10 @@ namespace pgn
                 continue;
             }
 
-            const char* tagEndC = std::strstr(m_bufferView.data() + tagStart, tagSectionEndSequence.c_str());
-            if (tagEndC == nullptr)
+            const char* bufferEnd = m_bufferView.data() + m_bufferView.size();
+
+            const char* tagEndC = scan::findEmptyLine(m_bufferView.data() + tagStart, bufferEnd);
+            if (tagEndC == bufferEnd)
             {
                 refillBuffer();
                 continue;
@@ -876,8 +1147,8 @@ namespace pgn
                 continue;
             }
 
-            const char* moveEndC = std::strstr(m_bufferView.data() + moveStart, moveSectionEndSequence.c_str());
-            if (moveEndC == nullptr)
+            const char* moveEndC = scan::findEmptyLine(m_bufferView.data() + moveStart, bufferEnd);
+            if (moveEndC == bufferEnd)
             {
                 refillBuffer();
                 continue;
@@ -902,6 +1173,159 @@ namespace pgn
 
             return;
         }
+
+        m_isEnd = true;
+    }
+
+    void LazyPgnFileReader::LazyPgnFileReaderIterator::moveToNextMappedGame()
+    {
+        // The same sequence as for the buffered reader, but the whole
+        // file is available so not finding a part means there are no more games.
+        // The only exception is the move section of the last game,
+        // which may end with the file instead of an empty line.
+        // The file is read as is, so a '\r' means that there may be
+        // "\r\n" line endings, which only the buffered reader handles.
+
+        releaseProcessedPages();
+
+        const char* fileEnd = m_bufferView.data() + m_bufferView.size();
+
+        auto hasCarriageReturn = [this](std::size_t begin, std::size_t end) {
+            return std::memchr(m_bufferView.data() + begin, '\r', end - begin) != nullptr;
+        };
+
+        const std::size_t tagStart = m_bufferView.find_first_not_of('\n');
+        if (tagStart == std::string::npos)
+        {
+            m_isEnd = true;
+            return;
+        }
+
+        const char* tagEndC = scan::findEmptyLine(m_bufferView.data() + tagStart, fileEnd);
+        if (tagEndC == fileEnd)
+        {
+            if (hasCarriageReturn(tagStart, m_bufferView.size()))
+            {
+                switchToBufferedReading();
+                return;
+            }
+
+            m_isEnd = true;
+            return;
+        }
+        const std::size_t tagEnd = tagEndC - m_bufferView.data();
+
+        const std::size_t moveStart = m_bufferView.find_first_not_of('\n', tagEnd + tagSectionEndSequence.size());
+        if (moveStart == std::string::npos)
+        {
+            if (hasCarriageReturn(tagStart, m_bufferView.size()))
+            {
+                switchToBufferedReading();
+                return;
+            }
+
+            m_isEnd = true;
+            return;
+        }
+
+        const char* moveEndC = scan::findEmptyLine(m_bufferView.data() + moveStart, fileEnd);
+        if (moveEndC == fileEnd)
+        {
+            if (hasCarriageReturn(tagStart, m_bufferView.size()))
+            {
+                switchToBufferedReading();
+                return;
+            }
+
+            // Move parsing relies on a new line after the last move.
+            // It's guaranteed only for terminated games so we need a copy.
+            // The tag section is copied too so that the game is in one place.
+            std::string_view rest = m_bufferView.substr(tagStart);
+            if (rest.back() == '\n')
+            {
+                rest.remove_suffix(1);
+            }
+
+            m_lastGame.assign(rest.begin(), rest.end());
+            m_lastGame.push_back('\n');
+            m_lastGame.push_back('\n');
+
+            const std::string_view lastGame(m_lastGame.data(), m_lastGame.size());
+            m_game = UnparsedGame(
+                lastGame.substr(0, tagEnd - tagStart + 1),
+                lastGame.substr(moveStart - tagStart, rest.size() - (moveStart - tagStart))
+            );
+
+            m_bufferView.remove_prefix(m_bufferView.size());
+
+            return;
+        }
+        const std::size_t moveEnd = moveEndC - m_bufferView.data();
+
+        if (hasCarriageReturn(tagStart, moveEnd))
+        {
+            switchToBufferedReading();
+            return;
+        }
+
+        std::size_t nextGameStart = m_bufferView.find_first_not_of('\n', moveEnd + moveSectionEndSequence.size());
+        if (nextGameStart == std::string::npos)
+        {
+            nextGameStart = m_bufferView.size();
+        }
+
+        m_game = UnparsedGame(
+            m_bufferView.substr(tagStart, tagEnd - tagStart + 1),
+            m_bufferView.substr(moveStart, moveEnd - moveStart)
+        );
+
+        m_bufferView.remove_prefix(nextGameStart);
+    }
+
+    void LazyPgnFileReader::LazyPgnFileReaderIterator::switchToBufferedReading()
+    {
+        // The mapping is kept so that the games already returned stay valid.
+        const std::uint64_t offset = m_bufferView.data() - reinterpret_cast<const char*>(m_mappedFile->data());
+
+        m_buffer.assign(m_bufferSize + 1, '\0');
+        m_auxBuffer.assign(m_bufferSize, '\0');
+        m_auxBufferLeft = 0;
+        m_bufferView = std::string_view(m_buffer.data(), m_bufferSize);
+
+        auto strPath = m_mappedFile->path().string();
+        m_file.reset(std::fopen(strPath.c_str(), "r"));
+        if (m_file == nullptr)
+        {
+            throw std::runtime_error("Cannot reopen " + strPath + ".");
+        }
+
+#if defined(_WIN32)
+        const int seekResult = _fseeki64(m_file.get(), static_cast<std::int64_t>(offset), SEEK_SET);
+#else
+        const int seekResult = fseeko(m_file.get(), static_cast<off_t>(offset), SEEK_SET);
+#endif
+        if (seekResult != 0)
+        {
+            throw std::runtime_error("Cannot seek in " + strPath + ".");
+        }
+
+        refillBuffer();
+
+        moveToNextBufferedGame();
+    }
+
+    void LazyPgnFileReader::LazyPgnFileReaderIterator::releaseProcessedPages()
+    {
+        // Games already returned stay readable, the pages
+        // are loaded from the file again if they are accessed.
+        const std::size_t numProcessedBytes =
+            m_bufferView.data() - reinterpret_cast<const char*>(m_mappedFile->data());
+
+        if (numProcessedBytes - m_numReleasedBytes >= m_mappedReleaseGranularity)
+        {
+            m_mappedFile->release(m_numReleasedBytes, numProcessedBytes - m_numReleasedBytes);
+            m_numReleasedBytes = numProcessedBytes;
+        }
     }
 
     // NOINLINE because it is rarely called
@@ -966,10 +1390,11 @@ namespace pgn
     // We keep the file opened. That way we weakly enforce that a created iterator
     // (that reopens the file to have it's own cursor)
     // is valid after a successful call to isOpen()
-    LazyPgnFileReader::LazyPgnFileReader(const std::filesystem::path& path, std::size_t bufferSize) :
+    LazyPgnFileReader::LazyPgnFileReader(const std::filesystem::path& path, std::size_t bufferSize, ReadMode mode) :
         m_file(nullptr, &std::fclose),
         m_path(path),
-        m_bufferSize(std::max(m_minBufferSize, bufferSize))
+        m_bufferSize(std::max(m_minBufferSize, bufferSize)),
+        m_mode(mode)
     {
         auto strPath = path.string();
         m_file.reset(std::fopen(strPath.c_str(), "r"));
@@ -982,7 +1407,7 @@ namespace pgn
 
     [[nodiscard]] LazyPgnFileReader::LazyPgnFileReaderIterator LazyPgnFileReader::begin()
     {
-        return { m_path, m_bufferSize };
+        return { m_path, m_bufferSize, m_mode };
     }
 
     [[nodiscard]] LazyPgnFileReader::LazyPgnFileReaderIterator::Sentinel LazyPgnFileReader::end() const
@@ -5,6 +5,8 @@
 #include "GameClassification.h"
 #include "Position.h"
 
+#include "external_storage/MemoryMappedFile.h"
+
 #include "util/Assert.h"
 
 #include <cstdint>
@@ -152,6 +154,104 @@ namespace pgn
         std::string_view m_tagSection;
     };
 
+    // Selects the tags decoded by UnparsedGame::parseTags.
+    enum struct TagSet : std::uint16_t
+    {
+        None = 0x0,
+        Event = 0x1,
+        White = 0x2,
+        Black = 0x4,
+        Result = 0x8,
+        Date = 0x10, // also UTCDate, used when Date is not present
+        Eco = 0x20,
+        WhiteElo = 0x40,
+        BlackElo = 0x80,
+        Round = 0x100,
+        PlyCount = 0x200,
+        Fen = 0x400,
+        Site = 0x800,
+
+        // Needed to import the positions of a game.
+        Positions = Result | Date | WhiteElo | BlackElo | Fen,
+
+        // Stored in a game header.
+        Header = Event | White | Black | Result | Date | Eco | PlyCount,
+
+        All = Positions | Header | Round | Site
+    };
+
+    [[nodiscard]] constexpr TagSet operator|(TagSet lhs, TagSet rhs)
+    {
+        return static_cast<TagSet>(static_cast<std::uint16_t>(lhs) | static_cast<std::uint16_t>(rhs));
+    }
+
+    [[nodiscard]] constexpr TagSet operator&(TagSet lhs, TagSet rhs)
+    {
+        return static_cast<TagSet>(static_cast<std::uint16_t>(lhs) & static_cast<std::uint16_t>(rhs));
+    }
+
+    // checks whether lhs contains rhs
+    [[nodiscard]] constexpr bool contains(TagSet lhs, TagSet rhs)
+    {
+        return (lhs & rhs) == rhs;
+    }
+
+    // Values of the tags decoded in a single pass over the tag section.
+    // Tags that were not selected or not present have the same values
+    // as returned by the respective UnparsedGame accessors for missing tags.
+    // String views point into the tag section of the game.
+    struct ParsedGameTags
+    {
+        ParsedGameTags();
+
+        [[nodiscard]] std::optional<GameResult> result() const;
+
+        [[nodiscard]] Date date() const;
+
+        // Eco('A', 0) when not present.
+        [[nodiscard]] Eco eco() const;
+
+        [[nodiscard]] std::string_view event() const;
+
+        [[nodiscard]] std::string_view white() const;
+
+        [[nodiscard]] std::string_view black() const;
+
+        [[nodiscard]] std::string_view site() const;
+
+        [[nodiscard]] std::int16_t whiteElo() const;
+
+        [[nodiscard]] std::int16_t blackElo() const;
+
+        [[nodiscard]] std::int16_t round() const;
+
+        [[nodiscard]] std::uint16_t plyCount() const;
+
+        [[nodiscard]] std::uint16_t plyCount(std::uint16_t def) const;
+
+        [[nodiscard]] Position startPosition() const;
+
+        [[nodiscard]] PositionWithZobrist startPositionWithZobrist() const;
+
+        [[nodiscard]] bool hasCustomStartPosition() const;
+
+    private:
+        std::string_view m_event;
+        std::string_view m_white;
+        std::string_view m_black;
+        std::string_view m_site;
+        std::string_view m_fen;
+        std::optional<GameResult> m_result;
+        Date m_date;
+        Eco m_eco;
+        std::int16_t m_whiteElo;
+        std::int16_t m_blackElo;
+        std::int16_t m_round;
+        std::optional<std::uint16_t> m_plyCount;
+
+        friend struct UnparsedGame;
+    };
+
     struct UnparsedGame
     {
         explicit UnparsedGame();
@@ -177,6 +277,13 @@ namespace pgn
             std::uint16_t& plyCount
         ) const;
 
+        // Decodes all tags in TagsV with a single pass over the tag section,
+        // while the accessors below search the tag section on each call.
+        // Instantiated for TagSet::Positions, TagSet::Header,
+        // TagSet::Positions | TagSet::Header, and TagSet::All.
+        template <TagSet TagsV>
+        [[nodiscard]] ParsedGameTags parseTags() const;
+
         [[nodiscard]] Position startPosition() const;
 
         [[nodiscard]] PositionWithZobrist startPositionWithZobrist() const;
@@ -227,7 +334,24 @@ namespace pgn
         // TODO: resize buffer when didn't process anything
         static constexpr std::size_t m_minBufferSize = 128ull * 1024ull;
 
+        // Bytes consumed by a memory mapped reader before the pages behind it
+        // are released, see ext::MemoryMappedFile::release.
+        static constexpr std::size_t m_mappedReleaseGranularity = 16ull * 1024ull * 1024ull;
+
     public:
+        enum struct ReadMode
+        {
+            // The file is read in chunks into a buffer of the given size.
+            Buffered,
+
+            // The whole file is memory mapped and the games are views into
+            // the mapping, so nothing is copied. There is no limit on the size
+            // of a game. The file is read as is, there is no new line translation,
+            // so when a '\r' is found the rest of the file is read like in
+            // the buffered mode, with a buffer of the given size.
+            MemoryMapped
+        };
+
         struct LazyPgnFileReaderIterator
         {
             struct Sentinel {};
@@ -238,7 +362,7 @@ namespace pgn
             using iterator_category = std::input_iterator_tag;
             using pointer = const UnparsedGame*;
 
-            LazyPgnFileReaderIterator(const std::filesystem::path& path, std::size_t bufferSize);
+            LazyPgnFileReaderIterator(const std::filesystem::path& path, std::size_t bufferSize, ReadMode mode);
 
             const LazyPgnFileReaderIterator& operator++();
 
@@ -258,13 +382,25 @@ namespace pgn
             std::future<std::size_t> m_future;
             std::size_t m_auxBufferLeft;
             std::string_view m_bufferView; // what is currently being processed
+            std::optional<ext::MemoryMappedFile> m_mappedFile;
+            std::size_t m_numReleasedBytes;
+            std::vector<char> m_lastGame; // the last game of a mapped file if it's not terminated
             UnparsedGame m_game;
+            bool m_isEnd;
 
             [[nodiscard]] bool isEnd() const;
 
             void moveToNextGame();
 
+            void moveToNextBufferedGame();
+
+            void moveToNextMappedGame();
+
             NOINLINE void refillBuffer();
+
+            void releaseProcessedPages();
+
+            void switchToBufferedReading();
         };
 
         using iterator = LazyPgnFileReaderIterator;
@@ -273,7 +409,11 @@ namespace pgn
         // We keep the file opened. That way we weakly enforce that a created iterator
         // (that reopens the file to have it's own cursor)
         // is valid after a successful call to isOpen()
-        LazyPgnFileReader(const std::filesystem::path& path, std::size_t bufferSize = m_minBufferSize);
+        LazyPgnFileReader(
+            const std::filesystem::path& path,
+            std::size_t bufferSize = m_minBufferSize,
+            ReadMode mode = ReadMode::Buffered
+            );
 
         [[nodiscard]] bool isOpen() const;
 
@@ -285,5 +425,6 @@ namespace pgn
         std::unique_ptr<FILE, decltype(&std::fclose)> m_file;
         std::filesystem::path m_path;
         std::size_t m_bufferSize;
+        ReadMode m_mode;
     };
 }
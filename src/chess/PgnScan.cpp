@@ -0,0 +1,153 @@
+#include "PgnScan.h"
+
+#include "intrin/Intrinsics.h"
+
+#include "util/Assert.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace pgn::scan
+{
+    namespace detail
+    {
+        namespace lookup::findVariationEvent
+        {
+            static constexpr std::array<bool, 256> isEvent = []() {
+                std::array<bool, 256> isEvent{};
+
+                isEvent['('] = true;
+                isEvent[')'] = true;
+                isEvent['{'] = true;
+                isEvent[';'] = true;
+
+                return isEvent;
+            }();
+        }
+
+        static constexpr std::size_t chunkSize = 32;
+
+        [[nodiscard]] const char* findEmptyLineScalar(const char* begin, const char* end)
+        {
+            ASSERT(begin <= end);
+
+            const char* p = begin;
+            while (end - p >= 2)
+            {
+                p = static_cast<const char*>(std::memchr(p, '\n', end - p - 1));
+                if (p == nullptr)
+                {
+                    return end;
+                }
+
+                if (p[1] == '\n')
+                {
+                    return p;
+                }
+
+                ++p;
+            }
+
+            return end;
+        }
+
+        [[nodiscard]] const char* findVariationEventScalar(const char* begin, const char* end)
+        {
+            ASSERT(begin <= end);
+
+            for (const char* p = begin; p != end; ++p)
+            {
+                if (lookup::findVariationEvent::isEvent[static_cast<unsigned char>(*p)])
+                {
+                    return p;
+                }
+            }
+
+            return end;
+        }
+
+        [[nodiscard]] TARGET_AVX2 static std::uint32_t matchMask(__m256i chunk, char c)
+        {
+            return static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(c))));
+        }
+
+        [[nodiscard]] TARGET_AVX2 const char* findEmptyLineAvx2(const char* begin, const char* end)
+        {
+            ASSERT(begin <= end);
+
+            // Whether the last byte of the previous chunk is a new line.
+            std::uint32_t carry = 0;
+
+            const char* p = begin;
+            for (; static_cast<std::size_t>(end - p) >= chunkSize; p += chunkSize)
+            {
+                const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+                const std::uint32_t newLines = matchMask(chunk, '\n');
+
+                // Bit i is set when bytes i - 1 and i are both new lines.
+                const std::uint32_t pairs = newLines & ((newLines << 1) | carry);
+                if (pairs)
+                {
+                    return p + intrin::lsb(pairs) - 1;
+                }
+
+                carry = newLines >> (chunkSize - 1);
+            }
+
+            if (carry && p != end && *p == '\n')
+            {
+                return p - 1;
+            }
+
+            return findEmptyLineScalar(p, end);
+        }
+
+        [[nodiscard]] TARGET_AVX2 const char* findVariationEventAvx2(const char* begin, const char* end)
+        {
+            ASSERT(begin <= end);
+
+            const char* p = begin;
+            for (; static_cast<std::size_t>(end - p) >= chunkSize; p += chunkSize)
+            {
+                const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+                const std::uint32_t events =
+                    matchMask(chunk, '(')
+                    | matchMask(chunk, ')')
+                    | matchMask(chunk, '{')
+                    | matchMask(chunk, ';');
+
+                if (events)
+                {
+                    return p + intrin::lsb(events);
+                }
+            }
+
+            return findVariationEventScalar(p, end);
+        }
+    }
+
+    [[nodiscard]] const char* findEmptyLine(const char* begin, const char* end)
+    {
+        if (intrin::hasAvx2())
+        {
+            return detail::findEmptyLineAvx2(begin, end);
+        }
+        else
+        {
+            return detail::findEmptyLineScalar(begin, end);
+        }
+    }
+
+    [[nodiscard]] const char* findVariationEvent(const char* begin, const char* end)
+    {
+        if (intrin::hasAvx2())
+        {
+            return detail::findVariationEventAvx2(begin, end);
+        }
+        else
+        {
+            return detail::findVariationEventScalar(begin, end);
+        }
+    }
+}
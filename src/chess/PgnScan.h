@@ -0,0 +1,28 @@
+#pragma once
+
+namespace pgn::scan
+{
+    // Searches for the characters that delimit the parts of PGN.
+    // 32 bytes are classified at a time when the cpu supports AVX2.
+    // All functions search in [begin, end) and return `end` if nothing is found.
+    // They never read outside of the range.
+
+    // The first of two consecutive new lines. They end the tag and move sections.
+    [[nodiscard]] const char* findEmptyLine(const char* begin, const char* end);
+
+    // The first of "(){;", the characters that matter when skipping a variation.
+    [[nodiscard]] const char* findVariationEvent(const char* begin, const char* end);
+
+    namespace detail
+    {
+        [[nodiscard]] const char* findEmptyLineScalar(const char* begin, const char* end);
+
+        [[nodiscard]] const char* findVariationEventScalar(const char* begin, const char* end);
+
+        // Can only be called when intrin::hasAvx2().
+        [[nodiscard]] const char* findEmptyLineAvx2(const char* begin, const char* end);
+
+        // Can only be called when intrin::hasAvx2().
+        [[nodiscard]] const char* findVariationEventAvx2(const char* begin, const char* end);
+    }
+}
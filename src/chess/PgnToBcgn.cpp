@@ -0,0 +1,520 @@
+#include "PgnToBcgn.h"
+
+#include "Bcgn.h"
+#include "Chess.h"
+#include "Pgn.h"
+#include "Position.h"
+#include "San.h"
+
+#include "util/Assert.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace bcgn
+{
+    namespace detail
+    {
+        // The number of bytes of PGN text in a batch of games given to a thread.
+        static constexpr std::size_t pgnBatchSize = 1024ull * 1024ull;
+
+        // The maximal number of batches being read, encoded, or waiting
+        // to be written, per encoding thread. Bounds the memory used.
+        static constexpr std::size_t numBatchesInFlightPerThread = 4;
+
+        // Copies of the games, because the reader reuses its buffers.
+        struct PgnBatch
+        {
+            struct Game
+            {
+                std::size_t tagSectionBegin;
+                std::size_t tagSectionSize;
+                std::size_t moveSectionBegin;
+                std::size_t moveSectionSize;
+            };
+
+            std::size_t index = 0;
+            std::string text;
+            std::vector<Game> games;
+
+            void addGame(const pgn::UnparsedGame& game)
+            {
+                const std::string_view tagSection = game.tagSection();
+                const std::string_view moveSection = game.moveSection();
+
+                Game& entry = games.emplace_back();
+                entry.tagSectionBegin = text.size();
+                entry.tagSectionSize = tagSection.size();
+                text.append(tagSection);
+                entry.moveSectionBegin = text.size();
+                entry.moveSectionSize = moveSection.size();
+                text.append(moveSection);
+            }
+
+            [[nodiscard]] pgn::UnparsedGame game(const Game& entry) const
+            {
+                return pgn::UnparsedGame(
+                    std::string_view(text.data() + entry.tagSectionBegin, entry.tagSectionSize),
+                    std::string_view(text.data() + entry.moveSectionBegin, entry.moveSectionSize)
+                );
+            }
+        };
+
+        struct EncodedBatch
+        {
+            std::vector<unsigned char> data;
+            // Offsets one past the end of each game.
+            std::vector<std::size_t> gameEnds;
+
+            // Only when writing position keys, in the same layout.
+            std::vector<unsigned char> keys;
+            std::vector<std::size_t> keyEnds;
+        };
+
+        // Keys are only collected when keys is not null.
+        static void encodeGame(
+            const pgn::UnparsedGame& game,
+            const BcgnFileHeader& header,
+            BcgnGameEntryBuffer& entry,
+            std::vector<BcgnPositionKey>* keys
+            )
+        {
+            entry.clear();
+
+            const pgn::ParsedGameTags tags =
+                header.isHeaderless
+                ? game.parseTags<pgn::TagSet::Positions>()
+                : game.parseTags<pgn::TagSet::All>();
+
+            PositionWithZobrist pos = tags.startPositionWithZobrist();
+
+            if (!header.isHeaderless)
+            {
+                entry.setWhiteElo(tags.whiteElo());
+                entry.setBlackElo(tags.blackElo());
+                entry.setDate(tags.date());
+                entry.setEco(tags.eco());
+                entry.setRound(tags.round());
+                entry.setWhitePlayer(tags.white());
+                entry.setBlackPlayer(tags.black());
+                entry.setEvent(tags.event());
+                entry.setSite(tags.site());
+            }
+
+            const std::optional<GameResult> result = tags.result();
+            if (result.has_value())
+            {
+                entry.setResult(*result);
+            }
+
+            if (tags.hasCustomStartPosition() && pos != Position::startPosition())
+            {
+                entry.setCustomStartPos(pos);
+            }
+
+            if (keys != nullptr)
+            {
+                keys->clear();
+                keys->push_back(BcgnPositionKey{ pos.zobrist(), PackedReverseMove(ReverseMove{}) });
+            }
+
+            for (auto&& san : game.moves())
+            {
+                const Move move = san::sanToMove(pos, san);
+                if (move == Move::null())
+                {
+                    break;
+                }
+
+                entry.addMove(pos, move);
+
+                const ReverseMove reverseMove = pos.doMove(move);
+                if (keys != nullptr)
+                {
+                    keys->push_back(BcgnPositionKey{ pos.zobrist(), PackedReverseMove(reverseMove) });
+                }
+            }
+        }
+
+        [[nodiscard]] static std::filesystem::path shardPath(const std::filesystem::path& path, std::size_t shardIdx)
+        {
+            return path.parent_path() / (path.stem().string() + "_" + std::to_string(shardIdx) + path.extension().string());
+        }
+
+        struct PgnToBcgnConverter
+        {
+            PgnToBcgnConverter(
+                const std::filesystem::path& bcgn,
+                const PgnToBcgnConversionParams& params,
+                PgnToBcgnProgressCallback progressCallback
+            ) :
+                m_path(bcgn),
+                m_params(params),
+                m_progressCallback(std::move(progressCallback)),
+                m_numThreads(std::max<std::size_t>(params.numThreads, 1)),
+                m_maxNumBatchesInFlight(m_numThreads * numBatchesInFlightPerThread)
+            {
+            }
+
+            [[nodiscard]] PgnToBcgnConversionStats run(const std::filesystem::path& pgn)
+            {
+                std::vector<std::thread> threads;
+                threads.emplace_back([this]() { writeBatches(); });
+                for (std::size_t i = 0; i < m_numThreads; ++i)
+                {
+                    threads.emplace_back([this]() { encodeBatches(); });
+                }
+
+                try
+                {
+                    readBatches(pgn);
+                }
+                catch (...)
+                {
+                    setError(std::current_exception());
+                }
+
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_isReadingFinished = true;
+                }
+                m_workAvailable.notify_all();
+                m_resultAvailable.notify_all();
+
+                for (auto& thread : threads)
+                {
+                    thread.join();
+                }
+
+                if (m_error)
+                {
+                    std::rethrow_exception(m_error);
+                }
+
+                return std::move(m_stats);
+            }
+
+        private:
+            std::filesystem::path m_path;
+            PgnToBcgnConversionParams m_params;
+            PgnToBcgnProgressCallback m_progressCallback;
+            std::size_t m_numThreads;
+            std::size_t m_maxNumBatchesInFlight;
+
+            std::mutex m_mutex;
+            std::condition_variable m_workAvailable;
+            std::condition_variable m_resultAvailable;
+            std::condition_variable m_slotAvailable;
+            std::deque<PgnBatch> m_work;
+            std::map<std::size_t, EncodedBatch> m_results;
+            // Batches submitted and not yet written.
+            std::size_t m_numBatchesInFlight = 0;
+            bool m_isReadingFinished = false;
+            std::exception_ptr m_error;
+
+            // Only accessed by the writer thread until it's joined.
+            PgnToBcgnConversionStats m_stats;
+
+            void setError(std::exception_ptr error)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    if (!m_error)
+                    {
+                        m_error = error;
+                    }
+                }
+
+                m_workAvailable.notify_all();
+                m_resultAvailable.notify_all();
+                m_slotAvailable.notify_all();
+            }
+
+            void readBatches(const std::filesystem::path& pgn)
+            {
+                pgn::LazyPgnFileReader reader(pgn, m_params.pgnParserMemory);
+                if (!reader.isOpen())
+                {
+                    throw std::runtime_error("Failed to open file " + pgn.string());
+                }
+
+                PgnBatch batch{};
+                for (auto&& game : reader)
+                {
+                    batch.addGame(game);
+
+                    if (batch.text.size() >= pgnBatchSize)
+                    {
+                        const std::size_t nextIndex = batch.index + 1;
+                        if (!submit(std::move(batch)))
+                        {
+                            return;
+                        }
+
+                        batch = PgnBatch{};
+                        batch.index = nextIndex;
+                    }
+                }
+
+                if (!batch.games.empty())
+                {
+                    (void)submit(std::move(batch));
+                }
+            }
+
+            // Returns false if the conversion failed and nothing more should be read.
+            [[nodiscard]] bool submit(PgnBatch&& batch)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_slotAvailable.wait(lock, [this]() {
+                        return m_numBatchesInFlight < m_maxNumBatchesInFlight || m_error;
+                    });
+
+                    if (m_error)
+                    {
+                        return false;
+                    }
+
+                    m_numBatchesInFlight += 1;
+                    m_work.emplace_back(std::move(batch));
+                }
+
+                m_workAvailable.notify_one();
+                return true;
+            }
+
+            void encodeBatches()
+            {
+                BcgnGameEntryBuffer entry(m_params.header);
+                std::vector<BcgnPositionKey> keys;
+
+                for (;;)
+                {
+                    PgnBatch batch;
+
+                    {
+                        std::unique_lock<std::mutex> lock(m_mutex);
+                        m_workAvailable.wait(lock, [this]() {
+                            return !m_work.empty() || m_isReadingFinished || m_error;
+                        });
+
+                        if (m_error || m_work.empty())
+                        {
+                            return;
+                        }
+
+                        batch = std::move(m_work.front());
+                        m_work.pop_front();
+                    }
+
+                    EncodedBatch encoded;
+                    try
+                    {
+                        encoded = encodeBatch(batch, entry, keys);
+                    }
+                    catch (...)
+                    {
+                        setError(std::current_exception());
+                        return;
+                    }
+
+                    {
+                        std::unique_lock<std::mutex> lock(m_mutex);
+                        m_results.emplace(batch.index, std::move(encoded));
+                    }
+
+                    m_resultAvailable.notify_one();
+                }
+            }
+
+            [[nodiscard]] EncodedBatch encodeBatch(
+                const PgnBatch& batch,
+                BcgnGameEntryBuffer& entry,
+                std::vector<BcgnPositionKey>& keys
+                ) const
+            {
+                EncodedBatch encoded;
+                encoded.gameEnds.reserve(batch.games.size());
+                if (m_params.writePositionKeys)
+                {
+                    encoded.keyEnds.reserve(batch.games.size());
+                }
+
+                // Encoded games are smaller than the PGN text, so this usually doesn't grow.
+                std::size_t size = 0;
+                encoded.data.resize(batch.text.size() + traits::maxGameLength);
+                for (auto&& game : batch.games)
+                {
+                    if (encoded.data.size() - size < traits::maxGameLength)
+                    {
+                        encoded.data.resize(encoded.data.size() * 2);
+                    }
+
+                    encodeGame(batch.game(game), m_params.header, entry, m_params.writePositionKeys ? &keys : nullptr);
+                    size += entry.writeTo(encoded.data.data() + size);
+                    encoded.gameEnds.emplace_back(size);
+
+                    if (m_params.writePositionKeys)
+                    {
+                        BcgnPositionKeyFileWriter::encodeGame(encoded.keys, keys);
+                        encoded.keyEnds.emplace_back(encoded.keys.size());
+                    }
+                }
+                encoded.data.resize(size);
+
+                return encoded;
+            }
+
+            void writeBatches()
+            {
+                try
+                {
+                    std::optional<BcgnFileWriter> writer;
+                    std::optional<BcgnPositionKeyFileWriter> keyWriter;
+                    std::size_t shardSize = 0;
+                    auto closeShard = [&]() {
+                        writer.reset();
+                        if (keyWriter.has_value())
+                        {
+                            keyWriter->finalize();
+                            keyWriter.reset();
+                        }
+                    };
+                    auto openNextShard = [&]() {
+                        const std::size_t shardIdx = m_stats.outputPaths.size();
+                        const auto path = m_params.maxShardSize ? shardPath(m_path, shardIdx) : m_path;
+
+                        const auto mode = shardIdx == 0 ? m_params.mode : BcgnFileWriter::FileOpenMode::Truncate;
+
+                        closeShard();
+                        writer.emplace(
+                            path,
+                            m_params.header,
+                            mode,
+                            m_params.bcgnWriterMemory
+                        );
+                        if (m_params.writePositionKeys)
+                        {
+                            keyWriter.emplace(path);
+                        }
+                        else if (mode == BcgnFileWriter::FileOpenMode::Truncate)
+                        {
+                            // Keys of an earlier conversion could match the size of the new file.
+                            std::filesystem::remove(BcgnPositionKeyFileReader::pathFor(path));
+                        }
+                        m_stats.outputPaths.emplace_back(path);
+                        shardSize = 0;
+                    };
+
+                    openNextShard();
+
+                    for (std::size_t nextIndex = 0;; ++nextIndex)
+                    {
+                        EncodedBatch batch;
+
+                        {
+                            std::unique_lock<std::mutex> lock(m_mutex);
+                            m_resultAvailable.wait(lock, [this, nextIndex]() {
+                                return
+                                    m_results.count(nextIndex)
+                                    || (m_isReadingFinished && m_numBatchesInFlight == 0)
+                                    || m_error;
+                            });
+
+                            if (m_error)
+                            {
+                                return;
+                            }
+
+                            auto it = m_results.find(nextIndex);
+                            if (it == m_results.end())
+                            {
+                                break;
+                            }
+
+                            batch = std::move(it->second);
+                            m_results.erase(it);
+                        }
+
+                        // Write runs of games that go to the same shard.
+                        std::size_t runBegin = 0;
+                        std::size_t runFirstGameIdx = 0;
+                        std::size_t gameBegin = 0;
+                        auto writeRun = [&](std::size_t gameIdx) {
+                            writer->writeEncodedGames(batch.data.data() + runBegin, gameBegin - runBegin);
+                            if (keyWriter.has_value())
+                            {
+                                const std::size_t keysBegin = runFirstGameIdx ? batch.keyEnds[runFirstGameIdx - 1] : 0;
+                                const std::size_t keysEnd = gameIdx ? batch.keyEnds[gameIdx - 1] : 0;
+                                keyWriter->writeEncodedGames(batch.keys.data() + keysBegin, keysEnd - keysBegin, gameIdx - runFirstGameIdx);
+                            }
+                        };
+                        for (std::size_t gameIdx = 0; gameIdx < batch.gameEnds.size(); ++gameIdx)
+                        {
+                            const std::size_t gameEnd = batch.gameEnds[gameIdx];
+                            const std::size_t gameSize = gameEnd - gameBegin;
+                            if (m_params.maxShardSize && shardSize != 0 && shardSize + gameSize > m_params.maxShardSize)
+                            {
+                                writeRun(gameIdx);
+                                openNextShard();
+                                runBegin = gameBegin;
+                                runFirstGameIdx = gameIdx;
+                            }
+
+                            shardSize += gameSize;
+                            gameBegin = gameEnd;
+                        }
+                        writeRun(batch.gameEnds.size());
+
+                        m_stats.numGames += batch.gameEnds.size();
+
+                        {
+                            std::unique_lock<std::mutex> lock(m_mutex);
+                            m_numBatchesInFlight -= 1;
+                        }
+                        m_slotAvailable.notify_one();
+
+                        if (m_progressCallback)
+                        {
+                            m_progressCallback(m_stats.numGames);
+                        }
+                    }
+
+                    closeShard();
+                }
+                catch (...)
+                {
+                    setError(std::current_exception());
+                }
+            }
+        };
+    }
+
+    PgnToBcgnConversionStats convertPgnToBcgn(
+        const std::filesystem::path& pgn,
+        const std::filesystem::path& bcgn,
+        const PgnToBcgnConversionParams& params,
+        PgnToBcgnProgressCallback progressCallback
+    )
+    {
+        if (params.writePositionKeys && params.mode == BcgnFileWriter::FileOpenMode::Append)
+        {
+            throw std::runtime_error("Position keys can't be written when appending.");
+        }
+
+        detail::PgnToBcgnConverter converter(bcgn, params, std::move(progressCallback));
+        return converter.run(pgn);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Bcgn.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+namespace bcgn
+{
+    struct PgnToBcgnConversionParams
+    {
+        BcgnFileHeader header{};
+
+        // Only applies to the first output file.
+        BcgnFileWriter::FileOpenMode mode = BcgnFileWriter::FileOpenMode::Truncate;
+
+        // The number of threads parsing and encoding games.
+        // The input is split into games on the calling thread
+        // and the output is written by one more thread.
+        std::size_t numThreads = 1;
+
+        // When not 0 the output is split into files named <stem>_<i><extension>.
+        // A new file is started before a game that would make the games
+        // in the current one take more than this many bytes, before aux compression.
+        std::size_t maxShardSize = 0;
+
+        // Whether to write the keys of all positions next to each output file,
+        // see BcgnPositionKeyFileWriter. Not supported when appending.
+        // They take 20 bytes per position, about 20 times as much as level 2 games.
+        // Otherwise the keys of an output file that is truncated are removed.
+        bool writePositionKeys = false;
+
+        std::size_t pgnParserMemory = 4ull * 1024ull * 1024ull;
+        std::size_t bcgnWriterMemory = traits::minBufferSize;
+    };
+
+    struct PgnToBcgnConversionStats
+    {
+        std::size_t numGames = 0;
+        std::vector<std::filesystem::path> outputPaths;
+    };
+
+    // Called from the writer thread with the number of games written so far.
+    using PgnToBcgnProgressCallback = std::function<void(std::size_t)>;
+
+    // Games are written in the order they appear in the PGN file,
+    // regardless of the number of threads.
+    // Moves after one that can't be decoded are dropped.
+    // Exceptions thrown by any of the threads are rethrown.
+    PgnToBcgnConversionStats convertPgnToBcgn(
+        const std::filesystem::path& pgn,
+        const std::filesystem::path& bcgn,
+        const PgnToBcgnConversionParams& params,
+        PgnToBcgnProgressCallback progressCallback = {}
+    );
+}
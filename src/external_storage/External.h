@@ -1,14 +1,20 @@
 #pragma once
 
+#include "MemoryMappedFile.h"
+
+#include "intrin/Intrinsics.h"
+
 #include "util/Assert.h"
 #include "util/Buffer.h"
 #include "util/MemoryAmount.h"
 
 #include <algorithm>
 #include <atomic>
+#include <cstdint>
 #include <cstdio>
 #include <filesystem>
 #include <future>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <queue>
@@ -2236,16 +2242,15 @@ namespace ext
         }
     }
 
-    template <typename T>
-    MergePlan make_merge_plan(
-        const std::vector<ImmutableSpan<T>>& in,
+    // Only the number of the input files affects the plan.
+    [[nodiscard]] inline MergePlan make_merge_plan(
+        std::size_t numFiles,
         std::filesystem::path temp1,
         std::filesystem::path temp2
     )
     {
         MergePlan plan{};
 
-        std::size_t numFiles = in.size();
         if (numFiles > 1)
         {
             std::size_t numPasses = 1;
@@ -2266,6 +2271,16 @@ namespace ext
         return plan;
     }
 
+    template <typename T>
+    [[nodiscard]] MergePlan make_merge_plan(
+        const std::vector<ImmutableSpan<T>>& in,
+        std::filesystem::path temp1,
+        std::filesystem::path temp2
+    )
+    {
+        return make_merge_plan(in.size(), std::move(temp1), std::move(temp2));
+    }
+
     // Each group contains consecutive spans.
     // If there's only one span in the group then its size may
     // be larger than the limit. That's the only case when this happens.
@@ -2328,6 +2343,12 @@ namespace ext
         return groups;
     }
 
+    // For inputs that are not spans yet, sizes are in elements.
+    [[nodiscard]] inline std::size_t merge_assess_work(const std::vector<std::size_t>& inSizes)
+    {
+        return detail::merge::merge_assess_work(std::begin(inSizes), std::end(inSizes));
+    }
+
     template <typename T>
     [[nodiscard]] std::size_t merge_assess_work(const std::vector<ImmutableSpan<T>>& in)
     {
@@ -2382,6 +2403,99 @@ namespace ext
             );
     }
 
+    // An array of T stored in a file, accessed through a memory mapping.
+    // Nothing is read until the elements are accessed.
+    // The file must be a raw array of T, like the ones written by writeFile.
+    template <typename T>
+    struct MappedSpan
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+
+        using value_type = T;
+        using const_iterator = const T*;
+
+        MappedSpan() = default;
+
+        explicit MappedSpan(std::filesystem::path path) :
+            m_file(std::move(path))
+        {
+            if (m_file.size() % sizeof(T) != 0)
+            {
+                throw Exception(
+                    "File " + m_file.path().string()
+                    + " of size " + std::to_string(m_file.size())
+                    + " is not an array of elements of size " + std::to_string(sizeof(T)) + "."
+                );
+            }
+        }
+
+        [[nodiscard]] const std::filesystem::path& path() const
+        {
+            return m_file.path();
+        }
+
+        [[nodiscard]] const T* data() const
+        {
+            return reinterpret_cast<const T*>(m_file.data());
+        }
+
+        [[nodiscard]] std::size_t size() const
+        {
+            return m_file.size() / sizeof(T);
+        }
+
+        [[nodiscard]] bool empty() const
+        {
+            return size() == 0;
+        }
+
+        [[nodiscard]] const T& operator[](std::size_t i) const
+        {
+            ASSERT(i < size());
+
+            return data()[i];
+        }
+
+        [[nodiscard]] const T& back() const
+        {
+            ASSERT(!empty());
+
+            return data()[size() - 1];
+        }
+
+        [[nodiscard]] const T* begin() const
+        {
+            return data();
+        }
+
+        [[nodiscard]] const T* end() const
+        {
+            return data() + size();
+        }
+
+        [[nodiscard]] const T* cbegin() const
+        {
+            return begin();
+        }
+
+        [[nodiscard]] const T* cend() const
+        {
+            return end();
+        }
+
+        // The pages are loaded on access and the OS can drop them at any time,
+        // so only a nominal amount is counted, not the size of the file.
+        [[nodiscard]] std::size_t memoryUsage() const
+        {
+            return nominalMemoryUsage;
+        }
+
+        static constexpr std::size_t nominalMemoryUsage = 64 * 1024;
+
+    private:
+        MemoryMappedFile m_file;
+    };
+
     template <typename RandomIterT, typename T = typename RandomIterT::value_type>
     struct IterValuePair
     {
@@ -2436,7 +2550,10 @@ namespace ext
         }
     };
 
-    template <typename KeyType, typename CompareT>
+    // The entries can be held in memory (the default) or in any other
+    // contiguous storage, for example MappedSpan, which allows searching
+    // an index file in place.
+    template <typename KeyType, typename CompareT, typename StorageT = std::vector<RangeIndexEntry<KeyType, CompareT>>>
     struct RangeIndex
     {
         static_assert(std::is_empty_v<CompareT>);
@@ -2444,9 +2561,11 @@ namespace ext
         using EntryType = RangeIndexEntry<KeyType, CompareT>;
         using IterValueType = IterValuePair<std::size_t, KeyType>;
 
+        static_assert(std::is_same_v<typename StorageT::value_type, EntryType>);
+
         RangeIndex() = default;
 
-        RangeIndex(std::vector<RangeIndexEntry<KeyType, CompareT>>&& entries) :
+        RangeIndex(StorageT&& entries) :
             m_entries(std::move(entries))
         {
         }
@@ -2481,6 +2600,18 @@ namespace ext
             return m_entries.size();
         }
 
+        [[nodiscard]] std::size_t memoryUsage() const
+        {
+            if constexpr (std::is_same_v<StorageT, std::vector<EntryType>>)
+            {
+                return m_entries.size() * sizeof(EntryType);
+            }
+            else
+            {
+                return m_entries.memoryUsage();
+            }
+        }
+
         // end is returned when there is no range with the given key
         [[nodiscard]] std::pair<IterValueType, IterValueType> equal_range(const KeyType& key) const
         {
@@ -2528,9 +2659,301 @@ namespace ext
         }
 
     private:
-        std::vector<RangeIndexEntry<KeyType, CompareT>> m_entries;
+        StorageT m_entries;
     };
 
+    // An alternative, read only, layout of a RangeIndex that is faster to search
+    // when the index is large (doesn't fit in the cache).
+    // Only the low values are touched during the search. They are stored
+    // in the Eytzinger (breadth first) order, so the first levels of the implicit
+    // search tree share cache lines and the nodes a few levels down
+    // are contiguous and can be prefetched. The search is branchless.
+    // The rest of the information is only accessed once the range is found:
+    //  - the sorted range index of each node, in the Eytzinger order,
+    //  - the offsets of the ranges, in the sorted order,
+    //    (ranges are contiguous so high of one range is low of the next one - 1)
+    //  - the high values of the ranges, in the sorted order.
+    // Produces the same results as RangeIndex::equal_range.
+    template <typename KeyType, typename CompareT>
+    struct EytzingerRangeIndex
+    {
+        static_assert(std::is_empty_v<CompareT>);
+
+        using IterValueType = IterValuePair<std::size_t, KeyType>;
+
+        EytzingerRangeIndex() = default;
+
+        template <typename StorageT>
+        EytzingerRangeIndex(const RangeIndex<KeyType, CompareT, StorageT>& index) :
+            m_lowValues(index.size() + 1),
+            m_ranks(index.size() + 1),
+            m_offsets(),
+            m_highValues()
+        {
+            const std::size_t size = index.size();
+
+            ASSERT(size < std::numeric_limits<std::uint32_t>::max());
+
+            m_offsets.reserve(size + 1);
+            m_highValues.reserve(size);
+            std::size_t end = 0;
+            for (auto&& entry : index)
+            {
+                ASSERT(m_offsets.empty() || end == entry.low);
+
+                m_offsets.emplace_back(entry.low);
+                m_highValues.emplace_back(entry.highValue);
+                end = entry.high + 1;
+            }
+            m_offsets.emplace_back(end);
+
+            (void)fillEytzinger(index.data(), 0, 1);
+        }
+
+        [[nodiscard]] std::size_t size() const
+        {
+            return m_highValues.size();
+        }
+
+        [[nodiscard]] std::size_t memoryUsage() const
+        {
+            return
+                m_lowValues.size() * sizeof(KeyType)
+                + m_ranks.size() * sizeof(std::uint32_t)
+                + m_offsets.size() * sizeof(std::size_t)
+                + m_highValues.size() * sizeof(KeyType);
+        }
+
+        // end is returned when there is no range with the given key
+        [[nodiscard]] std::pair<IterValueType, IterValueType> equal_range(const KeyType& key) const
+        {
+            const std::size_t size = this->size();
+            const std::size_t end = m_offsets.back();
+
+            auto cmp = CompareT{};
+
+            // Find the last range with lowValue <= key.
+            // We go right each time the key is not lower than the node's value,
+            // so the answer is the last node where we went right.
+            const KeyType* lowValues = m_lowValues.data();
+            std::size_t k = 1;
+            while (k <= size)
+            {
+                intrin::prefetch(lowValues + k * prefetchStride);
+                k = 2 * k + static_cast<std::size_t>(!cmp(key, lowValues[k]));
+            }
+            // Remove the trailing left turns and the last right turn.
+            // If there were no right turns then we end up with 0.
+            k >>= intrin::lsb(k) + 1;
+
+            if (k == 0)
+            {
+                // All values are greater.
+                return { { end, KeyType{} }, { end, KeyType{} } };
+            }
+
+            const std::size_t rank = m_ranks[k];
+            const KeyType& highValue = m_highValues[rank];
+
+            // If the key is past the found range then it lies between
+            // two ranges (or past all of them) and doesn't exist in the data.
+            if (cmp(highValue, key))
+            {
+                return { { end, lowValues[k] }, { end, highValue } };
+            }
+
+            return { { m_offsets[rank], lowValues[k] }, { m_offsets[rank + 1], highValue } };
+        }
+
+    private:
+        // The subtree of a node 2^d levels down from some node is contiguous
+        // and has 2^d elements. We prefetch the one that fits in a cache line.
+        static constexpr std::size_t cacheLineSize = 64;
+        static constexpr std::size_t prefetchStride = std::max<std::size_t>(cacheLineSize / sizeof(KeyType), 1);
+
+        // index 0 is unused - it makes navigating the tree simpler
+        std::vector<KeyType> m_lowValues;
+        std::vector<std::uint32_t> m_ranks;
+        std::vector<std::size_t> m_offsets;
+        std::vector<KeyType> m_highValues;
+
+        // In-order traversal of the implicit tree assigns consecutive sorted entries.
+        std::size_t fillEytzinger(const RangeIndexEntry<KeyType, CompareT>* entries, std::size_t i, std::size_t k)
+        {
+            if (k < m_lowValues.size())
+            {
+                i = fillEytzinger(entries, i, 2 * k);
+                m_lowValues[k] = entries[i].lowValue;
+                m_ranks[k] = static_cast<std::uint32_t>(i);
+                ++i;
+                i = fillEytzinger(entries, i, 2 * k + 1);
+            }
+
+            return i;
+        }
+    };
+
+    // An index for data sorted by uniformly distributed keys (like hashes).
+    // The entries are partitioned into 2^numBits buckets by the most significant
+    // bits of their radix keys and for each bucket the offset of its first entry is stored.
+    // Finding the range of entries that can contain a key requires one table lookup.
+    // The size of the index depends only on numBits (8 bytes per bucket),
+    // not on the number of entries, and the expected number of entries in a bucket
+    // is size / 2^numBits.
+    // The radix key must be consistent with the order of the data, ie.
+    // it has to be a non decreasing function of the key.
+    struct RadixIndex
+    {
+        static constexpr std::size_t maxNumBits = 32;
+
+        RadixIndex() = default;
+
+        // offsets.size() must be 2^numBits + 1, the last offset is the end of the data.
+        RadixIndex(std::vector<std::uint64_t>&& offsets) :
+            m_offsets(std::move(offsets)),
+            m_numBits(0)
+        {
+            ASSERT(m_offsets.size() >= 2);
+
+            const std::size_t numBuckets = m_offsets.size() - 1;
+            ASSERT((numBuckets & (numBuckets - 1)) == 0);
+
+            while ((std::size_t(1) << m_numBits) < numBuckets)
+            {
+                ++m_numBits;
+            }
+
+            ASSERT(m_numBits <= maxNumBits);
+        }
+
+        [[nodiscard]] const std::uint64_t* data() const
+        {
+            return m_offsets.data();
+        }
+
+        [[nodiscard]] std::size_t size() const
+        {
+            return m_offsets.size();
+        }
+
+        [[nodiscard]] std::size_t numBits() const
+        {
+            return m_numBits;
+        }
+
+        [[nodiscard]] std::size_t numBuckets() const
+        {
+            return m_offsets.size() - 1;
+        }
+
+        [[nodiscard]] std::size_t memoryUsage() const
+        {
+            return m_offsets.size() * sizeof(std::uint64_t);
+        }
+
+        [[nodiscard]] std::size_t bucketOf(std::uint64_t radixKey) const
+        {
+            return bucketOf(radixKey, m_numBits);
+        }
+
+        [[nodiscard]] static std::size_t bucketOf(std::uint64_t radixKey, std::size_t numBits)
+        {
+            // Shifting by 64 is undefined.
+            return numBits == 0 ? 0 : static_cast<std::size_t>(radixKey >> (64 - numBits));
+        }
+
+        // Returns [begin, end) of entries with the same bucket as radixKey.
+        [[nodiscard]] std::pair<std::size_t, std::size_t> equal_range(std::uint64_t radixKey) const
+        {
+            const std::size_t bucket = bucketOf(radixKey);
+            return {
+                static_cast<std::size_t>(m_offsets[bucket]),
+                static_cast<std::size_t>(m_offsets[bucket + 1])
+            };
+        }
+
+        // Returns an index with less buckets. Every bucket of the result
+        // is a union of 2^(this->numBits() - numBits) consecutive buckets.
+        // If numBits is not less than this->numBits() a copy is returned.
+        [[nodiscard]] RadixIndex coarsened(std::size_t numBits) const
+        {
+            if (numBits >= m_numBits)
+            {
+                return *this;
+            }
+
+            const std::size_t step = std::size_t(1) << (m_numBits - numBits);
+            const std::size_t numBuckets = std::size_t(1) << numBits;
+            std::vector<std::uint64_t> offsets;
+            offsets.reserve(numBuckets + 1);
+            for (std::size_t i = 0; i <= numBuckets; ++i)
+            {
+                offsets.emplace_back(m_offsets[i * step]);
+            }
+
+            return RadixIndex(std::move(offsets));
+        }
+
+    private:
+        std::vector<std::uint64_t> m_offsets;
+        std::size_t m_numBits;
+    };
+
+    // Builds a RadixIndex from radix keys of consecutive entries.
+    struct RadixIndexBuilder
+    {
+        RadixIndexBuilder(std::size_t numBits) :
+            m_offsets((std::size_t(1) << numBits) + 1),
+            m_numBits(numBits),
+            m_nextBucket(0),
+            m_numEntries(0)
+        {
+            ASSERT(numBits <= RadixIndex::maxNumBits);
+        }
+
+        void append(std::uint64_t radixKey)
+        {
+            const std::size_t bucket = RadixIndex::bucketOf(radixKey, m_numBits);
+
+            // The keys must be non decreasing.
+            ASSERT(bucket + 1 >= m_nextBucket);
+
+            while (m_nextBucket <= bucket)
+            {
+                m_offsets[m_nextBucket++] = m_numEntries;
+            }
+
+            ++m_numEntries;
+        }
+
+        [[nodiscard]] RadixIndex end()
+        {
+            while (m_nextBucket < m_offsets.size())
+            {
+                m_offsets[m_nextBucket++] = m_numEntries;
+            }
+
+            return RadixIndex(std::move(m_offsets));
+        }
+
+    private:
+        std::vector<std::uint64_t> m_offsets;
+        std::size_t m_numBits;
+        std::size_t m_nextBucket;
+        std::uint64_t m_numEntries;
+    };
+
+    template <typename RandomIterT, typename RadixKeyT>
+    [[nodiscard]] RadixIndex makeRadixIndex(RandomIterT begin, RandomIterT end, std::size_t numBits, RadixKeyT radixKey)
+    {
+        RadixIndexBuilder builder(numBits);
+        for (; begin != end; ++begin)
+        {
+            builder.append(radixKey(*begin));
+        }
+        return builder.end();
+    }
+
     namespace detail::equal_range
     {
         [[nodiscard]] std::pair<std::size_t, std::size_t> neighbourhood(
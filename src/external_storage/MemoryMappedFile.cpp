@@ -0,0 +1,258 @@
+#include "MemoryMappedFile.h"
+
+#include "External.h"
+
+#include "util/Assert.h"
+
+#include <filesystem>
+#include <string>
+#include <utility>
+
+#if defined(_WIN32)
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#endif
+
+namespace ext
+{
+    namespace detail::except
+    {
+        [[noreturn]] static void throwMapException(const std::filesystem::path& path, const std::string& reason)
+        {
+            throw Exception(
+                "Cannot map file " + path.string()
+                + " into memory. " + reason
+            );
+        }
+    }
+
+    MemoryMappedFile::MemoryMappedFile() noexcept :
+        m_path{},
+        m_data(nullptr),
+        m_size(0)
+    {
+    }
+
+#if defined(_WIN32)
+
+    [[nodiscard]] static std::size_t pageSize()
+    {
+        static const std::size_t size = []() {
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            return static_cast<std::size_t>(info.dwPageSize);
+        }();
+
+        return size;
+    }
+
+    MemoryMappedFile::MemoryMappedFile(std::filesystem::path path, MemoryMappedFileAccess access) :
+        m_path(std::move(path)),
+        m_data(nullptr),
+        m_size(0)
+    {
+        const DWORD accessFlag =
+            access == MemoryMappedFileAccess::Sequential
+            ? FILE_FLAG_SEQUENTIAL_SCAN
+            : FILE_FLAG_RANDOM_ACCESS;
+
+        HANDLE file = CreateFileW(
+            m_path.c_str(),
+            GENERIC_READ,
+            FILE_SHARE_READ,
+            nullptr,
+            OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | accessFlag,
+            nullptr
+        );
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            detail::except::throwMapException(m_path, "Cannot open the file.");
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size))
+        {
+            CloseHandle(file);
+            detail::except::throwMapException(m_path, "Cannot query the file size.");
+        }
+
+        // Empty files cannot be mapped.
+        if (size.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return;
+        }
+
+        // The view keeps the mapping, and the mapping keeps the file,
+        // so the handles can be closed right away.
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr)
+        {
+            detail::except::throwMapException(m_path, "Cannot create the mapping.");
+        }
+
+        const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+        if (view == nullptr)
+        {
+            detail::except::throwMapException(m_path, "Cannot map the view.");
+        }
+
+        m_data = static_cast<const std::byte*>(view);
+        m_size = static_cast<std::size_t>(size.QuadPart);
+    }
+
+    void MemoryMappedFile::unmap() noexcept
+    {
+        if (m_data != nullptr)
+        {
+            UnmapViewOfFile(m_data);
+        }
+    }
+
+    void MemoryMappedFile::releasePages(const std::byte* begin, std::size_t size) const
+    {
+        // Unlocking pages that are not locked removes them from the working set.
+        // The call reports a failure in this case, which is expected.
+        // The pages go to the standby list, where they stay cached until
+        // the memory is needed. DiscardVirtualMemory and OfferVirtualMemory
+        // can't be used, they only apply to private pages, not to file views.
+        (void)VirtualUnlock(const_cast<std::byte*>(begin), size);
+    }
+
+#else
+
+    [[nodiscard]] static std::size_t pageSize()
+    {
+        static const std::size_t size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+
+        return size;
+    }
+
+    MemoryMappedFile::MemoryMappedFile(std::filesystem::path path, MemoryMappedFileAccess access) :
+        m_path(std::move(path)),
+        m_data(nullptr),
+        m_size(0)
+    {
+        const int fd = ::open(m_path.c_str(), O_RDONLY);
+        if (fd == -1)
+        {
+            detail::except::throwMapException(m_path, "Cannot open the file.");
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) == -1)
+        {
+            ::close(fd);
+            detail::except::throwMapException(m_path, "Cannot query the file size.");
+        }
+
+        // Empty files cannot be mapped.
+        if (st.st_size == 0)
+        {
+            ::close(fd);
+            return;
+        }
+
+        // The mapping keeps the file so the descriptor can be closed right away.
+        void* view = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED)
+        {
+            detail::except::throwMapException(m_path, "Cannot map the view.");
+        }
+
+        (void)::madvise(
+            view,
+            static_cast<std::size_t>(st.st_size),
+            access == MemoryMappedFileAccess::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM
+        );
+
+        m_data = static_cast<const std::byte*>(view);
+        m_size = static_cast<std::size_t>(st.st_size);
+    }
+
+    void MemoryMappedFile::unmap() noexcept
+    {
+        if (m_data != nullptr)
+        {
+            ::munmap(const_cast<std::byte*>(m_data), m_size);
+        }
+    }
+
+    void MemoryMappedFile::releasePages(const std::byte* begin, std::size_t size) const
+    {
+        // The mapping is read only and backed by the file,
+        // so the pages are read from it again when accessed.
+        (void)::madvise(const_cast<std::byte*>(begin), size, MADV_DONTNEED);
+    }
+
+#endif
+
+    MemoryMappedFile::MemoryMappedFile(MemoryMappedFile&& other) noexcept :
+        m_path(std::move(other.m_path)),
+        m_data(std::exchange(other.m_data, nullptr)),
+        m_size(std::exchange(other.m_size, 0))
+    {
+    }
+
+    MemoryMappedFile& MemoryMappedFile::operator=(MemoryMappedFile&& other) noexcept
+    {
+        if (this != &other)
+        {
+            unmap();
+
+            m_path = std::move(other.m_path);
+            m_data = std::exchange(other.m_data, nullptr);
+            m_size = std::exchange(other.m_size, 0);
+        }
+
+        return *this;
+    }
+
+    MemoryMappedFile::~MemoryMappedFile()
+    {
+        unmap();
+    }
+
+    [[nodiscard]] const std::filesystem::path& MemoryMappedFile::path() const
+    {
+        return m_path;
+    }
+
+    [[nodiscard]] const std::byte* MemoryMappedFile::data() const
+    {
+        return m_data;
+    }
+
+    [[nodiscard]] std::size_t MemoryMappedFile::size() const
+    {
+        return m_size;
+    }
+
+    void MemoryMappedFile::release(std::size_t offset, std::size_t size) const
+    {
+        ASSERT(offset + size <= m_size);
+
+        // The mapping starts at a page boundary.
+        const std::size_t page = pageSize();
+        const std::size_t begin = (offset + page - 1) / page * page;
+        const std::size_t end = (offset + size) / page * page;
+        if (begin < end)
+        {
+            releasePages(m_data + begin, end - begin);
+        }
+    }
+}
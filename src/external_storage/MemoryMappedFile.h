@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+
+namespace ext
+{
+    enum struct MemoryMappedFileAccess
+    {
+        // Scattered reads, like searching an index. Pages are
+        // only loaded when they are touched.
+        Random,
+
+        // A single pass from the beginning to the end.
+        // Pages ahead of the reads are loaded in advance.
+        Sequential
+    };
+
+    // Read only view of a whole file mapped into the address space.
+    // Pages are loaded by the OS on first access and, being backed
+    // by the file, can be dropped from memory under pressure
+    // without being written to the page file.
+    // The file must not be modified or removed while it's mapped.
+    struct MemoryMappedFile
+    {
+        MemoryMappedFile() noexcept;
+
+        explicit MemoryMappedFile(
+            std::filesystem::path path,
+            MemoryMappedFileAccess access = MemoryMappedFileAccess::Random
+            );
+
+        MemoryMappedFile(const MemoryMappedFile&) = delete;
+        MemoryMappedFile(MemoryMappedFile&& other) noexcept;
+
+        MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+        MemoryMappedFile& operator=(MemoryMappedFile&& other) noexcept;
+
+        ~MemoryMappedFile();
+
+        [[nodiscard]] const std::filesystem::path& path() const;
+
+        // nullptr for empty files
+        [[nodiscard]] const std::byte* data() const;
+
+        [[nodiscard]] std::size_t size() const;
+
+        // Hints that [offset, offset + size) won't be needed soon.
+        // Its pages are removed from the resident set (working set on Windows)
+        // of the process, the OS may still keep them in its file cache.
+        // The data stays valid, it is read from the file again if accessed.
+        // Only whole pages inside the range are released.
+        void release(std::size_t offset, std::size_t size) const;
+
+    private:
+        std::filesystem::path m_path;
+        const std::byte* m_data;
+        std::size_t m_size;
+
+        void unmap() noexcept;
+
+        void releasePages(const std::byte* begin, std::size_t size) const;
+    };
+}
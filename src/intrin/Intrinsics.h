@@ -39,6 +39,20 @@
 
 #endif
 
+// Allows using AVX2 intrinsics in a function when the whole
+// program is not compiled for AVX2. Such functions must only be
+// called when intrin::hasAvx2() is true.
+#if defined(__clang__) || defined(__GNUC__) || defined(__GNUG__)
+
+#define TARGET_AVX2 __attribute__((target("avx2")))
+
+#else
+
+// MSVC allows the intrinsics anywhere.
+#define TARGET_AVX2
+
+#endif
+
 
 // the following enables constexpr intrinsics, but they are slower
 // it's useful for running compile time tests
@@ -172,4 +186,77 @@ namespace intrin
 
 #endif
 }
-#endif
\ No newline at end of file
+#endif
+
+namespace intrin
+{
+    // Hints the cpu to bring the cache line containing `ptr` into all cache levels.
+    // Never faults, so it's fine to prefetch past the end of an array.
+    inline void prefetch(const void* ptr)
+    {
+        _mm_prefetch(static_cast<const char*>(ptr), _MM_HINT_T0);
+    }
+
+    // Reverses the order of bytes, i.e. converts between little and big endian.
+    [[nodiscard]] inline std::uint64_t byteswap(std::uint64_t value)
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+
+        return _byteswap_uint64(value);
+
+#else
+
+        return __builtin_bswap64(value);
+
+#endif
+    }
+}
+
+namespace intrin
+{
+    namespace detail
+    {
+        [[nodiscard]] inline bool detectAvx2()
+        {
+#if defined(_MSC_VER) && !defined(__clang__)
+
+            int regs[4];
+            __cpuid(regs, 0);
+            if (regs[0] < 7)
+            {
+                return false;
+            }
+
+            // The OS must also save the ymm registers on context switches.
+            __cpuid(regs, 1);
+            constexpr int osxsaveBit = 1 << 27;
+            constexpr int avxBit = 1 << 28;
+            if ((regs[2] & (osxsaveBit | avxBit)) != (osxsaveBit | avxBit))
+            {
+                return false;
+            }
+
+            if ((_xgetbv(0) & 0b110) != 0b110)
+            {
+                return false;
+            }
+
+            __cpuidex(regs, 7, 0);
+            constexpr int avx2Bit = 1 << 5;
+            return (regs[1] & avx2Bit) != 0;
+
+#else
+
+            return __builtin_cpu_supports("avx2");
+
+#endif
+        }
+    }
+
+    // Whether functions marked with TARGET_AVX2 can be called.
+    [[nodiscard]] inline bool hasAvx2()
+    {
+        static const bool value = detail::detectAvx2();
+        return value;
+    }
+}
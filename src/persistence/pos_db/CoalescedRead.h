@@ -0,0 +1,51 @@
+#pragma once
+
+#include "external_storage/External.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace persistence
+{
+    namespace detail
+    {
+        // Calls func(i, data) for each range i of elements [begin, end).
+        // The ranges must be sorted and not empty. Ranges that are at most maxGap
+        // elements apart are read with a single read, together with the gap.
+        template <typename T, typename FuncT>
+        void readCoalesced(
+            ext::Vector<T>& vec,
+            const std::vector<std::pair<std::size_t, std::size_t>>& ranges,
+            std::size_t maxGap,
+            FuncT&& func
+        )
+        {
+            std::vector<T> buffer;
+            for (std::size_t i = 0; i < ranges.size();)
+            {
+                const std::size_t begin = ranges[i].first;
+                std::size_t end = ranges[i].second;
+                std::size_t j = i + 1;
+                while (j < ranges.size() && ranges[j].first <= end + maxGap)
+                {
+                    end = std::max(end, ranges[j].second);
+                    ++j;
+                }
+
+                buffer.resize(end - begin);
+                const std::size_t numRead = vec.read(buffer.data(), begin, end - begin);
+                if (numRead != end - begin)
+                {
+                    ext::detail::except::throwReadException(vec.path(), begin, end - begin, numRead);
+                }
+
+                for (; i < j; ++i)
+                {
+                    func(i, buffer.data() + (ranges[i].first - begin));
+                }
+            }
+        }
+    }
+}
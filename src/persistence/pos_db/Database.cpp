@@ -170,6 +170,7 @@ namespace persistence
         SingleGameLevelDatabaseStats::operator+=(rhs);
 
         numSkippedGames += rhs.numSkippedGames;
+        numCachedPositions += rhs.numCachedPositions;
 
         return *this;
     }
@@ -179,6 +180,7 @@ namespace persistence
         to_json(j, static_cast<const SingleGameLevelDatabaseStats&>(stats));
 
         j["num_skipped_games"] = stats.numSkippedGames;
+        j["num_cached_positions"] = stats.numCachedPositions;
     }
 
     void from_json(const nlohmann::json& j, SingleGameLevelImportStats& stats)
@@ -186,6 +188,8 @@ namespace persistence
         from_json(j, static_cast<SingleGameLevelDatabaseStats&>(stats));
         
         stats.numSkippedGames = j["num_skipped_games"].get<std::size_t>();
+        // Stats saved without the opening trie don't have it.
+        stats.numCachedPositions = j.value("num_cached_positions", std::size_t(0));
     }
 
     ImportStats& ImportStats::operator+=(const ImportStats& rhs)
@@ -195,9 +199,42 @@ namespace persistence
             m_statsByLevel[level] += rhs.m_statsByLevel[level];
         }
 
+        m_elapsedSeconds += rhs.m_elapsedSeconds;
+
         return *this;
     }
 
+    [[nodiscard]] double ImportStats::elapsedSeconds() const
+    {
+        return m_elapsedSeconds;
+    }
+
+    void ImportStats::setElapsedSeconds(double seconds)
+    {
+        m_elapsedSeconds = seconds;
+    }
+
+    [[nodiscard]] double ImportStats::positionsPerSecond() const
+    {
+        if (m_elapsedSeconds <= 0.0)
+        {
+            return 0.0;
+        }
+
+        return static_cast<double>(total().numPositions) / m_elapsedSeconds;
+    }
+
+    [[nodiscard]] double ImportStats::openingTrieHitRate() const
+    {
+        const auto sum = total();
+        if (sum.numPositions == 0)
+        {
+            return 0.0;
+        }
+
+        return static_cast<double>(sum.numCachedPositions) / static_cast<double>(sum.numPositions);
+    }
+
     ImportStats::ImportStats(SingleGameLevelImportStats stats, GameLevel level)
     {
         m_statsByLevel[level] = stats;
@@ -234,6 +271,10 @@ namespace persistence
         {
             j[std::string(toString(level))] = nlohmann::json(stats.m_statsByLevel[level]);
         }
+
+        j["elapsed_seconds"] = stats.m_elapsedSeconds;
+        j["positions_per_second"] = stats.positionsPerSecond();
+        j["opening_trie_hit_rate"] = stats.openingTrieHitRate();
     }
 
     void from_json(const nlohmann::json& j, ImportStats& stats)
@@ -242,6 +283,9 @@ namespace persistence
         {
             stats.m_statsByLevel[level] = j[std::string(toString(level))];
         }
+
+        // Stats saved before the import time was measured don't have it.
+        stats.m_elapsedSeconds = j.value("elapsed_seconds", 0.0);
     }
 
     [[nodiscard]] const std::string& importableFileTypeExtension(ImportableFileType type)
@@ -60,6 +60,7 @@ namespace persistence
     struct SingleGameLevelImportStats : SingleGameLevelDatabaseStats
     {
         std::size_t numSkippedGames = 0; // We skip games with an unknown result.
+        std::size_t numCachedPositions = 0; // Positions taken from the opening trie without decoding the move.
 
         SingleGameLevelImportStats& operator+=(const SingleGameLevelImportStats& rhs);
 
@@ -81,11 +82,21 @@ namespace persistence
 
         ImportStats& operator+=(const ImportStats& rhs);
 
+        // Wall time spent importing, including waiting for the storage.
+        [[nodiscard]] double elapsedSeconds() const;
+        void setElapsedSeconds(double seconds);
+
+        [[nodiscard]] double positionsPerSecond() const;
+
+        // The fraction of imported positions taken from the opening trie.
+        [[nodiscard]] double openingTrieHitRate() const;
+
         friend void to_json(nlohmann::json& j, const ImportStats& stats);
         friend void from_json(const nlohmann::json& j, ImportStats& stats);
 
     private:
         EnumArray<GameLevel, SingleGameLevelImportStats> m_statsByLevel;
+        double m_elapsedSeconds = 0.0;
     };
 
     enum struct ImportableFileType
@@ -256,6 +267,14 @@ namespace persistence
 
         [[nodiscard]] virtual query::Response executeQuery(query::Request query) = 0;
 
+        [[nodiscard]] virtual query::GamesByNameResponse queryGamesByName(const query::GamesByNameRequest& query) = 0;
+
+        [[nodiscard]] virtual query::GamesByPositionResponse queryGamesByPosition(const query::GamesByPositionRequest& query) = 0;
+
+        [[nodiscard]] virtual query::MaterialStatsResponse queryMaterialStats(const query::MaterialStatsRequest& query) = 0;
+
+        [[nodiscard]] virtual query::NoveltyResponse queryNovelty(const query::NoveltyRequest& query) = 0;
+
         virtual void mergeAll(
             const std::vector<std::filesystem::path>& temporaryDirs,
             std::optional<MemoryAmount> temporarySpace,
@@ -0,0 +1,316 @@
+#include "DictionaryGameHeaderStorage.h"
+
+#include "CoalescedRead.h"
+
+#include "algorithm/Unsort.h"
+
+#include "external_storage/External.h"
+
+#include "Configuration.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace persistence
+{
+    template <typename GameIndexT>
+    DictionaryGameHeaderStorage<GameIndexT>::DictionaryGameHeaderStorage(std::filesystem::path path, MemoryAmount memory, std::string name) :
+        // here we use operator, to create directories before we try to
+        // create files there
+        m_name(std::move(name)),
+        m_path((std::filesystem::create_directories(path), std::move(path))),
+        m_recordsPath(std::move((m_path / recordsPath) += m_name)),
+        m_stringsPath(std::move((m_path / stringsPath) += m_name)),
+        m_nameIndexPath(std::move((m_path / nameIndexPath) += m_name)),
+        m_records({ m_recordsPath, ext::OutputMode::Append }, util::DoubleBuffer<Record>(ext::numObjectsPerBufferUnit<Record>(std::max(memory.bytes(), minMemory.bytes()), 4))),
+        m_stringsFile({ m_stringsPath, ext::OutputMode::Append }, util::DoubleBuffer<char>(ext::numObjectsPerBufferUnit<char>(std::max(memory.bytes(), minMemory.bytes()), 4)))
+    {
+        loadStrings();
+
+        if (cfg::g_config["persistence"]["name_index"].get<bool>())
+        {
+            m_nameIndex.emplace(m_nameIndexPath);
+            m_nameIndex->update(*this);
+        }
+    }
+
+    template <typename GameIndexT>
+    HeaderEntryLocation DictionaryGameHeaderStorage<GameIndexT>::addGame(const pgn::UnparsedGame& game)
+    {
+        return addHeader(PackedGameHeaderType(game, static_cast<GameIndexType>(nextGameId())));
+    }
+
+    template <typename GameIndexT>
+    HeaderEntryLocation DictionaryGameHeaderStorage<GameIndexT>::addGame(const pgn::UnparsedGame& game, std::uint16_t plyCount)
+    {
+        return addHeader(PackedGameHeaderType(game, static_cast<GameIndexType>(nextGameId()), plyCount));
+    }
+
+    template <typename GameIndexT>
+    HeaderEntryLocation DictionaryGameHeaderStorage<GameIndexT>::addGame(const pgn::ParsedGameTags& tags, std::uint16_t plyCount)
+    {
+        return addHeader(PackedGameHeaderType(tags, static_cast<GameIndexType>(nextGameId()), plyCount));
+    }
+
+    template <typename GameIndexT>
+    HeaderEntryLocation DictionaryGameHeaderStorage<GameIndexT>::addGame(const bcgn::UnparsedBcgnGame& game)
+    {
+        return addHeader(PackedGameHeaderType(game, static_cast<GameIndexType>(nextGameId())));
+    }
+
+    template <typename GameIndexT>
+    HeaderEntryLocation DictionaryGameHeaderStorage<GameIndexT>::addGame(const bcgn::UnparsedBcgnGame& game, std::uint16_t plyCount)
+    {
+        return addHeader(PackedGameHeaderType(game, static_cast<GameIndexType>(nextGameId()), plyCount));
+    }
+
+    template <typename GameIndexT>
+    [[nodiscard]] std::uint64_t DictionaryGameHeaderStorage<GameIndexT>::nextGameId() const
+    {
+        return static_cast<std::uint64_t>(m_records.size());
+    }
+
+    template <typename GameIndexT>
+    [[nodiscard]] std::uint64_t DictionaryGameHeaderStorage<GameIndexT>::nextGameOffset() const
+    {
+        return static_cast<std::uint64_t>(m_records.size()) * sizeof(Record);
+    }
+
+    template <typename GameIndexT>
+    void DictionaryGameHeaderStorage<GameIndexT>::flush()
+    {
+        m_records.flush();
+        m_stringsFile.flush();
+
+        if (m_nameIndex.has_value())
+        {
+            m_nameIndex->flush();
+        }
+    }
+
+    template <typename GameIndexT>
+    void DictionaryGameHeaderStorage<GameIndexT>::clear()
+    {
+        m_records.clear();
+        m_stringsFile.clear();
+        m_ids.clear();
+        m_strings.clear();
+
+        // Also when disabled, so that a stale index is not used later.
+        if (m_nameIndex.has_value())
+        {
+            m_nameIndex->clear();
+        }
+        else
+        {
+            std::filesystem::remove(m_nameIndexPath);
+        }
+    }
+
+    template <typename GameIndexT>
+    void DictionaryGameHeaderStorage<GameIndexT>::replicateTo(const std::filesystem::path& path) const
+    {
+        std::filesystem::path newRecordsPath = path / recordsPath;
+        newRecordsPath += m_name;
+        std::filesystem::path newStringsPath = path / stringsPath;
+        newStringsPath += m_name;
+        std::filesystem::copy_file(m_recordsPath, newRecordsPath, std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::copy_file(m_stringsPath, newStringsPath, std::filesystem::copy_options::overwrite_existing);
+
+        if (std::filesystem::exists(m_nameIndexPath))
+        {
+            std::filesystem::path newNameIndexPath = path / nameIndexPath;
+            newNameIndexPath += m_name;
+            std::filesystem::copy_file(m_nameIndexPath, newNameIndexPath, std::filesystem::copy_options::overwrite_existing);
+        }
+    }
+
+    template <typename GameIndexT>
+    [[nodiscard]] std::vector<PackedGameHeader<GameIndexT>> DictionaryGameHeaderStorage<GameIndexT>::queryByOffsets(std::vector<std::uint64_t> offsets)
+    {
+        for (auto& offset : offsets)
+        {
+            ASSERT(offset % sizeof(Record) == 0);
+
+            offset /= sizeof(Record);
+        }
+
+        return queryByIndices(std::move(offsets));
+    }
+
+    template <typename GameIndexT>
+    [[nodiscard]] std::vector<PackedGameHeader<GameIndexT>> DictionaryGameHeaderStorage<GameIndexT>::queryByIndices(std::vector<std::uint64_t> keys)
+    {
+        const std::size_t numKeys = keys.size();
+
+        auto unsort = reversibleSort(keys);
+
+        std::vector<PackedGameHeaderType> headers(numKeys);
+
+        // Indices of the first key of each unique key.
+        std::vector<std::size_t> unique;
+        std::vector<std::pair<std::size_t, std::size_t>> ranges;
+        for (std::size_t i = 0; i < numKeys; ++i)
+        {
+            if (i > 0 && keys[i] == keys[i - 1])
+            {
+                continue;
+            }
+
+            ASSERT(keys[i] < m_records.size());
+
+            unique.emplace_back(i);
+            ranges.emplace_back(keys[i], keys[i] + 1);
+        }
+
+        detail::readCoalesced(m_records, ranges, maxReadGap / sizeof(Record), [&](std::size_t i, const Record* record) {
+            headers[unique[i]] = unpack(*record);
+        });
+
+        for (std::size_t i = 1; i < numKeys; ++i)
+        {
+            if (keys[i] == keys[i - 1])
+            {
+                headers[i] = headers[i - 1];
+            }
+        }
+
+        unsort(headers);
+
+        return headers;
+    }
+
+    template <typename GameIndexT>
+    [[nodiscard]] std::vector<PackedGameHeader<GameIndexT>> DictionaryGameHeaderStorage<GameIndexT>::queryByIndicesUncached(std::vector<std::uint64_t> keys)
+    {
+        return queryByIndices(std::move(keys));
+    }
+
+    template <typename GameIndexT>
+    [[nodiscard]] std::uint64_t DictionaryGameHeaderStorage<GameIndexT>::numGames() const
+    {
+        return static_cast<std::uint64_t>(m_records.size());
+    }
+
+    template <typename GameIndexT>
+    [[nodiscard]] std::size_t DictionaryGameHeaderStorage<GameIndexT>::numStrings() const
+    {
+        return m_strings.size();
+    }
+
+    template <typename GameIndexT>
+    [[nodiscard]] std::size_t DictionaryGameHeaderStorage<GameIndexT>::countGamesByName(NameIndexField field, std::string_view name) const
+    {
+        if (!m_nameIndex.has_value())
+        {
+            throw std::runtime_error("Name index is not enabled.");
+        }
+
+        return m_nameIndex->countGames(field, name);
+    }
+
+    template <typename GameIndexT>
+    [[nodiscard]] std::vector<PackedGameHeader<GameIndexT>> DictionaryGameHeaderStorage<GameIndexT>::queryByName(NameIndexField field, std::string_view name, std::size_t offset, std::size_t limit)
+    {
+        if (!m_nameIndex.has_value())
+        {
+            throw std::runtime_error("Name index is not enabled.");
+        }
+
+        return queryByIndices(m_nameIndex->findGames(field, name, offset, limit));
+    }
+
+    template <typename GameIndexT>
+    void DictionaryGameHeaderStorage<GameIndexT>::loadStrings()
+    {
+        std::vector<char> data(m_stringsFile.size());
+        const std::size_t numRead = m_stringsFile.read(data.data(), 0, data.size());
+        if (numRead != data.size())
+        {
+            ext::detail::except::throwReadException(m_stringsFile.path(), 0, data.size(), numRead);
+        }
+
+        for (std::size_t i = 0; i < data.size();)
+        {
+            const std::size_t length = static_cast<std::uint8_t>(data[i]);
+            if (i + 1 + length > data.size())
+            {
+                throw ext::Exception("Invalid header string dictionary.");
+            }
+
+            const auto id = static_cast<StringIdType>(m_strings.size());
+            const std::string& stored = m_strings.emplace_back(data.data() + i + 1, length);
+            m_ids.emplace(stored, id);
+            i += 1 + length;
+        }
+    }
+
+    template <typename GameIndexT>
+    [[nodiscard]] typename DictionaryGameHeaderStorage<GameIndexT>::StringIdType DictionaryGameHeaderStorage<GameIndexT>::intern(std::string_view str)
+    {
+        str = str.substr(0, maxStringLength);
+
+        auto it = m_ids.find(str);
+        if (it != m_ids.end())
+        {
+            return it->second;
+        }
+
+        const auto id = static_cast<StringIdType>(m_strings.size());
+        const std::string& stored = m_strings.emplace_back(str);
+        m_ids.emplace(stored, id);
+
+        m_stringsFile.emplace_back(static_cast<char>(stored.size()));
+        m_stringsFile.append(stored.data(), stored.size());
+
+        return id;
+    }
+
+    template <typename GameIndexT>
+    [[nodiscard]] PackedGameHeader<GameIndexT> DictionaryGameHeaderStorage<GameIndexT>::unpack(const Record& record) const
+    {
+        ASSERT(record.event < m_strings.size());
+        ASSERT(record.white < m_strings.size());
+        ASSERT(record.black < m_strings.size());
+
+        return PackedGameHeaderType(
+            record.gameIdx,
+            record.result,
+            record.date,
+            record.eco,
+            record.plyCount,
+            m_strings[record.event],
+            m_strings[record.white],
+            m_strings[record.black]
+        );
+    }
+
+    template <typename GameIndexT>
+    HeaderEntryLocation DictionaryGameHeaderStorage<GameIndexT>::addHeader(const PackedGameHeaderType& header)
+    {
+        Record record{};
+        record.gameIdx = header.gameIdx();
+        record.event = intern(header.event());
+        record.white = intern(header.white());
+        record.black = intern(header.black());
+        record.date = header.date();
+        record.eco = header.eco();
+        record.plyCount = header.plyCount();
+        record.result = header.result();
+
+        const std::uint64_t offset = nextGameOffset();
+        m_records.emplace_back(record);
+
+        if (m_nameIndex.has_value())
+        {
+            m_nameIndex->add(record.gameIdx, header.event(), header.white(), header.black());
+        }
+
+        return { offset, record.gameIdx };
+    }
+
+    template struct DictionaryGameHeaderStorage<std::uint32_t>;
+    template struct DictionaryGameHeaderStorage<std::uint64_t>;
+}
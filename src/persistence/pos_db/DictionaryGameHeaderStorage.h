@@ -0,0 +1,146 @@
+#pragma once
+
+#include "IndexedGameHeaderStorage.h"
+#include "NameIndex.h"
+#include "PackedGameHeader.h"
+
+#include "chess/Bcgn.h"
+#include "chess/Date.h"
+#include "chess/Eco.h"
+#include "chess/GameClassification.h"
+#include "chess/Pgn.h"
+
+#include "external_storage/External.h"
+
+#include "util/MemoryAmount.h"
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+namespace persistence
+{
+    // Stores the same data as IndexedGameHeaderStorage, but event and player
+    // names are stored only once, in a dictionary, and the headers refer to
+    // them by id. All headers have the same size so no index is needed.
+    // The whole dictionary is kept in memory.
+    template <typename GameIndexT>
+    struct DictionaryGameHeaderStorage
+    {
+        using GameIndexType = GameIndexT;
+        using PackedGameHeaderType = PackedGameHeader<GameIndexT>;
+        using StringIdType = std::uint32_t;
+
+        struct Record
+        {
+            GameIndexType gameIdx;
+            StringIdType event;
+            StringIdType white;
+            StringIdType black;
+            Date date;
+            Eco eco;
+            std::uint16_t plyCount;
+            GameResult result;
+            // Records are written as raw bytes, so there must be
+            // no implicit padding, which copies would leave uninitialized.
+            std::uint8_t reserved[3];
+        };
+
+        static_assert(std::is_trivially_copyable_v<Record>);
+        static_assert(std::has_unique_object_representations_v<Record>);
+
+        static inline const std::filesystem::path recordsPath = "header_records";
+        static inline const std::filesystem::path stringsPath = "header_strings";
+        static inline const std::filesystem::path nameIndexPath = "name_index";
+
+        static constexpr MemoryAmount defaultMemory = MemoryAmount::mebibytes(4);
+        static constexpr MemoryAmount minMemory = MemoryAmount::kibibytes(1);
+
+        // Same as for PackedGameHeader.
+        static constexpr std::size_t maxStringLength = 255;
+
+        // Requested headers that are closer than this are read with a single read.
+        static constexpr std::size_t maxReadGap = 4096;
+
+        DictionaryGameHeaderStorage(std::filesystem::path path, MemoryAmount memory = defaultMemory, std::string name = "");
+
+        DictionaryGameHeaderStorage(const DictionaryGameHeaderStorage&) = delete;
+        DictionaryGameHeaderStorage(DictionaryGameHeaderStorage&&) noexcept = default;
+
+        DictionaryGameHeaderStorage& operator=(const DictionaryGameHeaderStorage&) = delete;
+        DictionaryGameHeaderStorage& operator=(DictionaryGameHeaderStorage&&) noexcept = default;
+
+        HeaderEntryLocation addGame(const pgn::UnparsedGame& game);
+        HeaderEntryLocation addGame(const pgn::UnparsedGame& game, std::uint16_t plyCount);
+        HeaderEntryLocation addGame(const pgn::ParsedGameTags& tags, std::uint16_t plyCount);
+        HeaderEntryLocation addGame(const bcgn::UnparsedBcgnGame& game);
+        HeaderEntryLocation addGame(const bcgn::UnparsedBcgnGame& game, std::uint16_t plyCount);
+
+        [[nodiscard]] std::uint64_t nextGameId() const;
+
+        // Offsets are in bytes, the same as for IndexedGameHeaderStorage.
+        [[nodiscard]] std::uint64_t nextGameOffset() const;
+
+        void flush();
+
+        void clear();
+
+        void replicateTo(const std::filesystem::path& path) const;
+
+        [[nodiscard]] std::vector<PackedGameHeaderType> queryByOffsets(std::vector<std::uint64_t> offsets);
+
+        // Headers are read in one pass over the file, in order of indices,
+        // with nearby headers read together.
+        [[nodiscard]] std::vector<PackedGameHeaderType> queryByIndices(std::vector<std::uint64_t> keys);
+
+        // There is no cache, so it's the same as queryByIndices.
+        [[nodiscard]] std::vector<PackedGameHeaderType> queryByIndicesUncached(std::vector<std::uint64_t> keys);
+
+        [[nodiscard]] std::uint64_t numGames() const;
+
+        // Finding games by name requires the name index to be enabled in the config.
+        [[nodiscard]] std::size_t countGamesByName(NameIndexField field, std::string_view name) const;
+
+        // Returns headers in order of game indices, see NameIndex::findGames.
+        [[nodiscard]] std::vector<PackedGameHeaderType> queryByName(NameIndexField field, std::string_view name, std::size_t offset, std::size_t limit);
+
+        [[nodiscard]] std::size_t numStrings() const;
+
+    private:
+        std::string m_name;
+        std::filesystem::path m_path;
+        std::filesystem::path m_recordsPath;
+        std::filesystem::path m_stringsPath;
+        std::filesystem::path m_nameIndexPath;
+        ext::Vector<Record> m_records;
+
+        // Each string is preceded by its length stored in one byte.
+        ext::Vector<char> m_stringsFile;
+
+        // The id of a string is its position in m_strings.
+        // Elements of a deque are not moved when new ones are added,
+        // so the keys of m_ids can view them.
+        std::deque<std::string> m_strings;
+        std::unordered_map<std::string_view, StringIdType> m_ids;
+
+        // Only present when enabled.
+        std::optional<NameIndex> m_nameIndex;
+
+        void loadStrings();
+
+        [[nodiscard]] StringIdType intern(std::string_view str);
+
+        [[nodiscard]] PackedGameHeaderType unpack(const Record& record) const;
+
+        HeaderEntryLocation addHeader(const PackedGameHeaderType& header);
+    };
+
+    extern template struct DictionaryGameHeaderStorage<std::uint32_t>;
+    extern template struct DictionaryGameHeaderStorage<std::uint64_t>;
+}
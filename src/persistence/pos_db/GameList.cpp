@@ -0,0 +1,59 @@
+#include "GameList.h"
+
+#include "coding/BitStream.h"
+#include "coding/Coding.h"
+
+#include "util/Assert.h"
+#include "util/Meta.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace persistence
+{
+    void GameListCoding::encode(const std::vector<std::uint64_t>& games, std::vector<std::byte>& out)
+    {
+        ASSERT(!games.empty());
+
+        bit::BitStream<> bs;
+
+        bit::EliasDeltaCoding{}.compress(bs, static_cast<std::uint64_t>(games.size() - 1u));
+        bit::EliasDeltaCoding{}.compress(bs, games[0]);
+        for (std::size_t i = 1; i < games.size(); ++i)
+        {
+            ASSERT(games[i] > games[i - 1]);
+
+            bit::EliasDeltaCoding{}.compress(bs, games[i] - games[i - 1] - 1u);
+        }
+
+        const std::size_t offset = out.size();
+        out.resize(offset + bs.numBytes());
+        bs.getBytes(out.data() + offset);
+    }
+
+    void GameListCoding::decode(const std::byte* data, std::size_t size, std::vector<std::uint64_t>& out)
+    {
+        bit::BitStream<> bs;
+        bs.setBytes(data, size);
+        bit::BitStreamSequentialReader<bit::BitStream<>> reader(bs);
+
+        const std::size_t count = bit::EliasDeltaCoding{}.decompress(reader, util::meta::Type<std::uint64_t>{}) + 1u;
+        out.reserve(out.size() + count);
+
+        std::uint64_t game = bit::EliasDeltaCoding{}.decompress(reader, util::meta::Type<std::uint64_t>{});
+        out.emplace_back(game);
+        for (std::size_t i = 1; i < count; ++i)
+        {
+            game += bit::EliasDeltaCoding{}.decompress(reader, util::meta::Type<std::uint64_t>{}) + 1u;
+            out.emplace_back(game);
+        }
+    }
+
+    void normalizeGameList(std::vector<std::uint64_t>& games)
+    {
+        std::sort(games.begin(), games.end());
+        games.erase(std::unique(games.begin(), games.end()), games.end());
+    }
+}
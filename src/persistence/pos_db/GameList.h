@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace persistence
+{
+    // A game list is the sorted set of games (indices or offsets, depending
+    // on the format) in which a key occurred.
+    // Stored as the number of games - 1, the first game and then
+    // the differences between consecutive games - 1, all Elias delta coded,
+    // see coding/Coding.h. Games of a common position are usually
+    // close together so most differences take a few bits.
+    struct GameListCoding
+    {
+        // Appends the encoded list to `out`. The games must be sorted and unique.
+        static void encode(const std::vector<std::uint64_t>& games, std::vector<std::byte>& out);
+
+        // Appends the decoded games to `out`.
+        static void decode(const std::byte* data, std::size_t size, std::vector<std::uint64_t>& out);
+    };
+
+    // Sorts and removes duplicates.
+    void normalizeGameList(std::vector<std::uint64_t>& games);
+}
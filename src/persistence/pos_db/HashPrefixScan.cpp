@@ -0,0 +1,149 @@
+#include "HashPrefixScan.h"
+
+#include "intrin/Intrinsics.h"
+
+#include "util/Assert.h"
+
+#include <cstring>
+#include <vector>
+
+namespace persistence
+{
+    namespace detail
+    {
+        [[nodiscard]] static std::uint64_t loadPrefix(const std::byte* data)
+        {
+            std::uint64_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+
+        // `mask` has bit i set when element `first` + i matches.
+        static void appendMatches(unsigned mask, std::size_t first, std::vector<std::size_t>& out)
+        {
+            while (mask)
+            {
+                out.emplace_back(first + intrin::lsb(mask));
+                mask &= mask - 1;
+            }
+        }
+
+        void findHashPrefixesScalar(
+            const std::byte* data,
+            std::size_t stride,
+            std::size_t count,
+            std::uint64_t prefix,
+            std::vector<std::size_t>& out
+        )
+        {
+            ASSERT(stride >= sizeof(std::uint64_t));
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                if (loadPrefix(data + i * stride) == prefix)
+                {
+                    out.emplace_back(i);
+                }
+            }
+        }
+
+        // Gets the first 8 bytes of 4 consecutive elements into the lanes of one register.
+        // The elements of the most common sizes are loaded whole and shuffled, others are gathered.
+        [[nodiscard]] TARGET_AVX2 static __m256i loadPrefixes16(const std::byte* data)
+        {
+            const __m256i e01 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+            const __m256i e23 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+            // [e0, e2, e1, e3]
+            const __m256i prefixes = _mm256_unpacklo_epi64(e01, e23);
+            return _mm256_permute4x64_epi64(prefixes, 0b11'01'10'00);
+        }
+
+        [[nodiscard]] TARGET_AVX2 static __m256i loadPrefixes32(const std::byte* data)
+        {
+            const __m256i e0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+            const __m256i e1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+            const __m256i e2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 64));
+            const __m256i e3 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 96));
+            // The prefixes are in the lower halves of the lower 128 bit lanes.
+            const __m256i e01 = _mm256_unpacklo_epi64(e0, e1);
+            const __m256i e23 = _mm256_unpacklo_epi64(e2, e3);
+            return _mm256_permute2x128_si256(e01, e23, 0x20);
+        }
+
+        [[nodiscard]] TARGET_AVX2 static __m256i loadPrefixesGather(const std::byte* data, __m256i offsets)
+        {
+            return _mm256_i64gather_epi64(reinterpret_cast<const long long*>(data), offsets, 1);
+        }
+
+        [[nodiscard]] TARGET_AVX2 static unsigned matchMask(__m256i prefixes, __m256i needle)
+        {
+            const __m256i eq = _mm256_cmpeq_epi64(prefixes, needle);
+            return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(eq)));
+        }
+
+        TARGET_AVX2 void findHashPrefixesAvx2(
+            const std::byte* data,
+            std::size_t stride,
+            std::size_t count,
+            std::uint64_t prefix,
+            std::vector<std::size_t>& out
+        )
+        {
+            ASSERT(stride >= sizeof(std::uint64_t));
+
+            const __m256i needle = _mm256_set1_epi64x(static_cast<long long>(prefix));
+            const std::size_t numFullGroups = count / 4;
+
+            std::size_t i = 0;
+            if (stride == 16)
+            {
+                for (std::size_t g = 0; g < numFullGroups; ++g, i += 4)
+                {
+                    appendMatches(matchMask(loadPrefixes16(data + i * stride), needle), i, out);
+                }
+            }
+            else if (stride == 32)
+            {
+                for (std::size_t g = 0; g < numFullGroups; ++g, i += 4)
+                {
+                    appendMatches(matchMask(loadPrefixes32(data + i * stride), needle), i, out);
+                }
+            }
+            else
+            {
+                const long long s = static_cast<long long>(stride);
+                const __m256i offsets = _mm256_set_epi64x(s * 3, s * 2, s, 0);
+                for (std::size_t g = 0; g < numFullGroups; ++g, i += 4)
+                {
+                    appendMatches(matchMask(loadPrefixesGather(data + i * stride, offsets), needle), i, out);
+                }
+            }
+
+            for (; i < count; ++i)
+            {
+                if (loadPrefix(data + i * stride) == prefix)
+                {
+                    out.emplace_back(i);
+                }
+            }
+        }
+    }
+
+    void findHashPrefixes(
+        const std::byte* data,
+        std::size_t stride,
+        std::size_t count,
+        std::uint64_t prefix,
+        std::vector<std::size_t>& out
+    )
+    {
+        if (intrin::hasAvx2())
+        {
+            detail::findHashPrefixesAvx2(data, stride, count, prefix, out);
+        }
+        else
+        {
+            detail::findHashPrefixesScalar(data, stride, count, prefix, out);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace persistence
+{
+    // Entries of all formats start with at least 8 bytes of the hash,
+    // so entries of a position can be found by comparing just these 8 bytes.
+    // The scan compares 4 entries at a time when the cpu supports AVX2.
+
+    // Appends to `out` the indices of the elements whose first 8 bytes are equal
+    // to the first 8 bytes of `prefix`. There are `count` elements
+    // starting at `data`, each `stride` bytes long.
+    // `stride` must be at least 8.
+    void findHashPrefixes(
+        const std::byte* data,
+        std::size_t stride,
+        std::size_t count,
+        std::uint64_t prefix,
+        std::vector<std::size_t>& out
+    );
+
+    namespace detail
+    {
+        void findHashPrefixesScalar(
+            const std::byte* data,
+            std::size_t stride,
+            std::size_t count,
+            std::uint64_t prefix,
+            std::vector<std::size_t>& out
+        );
+
+        // Can only be called when intrin::hasAvx2().
+        void findHashPrefixesAvx2(
+            const std::byte* data,
+            std::size_t stride,
+            std::size_t count,
+            std::uint64_t prefix,
+            std::vector<std::size_t>& out
+        );
+    }
+}
@@ -0,0 +1,176 @@
+#include "IndexCache.h"
+
+#include "util/MemoryAmount.h"
+
+#include "Configuration.h"
+
+#include "json/json.hpp"
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace persistence
+{
+    void to_json(nlohmann::json& j, const IndexCacheStats& stats)
+    {
+        j["memory_budget"] = stats.memoryBudget;
+        j["resident_bytes"] = stats.residentBytes;
+        j["num_resident"] = stats.numResident;
+        j["num_registered"] = stats.numRegistered;
+        j["num_hits"] = stats.numHits;
+        j["num_loads"] = stats.numLoads;
+        j["num_reloads"] = stats.numReloads;
+        j["num_evictions"] = stats.numEvictions;
+    }
+
+    namespace detail
+    {
+        IndexCacheEntry::IndexCacheEntry(LoaderType&& loader) :
+            m_loader(std::move(loader)),
+            m_value{},
+            m_memoryUsage(0),
+            m_wasEvicted(false),
+            m_lruPosition{}
+        {
+            IndexCache::instance().registerEntry();
+        }
+
+        IndexCacheEntry::~IndexCacheEntry()
+        {
+            IndexCache::instance().unregisterEntry(*this);
+        }
+
+        [[nodiscard]] std::shared_ptr<const void> IndexCacheEntry::get()
+        {
+            return IndexCache::instance().acquire(*this);
+        }
+    }
+
+    [[nodiscard]] IndexCache& IndexCache::instance()
+    {
+        static IndexCache s_instance;
+        return s_instance;
+    }
+
+    IndexCache::IndexCache() :
+        m_memoryBudget(cfg::g_config["persistence"]["index_cache_memory"].get<MemoryAmount>().bytes()),
+        m_lru{},
+        m_stats{}
+    {
+    }
+
+    [[nodiscard]] IndexCacheStats IndexCache::stats() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        IndexCacheStats stats = m_stats;
+        stats.memoryBudget = m_memoryBudget;
+        stats.numResident = m_lru.size();
+        return stats;
+    }
+
+    [[nodiscard]] MemoryAmount IndexCache::memoryBudget() const
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        return MemoryAmount::bytes(m_memoryBudget);
+    }
+
+    void IndexCache::setMemoryBudget(MemoryAmount budget)
+    {
+        std::vector<std::shared_ptr<const void>> released;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_memoryBudget = budget.bytes();
+        evictNoLock(released);
+    }
+
+    void IndexCache::registerEntry()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_stats.numRegistered += 1;
+    }
+
+    void IndexCache::unregisterEntry(detail::IndexCacheEntry& entry)
+    {
+        std::shared_ptr<const void> released;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        m_stats.numRegistered -= 1;
+
+        if (entry.m_value != nullptr)
+        {
+            m_lru.erase(entry.m_lruPosition);
+            m_stats.residentBytes -= entry.m_memoryUsage;
+            released = std::move(entry.m_value);
+        }
+    }
+
+    [[nodiscard]] std::shared_ptr<const void> IndexCache::acquire(detail::IndexCacheEntry& entry)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            if (entry.m_value != nullptr)
+            {
+                m_lru.splice(m_lru.begin(), m_lru, entry.m_lruPosition);
+                m_stats.numHits += 1;
+                return entry.m_value;
+            }
+        }
+
+        // Loading can take a while, we don't want to block other files.
+        // It's not worth preventing concurrent loads of the same index.
+        auto [value, memoryUsage] = entry.m_loader();
+
+        std::vector<std::shared_ptr<const void>> released;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if (entry.m_value != nullptr)
+        {
+            // Someone else was faster, ours is discarded.
+            m_lru.splice(m_lru.begin(), m_lru, entry.m_lruPosition);
+            m_stats.numHits += 1;
+            released.emplace_back(std::move(value));
+            return entry.m_value;
+        }
+
+        m_stats.numLoads += 1;
+        if (entry.m_wasEvicted)
+        {
+            m_stats.numReloads += 1;
+        }
+
+        entry.m_value = std::move(value);
+        entry.m_memoryUsage = memoryUsage;
+        entry.m_lruPosition = m_lru.insert(m_lru.begin(), &entry);
+        m_stats.residentBytes += memoryUsage;
+
+        evictNoLock(released);
+
+        return entry.m_value;
+    }
+
+    void IndexCache::evictNoLock(std::vector<std::shared_ptr<const void>>& released)
+    {
+        // The front is the most recently used one and is kept regardless.
+        while (m_stats.residentBytes > m_memoryBudget && m_lru.size() > 1)
+        {
+            detail::IndexCacheEntry& victim = *m_lru.back();
+            m_lru.pop_back();
+
+            m_stats.residentBytes -= victim.m_memoryUsage;
+            m_stats.numEvictions += 1;
+
+            victim.m_memoryUsage = 0;
+            victim.m_wasEvicted = true;
+            released.emplace_back(std::move(victim.m_value));
+        }
+    }
+}
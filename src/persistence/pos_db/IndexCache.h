@@ -0,0 +1,152 @@
+#pragma once
+
+#include "util/MemoryAmount.h"
+
+#include "json/json.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace persistence
+{
+    struct IndexCacheStats
+    {
+        std::size_t memoryBudget = 0;
+        std::size_t residentBytes = 0;
+        std::size_t numResident = 0;
+        std::size_t numRegistered = 0;
+        std::size_t numHits = 0;
+        std::size_t numLoads = 0;
+        // Loads of indexes that were evicted before.
+        std::size_t numReloads = 0;
+        std::size_t numEvictions = 0;
+
+        friend void to_json(nlohmann::json& j, const IndexCacheStats& stats);
+    };
+
+    struct IndexCache;
+
+    namespace detail
+    {
+        struct IndexCacheEntry
+        {
+            using LoadResultType = std::pair<std::shared_ptr<const void>, std::size_t>;
+            using LoaderType = std::function<LoadResultType()>;
+
+            IndexCacheEntry(LoaderType&& loader);
+
+            IndexCacheEntry(const IndexCacheEntry&) = delete;
+            IndexCacheEntry(IndexCacheEntry&&) = delete;
+
+            IndexCacheEntry& operator=(const IndexCacheEntry&) = delete;
+            IndexCacheEntry& operator=(IndexCacheEntry&&) = delete;
+
+            ~IndexCacheEntry();
+
+            [[nodiscard]] std::shared_ptr<const void> get();
+
+        private:
+            friend struct persistence::IndexCache;
+
+            LoaderType m_loader;
+
+            // All below is guarded by the cache's mutex.
+            std::shared_ptr<const void> m_value;
+            std::size_t m_memoryUsage;
+            bool m_wasEvicted;
+            std::list<IndexCacheEntry*>::iterator m_lruPosition;
+        };
+
+        template <typename T>
+        [[nodiscard]] std::size_t indexMemoryUsage(const T& index)
+        {
+            return index.memoryUsage();
+        }
+
+        template <typename T>
+        [[nodiscard]] std::size_t indexMemoryUsage(const std::optional<T>& index)
+        {
+            return index.has_value() ? indexMemoryUsage(*index) : 0;
+        }
+    }
+
+    // Indexes of files of all open databases share one memory budget,
+    // persistence.index_cache_memory in the config.
+    // When it's exceeded the least recently used indexes are released
+    // and loaded again on the next access.
+    // The most recently loaded index is never released, even
+    // if it alone exceeds the budget.
+    // Indexes searched in place through memory mappings only count
+    // with a nominal size, see ext::MappedSpan::memoryUsage.
+    struct IndexCache
+    {
+        [[nodiscard]] static IndexCache& instance();
+
+        [[nodiscard]] IndexCacheStats stats() const;
+
+        [[nodiscard]] MemoryAmount memoryBudget() const;
+
+        // Evicts indexes if they don't fit in the new budget.
+        void setMemoryBudget(MemoryAmount budget);
+
+    private:
+        friend struct detail::IndexCacheEntry;
+
+        mutable std::mutex m_mutex;
+        std::size_t m_memoryBudget;
+
+        // Resident entries, the most recently used at the front.
+        std::list<detail::IndexCacheEntry*> m_lru;
+
+        IndexCacheStats m_stats;
+
+        IndexCache();
+
+        void registerEntry();
+
+        void unregisterEntry(detail::IndexCacheEntry& entry);
+
+        [[nodiscard]] std::shared_ptr<const void> acquire(detail::IndexCacheEntry& entry);
+
+        // Moves the released values to `released` so they can be destroyed without holding the lock.
+        void evictNoLock(std::vector<std::shared_ptr<const void>>& released);
+    };
+
+    // An index that is loaded on first use and can be
+    // released at any time when not in use by the IndexCache.
+    // The returned pointer keeps the index alive.
+    template <typename T>
+    struct CachedIndex
+    {
+        CachedIndex(std::function<T()>&& loader) :
+            m_entry(std::make_unique<detail::IndexCacheEntry>(
+                [loader = std::move(loader)]() -> detail::IndexCacheEntry::LoadResultType {
+                    auto index = std::make_shared<const T>(loader());
+                    const std::size_t memoryUsage = detail::indexMemoryUsage(*index);
+                    return { std::move(index), memoryUsage };
+                }
+            ))
+        {
+        }
+
+        CachedIndex(const CachedIndex&) = delete;
+        CachedIndex(CachedIndex&&) noexcept = default;
+
+        CachedIndex& operator=(const CachedIndex&) = delete;
+        CachedIndex& operator=(CachedIndex&&) noexcept = default;
+
+        [[nodiscard]] std::shared_ptr<const T> get() const
+        {
+            return std::static_pointer_cast<const T>(m_entry->get());
+        }
+
+    private:
+        std::unique_ptr<detail::IndexCacheEntry> m_entry;
+    };
+}
@@ -1,7 +1,18 @@
 #include "IndexedGameHeaderStorage.h"
 
+#include "CoalescedRead.h"
+
 #include "algorithm/Unsort.h"
 
+#include "external_storage/External.h"
+
+#include "Configuration.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
 namespace persistence
 {
     template <typename PackedGameHeaderT>
@@ -12,9 +23,16 @@ namespace persistence
         m_path((std::filesystem::create_directories(path), std::move(path))),
         m_headerPath(std::move((m_path / headerPath) += m_name)),
         m_indexPath(std::move((m_path / indexPath) += m_name)),
+        m_nameIndexPath(std::move((m_path / nameIndexPath) += m_name)),
         m_header({ m_headerPath, ext::OutputMode::Append }, util::DoubleBuffer<char>(ext::numObjectsPerBufferUnit<char>(std::max(memory.bytes(), minMemory.bytes()), 4))),
-        m_index({ m_indexPath, ext::OutputMode::Append }, util::DoubleBuffer<std::size_t>(ext::numObjectsPerBufferUnit<std::size_t>(std::max(memory.bytes(), minMemory.bytes()), 4)))
+        m_index({ m_indexPath, ext::OutputMode::Append }, util::DoubleBuffer<std::size_t>(ext::numObjectsPerBufferUnit<std::size_t>(std::max(memory.bytes(), minMemory.bytes()), 4))),
+        m_cache(cfg::g_config["persistence"]["header_cache_size"].get<std::size_t>())
     {
+        if (cfg::g_config["persistence"]["name_index"].get<bool>())
+        {
+            m_nameIndex.emplace(m_nameIndexPath);
+            m_nameIndex->update(*this);
+        }
     }
 
     template <typename PackedGameHeaderT>
@@ -29,6 +47,12 @@ namespace persistence
         return addHeader(game, plyCount);
     }
 
+    template <typename PackedGameHeaderT>
+    HeaderEntryLocation IndexedGameHeaderStorage<PackedGameHeaderT>::addGame(const pgn::ParsedGameTags& tags, std::uint16_t plyCount)
+    {
+        return addHeader(tags, plyCount);
+    }
+
     template <typename PackedGameHeaderT>
     HeaderEntryLocation IndexedGameHeaderStorage<PackedGameHeaderT>::addGame(const bcgn::UnparsedBcgnGame& game)
     {
@@ -58,6 +82,11 @@ namespace persistence
     {
         m_header.flush();
         m_index.flush();
+
+        if (m_nameIndex.has_value())
+        {
+            m_nameIndex->flush();
+        }
     }
 
     template <typename PackedGameHeaderT>
@@ -65,6 +94,17 @@ namespace persistence
     {
         m_header.clear();
         m_index.clear();
+        m_cache.clear();
+
+        // Also when disabled, so that a stale index is not used later.
+        if (m_nameIndex.has_value())
+        {
+            m_nameIndex->clear();
+        }
+        else
+        {
+            std::filesystem::remove(m_nameIndexPath);
+        }
     }
 
     template <typename PackedGameHeaderT>
@@ -76,44 +116,148 @@ namespace persistence
         newIndexPath += m_name;
         std::filesystem::copy_file(m_headerPath, newHeaderPath, std::filesystem::copy_options::overwrite_existing);
         std::filesystem::copy_file(m_indexPath, newIndexPath, std::filesystem::copy_options::overwrite_existing);
+
+        if (std::filesystem::exists(m_nameIndexPath))
+        {
+            std::filesystem::path newNameIndexPath = path / nameIndexPath;
+            newNameIndexPath += m_name;
+            std::filesystem::copy_file(m_nameIndexPath, newNameIndexPath, std::filesystem::copy_options::overwrite_existing);
+        }
     }
 
     template <typename PackedGameHeaderT>
     [[nodiscard]] std::vector<PackedGameHeaderT> IndexedGameHeaderStorage<PackedGameHeaderT>::queryByOffsets(std::vector<std::uint64_t> offsets)
     {
-        const std::size_t numKeys = offsets.size();
-
-        auto unsort = reversibleSort(offsets);
+        // The sizes are not known so we read as much as a header can take.
+        const std::uint64_t fileSize = m_header.size();
 
-        std::vector<PackedGameHeaderT> headers;
-        headers.reserve(numKeys);
-        for (std::size_t i = 0; i < numKeys; ++i)
+        std::vector<HeaderSpan> spans;
+        spans.reserve(offsets.size());
+        for (auto& offset : offsets)
         {
-            headers.emplace_back(m_header, offsets[i]);
-        }
+            ASSERT(offset < fileSize);
 
-        unsort(headers);
+            spans.push_back(HeaderSpan{ offset, std::min<std::uint64_t>(sizeof(PackedGameHeaderT), fileSize - offset) });
+        }
 
-        return headers;
+        return queryBySpans(std::move(spans));
     }
 
     template <typename PackedGameHeaderT>
     [[nodiscard]] std::vector<PackedGameHeaderT> IndexedGameHeaderStorage<PackedGameHeaderT>::queryByIndices(std::vector<std::uint64_t> keys)
+    {
+        return queryBySpans(spansOfIndices(std::move(keys)));
+    }
+
+    template <typename PackedGameHeaderT>
+    [[nodiscard]] std::vector<PackedGameHeaderT> IndexedGameHeaderStorage<PackedGameHeaderT>::queryByIndicesUncached(std::vector<std::uint64_t> keys)
+    {
+        return queryBySpans(spansOfIndices(std::move(keys)), false);
+    }
+
+    template <typename PackedGameHeaderT>
+    [[nodiscard]] std::size_t IndexedGameHeaderStorage<PackedGameHeaderT>::numCachedHeaders() const
+    {
+        return m_cache.size();
+    }
+
+    template <typename PackedGameHeaderT>
+    [[nodiscard]] std::vector<typename IndexedGameHeaderStorage<PackedGameHeaderT>::HeaderSpan> IndexedGameHeaderStorage<PackedGameHeaderT>::spansOfIndices(std::vector<std::uint64_t> keys)
     {
         const std::size_t numKeys = keys.size();
 
         auto unsort = reversibleSort(keys);
 
-        std::vector<std::size_t> offsets;
-        offsets.reserve(numKeys);
-        for (auto& key : keys)
+        // The offset of the next header is where the header ends.
+        std::vector<std::pair<std::size_t, std::size_t>> ranges;
+        for (std::size_t i = 0; i < numKeys; ++i)
+        {
+            if (i > 0 && keys[i] == keys[i - 1])
+            {
+                continue;
+            }
+
+            ASSERT(keys[i] < m_index.size());
+
+            ranges.emplace_back(keys[i], std::min<std::size_t>(keys[i] + 2, m_index.size()));
+        }
+
+        std::vector<HeaderSpan> uniqueSpans(ranges.size());
+        detail::readCoalesced(m_index, ranges, maxReadGap / sizeof(std::size_t), [&](std::size_t i, const std::size_t* offsets) {
+            const std::uint64_t end = ranges[i].second - ranges[i].first == 2 ? offsets[1] : m_header.size();
+            uniqueSpans[i] = HeaderSpan{ offsets[0], end - offsets[0] };
+        });
+
+        std::vector<HeaderSpan> spans;
+        spans.reserve(numKeys);
+        for (std::size_t i = 0, j = 0; i < numKeys; ++i)
+        {
+            if (i > 0 && keys[i] != keys[i - 1])
+            {
+                ++j;
+            }
+
+            spans.emplace_back(uniqueSpans[j]);
+        }
+
+        unsort(spans);
+
+        return spans;
+    }
+
+    template <typename PackedGameHeaderT>
+    [[nodiscard]] std::vector<PackedGameHeaderT> IndexedGameHeaderStorage<PackedGameHeaderT>::queryBySpans(std::vector<HeaderSpan> spans, bool useCache)
+    {
+        const std::size_t numKeys = spans.size();
+
+        auto unsort = reversibleSort(spans, [](const HeaderSpan& lhs, const HeaderSpan& rhs) {
+            return lhs.offset < rhs.offset;
+        });
+
+        std::vector<PackedGameHeaderT> headers(numKeys);
+
+        // Indices of the first span of each offset that is not cached.
+        std::vector<std::size_t> missing;
+        std::vector<std::pair<std::size_t, std::size_t>> ranges;
+        for (std::size_t i = 0; i < numKeys; ++i)
         {
-            offsets.emplace_back(m_index[key]);
+            if (i > 0 && spans[i].offset == spans[i - 1].offset)
+            {
+                continue;
+            }
+
+            const auto* cached = useCache ? m_cache.get(spans[i].offset) : nullptr;
+            if (cached != nullptr)
+            {
+                headers[i] = *cached;
+            }
+            else
+            {
+                missing.emplace_back(i);
+                ranges.emplace_back(spans[i].offset, spans[i].offset + spans[i].size);
+            }
         }
 
-        unsort(offsets);
+        detail::readCoalesced(m_header, ranges, maxReadGap, [&](std::size_t i, const char* data) {
+            const std::size_t idx = missing[i];
+            headers[idx] = PackedGameHeaderT(data, spans[idx].size);
+            if (useCache)
+            {
+                m_cache.insert(spans[idx].offset, headers[idx]);
+            }
+        });
 
-        return queryByOffsets(offsets);
+        for (std::size_t i = 1; i < numKeys; ++i)
+        {
+            if (spans[i].offset == spans[i - 1].offset)
+            {
+                headers[i] = headers[i - 1];
+            }
+        }
+
+        unsort(headers);
+
+        return headers;
     }
 
     template <typename PackedGameHeaderT>
@@ -122,6 +266,28 @@ namespace persistence
         return static_cast<std::uint32_t>(m_index.size());
     }
 
+    template <typename PackedGameHeaderT>
+    [[nodiscard]] std::size_t IndexedGameHeaderStorage<PackedGameHeaderT>::countGamesByName(NameIndexField field, std::string_view name) const
+    {
+        if (!m_nameIndex.has_value())
+        {
+            throw std::runtime_error("Name index is not enabled.");
+        }
+
+        return m_nameIndex->countGames(field, name);
+    }
+
+    template <typename PackedGameHeaderT>
+    [[nodiscard]] std::vector<PackedGameHeaderT> IndexedGameHeaderStorage<PackedGameHeaderT>::queryByName(NameIndexField field, std::string_view name, std::size_t offset, std::size_t limit)
+    {
+        if (!m_nameIndex.has_value())
+        {
+            throw std::runtime_error("Name index is not enabled.");
+        }
+
+        return queryByIndices(m_nameIndex->findGames(field, name, offset, limit));
+    }
+
     template <typename PackedGameHeaderT>
     HeaderEntryLocation IndexedGameHeaderStorage<PackedGameHeaderT>::addHeader(const pgn::UnparsedGame& game)
     {
@@ -134,6 +300,12 @@ namespace persistence
         return addHeader(PackedGameHeaderT(game, static_cast<GameIndexType>(nextId()), plyCount));
     }
 
+    template <typename PackedGameHeaderT>
+    HeaderEntryLocation IndexedGameHeaderStorage<PackedGameHeaderT>::addHeader(const pgn::ParsedGameTags& tags, std::uint16_t plyCount)
+    {
+        return addHeader(PackedGameHeaderT(tags, static_cast<GameIndexType>(nextId()), plyCount));
+    }
+
     template <typename PackedGameHeaderT>
     HeaderEntryLocation IndexedGameHeaderStorage<PackedGameHeaderT>::addHeader(const bcgn::UnparsedBcgnGame& game)
     {
@@ -153,6 +325,12 @@ namespace persistence
         const std::uint64_t headerSizeBytes = m_header.size();
         m_header.append(entry.data(), entry.size());
         m_index.emplace_back(headerSizeBytes);
+
+        if (m_nameIndex.has_value())
+        {
+            m_nameIndex->add(gameIdx, entry.event(), entry.white(), entry.black());
+        }
+
         return { headerSizeBytes, gameIdx };
     }
 
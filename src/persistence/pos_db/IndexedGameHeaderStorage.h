@@ -1,5 +1,6 @@
 #pragma once
 
+#include "NameIndex.h"
 #include "PackedGameHeader.h"
 
 #include "chess/Bcgn.h"
@@ -7,11 +8,15 @@
 
 #include "external_storage/External.h"
 
+#include "util/LruCache.h"
 #include "util/MemoryAmount.h"
 
 #include <cstdint>
 #include <filesystem>
+#include <optional>
+#include <string_view>
 #include <type_traits>
+#include <vector>
 
 namespace persistence
 {
@@ -29,10 +34,14 @@ namespace persistence
 
         static inline const std::filesystem::path headerPath = "header";
         static inline const std::filesystem::path indexPath = "index";
+        static inline const std::filesystem::path nameIndexPath = "name_index";
 
         static constexpr MemoryAmount defaultMemory = MemoryAmount::mebibytes(4);
         static constexpr MemoryAmount minMemory = MemoryAmount::kibibytes(1);
 
+        // Requested headers that are closer than this are read with a single read.
+        static constexpr std::size_t maxReadGap = 4096;
+
         IndexedGameHeaderStorage(std::filesystem::path path, MemoryAmount memory = defaultMemory, std::string name = "");
 
         IndexedGameHeaderStorage(const IndexedGameHeaderStorage&) = delete;
@@ -43,6 +52,7 @@ namespace persistence
 
         HeaderEntryLocation addGame(const pgn::UnparsedGame& game);
         HeaderEntryLocation addGame(const pgn::UnparsedGame& game, std::uint16_t plyCount);
+        HeaderEntryLocation addGame(const pgn::ParsedGameTags& tags, std::uint16_t plyCount);
         HeaderEntryLocation addGame(const bcgn::UnparsedBcgnGame& game);
         HeaderEntryLocation addGame(const bcgn::UnparsedBcgnGame& game, std::uint16_t plyCount);
 
@@ -56,22 +66,58 @@ namespace persistence
 
         void replicateTo(const std::filesystem::path& path) const;
 
+        // Headers are served from the cache when possible. The rest is read
+        // in one pass over the file, in order of offsets, with nearby headers
+        // read together.
         [[nodiscard]] std::vector<PackedGameHeaderType> queryByOffsets(std::vector<std::uint64_t> offsets);
 
+        // Like queryByOffsets, but the offsets are first read from the index in the same way.
         [[nodiscard]] std::vector<PackedGameHeaderType> queryByIndices(std::vector<std::uint64_t> keys);
 
+        // Like queryByIndices, but the cache is neither used nor updated.
+        // For bulk reads, which would evict the headers used by queries.
+        [[nodiscard]] std::vector<PackedGameHeaderType> queryByIndicesUncached(std::vector<std::uint64_t> keys);
+
+        [[nodiscard]] std::size_t numCachedHeaders() const;
+
         [[nodiscard]] std::uint64_t numGames() const;
 
+        // Finding games by name requires the name index to be enabled in the config.
+        [[nodiscard]] std::size_t countGamesByName(NameIndexField field, std::string_view name) const;
+
+        // Returns headers in order of game indices, see NameIndex::findGames.
+        [[nodiscard]] std::vector<PackedGameHeaderType> queryByName(NameIndexField field, std::string_view name, std::size_t offset, std::size_t limit);
+
     private:
         std::string m_name;
         std::filesystem::path m_path;
         std::filesystem::path m_headerPath;
         std::filesystem::path m_indexPath;
+        std::filesystem::path m_nameIndexPath;
         ext::Vector<char> m_header;
         ext::Vector<std::size_t> m_index;
 
+        // Decoded headers by offset.
+        util::LruCache<std::uint64_t, PackedGameHeaderType> m_cache;
+
+        // Only present when enabled.
+        std::optional<NameIndex> m_nameIndex;
+
+        // Headers are stored back to back, so when the offset of the next
+        // header is known the exact size of a header is known too.
+        struct HeaderSpan
+        {
+            std::uint64_t offset;
+            std::uint64_t size;
+        };
+
+        [[nodiscard]] std::vector<HeaderSpan> spansOfIndices(std::vector<std::uint64_t> keys);
+
+        [[nodiscard]] std::vector<PackedGameHeaderType> queryBySpans(std::vector<HeaderSpan> spans, bool useCache = true);
+
         HeaderEntryLocation addHeader(const pgn::UnparsedGame& game, std::uint16_t plyCount);
         HeaderEntryLocation addHeader(const pgn::UnparsedGame& game);
+        HeaderEntryLocation addHeader(const pgn::ParsedGameTags& tags, std::uint16_t plyCount);
         HeaderEntryLocation addHeader(const bcgn::UnparsedBcgnGame& game);
         HeaderEntryLocation addHeader(const bcgn::UnparsedBcgnGame& game, std::uint16_t plyCount);
 
@@ -0,0 +1,308 @@
+#include "MaterialIndex.h"
+
+#include "chess/Chess.h"
+#include "chess/GameClassification.h"
+#include "chess/Position.h"
+
+#include "enum/Enum.h"
+#include "enum/EnumArray.h"
+
+#include "external_storage/External.h"
+
+#include "util/Assert.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace persistence
+{
+    namespace
+    {
+        // From the most valuable, the order used in signature strings.
+        constexpr PieceType pieceTypesByValue[] = {
+            PieceType::Queen,
+            PieceType::Rook,
+            PieceType::Bishop,
+            PieceType::Knight,
+            PieceType::Pawn
+        };
+
+        constexpr char pieceTypeSymbols[] = { 'P', 'N', 'B', 'R', 'Q' };
+
+        [[nodiscard]] std::optional<PieceType> pieceTypeFromSymbol(char c)
+        {
+            for (PieceType type : pieceTypesByValue)
+            {
+                if (pieceTypeSymbols[ordinal(type)] == c)
+                {
+                    return type;
+                }
+            }
+
+            return {};
+        }
+
+        [[nodiscard]] bool parseSide(std::string_view str, Color color, MaterialSignature& signature)
+        {
+            std::size_t numKings = 0;
+            for (char c : str)
+            {
+                if (c == 'K')
+                {
+                    numKings += 1;
+                    continue;
+                }
+
+                const auto typeOpt = pieceTypeFromSymbol(c);
+                if (!typeOpt.has_value())
+                {
+                    return false;
+                }
+
+                const Piece piece(*typeOpt, color);
+                const std::uint8_t count = signature.count(piece);
+                if (count == MaterialSignature::maxCount)
+                {
+                    return false;
+                }
+
+                signature.setCount(piece, count + 1);
+            }
+
+            return numKings == 1;
+        }
+
+        // The signature followed by the stats in order of levels and results.
+        constexpr std::size_t recordSize = 1 + cardinality<GameLevel>() * cardinality<GameResult>() * 2;
+    }
+
+    [[nodiscard]] MaterialSignature MaterialSignature::fromBoard(const Board& board)
+    {
+        MaterialSignature signature;
+        for (Color color : { Color::White, Color::Black })
+        {
+            for (PieceType type : pieceTypesByValue)
+            {
+                const Piece piece(type, color);
+                signature.setCount(piece, std::min(board.pieceCount(piece), maxCount));
+            }
+        }
+
+        return signature;
+    }
+
+    [[nodiscard]] MaterialSignature MaterialSignature::fromBits(std::uint64_t bits)
+    {
+        MaterialSignature signature;
+        signature.m_bits = bits & ((std::uint64_t(1) << (2 * numPieceTypes * bitsPerCount)) - 1u);
+        return signature;
+    }
+
+    [[nodiscard]] std::optional<MaterialSignature> MaterialSignature::fromString(std::string_view str)
+    {
+        const auto separator = str.find('v');
+        if (separator == std::string_view::npos)
+        {
+            return {};
+        }
+
+        MaterialSignature signature;
+        if (!parseSide(str.substr(0, separator), Color::White, signature)
+            || !parseSide(str.substr(separator + 1), Color::Black, signature))
+        {
+            return {};
+        }
+
+        return signature;
+    }
+
+    [[nodiscard]] std::string MaterialSignature::toString() const
+    {
+        std::string str;
+        for (Color color : { Color::White, Color::Black })
+        {
+            if (color == Color::Black)
+            {
+                str += 'v';
+            }
+
+            str += 'K';
+            for (PieceType type : pieceTypesByValue)
+            {
+                str.append(count(Piece(type, color)), pieceTypeSymbols[ordinal(type)]);
+            }
+        }
+
+        return str;
+    }
+
+    [[nodiscard]] std::uint8_t MaterialSignature::count(Piece piece) const
+    {
+        return static_cast<std::uint8_t>((m_bits >> shift(piece)) & maxCount);
+    }
+
+    void MaterialSignature::setCount(Piece piece, std::uint8_t count)
+    {
+        ASSERT(count <= maxCount);
+
+        const std::size_t s = shift(piece);
+        m_bits &= ~(static_cast<std::uint64_t>(maxCount) << s);
+        m_bits |= static_cast<std::uint64_t>(count) << s;
+    }
+
+    [[nodiscard]] std::size_t MaterialSignature::shift(Piece piece)
+    {
+        ASSERT(piece.type() != PieceType::King && piece.type() != PieceType::None);
+
+        return (ordinal(piece.color()) * numPieceTypes + ordinal(piece.type())) * bitsPerCount;
+    }
+
+    MaterialIndex::MaterialIndex(std::filesystem::path path) :
+        m_path(std::move(path)),
+        m_isDirty(false),
+        m_level{},
+        m_result{},
+        m_runSignature{},
+        m_runLength(0)
+    {
+        if (std::filesystem::exists(m_path))
+        {
+            load();
+        }
+    }
+
+    void MaterialIndex::beginGame(GameLevel level, GameResult result)
+    {
+        ASSERT(m_runLength == 0);
+
+        m_level = level;
+        m_result = result;
+    }
+
+    void MaterialIndex::addPosition(const Board& board)
+    {
+        const MaterialSignature signature = MaterialSignature::fromBoard(board);
+        if (m_runLength != 0 && signature != m_runSignature)
+        {
+            endRun();
+        }
+
+        m_runSignature = signature;
+        m_runLength += 1;
+    }
+
+    void MaterialIndex::endGame()
+    {
+        if (m_runLength != 0)
+        {
+            endRun();
+        }
+    }
+
+    [[nodiscard]] std::size_t MaterialIndex::numSignatures() const
+    {
+        return m_stats.size();
+    }
+
+    [[nodiscard]] MaterialStatsByLevelAndResult MaterialIndex::stats(MaterialSignature signature) const
+    {
+        auto it = m_stats.find(signature);
+        return it == m_stats.end() ? MaterialStatsByLevelAndResult{} : it->second;
+    }
+
+    void MaterialIndex::flush()
+    {
+        if (!m_isDirty)
+        {
+            return;
+        }
+
+        // Sorted so that the same index always produces the same file.
+        std::vector<MaterialSignature> signatures;
+        signatures.reserve(m_stats.size());
+        for (auto&& [signature, stats] : m_stats)
+        {
+            signatures.emplace_back(signature);
+        }
+        std::sort(signatures.begin(), signatures.end());
+
+        std::vector<std::uint64_t> data;
+        data.reserve(signatures.size() * recordSize);
+        for (auto&& signature : signatures)
+        {
+            const auto& stats = m_stats.at(signature);
+
+            data.emplace_back(signature.bits());
+            for (GameLevel level : values<GameLevel>())
+            {
+                for (GameResult result : values<GameResult>())
+                {
+                    data.emplace_back(stats[level][result].numPositions);
+                    data.emplace_back(stats[level][result].numGames);
+                }
+            }
+        }
+
+        // Write the whole file anew and replace the old one
+        // so that it's never left half written.
+        std::filesystem::path tmpPath = m_path;
+        tmpPath += "_tmp";
+        (void)ext::writeFile(tmpPath, data.data(), data.size());
+        std::filesystem::rename(tmpPath, m_path);
+
+        m_isDirty = false;
+    }
+
+    void MaterialIndex::clear()
+    {
+        m_stats.clear();
+        m_runLength = 0;
+
+        // The file is kept so that the database is known to have the index.
+        m_isDirty = true;
+        flush();
+    }
+
+    void MaterialIndex::endRun()
+    {
+        ASSERT(m_runLength != 0);
+
+        // A material signature can't repeat after it changes, because
+        // captured pieces and promoted pawns never come back.
+        // So each run is a different game for its signature.
+        MaterialStats& stats = m_stats[m_runSignature][m_level][m_result];
+        stats.numPositions += m_runLength;
+        stats.numGames += 1;
+
+        m_runLength = 0;
+        m_isDirty = true;
+    }
+
+    void MaterialIndex::load()
+    {
+        const auto data = ext::readFile<std::uint64_t>(m_path);
+        if (data.size() % recordSize != 0)
+        {
+            throw ext::Exception("Invalid material index.");
+        }
+
+        for (std::size_t i = 0; i < data.size(); i += recordSize)
+        {
+            auto& stats = m_stats[MaterialSignature::fromBits(data[i])];
+            std::size_t j = i + 1;
+            for (GameLevel level : values<GameLevel>())
+            {
+                for (GameResult result : values<GameResult>())
+                {
+                    stats[level][result].numPositions = data[j++];
+                    stats[level][result].numGames = data[j++];
+                }
+            }
+        }
+    }
+}
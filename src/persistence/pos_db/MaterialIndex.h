@@ -0,0 +1,150 @@
+#pragma once
+
+#include "chess/Chess.h"
+#include "chess/GameClassification.h"
+#include "chess/Position.h"
+
+#include "enum/EnumArray.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace persistence
+{
+    // Number of pieces of each type, except kings, of both sides.
+    // Each count takes 4 bits, in order of piece types,
+    // white's pieces occupy the lower 20 bits and black's the next 20.
+    struct MaterialSignature
+    {
+        static constexpr std::size_t numPieceTypes = 5;
+        static constexpr std::size_t bitsPerCount = 4;
+        static constexpr std::uint8_t maxCount = (1u << bitsPerCount) - 1u;
+
+        constexpr MaterialSignature() :
+            m_bits(0)
+        {
+        }
+
+        // Counts that don't fit are saturated. It can only
+        // happen in positions that can't arise in a game.
+        [[nodiscard]] static MaterialSignature fromBoard(const Board& board);
+
+        // Bits not used by any count are ignored.
+        [[nodiscard]] static MaterialSignature fromBits(std::uint64_t bits);
+
+        // Parses signatures like "KRPvKR", the pieces of white
+        // are before the 'v'. Each side must have exactly one king.
+        // The pieces may be given in any order.
+        [[nodiscard]] static std::optional<MaterialSignature> fromString(std::string_view str);
+
+        // Pieces of each side are ordered from the most valuable, like "KQRBNPvKQ".
+        [[nodiscard]] std::string toString() const;
+
+        [[nodiscard]] std::uint8_t count(Piece piece) const;
+
+        void setCount(Piece piece, std::uint8_t count);
+
+        [[nodiscard]] std::uint64_t bits() const
+        {
+            return m_bits;
+        }
+
+        [[nodiscard]] friend bool operator==(MaterialSignature lhs, MaterialSignature rhs) noexcept
+        {
+            return lhs.m_bits == rhs.m_bits;
+        }
+
+        [[nodiscard]] friend bool operator!=(MaterialSignature lhs, MaterialSignature rhs) noexcept
+        {
+            return lhs.m_bits != rhs.m_bits;
+        }
+
+        [[nodiscard]] friend bool operator<(MaterialSignature lhs, MaterialSignature rhs) noexcept
+        {
+            return lhs.m_bits < rhs.m_bits;
+        }
+
+    private:
+        std::uint64_t m_bits;
+
+        [[nodiscard]] static std::size_t shift(Piece piece);
+    };
+
+    struct MaterialStats
+    {
+        std::uint64_t numPositions = 0;
+
+        // The number of games in which the material occurred at least once.
+        std::uint64_t numGames = 0;
+    };
+
+    using MaterialStatsByLevelAndResult = EnumArray2<GameLevel, GameResult, MaterialStats>;
+}
+
+namespace std
+{
+    template <>
+    struct hash<persistence::MaterialSignature>
+    {
+        [[nodiscard]] std::size_t operator()(persistence::MaterialSignature signature) const noexcept
+        {
+            return std::hash<std::uint64_t>{}(signature.bits());
+        }
+    };
+}
+
+namespace persistence
+{
+    // Aggregates the number of positions and games for each material
+    // signature, split by game level and result.
+    // Positions are added game by game during the import.
+    // The whole index is kept in memory and is written to the file on flush.
+    struct MaterialIndex
+    {
+        MaterialIndex(std::filesystem::path path);
+
+        MaterialIndex(const MaterialIndex&) = delete;
+        MaterialIndex(MaterialIndex&&) noexcept = default;
+
+        MaterialIndex& operator=(const MaterialIndex&) = delete;
+        MaterialIndex& operator=(MaterialIndex&&) noexcept = default;
+
+        void beginGame(GameLevel level, GameResult result);
+
+        void addPosition(const Board& board);
+
+        void endGame();
+
+        [[nodiscard]] std::size_t numSignatures() const;
+
+        // Zero if the signature never occurred.
+        [[nodiscard]] MaterialStatsByLevelAndResult stats(MaterialSignature signature) const;
+
+        void flush();
+
+        // Leaves an empty index in the file.
+        void clear();
+
+    private:
+        std::filesystem::path m_path;
+        bool m_isDirty;
+
+        std::unordered_map<MaterialSignature, MaterialStatsByLevelAndResult> m_stats;
+
+        // State of the game being added. Consecutive positions with
+        // the same material are counted together.
+        GameLevel m_level;
+        GameResult m_result;
+        MaterialSignature m_runSignature;
+        std::uint64_t m_runLength;
+
+        void endRun();
+
+        void load();
+    };
+}
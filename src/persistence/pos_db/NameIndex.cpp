@@ -0,0 +1,256 @@
+#include "NameIndex.h"
+
+#include "external_storage/External.h"
+
+#include "util/Assert.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace persistence
+{
+    namespace
+    {
+        void writeVarint(std::vector<std::uint8_t>& out, std::uint64_t value)
+        {
+            while (value >= 0x80)
+            {
+                out.emplace_back(static_cast<std::uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            out.emplace_back(static_cast<std::uint8_t>(value));
+        }
+
+        [[nodiscard]] std::uint64_t readVarint(const std::uint8_t*& data, const std::uint8_t* end)
+        {
+            std::uint64_t value = 0;
+            for (unsigned shift = 0; data != end && shift < 64; shift += 7)
+            {
+                const std::uint8_t byte = *data++;
+                value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                {
+                    return value;
+                }
+            }
+
+            throw ext::Exception("Invalid name index.");
+        }
+
+        [[nodiscard]] std::string makeKey(NameIndexField field, std::string_view normalizedName)
+        {
+            std::string key;
+            key.reserve(normalizedName.size() + 1);
+            key += static_cast<char>(field);
+            key += normalizedName;
+            return key;
+        }
+
+        [[nodiscard]] bool isWhitespace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        }
+    }
+
+    NameIndex::NameIndex(std::filesystem::path path) :
+        m_path(std::move(path)),
+        m_numGames(0),
+        m_isDirty(false)
+    {
+        if (std::filesystem::exists(m_path))
+        {
+            load();
+        }
+    }
+
+    void NameIndex::add(std::uint64_t gameIdx, std::string_view event, std::string_view white, std::string_view black)
+    {
+        ASSERT(gameIdx == m_numGames);
+
+        addName(gameIdx, NameIndexField::Event, event);
+        addName(gameIdx, NameIndexField::Player, white);
+        addName(gameIdx, NameIndexField::Player, black);
+
+        m_numGames = gameIdx + 1;
+        m_isDirty = true;
+    }
+
+    [[nodiscard]] std::uint64_t NameIndex::numGames() const
+    {
+        return m_numGames;
+    }
+
+    [[nodiscard]] std::size_t NameIndex::numNames() const
+    {
+        return m_postingLists.size();
+    }
+
+    [[nodiscard]] std::size_t NameIndex::countGames(NameIndexField field, std::string_view name) const
+    {
+        const PostingList* list = find(field, name);
+        return list == nullptr ? 0 : list->numGames;
+    }
+
+    [[nodiscard]] std::vector<std::uint64_t> NameIndex::findGames(
+        NameIndexField field,
+        std::string_view name,
+        std::size_t offset,
+        std::size_t limit
+    ) const
+    {
+        std::vector<std::uint64_t> gameIndices;
+
+        const PostingList* list = find(field, name);
+        if (list == nullptr || offset >= list->numGames)
+        {
+            return gameIndices;
+        }
+
+        gameIndices.reserve(std::min<std::uint64_t>(limit, list->numGames - offset));
+
+        // The deltas have to be decoded from the start.
+        const std::uint8_t* data = list->deltas.data();
+        const std::uint8_t* end = data + list->deltas.size();
+        std::uint64_t gameIdx = 0;
+        for (std::size_t i = 0; i < list->numGames && gameIndices.size() < limit; ++i)
+        {
+            gameIdx += readVarint(data, end);
+            if (i >= offset)
+            {
+                gameIndices.emplace_back(gameIdx);
+            }
+        }
+
+        return gameIndices;
+    }
+
+    void NameIndex::flush()
+    {
+        if (!m_isDirty)
+        {
+            return;
+        }
+
+        // numGames, then for each name:
+        // key length, key, number of games, last game index, size of deltas, deltas
+        std::vector<std::uint8_t> data;
+        writeVarint(data, m_numGames);
+        for (auto&& [key, list] : m_postingLists)
+        {
+            writeVarint(data, key.size());
+            data.insert(data.end(), key.begin(), key.end());
+            writeVarint(data, list.numGames);
+            writeVarint(data, list.lastGameIdx);
+            writeVarint(data, list.deltas.size());
+            data.insert(data.end(), list.deltas.begin(), list.deltas.end());
+        }
+
+        // Write the whole file anew and replace the old one
+        // so that it's never left half written.
+        std::filesystem::path tmpPath = m_path;
+        tmpPath += "_tmp";
+        (void)ext::writeFile(tmpPath, data.data(), data.size());
+        std::filesystem::rename(tmpPath, m_path);
+
+        m_isDirty = false;
+    }
+
+    void NameIndex::clear()
+    {
+        m_postingLists.clear();
+        m_numGames = 0;
+        m_isDirty = false;
+
+        std::filesystem::remove(m_path);
+    }
+
+    [[nodiscard]] std::string NameIndex::normalize(std::string_view name)
+    {
+        while (!name.empty() && isWhitespace(name.front()))
+        {
+            name.remove_prefix(1);
+        }
+
+        while (!name.empty() && isWhitespace(name.back()))
+        {
+            name.remove_suffix(1);
+        }
+
+        std::string normalized(name);
+        for (char& c : normalized)
+        {
+            if (c >= 'A' && c <= 'Z')
+            {
+                c = static_cast<char>(c - 'A' + 'a');
+            }
+        }
+
+        return normalized;
+    }
+
+    void NameIndex::addName(std::uint64_t gameIdx, NameIndexField field, std::string_view name)
+    {
+        const std::string normalized = normalize(name);
+        if (normalized.empty())
+        {
+            return;
+        }
+
+        PostingList& list = m_postingLists[makeKey(field, normalized)];
+
+        // Both players can have the same name.
+        if (list.numGames != 0 && list.lastGameIdx == gameIdx)
+        {
+            return;
+        }
+
+        writeVarint(list.deltas, gameIdx - list.lastGameIdx);
+        list.lastGameIdx = gameIdx;
+        list.numGames += 1;
+    }
+
+    [[nodiscard]] const NameIndex::PostingList* NameIndex::find(NameIndexField field, std::string_view name) const
+    {
+        auto it = m_postingLists.find(makeKey(field, normalize(name)));
+        return it == m_postingLists.end() ? nullptr : &it->second;
+    }
+
+    void NameIndex::load()
+    {
+        const auto data = ext::readFile<std::uint8_t>(m_path);
+        const std::uint8_t* ptr = data.data();
+        const std::uint8_t* end = ptr + data.size();
+
+        const auto readBytes = [&](std::size_t size) {
+            if (static_cast<std::size_t>(end - ptr) < size)
+            {
+                throw ext::Exception("Invalid name index.");
+            }
+
+            const std::uint8_t* begin = ptr;
+            ptr += size;
+            return begin;
+        };
+
+        m_numGames = readVarint(ptr, end);
+        while (ptr != end)
+        {
+            const std::size_t keySize = readVarint(ptr, end);
+            const std::uint8_t* key = readBytes(keySize);
+
+            PostingList list;
+            list.numGames = readVarint(ptr, end);
+            list.lastGameIdx = readVarint(ptr, end);
+            const std::size_t deltasSize = readVarint(ptr, end);
+            const std::uint8_t* deltas = readBytes(deltasSize);
+            list.deltas.assign(deltas, deltas + deltasSize);
+
+            m_postingLists.emplace(std::string(reinterpret_cast<const char*>(key), keySize), std::move(list));
+        }
+    }
+}
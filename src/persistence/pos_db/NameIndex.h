@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace persistence
+{
+    enum struct NameIndexField : std::uint8_t
+    {
+        Player,
+        Event
+    };
+
+    // Maps player and event names to the indices of the games
+    // they appear in. Names are compared after normalization.
+    // The games of each name are stored as a list of differences
+    // between consecutive game indices, each as a varint.
+    // The whole index is kept in memory and is written to the file on flush.
+    struct NameIndex
+    {
+        // Number of headers read at once by update.
+        static constexpr std::size_t updateBatchSize = 4096;
+
+        NameIndex(std::filesystem::path path);
+
+        NameIndex(const NameIndex&) = delete;
+        NameIndex(NameIndex&&) noexcept = default;
+
+        NameIndex& operator=(const NameIndex&) = delete;
+        NameIndex& operator=(NameIndex&&) noexcept = default;
+
+        // Games must be added in order of indices, without gaps.
+        void add(std::uint64_t gameIdx, std::string_view event, std::string_view white, std::string_view black);
+
+        // Adds the games of the header storage that are not in the index yet,
+        // for example when the index was disabled during an import.
+        template <typename HeaderStorageT>
+        void update(HeaderStorageT& storage)
+        {
+            // The headers were cleared without the index.
+            if (m_numGames > storage.numGames())
+            {
+                clear();
+            }
+
+            std::vector<std::uint64_t> gameIndices;
+            while (m_numGames < storage.numGames())
+            {
+                const std::uint64_t end = std::min<std::uint64_t>(m_numGames + updateBatchSize, storage.numGames());
+
+                gameIndices.clear();
+                for (std::uint64_t i = m_numGames; i < end; ++i)
+                {
+                    gameIndices.emplace_back(i);
+                }
+
+                // Not through the header cache, it would evict the headers used by queries.
+                for (auto&& header : storage.queryByIndicesUncached(gameIndices))
+                {
+                    add(m_numGames, header.event(), header.white(), header.black());
+                }
+            }
+
+            flush();
+        }
+
+        // The number of games added, which is also the index of the next game.
+        [[nodiscard]] std::uint64_t numGames() const;
+
+        [[nodiscard]] std::size_t numNames() const;
+
+        [[nodiscard]] std::size_t countGames(NameIndexField field, std::string_view name) const;
+
+        // Returns at most `limit` game indices, in ascending order,
+        // skipping the first `offset` ones.
+        [[nodiscard]] std::vector<std::uint64_t> findGames(
+            NameIndexField field,
+            std::string_view name,
+            std::size_t offset,
+            std::size_t limit
+        ) const;
+
+        void flush();
+
+        // Removes the file too.
+        void clear();
+
+        // Trims whitespace and lowercases ASCII letters.
+        [[nodiscard]] static std::string normalize(std::string_view name);
+
+    private:
+        struct PostingList
+        {
+            std::uint64_t numGames = 0;
+            std::uint64_t lastGameIdx = 0;
+            std::vector<std::uint8_t> deltas;
+        };
+
+        std::filesystem::path m_path;
+        std::uint64_t m_numGames;
+        bool m_isDirty;
+
+        // Keys are the field followed by the normalized name.
+        std::unordered_map<std::string, PostingList> m_postingLists;
+
+        void addName(std::uint64_t gameIdx, NameIndexField field, std::string_view name);
+
+        [[nodiscard]] const PostingList* find(NameIndexField field, std::string_view name) const;
+
+        void load();
+    };
+}
@@ -1,8 +1,13 @@
 #pragma once
 
 #include "Database.h"
+#include "DictionaryGameHeaderStorage.h"
 #include "EntryConstructionParameters.h"
+#include "GameList.h"
+#include "HashPrefixScan.h"
+#include "IndexCache.h"
 #include "IndexedGameHeaderStorage.h"
+#include "MaterialIndex.h"
 #include "Query.h"
 
 #include "algorithm/Unsort.h"
@@ -10,6 +15,7 @@
 #include "chess/Bcgn.h"
 #include "chess/Chess.h"
 #include "chess/GameClassification.h"
+#include "chess/OpeningTrie.h"
 #include "chess/Position.h"
 #include "chess/San.h"
 
@@ -17,16 +23,19 @@
 
 #include "external_storage/External.h"
 
-#include "util/LazyCached.h"
-
 #include "Configuration.h"
 #include "Logger.h"
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <climits>
 #include <cstdint>
+#include <cstring>
 #include <execution>
 #include <filesystem>
 #include <functional>
+#include <future>
 #include <memory>
 #include <optional>
 #include <set>
@@ -242,6 +251,66 @@ namespace persistence
                 using type = typename T::SmearedEntryType;
             };
 
+            template<typename T, typename = void>
+            struct HasBlockCodec
+            {
+                static constexpr bool value = false;
+            };
+
+            template<typename T>
+            struct HasBlockCodec<T, void_t<typename T::BlockCodecType>>
+            {
+                static constexpr bool value = true;
+            };
+
+            template<typename T, typename = void>
+            struct GetBlockCodecType
+            {
+                using type = void;
+            };
+
+            template<typename T>
+            struct GetBlockCodecType<T, void_t<typename T::BlockCodecType>>
+            {
+                using type = typename T::BlockCodecType;
+            };
+
+            template<typename T, typename = void>
+            struct HasLeadingHashPrefix
+            {
+                static constexpr bool value = false;
+            };
+
+            template<typename T>
+            struct HasLeadingHashPrefix<T, void_t<decltype(T::hasLeadingHashPrefix)>>
+            {
+                static constexpr bool value = T::hasLeadingHashPrefix;
+            };
+
+            template<typename T, typename = void>
+            struct HasKeyColumn
+            {
+                static constexpr bool value = false;
+            };
+
+            template<typename T>
+            struct HasKeyColumn<T, void_t<decltype(T::hasKeyColumn)>>
+            {
+                static constexpr bool value = T::hasKeyColumn;
+            };
+
+            template<typename T, typename = void>
+            struct HasDictionaryEncodedHeaders
+            {
+                static constexpr bool value = false;
+            };
+
+            template<typename T>
+            struct HasDictionaryEncodedHeaders<T, void_t<decltype(T::hasDictionaryEncodedHeaders)>>
+            {
+                static constexpr bool value = T::hasDictionaryEncodedHeaders;
+            };
+
             template<typename T, bool HasHeadersV = false>
             struct GetGameIndexType
             {
@@ -269,6 +338,37 @@ namespace persistence
 
             static_assert(std::is_trivially_copyable_v<PersistedEntryType>);
 
+            // Formats with a block codec store data files as sequences of compressed blocks.
+            static constexpr bool hasCompressedBlocks = detail::HasBlockCodec<TraitsT>::value;
+
+            using BlockCodecType = typename detail::GetBlockCodecType<TraitsT>::type;
+
+            // Entries and keys that start with 8 bytes of the hash can be
+            // scanned for matching keys with SIMD, see HashPrefixScan.h.
+            static constexpr bool hasLeadingHashPrefix =
+                detail::HasLeadingHashPrefix<PersistedEntryType>::value
+                && detail::HasLeadingHashPrefix<KeyT>::value;
+
+            // Block codecs that store the keys of a block apart from the rest
+            // can decode only the entries with matching keys.
+            static constexpr bool hasKeyColumn = detail::HasKeyColumn<BlockCodecType>::value;
+
+            // Entries that only need the zobrist key and the packed reverse move
+            // can be imported from the position keys written next to BCGN files,
+            // without decoding and playing the moves, see bcgn::BcgnPositionKeyFileReader.
+            static constexpr bool canImportPositionKeys = std::is_constructible_v<
+                PersistedEntryType,
+                const EntryConstructionParameters&,
+                const ZobristKey&,
+                PackedReverseMove
+            >;
+
+            using StoredSpanType = std::conditional_t<
+                hasCompressedBlocks,
+                ext::ImmutableSpan<std::byte>,
+                ext::ImmutableSpan<PersistedEntryType>
+            >;
+
             static constexpr bool hasEloDiff = detail::HasEloDiff<EntryType>::value;
             static constexpr bool hasWhiteElo = detail::HasWhiteElo<EntryType>::value;
             static constexpr bool hasBlackElo = detail::HasBlackElo<EntryType>::value;
@@ -294,6 +394,11 @@ namespace persistence
 
             static constexpr bool hasGameHeaders = usesGameIndex || usesGameOffset;
 
+            // Formats that reference games can store the list of all games
+            // of each key next to the data files, see GameList.h.
+            // Smeared entries don't come from single games.
+            static constexpr bool hasGameLists = hasFirstGame && !hasSmearedEntry;
+
             static constexpr const char* name = TraitsT::name;
 
             static_assert(!(usesGameIndex && usesGameOffset), "Only one type of game reference can be used.");
@@ -302,7 +407,15 @@ namespace persistence
 
             using PackedGameHeaderType = PackedGameHeader<GameIndexType>;
 
-            using IndexedGameHeaderStorageType = IndexedGameHeaderStorage<PackedGameHeaderType>;
+            // Formats can store strings of the headers in a dictionary, see DictionaryGameHeaderStorage.h.
+            // Both storages return PackedGameHeaderType.
+            static constexpr bool hasDictionaryEncodedHeaders = detail::HasDictionaryEncodedHeaders<TraitsT>::value;
+
+            using IndexedGameHeaderStorageType = std::conditional_t<
+                hasDictionaryEncodedHeaders,
+                DictionaryGameHeaderStorage<GameIndexType>,
+                IndexedGameHeaderStorage<PackedGameHeaderType>
+            >;
 
             using CompareEqualWithReverseMove = typename PersistedEntryType::CompareEqualWithReverseMove;
             using CompareEqualWithoutReverseMove = typename PersistedEntryType::CompareEqualWithoutReverseMove;
@@ -329,6 +442,92 @@ namespace persistence
 
             using Index = ext::RangeIndex<KeyT, typename PersistedEntryType::CompareLessWithoutReverseMove>;
 
+            // The index files are searched in place. Only the pages that are
+            // touched by the searches are loaded and the OS can drop them at will.
+            using MappedIndex = ext::RangeIndex<
+                KeyT,
+                typename PersistedEntryType::CompareLessWithoutReverseMove,
+                ext::MappedSpan<typename Index::EntryType>
+            >;
+
+            // An in-memory copy of the index that is faster to search,
+            // see eytzinger_index in the config.
+            using EytzingerIndex = ext::EytzingerRangeIndex<KeyT, typename PersistedEntryType::CompareLessWithoutReverseMove>;
+
+            // Compressed data files consist of blocks with a fixed number of entries,
+            // only the last one can be shorter. Entry i is in the block i / entriesPerBlock,
+            // so the indexes still work on entry offsets.
+            // Stored as [numEntries, entriesPerBlock, offset of each block..., file size].
+            struct BlockDirectory
+            {
+                BlockDirectory(std::vector<std::uint64_t>&& data) :
+                    m_data(std::move(data))
+                {
+                    if (m_data.size() < 3 || m_data[1] == 0)
+                    {
+                        throw ext::Exception("Invalid block directory.");
+                    }
+                }
+
+                [[nodiscard]] const std::uint64_t* data() const
+                {
+                    return m_data.data();
+                }
+
+                [[nodiscard]] std::size_t size() const
+                {
+                    return m_data.size();
+                }
+
+                [[nodiscard]] std::size_t numEntries() const
+                {
+                    return m_data[0];
+                }
+
+                [[nodiscard]] std::size_t entriesPerBlock() const
+                {
+                    return m_data[1];
+                }
+
+                [[nodiscard]] std::size_t numBlocks() const
+                {
+                    return m_data.size() - 3;
+                }
+
+                [[nodiscard]] std::size_t blockOf(std::size_t entryIdx) const
+                {
+                    return entryIdx / entriesPerBlock();
+                }
+
+                [[nodiscard]] std::size_t firstEntryOfBlock(std::size_t blockIdx) const
+                {
+                    return blockIdx * entriesPerBlock();
+                }
+
+                [[nodiscard]] std::size_t numEntriesInBlock(std::size_t blockIdx) const
+                {
+                    return std::min(entriesPerBlock(), numEntries() - firstEntryOfBlock(blockIdx));
+                }
+
+                [[nodiscard]] std::size_t blockBegin(std::size_t blockIdx) const
+                {
+                    return m_data[2 + blockIdx];
+                }
+
+                [[nodiscard]] std::size_t blockEnd(std::size_t blockIdx) const
+                {
+                    return m_data[3 + blockIdx];
+                }
+
+                [[nodiscard]] std::size_t memoryUsage() const
+                {
+                    return m_data.size() * sizeof(std::uint64_t);
+                }
+
+            private:
+                std::vector<std::uint64_t> m_data;
+            };
+
             [[nodiscard]] static std::filesystem::path dataFilePathToIndexPath(const std::filesystem::path& dataFilePath)
             {
                 auto cpy = dataFilePath;
@@ -336,10 +535,10 @@ namespace persistence
                 return cpy;
             }
 
-            [[nodiscard]] static auto readIndexOfDataFile(const std::filesystem::path& dataFilePath)
+            [[nodiscard]] static MappedIndex mapIndexOfDataFile(const std::filesystem::path& dataFilePath)
             {
                 auto indexPath = dataFilePathToIndexPath(dataFilePath);
-                return Index(ext::readFile<typename Index::EntryType>(indexPath));
+                return MappedIndex(ext::MappedSpan<typename Index::EntryType>(indexPath));
             }
 
             static void writeIndexOfDataFile(const std::filesystem::path& dataFilePath, const Index& index)
@@ -348,6 +547,133 @@ namespace persistence
                 (void)ext::writeFile<typename Index::EntryType>(indexPath, index.data(), index.size());
             }
 
+            [[nodiscard]] static std::filesystem::path dataFilePathToRadixIndexPath(const std::filesystem::path& dataFilePath)
+            {
+                auto cpy = dataFilePath;
+                cpy += "_radix_index";
+                return cpy;
+            }
+
+            // Files written with radix index disabled don't have one.
+            [[nodiscard]] static std::optional<ext::RadixIndex> readRadixIndexOfDataFile(const std::filesystem::path& dataFilePath)
+            {
+                auto indexPath = dataFilePathToRadixIndexPath(dataFilePath);
+                if (!std::filesystem::exists(indexPath))
+                {
+                    return std::nullopt;
+                }
+
+                return ext::RadixIndex(ext::readFile<std::uint64_t>(indexPath));
+            }
+
+            static void writeRadixIndexOfDataFile(const std::filesystem::path& dataFilePath, const ext::RadixIndex& index)
+            {
+                auto indexPath = dataFilePathToRadixIndexPath(dataFilePath);
+                (void)ext::writeFile<std::uint64_t>(indexPath, index.data(), index.size());
+            }
+
+            // Keys of all formats are ordered by hash()[0] first
+            // and the hash is uniformly distributed, so its most significant
+            // bits make a good radix.
+            [[nodiscard]] static std::uint64_t radixKeyOf(const KeyT& key)
+            {
+                const auto mostSignificantPart = key.hash()[0];
+                return static_cast<std::uint64_t>(mostSignificantPart) << (64 - sizeof(mostSignificantPart) * CHAR_BIT);
+            }
+
+            [[nodiscard]] static std::filesystem::path dataFilePathToBlockIndexPath(const std::filesystem::path& dataFilePath)
+            {
+                auto cpy = dataFilePath;
+                cpy += "_block_index";
+                return cpy;
+            }
+
+            [[nodiscard]] static BlockDirectory readBlockIndexOfDataFile(const std::filesystem::path& dataFilePath)
+            {
+                auto indexPath = dataFilePathToBlockIndexPath(dataFilePath);
+                return BlockDirectory(ext::readFile<std::uint64_t>(indexPath));
+            }
+
+            static void writeBlockIndexOfDataFile(const std::filesystem::path& dataFilePath, const BlockDirectory& directory)
+            {
+                auto indexPath = dataFilePathToBlockIndexPath(dataFilePath);
+                (void)ext::writeFile<std::uint64_t>(indexPath, directory.data(), directory.size());
+            }
+
+            // The game lists of a data file are stored in 4 files next to it:
+            //   keys    - distinct keys, ordered like the entries
+            //   offsets - offset of the list of each key in `lists` and the size of `lists` at the end
+            //   lists   - the lists, see GameList.h
+            //   index   - range index of the keys
+            struct GameListPaths
+            {
+                std::filesystem::path keys;
+                std::filesystem::path offsets;
+                std::filesystem::path lists;
+                std::filesystem::path index;
+
+                [[nodiscard]] std::array<const std::filesystem::path*, 4> all() const
+                {
+                    return { &keys, &offsets, &lists, &index };
+                }
+            };
+
+            [[nodiscard]] static GameListPaths dataFilePathToGameListPaths(const std::filesystem::path& dataFilePath)
+            {
+                GameListPaths paths{ dataFilePath, dataFilePath, dataFilePath, dataFilePath };
+                paths.keys += "_game_list_keys_index";
+                paths.offsets += "_game_list_offsets_index";
+                paths.lists += "_game_list_data_index";
+                paths.index += "_game_list_range_index";
+                return paths;
+            }
+
+            // Files written with game lists disabled don't have them.
+            // The range index is written last.
+            [[nodiscard]] static bool hasGameListsOfDataFile(const std::filesystem::path& dataFilePath)
+            {
+                return std::filesystem::exists(dataFilePathToGameListPaths(dataFilePath).index);
+            }
+
+            static void removeGameListsOfDataFile(const std::filesystem::path& dataFilePath)
+            {
+                for (auto&& path : dataFilePathToGameListPaths(dataFilePath).all())
+                {
+                    std::filesystem::remove(*path);
+                }
+            }
+
+            static void renameGameListsOfDataFile(const std::filesystem::path& from, const std::filesystem::path& to)
+            {
+                const auto fromPaths = dataFilePathToGameListPaths(from).all();
+                const auto toPaths = dataFilePathToGameListPaths(to).all();
+                for (std::size_t i = 0; i < fromPaths.size(); ++i)
+                {
+                    if (std::filesystem::exists(*fromPaths[i]))
+                    {
+                        std::filesystem::rename(*fromPaths[i], *toPaths[i]);
+                    }
+                }
+            }
+
+            // Each persisted entry is created from a single game.
+            [[nodiscard]] static std::uint64_t gameOfUncombinedEntry(const PersistedEntryType& entry)
+            {
+                if constexpr (hasGameLists && hasFirstGameIndex)
+                {
+                    return entry.firstGameIndex();
+                }
+                else if constexpr (hasGameLists && hasFirstGameOffset)
+                {
+                    return entry.firstGameOffset();
+                }
+                else
+                {
+                    ASSERT(false);
+                    return 0;
+                }
+            }
+
             [[nodiscard]] static std::string fileIdToName(std::uint32_t id)
             {
                 return std::to_string(id);
@@ -385,7 +711,7 @@ namespace persistence
                 const bool includeUnknownElo = filter.includeUnknownElo;
 
                 const std::uint32_t minMonth = filter.minMonthSinceYear0.value_or(0);
-                const std::uint32_t maxMonth = filter.minMonthSinceYear0.value_or(std::numeric_limits<std::uint32_t>::max());
+                const std::uint32_t maxMonth = filter.maxMonthSinceYear0.value_or(std::numeric_limits<std::uint32_t>::max());
                 const bool includeUnknownMonth = filter.includeUnknownMonth;
 
                 return [
@@ -434,7 +760,449 @@ namespace persistence
             }
 
             static inline std::size_t m_indexGranularity = cfg::g_config["persistence"][name]["index_granularity"].get<std::size_t>();
+            static inline std::size_t m_indexRadixBits = std::min(cfg::g_config["persistence"][name]["index_radix_bits"].get<std::size_t>(), ext::RadixIndex::maxNumBits);
             static inline MemoryAmount m_mergeWriterBufferSize = cfg::g_config["persistence"][name]["merge_writer_buffer_size"].get<MemoryAmount>();
+            static inline std::size_t m_blockSize = hasCompressedBlocks ? cfg::g_config["persistence"][name]["block_size"].get<std::size_t>() : 0;
+            static inline bool m_gameListsEnabled = hasGameLists ? cfg::g_config["persistence"][name]["game_lists"].get<bool>() : false;
+
+            // Read each time a file is opened.
+            [[nodiscard]] static bool isEytzingerIndexEnabled()
+            {
+                return cfg::g_config["persistence"][name]["eytzinger_index"].get<bool>();
+            }
+
+            // Gathers entries into blocks and appends them compressed to the file.
+            struct CompressedBlockWriter
+            {
+                CompressedBlockWriter(ext::BinaryOutputFile& file) :
+                    m_file(&file),
+                    m_block{},
+                    m_compressed{},
+                    m_directory{ 0, m_blockSize, 0 },
+                    m_numBytesWritten(0)
+                {
+                    ASSERT(m_blockSize > 0);
+
+                    m_block.reserve(m_blockSize);
+                }
+
+                CompressedBlockWriter(const CompressedBlockWriter&) = delete;
+                CompressedBlockWriter(CompressedBlockWriter&&) = default;
+
+                void emplace(const PersistedEntryType& entry)
+                {
+                    m_block.emplace_back(entry);
+                    if (m_block.size() == m_blockSize)
+                    {
+                        compressBlock();
+
+                        if (m_compressed.size() >= m_mergeWriterBufferSize.bytes())
+                        {
+                            writeCompressed();
+                        }
+                    }
+                }
+
+                // Must be called once after the last entry.
+                [[nodiscard]] BlockDirectory finish()
+                {
+                    compressBlock();
+                    writeCompressed();
+                    return BlockDirectory(std::move(m_directory));
+                }
+
+            private:
+                ext::BinaryOutputFile* m_file;
+                std::vector<PersistedEntryType> m_block;
+                std::vector<std::byte> m_compressed;
+                std::vector<std::uint64_t> m_directory;
+                std::size_t m_numBytesWritten;
+
+                void compressBlock()
+                {
+                    if constexpr (hasCompressedBlocks)
+                    {
+                        if (m_block.empty())
+                        {
+                            return;
+                        }
+
+                        BlockCodecType::encode(m_block.data(), m_block.size(), m_compressed);
+
+                        m_directory[0] += m_block.size();
+                        m_directory.emplace_back(m_numBytesWritten + m_compressed.size());
+
+                        m_block.clear();
+                    }
+                }
+
+                void writeCompressed()
+                {
+                    m_numBytesWritten += m_file->append(m_compressed.data(), 1, m_compressed.size());
+                    m_compressed.clear();
+                }
+            };
+
+            // Writes the data file and, for compressed formats, its block index.
+            // The block index is written first so the data file is always complete.
+            static void writeDataFile(const std::filesystem::path& path, const std::vector<PersistedEntryType>& entries)
+            {
+                if constexpr (hasCompressedBlocks)
+                {
+                    std::vector<std::byte> compressed;
+                    std::vector<std::uint64_t> directory{ entries.size(), m_blockSize, 0 };
+                    for (std::size_t i = 0; i < entries.size(); i += m_blockSize)
+                    {
+                        const std::size_t count = std::min(m_blockSize, entries.size() - i);
+                        BlockCodecType::encode(entries.data() + i, count, compressed);
+                        directory.emplace_back(compressed.size());
+                    }
+
+                    writeBlockIndexOfDataFile(path, BlockDirectory(std::move(directory)));
+                    (void)ext::writeFile(path, compressed.data(), compressed.size());
+                }
+                else
+                {
+                    (void)ext::writeFile(path, entries.data(), entries.size());
+                }
+            }
+
+            // Encoded game lists of consecutive keys.
+            struct GameLists
+            {
+                std::vector<KeyT> keys;
+                // Offset of the list of each key in `lists`.
+                std::vector<std::uint64_t> offsets;
+                std::vector<std::byte> lists;
+
+                void append(const KeyT& key, const std::vector<std::uint64_t>& games)
+                {
+                    keys.emplace_back(key);
+                    offsets.emplace_back(lists.size());
+                    GameListCoding::encode(games, lists);
+                }
+
+                [[nodiscard]] bool empty() const
+                {
+                    return keys.empty();
+                }
+
+                void clear()
+                {
+                    keys.clear();
+                    offsets.clear();
+                    lists.clear();
+                }
+            };
+
+            // Collects the games of each distinct key of sorted, not yet combined, entries.
+            static void gatherGameLists(const std::vector<PersistedEntryType>& entries, GameLists& gameLists)
+            {
+                auto cmp = CompareEqualFull{};
+                std::vector<std::uint64_t> games;
+                for (std::size_t i = 0; i < entries.size();)
+                {
+                    games.clear();
+
+                    std::size_t j = i;
+                    for (; j < entries.size() && cmp(entries[i], entries[j]); ++j)
+                    {
+                        games.emplace_back(gameOfUncombinedEntry(entries[j]));
+                    }
+
+                    normalizeGameList(games);
+                    gameLists.append(entries[i].key(), games);
+
+                    i = j;
+                }
+            }
+
+            // Writes the game lists of a data file. The keys must be appended in order.
+            // Nothing is written if there are no keys.
+            struct GameListWriter
+            {
+                GameListWriter(const std::filesystem::path& dataFilePath) :
+                    m_paths(dataFilePathToGameListPaths(dataFilePath)),
+                    m_keysFile(m_paths.keys),
+                    m_offsetsFile(m_paths.offsets),
+                    m_listsFile(m_paths.lists),
+                    m_indexBuilder(m_indexGranularity),
+                    m_buffer{},
+                    m_numKeys(0),
+                    m_numListBytesWritten(0)
+                {
+                }
+
+                GameListWriter(const GameListWriter&) = delete;
+                GameListWriter(GameListWriter&&) = default;
+
+                void append(const KeyT& key, const std::vector<std::uint64_t>& games)
+                {
+                    m_buffer.append(key, games);
+                    if (m_buffer.lists.size() >= m_mergeWriterBufferSize.bytes())
+                    {
+                        append(m_buffer);
+                        m_buffer.clear();
+                    }
+                }
+
+                void append(const GameLists& gameLists)
+                {
+                    if (gameLists.empty())
+                    {
+                        return;
+                    }
+
+                    std::vector<std::uint64_t> offsets(gameLists.offsets);
+                    for (auto& offset : offsets)
+                    {
+                        offset += m_numListBytesWritten;
+                    }
+
+                    m_indexBuilder.append(gameLists.keys.data(), gameLists.keys.size());
+                    (void)m_keysFile.append(reinterpret_cast<const std::byte*>(gameLists.keys.data()), sizeof(KeyT), gameLists.keys.size());
+                    (void)m_offsetsFile.append(reinterpret_cast<const std::byte*>(offsets.data()), sizeof(std::uint64_t), offsets.size());
+                    m_numListBytesWritten += m_listsFile.append(gameLists.lists.data(), 1, gameLists.lists.size());
+                    m_numKeys += gameLists.keys.size();
+                }
+
+                // Must be called once after the last list.
+                // The range index is written last so its presence means the lists are complete.
+                void finish()
+                {
+                    append(m_buffer);
+                    m_buffer.clear();
+
+                    (void)m_offsetsFile.append(reinterpret_cast<const std::byte*>(&m_numListBytesWritten), sizeof(std::uint64_t), 1);
+
+                    m_keysFile.flush();
+                    m_offsetsFile.flush();
+                    m_listsFile.flush();
+
+                    if (m_numKeys != 0)
+                    {
+                        const Index index = m_indexBuilder.end();
+                        (void)ext::writeFile<typename Index::EntryType>(m_paths.index, index.data(), index.size());
+                    }
+                }
+
+            private:
+                GameListPaths m_paths;
+                ext::BinaryOutputFile m_keysFile;
+                ext::BinaryOutputFile m_offsetsFile;
+                ext::BinaryOutputFile m_listsFile;
+                ext::IndexBuilder<KeyT, CompareLessWithoutReverseMove> m_indexBuilder;
+                GameLists m_buffer;
+                std::size_t m_numKeys;
+                std::uint64_t m_numListBytesWritten;
+            };
+
+            // Reads the game lists of a data file in order, a chunk of keys at a time.
+            struct GameListReader
+            {
+                static constexpr std::size_t chunkSize = 4096;
+
+                GameListReader(const std::filesystem::path& dataFilePath) :
+                    GameListReader(dataFilePathToGameListPaths(dataFilePath))
+                {
+                }
+
+                GameListReader(const GameListReader&) = delete;
+                GameListReader(GameListReader&&) = default;
+
+                [[nodiscard]] bool isEnd() const
+                {
+                    return m_chunkBegin + m_idx >= m_keys.size();
+                }
+
+                [[nodiscard]] const KeyT& key() const
+                {
+                    ASSERT(!isEnd());
+
+                    return m_chunkKeys[m_idx];
+                }
+
+                // Appends the games of the current key to `games`.
+                void readGames(std::vector<std::uint64_t>& games) const
+                {
+                    ASSERT(!isEnd());
+
+                    const std::uint64_t begin = m_chunkOffsets[m_idx] - m_chunkOffsets[0];
+                    const std::uint64_t end = m_chunkOffsets[m_idx + 1] - m_chunkOffsets[0];
+                    GameListCoding::decode(m_chunkLists.data() + begin, end - begin, games);
+                }
+
+                void next()
+                {
+                    ASSERT(!isEnd());
+
+                    if (++m_idx == m_chunkKeys.size())
+                    {
+                        readChunk(m_chunkBegin + m_idx);
+                    }
+                }
+
+            private:
+                ext::ImmutableSpan<KeyT> m_keys;
+                ext::ImmutableSpan<std::uint64_t> m_offsets;
+                ext::ImmutableSpan<std::byte> m_lists;
+
+                std::size_t m_chunkBegin;
+                std::size_t m_idx;
+                std::vector<KeyT> m_chunkKeys;
+                std::vector<std::uint64_t> m_chunkOffsets;
+                std::vector<std::byte> m_chunkLists;
+
+                GameListReader(const GameListPaths& paths) :
+                    m_keys(ext::ImmutableBinaryFile(ext::Pooled{}, paths.keys)),
+                    m_offsets(ext::ImmutableBinaryFile(ext::Pooled{}, paths.offsets)),
+                    m_lists(ext::ImmutableBinaryFile(ext::Pooled{}, paths.lists)),
+                    m_chunkBegin(0),
+                    m_idx(0)
+                {
+                    readChunk(0);
+                }
+
+                void readChunk(std::size_t begin)
+                {
+                    m_chunkBegin = begin;
+                    m_idx = 0;
+
+                    const std::size_t count = std::min(chunkSize, m_keys.size() - begin);
+                    m_chunkKeys.resize(count);
+                    m_chunkOffsets.resize(count + 1);
+                    if (count == 0)
+                    {
+                        return;
+                    }
+
+                    (void)m_keys.read(m_chunkKeys.data(), begin, count);
+                    (void)m_offsets.read(m_chunkOffsets.data(), begin, count + 1);
+
+                    m_chunkLists.resize(m_chunkOffsets.back() - m_chunkOffsets.front());
+                    (void)m_lists.read(m_chunkLists.data(), m_chunkOffsets.front(), m_chunkLists.size());
+                }
+            };
+
+            // Writes the game lists of `outFilePath` by merging the game lists
+            // of the data files. The lists of equal keys are united.
+            static void mergeGameListsOfDataFiles(const std::vector<std::filesystem::path>& dataFilePaths, const std::filesystem::path& outFilePath)
+            {
+                std::vector<GameListReader> readers;
+                readers.reserve(dataFilePaths.size());
+                for (auto&& path : dataFilePaths)
+                {
+                    readers.emplace_back(path);
+                }
+
+                GameListWriter writer(outFilePath);
+                std::vector<std::uint64_t> games;
+                auto cmpLess = KeyCompareLessFull{};
+                auto cmpEqual = KeyCompareEqualFull{};
+                for (;;)
+                {
+                    // There are few files so a linear search is enough.
+                    const KeyT* smallest = nullptr;
+                    for (auto&& reader : readers)
+                    {
+                        if (!reader.isEnd() && (smallest == nullptr || cmpLess(reader.key(), *smallest)))
+                        {
+                            smallest = &reader.key();
+                        }
+                    }
+
+                    if (smallest == nullptr)
+                    {
+                        break;
+                    }
+
+                    const KeyT key = *smallest;
+                    games.clear();
+                    for (auto&& reader : readers)
+                    {
+                        if (!reader.isEnd() && cmpEqual(reader.key(), key))
+                        {
+                            reader.readGames(games);
+                            reader.next();
+                        }
+                    }
+
+                    normalizeGameList(games);
+                    writer.append(key, games);
+                }
+
+                writer.finish();
+            }
+
+            // The game lists of a data file searched by key.
+            struct GameListFiles
+            {
+                GameListFiles(const std::filesystem::path& dataFilePath) :
+                    GameListFiles(dataFilePathToGameListPaths(dataFilePath))
+                {
+                }
+
+                [[nodiscard]] std::size_t memoryUsage() const
+                {
+                    return m_index.memoryUsage();
+                }
+
+                // Appends the games of the keys that are equal to `key`
+                // according to `cmp` to games[level of the key].
+                template <typename CompareEqualT>
+                void gatherGames(const KeyT& key, CompareEqualT cmp, EnumArray<GameLevel, std::vector<std::uint64_t>>& games) const
+                {
+                    auto [a, b] = m_index.equal_range(key);
+                    const std::size_t count = b.it - a.it;
+                    if (count == 0)
+                    {
+                        return;
+                    }
+
+                    std::vector<KeyT> keys(count);
+                    (void)m_keys.read(keys.data(), a.it, count);
+
+                    // Equal keys are adjacent.
+                    const auto first = std::find_if(keys.begin(), keys.end(), [&](const KeyT& k) { return cmp(k, key); });
+                    const auto last = std::find_if(first, keys.end(), [&](const KeyT& k) { return !cmp(k, key); });
+                    if (first == last)
+                    {
+                        return;
+                    }
+
+                    const std::size_t firstIdx = first - keys.begin();
+                    const std::size_t numMatching = last - first;
+
+                    std::vector<std::uint64_t> offsets(numMatching + 1);
+                    (void)m_offsets.read(offsets.data(), a.it + firstIdx, numMatching + 1);
+
+                    std::vector<std::byte> lists(offsets.back() - offsets.front());
+                    (void)m_lists.read(lists.data(), offsets.front(), lists.size());
+
+                    for (std::size_t i = 0; i < numMatching; ++i)
+                    {
+                        GameListCoding::decode(
+                            lists.data() + (offsets[i] - offsets.front()),
+                            offsets[i + 1] - offsets[i],
+                            games[keys[firstIdx + i].level()]
+                        );
+                    }
+                }
+
+            private:
+                MappedIndex m_index;
+                ext::ImmutableSpan<KeyT> m_keys;
+                ext::ImmutableSpan<std::uint64_t> m_offsets;
+                ext::ImmutableSpan<std::byte> m_lists;
+
+                GameListFiles(const GameListPaths& paths) :
+                    m_index(ext::MappedSpan<typename Index::EntryType>(paths.index)),
+                    m_keys(ext::ImmutableBinaryFile(ext::Pooled{}, paths.keys)),
+                    m_offsets(ext::ImmutableBinaryFile(ext::Pooled{}, paths.offsets)),
+                    m_lists(ext::ImmutableBinaryFile(ext::Pooled{}, paths.lists))
+                {
+                }
+            };
 
             struct File
             {
@@ -447,27 +1215,21 @@ namespace persistence
                 File(std::filesystem::path path) :
                     m_entries({ ext::Pooled{}, std::move(path) }),
                     m_index{makeIndexGetter()},
+                    m_radixIndex{makeRadixIndexGetter()},
+                    m_eytzingerIndex{makeEytzingerIndexGetter()},
+                    m_blockIndex{makeBlockIndexGetter()},
+                    m_gameLists{makeGameListsGetter()},
                     m_id(dataFilePathToId(m_entries.path()))
                 {
                 }
 
-                File(ext::ImmutableSpan<PersistedEntryType>&& entries) :
+                File(StoredSpanType&& entries) :
                     m_entries(std::move(entries)),
                     m_index{makeIndexGetter()},
-                    m_id(dataFilePathToId(m_entries.path()))
-                {
-                }
-
-                File(std::filesystem::path path, Index&& index) :
-                    m_entries({ ext::Pooled{}, std::move(path) }),
-                    m_index(std::move(index)),
-                    m_id(dataFilePathToId(m_entries.path()))
-                {
-                }
-
-                File(ext::ImmutableSpan<PersistedEntryType>&& entries, Index&& index) :
-                    m_entries(std::move(entries)),
-                    m_index(std::move(index)),
+                    m_radixIndex{makeRadixIndexGetter()},
+                    m_eytzingerIndex{makeEytzingerIndexGetter()},
+                    m_blockIndex{makeBlockIndexGetter()},
+                    m_gameLists{makeGameListsGetter()},
                     m_id(dataFilePathToId(m_entries.path()))
                 {
                 }
@@ -499,19 +1261,138 @@ namespace persistence
 
                 [[nodiscard]] PersistedEntryType at(std::size_t idx) const
                 {
-                    return m_entries[idx];
+                    if constexpr (hasCompressedBlocks)
+                    {
+                        std::vector<PersistedEntryType> buffer;
+                        readEntries(buffer, idx, 1);
+                        return buffer.front();
+                    }
+                    else
+                    {
+                        return m_entries[idx];
+                    }
                 }
 
-                [[nodiscard]] const ext::ImmutableSpan<PersistedEntryType>& entries() const
+                // For compressed formats these are the compressed bytes.
+                [[nodiscard]] const StoredSpanType& entries() const
                 {
                     return m_entries;
                 }
 
+                [[nodiscard]] std::size_t numEntries() const
+                {
+                    if constexpr (hasCompressedBlocks)
+                    {
+                        return m_blockIndex.get()->numEntries();
+                    }
+                    else
+                    {
+                        return m_entries.size();
+                    }
+                }
+
+                [[nodiscard]] std::size_t numEntryBytes() const
+                {
+                    return numEntries() * sizeof(PersistedEntryType);
+                }
+
+                // Reads entries [offset, offset + count) into the buffer,
+                // resizing it to count.
+                void readEntries(std::vector<PersistedEntryType>& buffer, std::size_t offset, std::size_t count) const
+                {
+                    buffer.resize(count);
+                    if (count == 0)
+                    {
+                        return;
+                    }
+
+                    if constexpr (hasCompressedBlocks)
+                    {
+                        std::vector<PersistedEntryType> block;
+                        forEachBlock(offset, count, [&](
+                            const std::byte* data,
+                            std::size_t size,
+                            std::size_t numEntriesInBlock,
+                            std::size_t from,
+                            std::size_t to,
+                            std::size_t blockFirstEntry
+                            ) {
+                            block.resize(numEntriesInBlock);
+                            BlockCodecType::decode(data, size, block.data(), numEntriesInBlock);
+
+                            std::copy(
+                                block.begin() + from,
+                                block.begin() + to,
+                                buffer.begin() + (blockFirstEntry + from - offset)
+                            );
+                        });
+                    }
+                    else
+                    {
+                        (void)m_entries.read(buffer.data(), offset, count);
+                    }
+                }
+
+                // Reads into the buffer only the entries from [offset, offset + count)
+                // that have the same key as `key`, ignoring the reverse move.
+                // For formats with a key column only the keys of the other
+                // entries are decoded.
+                void readMatchingEntries(std::vector<PersistedEntryType>& buffer, std::size_t offset, std::size_t count, const KeyT& key) const
+                {
+                    if constexpr (hasKeyColumn)
+                    {
+                        buffer.clear();
+                        if (count == 0)
+                        {
+                            return;
+                        }
+
+                        auto pred = [&key](const PersistedEntryType& entry) {
+                            return CompareEqualWithoutReverseMove{}(entry, key);
+                        };
+
+                        forEachBlock(offset, count, [&](
+                            const std::byte* data,
+                            std::size_t size,
+                            std::size_t numEntriesInBlock,
+                            std::size_t from,
+                            std::size_t to,
+                            std::size_t /* blockFirstEntry */
+                            ) {
+                            BlockCodecType::decodeMatching(data, size, numEntriesInBlock, from, to, pred, buffer);
+                        });
+                    }
+                    else
+                    {
+                        // Non matching entries are filtered out later.
+                        readEntries(buffer, offset, count);
+                    }
+                }
+
+                // Writes all entries uncompressed to a new file.
+                void expandInto(const std::filesystem::path& path) const
+                {
+                    ext::BinaryOutputFile outFile(path);
+                    outFile.reserve(numEntryBytes());
+
+                    const std::size_t chunkSize = ext::numObjectsPerBufferUnit<PersistedEntryType>(m_mergeWriterBufferSize.bytes(), 1);
+                    const std::size_t size = numEntries();
+                    std::vector<PersistedEntryType> buffer;
+                    for (std::size_t offset = 0; offset < size; offset += chunkSize)
+                    {
+                        readEntries(buffer, offset, std::min(chunkSize, size - offset));
+                        (void)outFile.append(reinterpret_cast<const std::byte*>(buffer.data()), sizeof(PersistedEntryType), buffer.size());
+                    }
+                }
+
+                // Retractions are gathered from the entries read for the root positions,
+                // retractionsStats is indexed by rootId. It's empty when they're not requested.
                 void executeQuery(
                     const query::Request& query,
                     const std::vector<KeyT>& keys,
                     const query::PositionQueries& queries,
-                    std::vector<PositionStats>& stats
+                    std::vector<PositionStats>& stats,
+                    std::vector<RetractionsStats>& retractionsStats
                 )
                 {
                     ASSERT(queries.size() == stats.size());
@@ -521,44 +1402,241 @@ namespace persistence
                     for (std::size_t i = 0; i < queries.size(); ++i)
                     {
                         auto& key = keys[i];
-                        auto [a, b] = m_index->equal_range(key);
+                        auto [a, b] = equalRange(key);
+
+                        const std::size_t count = b - a;
+                        if (count == 0) continue; // the range is empty, the value certainly does not exist
+
+                        readMatchingEntries(buffer, a, count, key);
+                        accumulateStatsFromEntries(buffer, query, key, queries[i].origin, stats[i]);
+
+                        if (!retractionsStats.empty() && queries[i].origin == query::PositionQueryOrigin::Root)
+                        {
+                            // The reverse move of the key is ignored when matching entries.
+                            accumulateRetractionsStatsFromEntries(buffer, query, queries[i].position, key, retractionsStats[queries[i].rootId]);
+                        }
+                    }
+                }
+
+                // Appends the games of the keys equal to `key` to games[level of the key].
+                // The reverse move is compared only if `withReverseMove` is true.
+                // Returns false if the file has no game lists.
+                [[nodiscard]] bool gatherGameLists(const KeyT& key, bool withReverseMove, EnumArray<GameLevel, std::vector<std::uint64_t>>& games) const
+                {
+                    if constexpr (hasGameLists)
+                    {
+                        const auto gameLists = m_gameLists.get();
+                        if (!gameLists->has_value())
+                        {
+                            return false;
+                        }
+
+                        if (withReverseMove)
+                        {
+                            (*gameLists)->gatherGames(key, KeyCompareEqualWithReverseMove{}, games);
+                        }
+                        else
+                        {
+                            (*gameLists)->gatherGames(key, KeyCompareEqualWithoutReverseMove{}, games);
+                        }
+
+                        return true;
+                    }
+                    else
+                    {
+                        return false;
+                    }
+                }
+
+            private:
+                StoredSpanType m_entries;
+                CachedIndex<MappedIndex> m_index;
+                CachedIndex<std::optional<ext::RadixIndex>> m_radixIndex;
+                // Only when enabled in the config when the file was opened.
+                CachedIndex<std::optional<EytzingerIndex>> m_eytzingerIndex;
+                // Only compressed formats have one.
+                std::conditional_t<hasCompressedBlocks, CachedIndex<BlockDirectory>, std::nullptr_t> m_blockIndex;
+                // Only formats with game lists have them.
+                std::conditional_t<hasGameLists, CachedIndex<std::optional<GameListFiles>>, std::nullptr_t> m_gameLists;
+                std::uint32_t m_id;
+
+                auto makeIndexGetter() const
+                {
+                    return [path = m_entries.path()]() -> MappedIndex{
+                        return mapIndexOfDataFile(path);
+                    };
+                }
+
+                auto makeRadixIndexGetter() const
+                {
+                    return [path = m_entries.path()]() -> std::optional<ext::RadixIndex>{
+                        if (m_indexRadixBits == 0)
+                        {
+                            return std::nullopt;
+                        }
+
+                        auto index = readRadixIndexOfDataFile(path);
+                        if (index.has_value() && index->numBits() > m_indexRadixBits)
+                        {
+                            // The file may have been written with different settings.
+                            index = index->coarsened(m_indexRadixBits);
+                        }
+                        return index;
+                    };
+                }
+
+                auto makeEytzingerIndexGetter() const
+                {
+                    return [path = m_entries.path(), enabled = isEytzingerIndexEnabled()]() -> std::optional<EytzingerIndex>{
+                        if (!enabled)
+                        {
+                            return std::nullopt;
+                        }
+
+                        return EytzingerIndex(mapIndexOfDataFile(path));
+                    };
+                }
+
+                auto makeBlockIndexGetter() const
+                {
+                    if constexpr (hasCompressedBlocks)
+                    {
+                        return [path = m_entries.path()]() -> BlockDirectory{
+                            return readBlockIndexOfDataFile(path);
+                        };
+                    }
+                    else
+                    {
+                        return nullptr;
+                    }
+                }
+
+                auto makeGameListsGetter() const
+                {
+                    if constexpr (hasGameLists)
+                    {
+                        return [path = m_entries.path()]() -> std::optional<GameListFiles>{
+                            if (!hasGameListsOfDataFile(path))
+                            {
+                                return std::nullopt;
+                            }
+
+                            return GameListFiles(path);
+                        };
+                    }
+                    else
+                    {
+                        return nullptr;
+                    }
+                }
+
+                // Calls func(data, size, numEntriesInBlock, from, to, blockFirstEntry)
+                // for each block with entries in [offset, offset + count).
+                // [from, to) is the part of the block within the range.
+                // All blocks are read at once, they are adjacent.
+                template <typename FuncT>
+                void forEachBlock(std::size_t offset, std::size_t count, FuncT&& func) const
+                {
+                    ASSERT(count > 0);
+
+                    const auto blockIndex = m_blockIndex.get();
+
+                    const std::size_t firstBlock = blockIndex->blockOf(offset);
+                    const std::size_t lastBlock = blockIndex->blockOf(offset + count - 1);
+
+                    const std::size_t begin = blockIndex->blockBegin(firstBlock);
+                    const std::size_t end = blockIndex->blockEnd(lastBlock);
+                    std::vector<std::byte> data(end - begin);
+                    (void)m_entries.read(data.data(), begin, end - begin);
+
+                    for (std::size_t blockIdx = firstBlock; blockIdx <= lastBlock; ++blockIdx)
+                    {
+                        const std::size_t numEntriesInBlock = blockIndex->numEntriesInBlock(blockIdx);
+                        const std::size_t blockFirstEntry = blockIndex->firstEntryOfBlock(blockIdx);
+                        const std::size_t from = std::max(offset, blockFirstEntry);
+                        const std::size_t to = std::min(offset + count, blockFirstEntry + numEntriesInBlock);
+
+                        func(
+                            data.data() + (blockIndex->blockBegin(blockIdx) - begin),
+                            blockIndex->blockEnd(blockIdx) - blockIndex->blockBegin(blockIdx),
+                            numEntriesInBlock,
+                            from - blockFirstEntry,
+                            to - blockFirstEntry,
+                            blockFirstEntry
+                        );
+                    }
+                }
+
+                // Returns the range of entries that may contain entries with the given key.
+                [[nodiscard]] std::pair<std::size_t, std::size_t> equalRange(const KeyT& key)
+                {
+                    const auto radixIndex = m_radixIndex.get();
+                    if (radixIndex->has_value())
+                    {
+                        auto [a, b] = (*radixIndex)->equal_range(radixKeyOf(key));
 
-                        const std::size_t count = b.it - a.it;
-                        if (count == 0) continue; // the range is empty, the value certainly does not exist
+                        // Buckets much larger than the ranges of the range index
+                        // are not worth reading whole. They appear when there is
+                        // too few radix bits for the size of the file.
+                        if (b - a <= 4 * m_indexGranularity)
+                        {
+                            return { a, b };
+                        }
+                    }
 
-                        buffer.resize(count);
-                        (void)m_entries.read(buffer.data(), a.it, count);
-                        accumulateStatsFromEntries(buffer, query, key, queries[i].origin, stats[i]);
+                    const auto eytzingerIndex = m_eytzingerIndex.get();
+                    if (eytzingerIndex->has_value())
+                    {
+                        auto [a, b] = (*eytzingerIndex)->equal_range(key);
+                        return { a.it, b.it };
                     }
+
+                    auto [a, b] = m_index.get()->equal_range(key);
+                    return { a.it, b.it };
                 }
 
-                void queryRetractions(
-                    const query::Request& query,
-                    const Position& pos,
-                    RetractionsStats& retractionsStats
+                // Returns indices of the entries with the same key as `key`, ignoring the reverse move.
+                // When possible the candidates are found by a SIMD scan of the hash prefixes.
+                [[nodiscard]] static std::vector<std::size_t> findMatchingEntries(
+                    const std::vector<PersistedEntryType>& entries,
+                    const KeyT& key
                 )
                 {
-                    const auto key = KeyT(PositionWithZobrist(pos));
-                    auto [a, b] = m_index->equal_range(key);
-
-                    const std::size_t count = b.it - a.it;
-                    if (count == 0) return; // the range is empty, the value certainly does not exist
+                    std::vector<std::size_t> matching;
 
-                    std::vector<PersistedEntryType> buffer(count);
-                    (void)m_entries.read(buffer.data(), a.it, count);
-                    accumulateRetractionsStatsFromEntries(buffer, query, pos, key, retractionsStats);
-                }
+                    if constexpr (hasLeadingHashPrefix)
+                    {
+                        std::uint64_t prefix;
+                        std::memcpy(&prefix, &key, sizeof(prefix));
+
+                        findHashPrefixes(
+                            reinterpret_cast<const std::byte*>(entries.data()),
+                            sizeof(PersistedEntryType),
+                            entries.size(),
+                            prefix,
+                            matching
+                        );
 
-            private:
-                ext::ImmutableSpan<PersistedEntryType> m_entries;
-                util::LazyCached<Index> m_index;
-                std::uint32_t m_id;
+                        // The prefix is only a part of the key.
+                        matching.erase(
+                            std::remove_if(matching.begin(), matching.end(), [&](std::size_t idx) {
+                                return !CompareEqualWithoutReverseMove{}(entries[idx], key);
+                            }),
+                            matching.end()
+                        );
+                    }
+                    else
+                    {
+                        for (std::size_t i = 0; i < entries.size(); ++i)
+                        {
+                            if (CompareEqualWithoutReverseMove{}(entries[i], key))
+                            {
+                                matching.emplace_back(i);
+                            }
+                        }
+                    }
 
-                auto makeIndexGetter() const
-                {
-                    return [path = m_entries.path()]() -> Index{
-                        return readIndexOfDataFile(path);
-                    };
+                    return matching;
                 }
 
                 void accumulateStatsFromEntries(
@@ -571,6 +1649,13 @@ namespace persistence
                 {
                     auto filter = makeFilter(query);
 
+                    // Every select only needs the entries of this position.
+                    const auto matching = findMatchingEntries(entries, key);
+                    if (matching.empty())
+                    {
+                        return;
+                    }
+
                     for (auto&& [select, fetch] : query.fetchingOptions)
                     {
                         auto&& statsForThisSelect = stats[select];
@@ -586,13 +1671,14 @@ namespace persistence
                             bool first = true;
                             std::uint32_t nextPos = 0;
 
-                            for (auto&& entry : entries)
+                            for (std::size_t idx : matching)
                             {
+                                const auto& entry = entries[idx];
                                 if (
                                     (
                                         (select == query::Select::Continuations && CompareEqualWithReverseMove{}(entry, key))
-                                        || (select == query::Select::Transpositions && CompareEqualWithoutReverseMove{}(entry, key) && !CompareEqualWithReverseMove{}(entry, key))
-                                        || (select == query::Select::All && CompareEqualWithoutReverseMove{}(entry, key))
+                                        || (select == query::Select::Transpositions && !CompareEqualWithReverseMove{}(entry, key))
+                                        || select == query::Select::All
                                     )
                                     && filter(entry)
                                    )
@@ -630,16 +1716,17 @@ namespace persistence
                         }
                         else
                         {
-                            for (auto&& entry : entries)
+                            for (std::size_t idx : matching)
                             {
+                                const auto& entry = entries[idx];
                                 const GameLevel level = entry.level();
                                 const GameResult result = entry.result();
 
                                 if (
                                     (
                                         (select == query::Select::Continuations && CompareEqualWithReverseMove{}(entry, key))
-                                        || (select == query::Select::Transpositions && CompareEqualWithoutReverseMove{}(entry, key) && !CompareEqualWithReverseMove{}(entry, key))
-                                        || (select == query::Select::All && CompareEqualWithoutReverseMove{}(entry, key))
+                                        || (select == query::Select::Transpositions && !CompareEqualWithReverseMove{}(entry, key))
+                                        || select == query::Select::All
                                     )
                                     && filter(entry)
                                    )
@@ -669,12 +1756,10 @@ namespace persistence
                             bool first = true;
                             std::uint32_t nextPos = 0;
 
-                            for (auto&& entry : entries)
+                            for (std::size_t idx : findMatchingEntries(entries, key))
                             {
-                                if (
-                                    !CompareEqualWithoutReverseMove{}(entry, key)
-                                    || !filter(entry)
-                                    )
+                                const auto& entry = entries[idx];
+                                if (!filter(entry))
                                 {
                                     continue;
                                 }
@@ -719,12 +1804,10 @@ namespace persistence
                         }
                         else
                         {
-                            for (auto&& entry : entries)
+                            for (std::size_t idx : findMatchingEntries(entries, key))
                             {
-                                if (
-                                    !CompareEqualWithoutReverseMove{}(entry, key)
-                                    || !filter(entry)
-                                    )
+                                const auto& entry = entries[idx];
+                                if (!filter(entry))
                                 {
                                     continue;
                                 }
@@ -747,7 +1830,7 @@ namespace persistence
 
             struct FutureFile
             {
-                FutureFile(std::future<Index>&& future, std::filesystem::path path) :
+                FutureFile(std::future<void>&& future, std::filesystem::path path) :
                     m_future(std::move(future)),
                     m_path(std::move(path)),
                     m_id(dataFilePathToId(m_path))
@@ -766,12 +1849,13 @@ namespace persistence
 
                 [[nodiscard]] File get() &&
                 {
-                    Index index = m_future.get();
-                    return { m_path, std::move(index) };
+                    // Wait until both the data and the index are written.
+                    m_future.get();
+                    return { m_path };
                 }
 
             private:
-                std::future<Index> m_future;
+                std::future<void> m_future;
                 std::filesystem::path m_path;
                 std::uint32_t m_id;
             };
@@ -781,7 +1865,7 @@ namespace persistence
             private:
                 struct Job
                 {
-                    Job(std::filesystem::path path, std::vector<PersistedEntryType>&& buffer, std::promise<Index>&& promise) :
+                    Job(std::filesystem::path path, std::vector<PersistedEntryType>&& buffer, std::promise<void>&& promise) :
                         path(std::move(path)),
                         buffer(std::move(buffer)),
                         promise(std::move(promise))
@@ -790,7 +1874,9 @@ namespace persistence
 
                     std::filesystem::path path;
                     std::vector<PersistedEntryType> buffer;
-                    std::promise<Index> promise;
+                    std::promise<void> promise;
+                    // Empty when game lists are disabled.
+                    GameLists gameLists;
                 };
 
             public:
@@ -821,12 +1907,12 @@ namespace persistence
                     waitForCompletion();
                 }
 
-                [[nodiscard]] std::future<Index> scheduleUnordered(const std::filesystem::path& path, std::vector<PersistedEntryType>&& elements)
+                [[nodiscard]] std::future<void> scheduleUnordered(const std::filesystem::path& path, std::vector<PersistedEntryType>&& elements)
                 {
                     std::unique_lock<std::mutex> lock(m_mutex);
 
-                    std::promise<Index> promise;
-                    std::future<Index> future = promise.get_future();
+                    std::promise<void> promise;
+                    std::future<void> future = promise.get_future();
                     m_sortQueue.emplace(path, std::move(elements), std::move(promise));
 
                     lock.unlock();
@@ -849,6 +1935,18 @@ namespace persistence
                     return buffer;
                 }
 
+                // Gives back a buffer that was taken but ended up not being stored.
+                void returnEmptyBuffer(std::vector<PersistedEntryType>&& buffer)
+                {
+                    buffer.clear();
+
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_bufferQueue.emplace(std::move(buffer));
+                    lock.unlock();
+
+                    m_bufferQueueNotEmpty.notify_one();
+                }
+
                 void waitForCompletion()
                 {
                     if (!m_sortingThreadFinished.load())
@@ -902,7 +2000,7 @@ namespace persistence
 
                         lock.unlock();
 
-                        prepareData(job.buffer);
+                        prepareData(job);
 
                         lock.lock();
                         m_writeQueue.emplace(std::move(job));
@@ -935,9 +2033,27 @@ namespace persistence
                             return entry.key();
                             });
                         writeIndexOfDataFile(job.path, index);
-                        job.promise.set_value(std::move(index));
 
-                        (void)ext::writeFile(job.path, job.buffer.data(), job.buffer.size());
+                        if (m_indexRadixBits != 0)
+                        {
+                            auto radixIndex = ext::makeRadixIndex(job.buffer.begin(), job.buffer.end(), m_indexRadixBits, [](const PersistedEntryType& entry) {
+                                return radixKeyOf(entry.key());
+                                });
+                            writeRadixIndexOfDataFile(job.path, radixIndex);
+                        }
+
+                        if (!job.gameLists.empty())
+                        {
+                            GameListWriter gameListWriter(job.path);
+                            gameListWriter.append(job.gameLists);
+                            gameListWriter.finish();
+                            job.gameLists = GameLists{};
+                        }
+
+                        writeDataFile(job.path, job.buffer);
+
+                        // The file is opened only after this so it has to be complete.
+                        job.promise.set_value();
 
                         job.buffer.clear();
 
@@ -1025,10 +2141,20 @@ namespace persistence
                     }
                 }
 
-                void prepareData(std::vector<PersistedEntryType>& buffer)
+                void prepareData(Job& job)
                 {
-                    sort(buffer);
-                    combine(buffer);
+                    sort(job.buffer);
+
+                    // The games are known only before the entries are combined.
+                    if constexpr (hasGameLists)
+                    {
+                        if (m_gameListsEnabled)
+                        {
+                            gatherGameLists(job.buffer, job.gameLists);
+                        }
+                    }
+
+                    combine(job.buffer);
                 }
             };
 
@@ -1051,27 +2177,27 @@ namespace persistence
                     const query::Request& query,
                     const std::vector<KeyT>& keys,
                     const query::PositionQueries& queries,
-                    std::vector<PositionStats>& stats)
+                    std::vector<PositionStats>& stats,
+                    std::vector<RetractionsStats>& retractionsStats)
                 {
                     for (auto&& file : m_files)
                     {
-                        file->executeQuery(query, keys, queries, stats);
+                        file->executeQuery(query, keys, queries, stats, retractionsStats);
                     }
                 }
 
-                [[nodiscard]] RetractionsStats queryRetractions(
-                    const query::Request& query,
-                    const Position& pos
-                )
+                // See File::gatherGameLists. Returns false if some file has no game lists.
+                [[nodiscard]] bool gatherGameLists(const KeyT& key, bool withReverseMove, EnumArray<GameLevel, std::vector<std::uint64_t>>& games) const
                 {
-                    RetractionsStats retractionsStats;
-
                     for (auto&& file : m_files)
                     {
-                        file->queryRetractions(query, pos, retractionsStats);
+                        if (!file->gatherGameLists(key, withReverseMove, games))
+                        {
+                            return false;
+                        }
                     }
 
-                    return retractionsStats;
+                    return true;
                 }
 
                 void mergeAll(
@@ -1162,6 +2288,14 @@ namespace persistence
 
                         auto indexPath = dataFilePathToIndexPath(path);
                         std::filesystem::remove(indexPath);
+
+                        auto radixIndexPath = dataFilePathToRadixIndexPath(path);
+                        std::filesystem::remove(radixIndexPath);
+
+                        auto blockIndexPath = dataFilePathToBlockIndexPath(path);
+                        std::filesystem::remove(blockIndexPath);
+
+                        removeGameListsOfDataFile(path);
                     }
                 }
 
@@ -1194,7 +2328,7 @@ namespace persistence
                 }
 
                 [[nodiscard]] ext::MergePlan makeMergePlan(
-                    const std::vector<ext::ImmutableSpan<PersistedEntryType>>& files,
+                    std::size_t numFiles,
                     const std::filesystem::path& outFilePath,
                     const std::vector<std::filesystem::path>& temporaryDirs
                 ) const
@@ -1203,11 +2337,11 @@ namespace persistence
 
                     if (temporaryDirs.size() == 0)
                     {
-                        return ext::make_merge_plan(files, outDir, outDir);
+                        return ext::make_merge_plan(numFiles, outDir, outDir);
                     }
                     else if (temporaryDirs.size() == 1)
                     {
-                        ext::MergePlan plan = ext::make_merge_plan(files, outDir, temporaryDirs[0]);
+                        ext::MergePlan plan = ext::make_merge_plan(numFiles, outDir, temporaryDirs[0]);
                         if (plan.numPasses() == 0)
                         {
                             return plan;
@@ -1222,11 +2356,11 @@ namespace persistence
                     }
                     else
                     {
-                        return ext::make_merge_plan(files, temporaryDirs[0], temporaryDirs[1]);
+                        return ext::make_merge_plan(numFiles, temporaryDirs[0], temporaryDirs[1]);
                     }
                 }
 
-                [[nodiscard]] Index mergeFilesIntoFile(
+                void mergeFilesIntoFile(
                     const std::vector<File*>& files,
                     const std::filesystem::path& outFilePath,
                     const std::vector<std::filesystem::path>& temporaryDirs,
@@ -1236,25 +2370,48 @@ namespace persistence
                 {
                     ASSERT(files.size() >= 2);
 
+                    // The merge of the entries doesn't tell which file an entry comes from
+                    // so the game lists are merged separately, before the files are removed.
+                    mergeGameListsIntoFile(files, outFilePath);
+
                     auto extractKey = [](const PersistedEntryType& entry) {
                         return entry.key();
                     };
                     ext::IndexBuilder<PersistedEntryType, CompareLessWithoutReverseMove, decltype(extractKey)> ib(m_indexGranularity, {}, extractKey);
+                    ext::RadixIndexBuilder rib(m_indexRadixBits);
+                    auto appendToIndex = [&ib, &rib](const PersistedEntryType& entry) {
+                        ib.append(&entry, 1);
+                        rib.append(radixKeyOf(entry.key()));
+                    };
                     {
+                        // Compressed files cannot be merged directly, they are
+                        // always expanded to temporary files first.
                         std::vector<ext::ImmutableSpan<PersistedEntryType>> spans;
                         spans.reserve(files.size());
+                        std::size_t totalFileSize = 0;
                         for (auto&& file : files)
                         {
-                            spans.emplace_back(file->entries());
+                            if constexpr (!hasCompressedBlocks)
+                            {
+                                spans.emplace_back(file->entries());
+                            }
+                            totalFileSize += file->numEntryBytes();
                         }
 
-                        const std::size_t totalFileSize = ext::bytesInSpans(spans);
-
                         ext::BinaryOutputFile outFile(outFilePath);
 
                         {
-                            const std::size_t outBufferSize = ext::numObjectsPerBufferUnit<PersistedEntryType>(m_mergeWriterBufferSize.bytes(), 2);
-                            ext::BackInserter<PersistedEntryType> out(outFile, util::DoubleBuffer<PersistedEntryType>(outBufferSize));
+                            auto out = [&outFile]() {
+                                if constexpr (hasCompressedBlocks)
+                                {
+                                    return CompressedBlockWriter(outFile);
+                                }
+                                else
+                                {
+                                    const std::size_t outBufferSize = ext::numObjectsPerBufferUnit<PersistedEntryType>(m_mergeWriterBufferSize.bytes(), 2);
+                                    return ext::BackInserter<PersistedEntryType>(outFile, util::DoubleBuffer<PersistedEntryType>(outBufferSize));
+                                }
+                            }();
 
                             bool first = true;
                             auto accumulator = []() {
@@ -1265,7 +2422,7 @@ namespace persistence
                                 if constexpr (hasSmearedEntry)
                                 {
                                     return[
-                                        &ib,
+                                        &appendToIndex,
                                         &out,
                                         &accumulator,
                                         &first,
@@ -1286,7 +2443,7 @@ namespace persistence
                                                 for (auto e : accumulator)
                                                 {
                                                     out.emplace(e);
-                                                    ib.append(&e, 1);
+                                                    appendToIndex(e);
                                                 }
                                             }
                                             accumulator = EntryType(nextSmeared);
@@ -1304,7 +2461,7 @@ namespace persistence
                                 else
                                 {
                                     return [
-                                        &ib,
+                                        &appendToIndex,
                                         &out, 
                                         &accumulator,
                                         &first,
@@ -1322,17 +2479,17 @@ namespace persistence
                                         else
                                         {
                                             out.emplace(accumulator);
-                                            ib.append(&accumulator, 1);
+                                            appendToIndex(accumulator);
                                             accumulator = entry;
                                         }
                                     };
                                 }
                             }();
 
-                            const ext::MergePlan plan = makeMergePlan(spans, outFilePath, temporaryDirs);
+                            const ext::MergePlan plan = makeMergePlan(files.size(), outFilePath, temporaryDirs);
                             // Now we have two options.
                             // Either we have to copy the files or not.
-                            const bool requiresCopyFirst = plan.passes[0].readDir != outFilePath.parent_path();
+                            const bool requiresCopyFirst = hasCompressedBlocks || plan.passes[0].readDir != outFilePath.parent_path();
                             if (requiresCopyFirst)
                             {
                                 // We have to include the copying progress.
@@ -1343,11 +2500,21 @@ namespace persistence
                                 copiedFilesPaths.reserve(files.size());
                                 for (auto&& file : files)
                                 {
-                                    const std::size_t size = file->entries().size_bytes();
+                                    const std::size_t size = file->numEntryBytes();
 
-                                    std::filesystem::path destinationPath = copyDestinationDir / file->path().filename();
-                                    std::filesystem::copy_file(file->path(), destinationPath);
-                                    copiedFilesPaths.emplace_back(std::move(destinationPath));
+                                    if constexpr (hasCompressedBlocks)
+                                    {
+                                        // The prefix prevents name clashes when copying to the same directory.
+                                        std::filesystem::path destinationPath = copyDestinationDir / ("expanded_" + file->name());
+                                        file->expandInto(destinationPath);
+                                        copiedFilesPaths.emplace_back(std::move(destinationPath));
+                                    }
+                                    else
+                                    {
+                                        std::filesystem::path destinationPath = copyDestinationDir / file->path().filename();
+                                        std::filesystem::copy_file(file->path(), destinationPath);
+                                        copiedFilesPaths.emplace_back(std::move(destinationPath));
+                                    }
 
                                     internalProgress.workDone += size;
                                     progressCallback(internalProgress);
@@ -1367,7 +2534,11 @@ namespace persistence
 
                                 // preallocate space for the resulting file
                                 // it's guaranteed that we haven't written anything to the output yet
-                                outFile.reserve(totalFileSize);
+                                // compressed size is not known up front
+                                if constexpr (!hasCompressedBlocks)
+                                {
+                                    outFile.reserve(totalFileSize);
+                                }
 
                                 auto internalProgressCallback = [&progressCallback, &internalProgress, totalFileSize](const ext::Progress& progress)
                                 {
@@ -1439,22 +2610,60 @@ namespace persistence
                                     for (auto e : accumulator)
                                     {
                                         out.emplace(e);
-                                        ib.append(&e, 1);
+                                        appendToIndex(e);
                                     }
                                 }
                                 else
                                 {
                                     out.emplace(accumulator);
-                                    ib.append(&accumulator, 1);
+                                    appendToIndex(accumulator);
                                 }
                             }
+
+                            if constexpr (hasCompressedBlocks)
+                            {
+                                writeBlockIndexOfDataFile(outFilePath, out.finish());
+                            }
                         }
                     }
 
-                    Index index = ib.end();
-                    writeIndexOfDataFile(outFilePath, index);
+                    writeIndexOfDataFile(outFilePath, ib.end());
+
+                    if (m_indexRadixBits != 0)
+                    {
+                        writeRadixIndexOfDataFile(outFilePath, rib.end());
+                    }
+                }
+
+                // The merged file gets game lists only if all the files have them.
+                // The lists of equal keys are united.
+                void mergeGameListsIntoFile(const std::vector<File*>& files, const std::filesystem::path& outFilePath)
+                {
+                    if constexpr (hasGameLists)
+                    {
+                        if (!m_gameListsEnabled)
+                        {
+                            return;
+                        }
+
+                        for (auto&& file : files)
+                        {
+                            if (!hasGameListsOfDataFile(file->path()))
+                            {
+                                Logger::instance().logInfo(": File ", file->name(), " has no game lists. The merged file won't have them.");
+                                return;
+                            }
+                        }
+
+                        std::vector<std::filesystem::path> paths;
+                        paths.reserve(files.size());
+                        for (auto&& file : files)
+                        {
+                            paths.emplace_back(file->path());
+                        }
 
-                    return index;
+                        mergeGameListsOfDataFiles(paths, outFilePath);
+                    }
                 }
 
                 void mergeFiles(
@@ -1467,7 +2676,7 @@ namespace persistence
                     auto groups = ext::groupConsecutiveSpans(
                         files,
                         temporarySpace,
-                        [](File* file) { return file->entries().size_bytes(); }
+                        [](File* file) { return file->numEntryBytes(); }
                     );
 
                     // assess total work
@@ -1480,13 +2689,13 @@ namespace persistence
                         }
                         else
                         {
-                            std::vector<ext::ImmutableSpan<PersistedEntryType>> spans;
-                            spans.reserve(filesInGroup.size());
+                            std::vector<std::size_t> sizes;
+                            sizes.reserve(filesInGroup.size());
                             for (auto&& file : filesInGroup)
                             {
-                                spans.emplace_back(file->entries());
+                                sizes.emplace_back(file->numEntries());
                             }
-                            totalWork += ext::merge_assess_work(spans);
+                            totalWork += ext::merge_assess_work(sizes);
                         }
                     }
 
@@ -1532,7 +2741,7 @@ namespace persistence
 
                     const auto outFilePath = m_path / "merge_tmp";
                     const std::uint32_t id = files.front()->id();
-                    auto index = mergeFilesIntoFile(files, outFilePath, temporaryDirs, progressCallback, true);
+                    mergeFilesIntoFile(files, outFilePath, temporaryDirs, progressCallback, true);
 
                     // We had to use a temporary name because we're working in the same directory.
                     // Now we can safely rename after old ones are removed.
@@ -1540,8 +2749,17 @@ namespace persistence
                     newFilePath.replace_filename(std::to_string(id));
                     std::filesystem::rename(outFilePath, newFilePath);
                     std::filesystem::rename(dataFilePathToIndexPath(outFilePath), dataFilePathToIndexPath(newFilePath));
+                    if (std::filesystem::exists(dataFilePathToRadixIndexPath(outFilePath)))
+                    {
+                        std::filesystem::rename(dataFilePathToRadixIndexPath(outFilePath), dataFilePathToRadixIndexPath(newFilePath));
+                    }
+                    if constexpr (hasCompressedBlocks)
+                    {
+                        std::filesystem::rename(dataFilePathToBlockIndexPath(outFilePath), dataFilePathToBlockIndexPath(newFilePath));
+                    }
+                    renameGameListsOfDataFile(outFilePath, newFilePath);
 
-                    addFile(std::make_unique<File>(newFilePath, std::move(index)));
+                    addFile(std::make_unique<File>(newFilePath));
                 }
 
                 void removeFiles(
@@ -1561,11 +2779,16 @@ namespace persistence
 
                         auto path = (*it)->path();
                         auto indexPath = dataFilePathToIndexPath(path);
+                        auto radixIndexPath = dataFilePathToRadixIndexPath(path);
+                        auto blockIndexPath = dataFilePathToBlockIndexPath(path);
 
                         m_files.erase(it);
 
                         std::filesystem::remove(path);
                         std::filesystem::remove(indexPath);
+                        std::filesystem::remove(radixIndexPath);
+                        std::filesystem::remove(blockIndexPath);
+                        removeGameListsOfDataFile(path);
                     }
 
                     m_lastId = 0;
@@ -1668,6 +2891,8 @@ namespace persistence
 
             static inline const std::filesystem::path partitionDirectory = "data";
 
+            static inline const std::filesystem::path materialIndexFilename = "material_index";
+
             static inline const DatabaseManifestModel m_manifest = { name, TraitsT::version, true };
 
             static constexpr std::size_t m_totalNumDirectories = 1;
@@ -1681,13 +2906,21 @@ namespace persistence
             static inline const MemoryAmount m_headerBufferMemory = cfg::g_config["persistence"][name]["header_buffer_memory"].get<MemoryAmount>();
             static inline const MemoryAmount m_pgnParserMemory = cfg::g_config["persistence"][name]["pgn_parser_memory"].get<MemoryAmount>();
             static inline const MemoryAmount m_bcgnParserMemory = cfg::g_config["persistence"][name]["bcgn_parser_memory"].get<MemoryAmount>();
+            static inline const bool m_memoryMappedImport = cfg::g_config["persistence"]["memory_mapped_import"].get<bool>();
+
+            // Decoded in one pass for each imported PGN game.
+            static constexpr pgn::TagSet m_importedPgnTags =
+                hasGameHeaders
+                ? pgn::TagSet::Positions | pgn::TagSet::Header
+                : pgn::TagSet::Positions;
 
         public:
             OrderedEntrySetPositionDatabase(std::filesystem::path path) :
                 BaseType(path, m_manifest, supportManifest()),
                 m_path(path),
                 m_headers(makeHeaders(path, m_headerBufferMemory)),
-                m_partition(path / partitionDirectory)
+                m_partition(path / partitionDirectory),
+                m_materialIndex(makeMaterialIndex(path))
             {
             }
 
@@ -1728,97 +2961,320 @@ namespace persistence
                     manifest.maxElo = TraitsT::maxElo;
                     manifest.hasCountWithElo = TraitsT::hasCountWithElo;
 
-                    manifest.hasFirstGame = TraitsT::hasFirstGame;
-                    manifest.hasLastGame = TraitsT::hasLastGame;
+                    manifest.hasFirstGame = TraitsT::hasFirstGame;
+                    manifest.hasLastGame = TraitsT::hasLastGame;
+
+                    manifest.allowsFilteringTranspositions = TraitsT::allowsFilteringTranspositions;
+                    manifest.hasReverseMove = TraitsT::hasReverseMove;
+
+                    manifest.allowsFilteringByEloRange = TraitsT::allowsFilteringByEloRange;
+                    manifest.eloFilterGranularity = TraitsT::eloFilterGranularity;
+
+                    manifest.allowsFilteringByMonthRange = TraitsT::allowsFilteringByMonthRange;
+                    manifest.monthFilterGranularity = TraitsT::monthFilterGranularity;
+
+                    manifest.maxBytesPerPosition = TraitsT::maxBytesPerPosition;
+                    manifest.estimatedAverageBytesPerPosition = TraitsT::estimatedAverageBytesPerPosition;
+
+                    manifest.minimumSupportedVersion = TraitsT::minimumSupportedVersion;
+
+                    return manifest;
+                }();
+
+                return manifest;
+            }
+
+            [[nodiscard]] const DatabaseManifestModel& manifestModel() const override
+            {
+                return m_manifest;
+            }
+
+            void clear() override
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                if constexpr (hasGameHeaders)
+                {
+                    for (auto& header : m_headers)
+                    {
+                        header->clear();
+                    }
+                }
+                m_partition.clear();
+
+                // The database is empty now so the index can be used again.
+                if (isMaterialIndexEnabled())
+                {
+                    if (!m_materialIndex.has_value())
+                    {
+                        m_materialIndex.emplace(m_path / materialIndexFilename);
+                    }
+                    m_materialIndex->clear();
+                }
+                else
+                {
+                    m_materialIndex.reset();
+                    std::filesystem::remove(m_path / materialIndexFilename);
+                }
+            }
+
+            const std::filesystem::path& path() const override
+            {
+                return m_path;
+            }
+
+            [[nodiscard]] query::Response executeQuery(query::Request query) override
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                disableUnsupportedQueryFeatures(query);
+
+                query::PositionQueries posQueries = query::gatherPositionQueries(query);
+                auto keys = getKeys(posQueries);
+                std::vector<PositionStats> stats(posQueries.size());
+
+                auto cmp = KeyCompareLessWithReverseMove{};
+                auto unsort = reversibleZipSort(keys, posQueries, cmp);
+
+                // Retractions of each root are collected in the same pass, from the same entries.
+                std::vector<RetractionsStats> retractionsStats;
+                if constexpr (hasReverseMove)
+                {
+                    if (query.retractionsFetchingOptions.has_value())
+                    {
+                        retractionsStats.resize(query.positions.size());
+                    }
+                }
+
+                m_partition.executeQuery(query, keys, posQueries, stats, retractionsStats);
+
+                auto results = segregatePositionStats(query, posQueries, stats);
+
+                // We have to either unsort both results and posQueries, or none.
+                // unflatten only needs relative order of results and posQueries to match
+                // So we don't unsort any.
+                auto unflattened = query::unflatten(std::move(results), query, posQueries);
+
+                if constexpr (hasReverseMove)
+                {
+                    if (query.retractionsFetchingOptions.has_value())
+                    {
+                        ASSERT(retractionsStats.size() == unflattened.size());
+
+                        for (std::size_t i = 0; i < unflattened.size(); ++i)
+                        {
+                            auto segregated = segregateRetractionsStats(
+                                query,
+                                std::move(retractionsStats[i])
+                            );
+
+                            unflattened[i].retractionsResults.retractions = std::move(segregated);
+                        }
+                    }
+                }
+
+                if (query.expansion.has_value())
+                {
+                    expandTree(query, unflattened);
+                }
+
+                return { std::move(query), std::move(unflattened) };
+            }
+
+            [[nodiscard]] query::GamesByNameResponse queryGamesByName(const query::GamesByNameRequest& query) override
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                query::GamesByNameResponse response{ query };
+
+                if constexpr (hasGameHeaders)
+                {
+                    // The offset and limit apply to games of all levels together.
+                    std::size_t offset = query.offset;
+                    std::size_t limit = query.limit;
+                    for (GameLevel level : query.levels)
+                    {
+                        const std::size_t numGames = m_headers[level]->countGamesByName(query.field, query.name);
+                        response.numGames += numGames;
+
+                        if (offset >= numGames)
+                        {
+                            offset -= numGames;
+                            continue;
+                        }
+
+                        for (auto&& header : m_headers[level]->queryByName(query.field, query.name, offset, limit))
+                        {
+                            response.games.emplace_back(level, header);
+                        }
+
+                        limit -= std::min(limit, numGames - offset);
+                        offset = 0;
+                    }
+                }
+                else
+                {
+                    throw std::runtime_error("The database doesn't store game headers.");
+                }
+
+                return response;
+            }
+
+            [[nodiscard]] query::GamesByPositionResponse queryGamesByPosition(const query::GamesByPositionRequest& query) override
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+
+                query::GamesByPositionResponse response{ query };
+
+                if constexpr (hasGameLists)
+                {
+                    if (!m_gameListsEnabled)
+                    {
+                        throw std::runtime_error("Game lists are not enabled.");
+                    }
+
+                    const auto positionOpt = query.position.tryGetWithHistory();
+                    if (!positionOpt.has_value())
+                    {
+                        throw std::runtime_error("Invalid position.");
+                    }
+
+                    const auto& [position, reverseMove] = *positionOpt;
+                    const KeyT key(PositionWithZobrist(position), reverseMove);
+                    const bool withReverseMove = hasReverseMove && query.position.move.has_value();
 
-                    manifest.allowsFilteringTranspositions = TraitsT::allowsFilteringTranspositions;
-                    manifest.hasReverseMove = TraitsT::hasReverseMove;
+                    EnumArray<GameLevel, std::vector<std::uint64_t>> games;
+                    if (!m_partition.gatherGameLists(key, withReverseMove, games))
+                    {
+                        throw std::runtime_error("Some files of the database don't have game lists.");
+                    }
 
-                    manifest.allowsFilteringByEloRange = TraitsT::allowsFilteringByEloRange;
-                    manifest.eloFilterGranularity = TraitsT::eloFilterGranularity;
+                    // The offset and limit apply to games of all levels together.
+                    std::size_t offset = query.offset;
+                    std::size_t limit = query.limit;
+                    for (GameLevel level : query.levels)
+                    {
+                        // A game can be in more than one file if it was split on import.
+                        auto& gamesOfLevel = games[level];
+                        normalizeGameList(gamesOfLevel);
 
-                    manifest.allowsFilteringByMonthRange = TraitsT::allowsFilteringByMonthRange;
-                    manifest.monthFilterGranularity = TraitsT::monthFilterGranularity;
+                        const std::size_t numGames = gamesOfLevel.size();
+                        response.numGames += numGames;
 
-                    manifest.maxBytesPerPosition = TraitsT::maxBytesPerPosition;
-                    manifest.estimatedAverageBytesPerPosition = TraitsT::estimatedAverageBytesPerPosition;
+                        if (offset >= numGames)
+                        {
+                            offset -= numGames;
+                            continue;
+                        }
 
-                    manifest.minimumSupportedVersion = TraitsT::minimumSupportedVersion;
+                        const std::size_t count = std::min(limit, numGames - offset);
+                        const std::vector<std::uint64_t> page(gamesOfLevel.begin() + offset, gamesOfLevel.begin() + (offset + count));
+                        const auto headers = [&]() {
+                            if constexpr (usesGameIndex)
+                            {
+                                return queryHeadersByIndices(page, level);
+                            }
+                            else
+                            {
+                                return queryHeadersByOffsets(page, level);
+                            }
+                        }();
 
-                    return manifest;
-                }();
+                        for (auto&& header : headers)
+                        {
+                            response.games.emplace_back(level, header);
+                        }
 
-                return manifest;
-            }
+                        limit -= count;
+                        offset = 0;
+                    }
+                }
+                else
+                {
+                    throw std::runtime_error("The database doesn't store game lists.");
+                }
 
-            [[nodiscard]] const DatabaseManifestModel& manifestModel() const override
-            {
-                return m_manifest;
+                return response;
             }
 
-            void clear() override
+            [[nodiscard]] query::MaterialStatsResponse queryMaterialStats(const query::MaterialStatsRequest& query) override
             {
                 std::unique_lock<std::mutex> lock(m_mutex);
 
-                if constexpr (hasGameHeaders)
+                if (!m_materialIndex.has_value())
                 {
-                    for (auto& header : m_headers)
-                    {
-                        header->clear();
-                    }
+                    throw std::runtime_error("The database has no material index.");
                 }
-                m_partition.clear();
-            }
 
-            const std::filesystem::path& path() const override
-            {
-                return m_path;
+                const auto signatureOpt = MaterialSignature::fromString(query.material);
+                if (!signatureOpt.has_value())
+                {
+                    throw std::runtime_error("Invalid material.");
+                }
+
+                return { query, *signatureOpt, m_materialIndex->stats(*signatureOpt) };
             }
 
-            [[nodiscard]] query::Response executeQuery(query::Request query) override
+            [[nodiscard]] query::NoveltyResponse queryNovelty(const query::NoveltyRequest& query) override
             {
                 std::unique_lock<std::mutex> lock(m_mutex);
 
-                disableUnsupportedQueryFeatures(query);
+                // The moves are parsed once and used for the lookup and the response.
+                const auto startPositionOpt = query.tryGetStartPosition();
+                const auto movesOpt = query.tryGetMoves();
+                if (!startPositionOpt.has_value() || !movesOpt.has_value() || movesOpt->size() > query::NoveltyRequest::maxPlies)
+                {
+                    throw std::runtime_error("Invalid game in query");
+                }
 
-                query::PositionQueries posQueries = query::gatherPositionQueries(query);
+                query::Request positionQuery = query.positionRequest();
+                disableUnsupportedQueryFeatures(positionQuery);
+
+                query::PositionQueries posQueries = query::gatherPositionQueries(*startPositionOpt, *movesOpt);
                 auto keys = getKeys(posQueries);
                 std::vector<PositionStats> stats(posQueries.size());
 
+                // All positions of the game are looked up in one sorted pass.
                 auto cmp = KeyCompareLessWithReverseMove{};
                 auto unsort = reversibleZipSort(keys, posQueries, cmp);
 
-                m_partition.executeQuery(query, keys, posQueries, stats);
+                std::vector<RetractionsStats> retractionsStats;
+                m_partition.executeQuery(positionQuery, keys, posQueries, stats, retractionsStats);
 
-                auto results = segregatePositionStats(query, posQueries, stats);
+                auto segregated = segregatePositionStats(positionQuery, posQueries, stats);
 
-                // We have to either unsort both results and posQueries, or none.
-                // unflatten only needs relative order of results and posQueries to match
-                // So we don't unsort any.
-                auto unflattened = query::unflatten(std::move(results), query, posQueries);
+                query::NoveltyResponse response{ query };
 
-                if constexpr (hasReverseMove)
+                // rootId is the ply.
+                response.plies.resize(posQueries.size());
+                for (std::size_t i = 0; i < posQueries.size(); ++i)
                 {
-                    if (query.retractionsFetchingOptions.has_value())
-                    {
-                        for (auto&& resultForRoot : unflattened)
-                        {
-                            auto queried = m_partition.queryRetractions(
-                                query,
-                                *resultForRoot.position.tryGet()
-                            );
+                    response.plies[posQueries[i].rootId] = std::move(segregated[i][query.select]);
+                }
 
-                            auto segregated = segregateRetractionsStats(
-                                query,
-                                std::move(queried)
-                            );
+                for (std::size_t ply = 0; ply < response.plies.size(); ++ply)
+                {
+                    std::size_t count = 0;
+                    for (auto&& [origin, entry] : response.plies[ply])
+                    {
+                        count += entry.count;
+                    }
 
-                            resultForRoot.retractionsResults.retractions = std::move(segregated);
-                        }
+                    if (count == 0)
+                    {
+                        response.noveltyPly = ply;
+                        break;
                     }
                 }
 
-                return { std::move(query), std::move(unflattened) };
+                auto position = *startPositionOpt;
+                for (auto&& move : *movesOpt)
+                {
+                    response.moves.emplace_back(san::moveToSan<san::SanSpec::Capture | san::SanSpec::Check | san::SanSpec::Compact>(position, move));
+                    position.doMove(move);
+                }
+
+                return response;
             }
 
             void mergeAll(
@@ -1908,7 +3364,13 @@ namespace persistence
                     totalSize += std::filesystem::file_size(file.path());
                 }
 
-                const std::size_t numBuffers = 1;
+                // Each thread importing a BCGN file in parallel fills its own buffer.
+                const bool hasBcgnFiles = std::any_of(files.begin(), files.end(), [](auto&& file) {
+                    return file.type() == ImportableFileType::Bcgn;
+                });
+                const std::size_t numImportThreads = hasBcgnFiles ? numBcgnImportThreads() : 1;
+
+                const std::size_t numBuffers = numImportThreads;
 
                 const std::size_t numAdditionalBuffers = 1 + numSortingThreads;
 
@@ -1923,10 +3385,13 @@ namespace persistence
                     numSortingThreads
                 );
 
+                const auto t0 = std::chrono::high_resolution_clock::now();
+
                 Logger::instance().logInfo(": Importing files...");
                 ImportStats stats = importImpl(
                     pipeline,
                     files,
+                    numImportThreads,
                     [&progressCallback, &totalSize, &totalSizeProcessed](auto&& file) {
                         totalSizeProcessed += std::filesystem::file_size(file);
                         Logger::instance().logInfo(
@@ -1955,8 +3420,16 @@ namespace persistence
 
                 Logger::instance().logInfo(": Completed.");
 
+                const auto t1 = std::chrono::high_resolution_clock::now();
+                stats.setElapsedSeconds(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count() / 1e9);
+
                 const auto total = stats.total();
                 Logger::instance().logInfo(": Imported ", total.numGames, " games with ", total.numPositions, " positions. Skipped ", total.numSkippedGames, " games.");
+                Logger::instance().logInfo(": ", static_cast<std::size_t>(stats.positionsPerSecond()), " positions/s.");
+                if (total.numCachedPositions > 0)
+                {
+                    Logger::instance().logInfo(": Opening trie hit rate ", static_cast<int>(stats.openingTrieHitRate() * 100.0), "%.");
+                }
 
                 BaseType::addStats(stats);
 
@@ -1983,6 +3456,11 @@ namespace persistence
                         header->flush();
                     }
                 }
+
+                if (m_materialIndex.has_value())
+                {
+                    m_materialIndex->flush();
+                }
             }
 
 
@@ -1995,7 +3473,15 @@ namespace persistence
             // We only have one partition for this format
             Partition m_partition;
 
+            // Empty if disabled in the config or if the database
+            // already had games when the index was enabled.
+            std::optional<MaterialIndex> m_materialIndex;
+
             std::mutex m_mutex;
+
+            // Serializes the files added to the partition by parallel imports.
+            std::mutex m_storeMutex;
+
             [[nodiscard]] EnumArray<GameLevel, std::unique_ptr<IndexedGameHeaderStorageType>> makeHeaders(const std::filesystem::path& path, MemoryAmount headerBufferMemory)
             {
                 if constexpr (hasGameHeaders)
@@ -2012,6 +3498,48 @@ namespace persistence
                 }
             }
 
+            [[nodiscard]] static bool isMaterialIndexEnabled()
+            {
+                return cfg::g_config["persistence"]["material_index"].get<bool>();
+            }
+
+            // When disabled the trie has no memory and only decodes the moves.
+            [[nodiscard]] static pgn::OpeningTrie makeOpeningTrie()
+            {
+                const auto& config = cfg::g_config["persistence"];
+                const bool isEnabled = config["opening_trie"].get<bool>();
+                return pgn::OpeningTrie(
+                    isEnabled ? config["opening_trie_memory"].get<MemoryAmount>().bytes() : 0,
+                    config["opening_trie_max_plies"].get<std::size_t>()
+                );
+            }
+
+            [[nodiscard]] static std::size_t numBcgnImportThreads()
+            {
+                const auto numThreads = cfg::g_config["persistence"]["bcgn_import_threads"].get<std::size_t>();
+                return numThreads != 0 ? numThreads : std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+            }
+
+            [[nodiscard]] std::optional<MaterialIndex> makeMaterialIndex(const std::filesystem::path& path) const
+            {
+                const auto indexPath = path / materialIndexFilename;
+
+                // Games imported from now on would be missing from an existing index.
+                if (!isMaterialIndexEnabled())
+                {
+                    std::filesystem::remove(indexPath);
+                    return std::nullopt;
+                }
+
+                // The games already in the database can't be added to the index.
+                if (!std::filesystem::exists(indexPath) && BaseType::stats().total().numGames != 0)
+                {
+                    return std::nullopt;
+                }
+
+                return MaterialIndex(indexPath);
+            }
+
             void collectFutureFiles()
             {
                 m_partition.collectFutureFiles();
@@ -2146,6 +3674,39 @@ namespace persistence
                 }
             }
 
+            // Fetches the children of the expanded nodes depth by depth.
+            // The children of all nodes of one depth are sorted and looked up in one pass.
+            void expandTree(const query::Request& query, std::vector<query::ResultForRoot>& results)
+            {
+                ASSERT(query.expansion.has_value());
+
+                query::ExpansionLevel level = query::rootExpansionLevel(results);
+
+                // The children of the roots are already fetched.
+                for (std::size_t depth = 1; depth < query.expansion->depth; ++depth)
+                {
+                    level = query::expandNextLevel(query, level);
+                    if (level.nodes.empty())
+                    {
+                        break;
+                    }
+
+                    query::PositionQueries posQueries = query::gatherPositionQueries(level);
+                    auto keys = getKeys(posQueries);
+                    std::vector<PositionStats> stats(posQueries.size());
+
+                    auto cmp = KeyCompareLessWithReverseMove{};
+                    auto unsort = reversibleZipSort(keys, posQueries, cmp);
+
+                    // Retractions are only collected for the roots.
+                    std::vector<RetractionsStats> retractionsStats;
+                    m_partition.executeQuery(query, keys, posQueries, stats, retractionsStats);
+
+                    auto segregated = segregatePositionStats(query, posQueries, stats);
+                    query::unflatten(std::move(segregated), query, posQueries, level);
+                }
+            }
+
             [[nodiscard]] query::PositionQueryResults segregatePositionStats(
                 const query::Request& query,
                 const query::PositionQueries& posQueries,
@@ -2343,20 +3904,47 @@ namespace persistence
                 return keys;
             }
 
+            // Fills the parts of the parameters that only depend on the game header.
+            template <typename GameT>
+            static void fillParamsForGame(EntryConstructionParameters& params, const GameT& game)
+            {
+                // we want either both or none to be known.
+                // So if only one is known then assume the
+                // other player has the same elo.
+                params.whiteElo = game.whiteElo();
+                params.blackElo = game.blackElo();
+
+                if (params.whiteElo && !params.blackElo) params.blackElo = params.whiteElo;
+                else if (params.blackElo && !params.whiteElo) params.whiteElo = params.blackElo;
+
+                if constexpr (needsDate)
+                {
+                    params.monthSinceYear0 = game.date().monthSinceYear0();
+                }
+            }
+
             ImportStats importImpl(
                 AsyncStorePipeline& pipeline,
                 const ImportableFiles& files,
+                std::size_t numImportThreads,
                 std::function<void(const std::filesystem::path& file)> completionCallback
             )
             {
                 // create buffers
                 std::vector<PersistedEntryType> bucket = pipeline.getEmptyBuffer();
 
-                auto processPosition = [this, &bucket, &pipeline](
+                MaterialIndex* materialIndex = m_materialIndex.has_value() ? &*m_materialIndex : nullptr;
+
+                auto processPosition = [this, &bucket, &pipeline, materialIndex](
                     const EntryConstructionParameters& params
                     ) {
                         bucket.emplace_back(params);
 
+                        if (materialIndex != nullptr)
+                        {
+                            materialIndex->addPosition(params.position);
+                        }
+
                         if (bucket.size() == bucket.capacity())
                         {
                             store(pipeline, bucket);
@@ -2366,18 +3954,19 @@ namespace persistence
                 ImportStats stats{};
                 EntryConstructionParameters params;
 
-                auto fillCommonStatsAndParamsForGame = [this, &stats, &params] (const auto& game, GameLevel level)
+                // Shared by all imported PGN files.
+                pgn::OpeningTrie openingTrie = makeOpeningTrie();
+
+                auto fillCommonStatsAndParamsForGame = [this, &stats, &params, materialIndex] (const auto& game, GameLevel level)
                 {
                     auto& statsForLevel = stats[level];
 
-                    // we want either both or none to be known.
-                    // So if only one is known then assume the
-                    // other player has the same elo.
-                    params.whiteElo = game.whiteElo();
-                    params.blackElo = game.blackElo();
+                    if (materialIndex != nullptr)
+                    {
+                        materialIndex->beginGame(level, params.result);
+                    }
 
-                    if (params.whiteElo && !params.blackElo) params.blackElo = params.whiteElo;
-                    else if (params.blackElo && !params.whiteElo) params.whiteElo = params.blackElo;
+                    fillParamsForGame(params, game);
 
                     // we know either none or both are present
                     if (params.whiteElo /* && params.blackElo */)
@@ -2414,13 +4003,8 @@ namespace persistence
                         }
                     }
 
-                    auto date = game.date();
-                    if constexpr (needsDate)
-                    {
-                        params.monthSinceYear0 = date.monthSinceYear0();
-                    }
-
                     // check if date is known
+                    auto date = game.date();
                     if (date.year() != 0)
                     {
                         date.setUnknownToFirst();
@@ -2450,7 +4034,13 @@ namespace persistence
 
                     if (type == ImportableFileType::Pgn)
                     {
-                        pgn::LazyPgnFileReader fr(path, m_pgnParserMemory.bytes());
+                        pgn::LazyPgnFileReader fr(
+                            path,
+                            m_pgnParserMemory.bytes(),
+                            m_memoryMappedImport
+                                ? pgn::LazyPgnFileReader::ReadMode::MemoryMapped
+                                : pgn::LazyPgnFileReader::ReadMode::Buffered
+                        );
                         if (!fr.isOpen())
                         {
                             Logger::instance().logError("Failed to open file ", path);
@@ -2460,7 +4050,9 @@ namespace persistence
 
                         for (auto& game : fr)
                         {
-                            const std::optional<GameResult> result = game.result();
+                            const pgn::ParsedGameTags tags = game.parseTags<m_importedPgnTags>();
+
+                            const std::optional<GameResult> result = tags.result();
                             if (!result.has_value())
                             {
                                 stats[level].numSkippedGames += 1;
@@ -2469,22 +4061,29 @@ namespace persistence
 
                             params.result = *result;
 
-                            fillCommonStatsAndParamsForGame(game, level);
+                            fillCommonStatsAndParamsForGame(tags, level);
 
-                            params.position = game.startPositionWithZobrist();
+                            params.position = tags.startPositionWithZobrist();
                             params.reverseMove = {};
 
                             processPosition(params);
                             std::size_t numPositionsInGame = 1;
+                            auto cursor =
+                                tags.hasCustomStartPosition()
+                                ? pgn::OpeningTrie::Cursor{}
+                                : openingTrie.root();
                             for (auto& san : game.moves())
                             {
-                                const Move move = san::sanToMove(params.position, san);
-                                if (move == Move::null())
+                                const auto moveResult = openingTrie.doMove(cursor, params.position, params.reverseMove, san);
+                                if (moveResult == pgn::OpeningTrie::MoveResult::Illegal)
                                 {
                                     break;
                                 }
+                                else if (moveResult == pgn::OpeningTrie::MoveResult::Cached)
+                                {
+                                    stats[level].numCachedPositions += 1;
+                                }
 
-                                params.reverseMove = params.position.doMove(move);
                                 processPosition(params);
 
                                 ++numPositionsInGame;
@@ -2492,9 +4091,14 @@ namespace persistence
 
                             ASSERT(numPositionsInGame > 0);
 
+                            if (materialIndex != nullptr)
+                            {
+                                materialIndex->endGame();
+                            }
+
                             if constexpr (hasGameHeaders)
                             {
-                                m_headers[level]->addGame(game, static_cast<std::uint16_t>(numPositionsInGame - 1u));
+                                m_headers[level]->addGame(tags, static_cast<std::uint16_t>(numPositionsInGame - 1u));
                             }
 
                             stats[level].numGames += 1;
@@ -2503,7 +4107,13 @@ namespace persistence
                     }
                     else if (type == ImportableFileType::Bcgn)
                     {
-                        bcgn::BcgnFileReader fr(path, m_bcgnParserMemory.bytes());
+                        bcgn::BcgnFileReader fr(
+                            path,
+                            m_bcgnParserMemory.bytes(),
+                            m_memoryMappedImport
+                                ? bcgn::BcgnFileReader::ReadMode::MemoryMapped
+                                : bcgn::BcgnFileReader::ReadMode::Buffered
+                        );
                         if (!fr.isOpen())
                         {
                             Logger::instance().logError("Failed to open file ", path);
@@ -2511,11 +4121,73 @@ namespace persistence
                             break;
                         }
 
+                        // The material index needs the positions themselves.
+                        std::optional<bcgn::BcgnPositionKeyFileReader> keys;
+                        if constexpr (canImportPositionKeys)
+                        {
+                            if (materialIndex == nullptr)
+                            {
+                                keys = bcgn::BcgnPositionKeyFileReader::open(path);
+                            }
+                        }
+
+                        // With a game offset directory the moves are decoded by several threads,
+                        // each reading its own range of games. Headers and stats have to be
+                        // added in order, so they come from a first pass over the file.
+                        if (materialIndex == nullptr && !keys.has_value() && numImportThreads > 1 && fr.hasGameOffsetDirectory())
+                        {
+                            std::vector<std::uint64_t> gameIndicesOrOffsets;
+                            gameIndicesOrOffsets.reserve(fr.numGames());
+                            for (auto& game : fr)
+                            {
+                                const std::optional<GameResult> result = game.result();
+                                if (!result.has_value())
+                                {
+                                    gameIndicesOrOffsets.emplace_back(0);
+                                    stats[level].numSkippedGames += 1;
+                                    continue;
+                                }
+
+                                params.result = *result;
+
+                                auto gameHeader = game.gameHeader();
+
+                                fillCommonStatsAndParamsForGame(gameHeader, level);
+
+                                gameIndicesOrOffsets.emplace_back(params.gameIndexOrOffset);
+
+                                const std::size_t numPositionsInGame = static_cast<std::size_t>(game.numPlies()) + 1u;
+
+                                if constexpr (hasGameHeaders)
+                                {
+                                    m_headers[level]->addGame(game, static_cast<std::uint16_t>(numPositionsInGame - 1u));
+                                }
+
+                                stats[level].numGames += 1;
+                                stats[level].numPositions += numPositionsInGame;
+                            }
+
+                            if (gameIndicesOrOffsets.size() != fr.numGames())
+                            {
+                                throw std::runtime_error("The game offset directory doesn't match the games in " + path.string());
+                            }
+
+                            importBcgnRanges(pipeline, path, level, fr.splitIntoRanges(numImportThreads), gameIndicesOrOffsets);
+
+                            completionCallback(path);
+                            continue;
+                        }
+
                         for (auto& game : fr)
                         {
                             const std::optional<GameResult> result = game.result();
                             if (!result.has_value())
                             {
+                                if (keys.has_value())
+                                {
+                                    (void)keys->nextGame();
+                                }
+
                                 stats[level].numSkippedGames += 1;
                                 continue;
                             }
@@ -2526,19 +4198,48 @@ namespace persistence
 
                             fillCommonStatsAndParamsForGame(gameHeader, level);
 
-                            params.position = game.startPositionWithZobrist();
-                            params.reverseMove = {};
+                            const std::size_t numPositionsInGame = static_cast<std::size_t>(game.numPlies()) + 1u;
 
-                            processPosition(params);
-                            auto moves = game.moves();
-                            while (moves.hasNext())
+                            if constexpr (canImportPositionKeys)
                             {
-                                const auto move = moves.next(params.position);
-                                params.reverseMove = params.position.doMove(move);
+                                if (keys.has_value())
+                                {
+                                    const auto& gameKeys = keys->nextGame();
+                                    if (gameKeys.size() != numPositionsInGame)
+                                    {
+                                        throw std::runtime_error("Position keys don't match the games in " + path.string());
+                                    }
+
+                                    for (auto&& key : gameKeys)
+                                    {
+                                        bucket.emplace_back(params, key.zobrist, key.packedReverseMove);
+                                        if (bucket.size() == bucket.capacity())
+                                        {
+                                            store(pipeline, bucket);
+                                        }
+                                    }
+                                }
+                            }
+
+                            if (!keys.has_value())
+                            {
+                                params.position = game.startPositionWithZobrist();
+                                params.reverseMove = {};
+
                                 processPosition(params);
+                                auto moves = game.moves();
+                                while (moves.hasNext())
+                                {
+                                    const auto move = moves.next(params.position);
+                                    params.reverseMove = params.position.doMove(move);
+                                    processPosition(params);
+                                }
                             }
 
-                            const auto numPositionsInGame = game.numPlies() + 1;
+                            if (materialIndex != nullptr)
+                            {
+                                materialIndex->endGame();
+                            }
 
                             if constexpr (hasGameHeaders)
                             {
@@ -2564,6 +4265,82 @@ namespace persistence
                 return stats;
             }
 
+            // Decodes the games of each range on its own thread, with its own reader and bucket.
+            // The game index or offset depends on the games before, so it's given for every
+            // game of the file, skipped ones included.
+            void importBcgnRanges(
+                AsyncStorePipeline& pipeline,
+                const std::filesystem::path& path,
+                GameLevel level,
+                const std::vector<bcgn::BcgnGameRange>& ranges,
+                const std::vector<std::uint64_t>& gameIndicesOrOffsets
+            )
+            {
+                auto importRange = [this, &pipeline, &path, level, &gameIndicesOrOffsets](const bcgn::BcgnGameRange& range) {
+                    bcgn::BcgnFileReader fr(
+                        path,
+                        m_bcgnParserMemory.bytes(),
+                        m_memoryMappedImport
+                            ? bcgn::BcgnFileReader::ReadMode::MemoryMapped
+                            : bcgn::BcgnFileReader::ReadMode::Buffered
+                    );
+                    fr.setRange(range);
+
+                    std::vector<PersistedEntryType> bucket = pipeline.getEmptyBuffer();
+
+                    EntryConstructionParameters params;
+                    params.level = level;
+
+                    auto processPosition = [this, &bucket, &pipeline, &params]() {
+                        bucket.emplace_back(params);
+                        if (bucket.size() == bucket.capacity())
+                        {
+                            store(pipeline, bucket);
+                        }
+                    };
+
+                    std::size_t gameIdx = range.firstGameIdx;
+                    for (auto& game : fr)
+                    {
+                        const std::optional<GameResult> result = game.result();
+                        if (result.has_value())
+                        {
+                            params.result = *result;
+                            params.gameIndexOrOffset = gameIndicesOrOffsets[gameIdx];
+                            fillParamsForGame(params, game.gameHeader());
+
+                            params.position = game.startPositionWithZobrist();
+                            params.reverseMove = {};
+
+                            processPosition();
+                            auto moves = game.moves();
+                            while (moves.hasNext())
+                            {
+                                const auto move = moves.next(params.position);
+                                params.reverseMove = params.position.doMove(move);
+                                processPosition();
+                            }
+                        }
+
+                        ++gameIdx;
+                    }
+
+                    store(pipeline, std::move(bucket));
+                };
+
+                std::vector<std::future<void>> futures;
+                futures.reserve(ranges.size());
+                for (auto&& range : ranges)
+                {
+                    futures.emplace_back(std::async(std::launch::async, importRange, std::cref(range)));
+                }
+
+                for (auto& future : futures)
+                {
+                    future.get();
+                }
+            }
+
             void store(
                 AsyncStorePipeline& pipeline,
                 std::vector<PersistedEntryType>& entries
@@ -2576,6 +4353,8 @@ namespace persistence
 
                 auto newBuffer = pipeline.getEmptyBuffer();
                 entries.swap(newBuffer);
+
+                std::unique_lock<std::mutex> lock(m_storeMutex);
                 m_partition.storeUnordered(pipeline, std::move(newBuffer));
             }
 
@@ -2586,9 +4365,11 @@ namespace persistence
             {
                 if (entries.empty())
                 {
+                    pipeline.returnEmptyBuffer(std::move(entries));
                     return;
                 }
 
+                std::unique_lock<std::mutex> lock(m_storeMutex);
                 m_partition.storeUnordered(pipeline, std::move(entries));
             }
         };
@@ -1,9 +1,12 @@
 #include "PackedGameHeader.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace persistence
 {
     template <typename GameIndexT>
-    PackedGameHeader<GameIndexT>::PackedGameHeader(ext::Vector<char>& headers, std::size_t offset) :
+    PackedGameHeader<GameIndexT>::PackedGameHeader(const char* data, std::size_t size) :
         m_gameIdx{},
         m_size{},
         m_result{},
@@ -14,36 +17,37 @@ namespace persistence
     {
         // there may be garbage at the end
         // we don't care because we have sizes serialized
-        const std::size_t read = headers.read(reinterpret_cast<char*>(this), offset, sizeof(PackedGameHeader));
-        ASSERT(m_size <= read);
-        (void)read;
+        std::memcpy(reinterpret_cast<char*>(this), data, std::min(size, sizeof(PackedGameHeader)));
+        ASSERT(m_size <= size);
     }
 
     template <typename GameIndexT>
-    PackedGameHeader<GameIndexT>::PackedGameHeader(const pgn::UnparsedGame& game, GameIndexT gameIdx, std::uint16_t plyCount) :
+    PackedGameHeader<GameIndexT>::PackedGameHeader(const pgn::ParsedGameTags& tags, GameIndexT gameIdx, std::uint16_t plyCount) :
         m_gameIdx(gameIdx),
+        m_result(*tags.result()),
+        m_date(tags.date()),
+        m_eco(tags.eco()),
         m_plyCount(plyCount)
     {
-        std::string_view event;
-        std::string_view white;
-        std::string_view black;
-        std::optional<GameResult> result;
-        game.getResultDateEcoEventWhiteBlack(result, m_date, m_eco, event, white, black);
-        m_result = *result;
-        fillPackedStrings(event, white, black);
+        fillPackedStrings(tags.event(), tags.white(), tags.black());
+    }
+
+    template <typename GameIndexT>
+    PackedGameHeader<GameIndexT>::PackedGameHeader(const pgn::ParsedGameTags& tags, GameIndexT gameIdx) :
+        PackedGameHeader(tags, gameIdx, tags.plyCount(unknownPlyCount))
+    {
+    }
+
+    template <typename GameIndexT>
+    PackedGameHeader<GameIndexT>::PackedGameHeader(const pgn::UnparsedGame& game, GameIndexT gameIdx, std::uint16_t plyCount) :
+        PackedGameHeader(game.parseTags<pgn::TagSet::Header>(), gameIdx, plyCount)
+    {
     }
 
     template <typename GameIndexT>
     PackedGameHeader<GameIndexT>::PackedGameHeader(const pgn::UnparsedGame& game, GameIndexT gameIdx) :
-        m_gameIdx(gameIdx)
+        PackedGameHeader(game.parseTags<pgn::TagSet::Header>(), gameIdx)
     {
-        std::string_view event;
-        std::string_view white;
-        std::string_view black;
-        std::optional<GameResult> result;
-        game.getResultDateEcoEventWhiteBlackPlyCount(result, m_date, m_eco, event, white, black, m_plyCount);
-        m_result = *result;
-        fillPackedStrings(event, white, black);
     }
 
     template <typename GameIndexT>
@@ -75,6 +79,26 @@ namespace persistence
         fillPackedStrings(event, white, black);
     }
 
+    template <typename GameIndexT>
+    PackedGameHeader<GameIndexT>::PackedGameHeader(
+        GameIndexT gameIdx,
+        GameResult result,
+        Date date,
+        Eco eco,
+        std::uint16_t plyCount,
+        std::string_view event,
+        std::string_view white,
+        std::string_view black
+    ) :
+        m_gameIdx(gameIdx),
+        m_result(result),
+        m_date(date),
+        m_eco(eco),
+        m_plyCount(plyCount)
+    {
+        fillPackedStrings(event, white, black);
+    }
+
     template <typename GameIndexT>
     [[nodiscard]] const char* PackedGameHeader<GameIndexT>::data() const
     {
@@ -28,7 +28,14 @@ namespace persistence
 
         PackedGameHeader() = default;
 
-        PackedGameHeader(ext::Vector<char>& headers, std::size_t offset);
+        // `data` must contain at least the whole serialized header.
+        // Anything past it is ignored.
+        PackedGameHeader(const char* data, std::size_t size);
+
+        // The tags must include pgn::TagSet::Header.
+        PackedGameHeader(const pgn::ParsedGameTags& tags, GameIndexType gameIdx, std::uint16_t plyCount);
+
+        PackedGameHeader(const pgn::ParsedGameTags& tags, GameIndexType gameIdx);
 
         PackedGameHeader(const pgn::UnparsedGame& game, GameIndexType gameIdx, std::uint16_t plyCount);
 
@@ -38,6 +45,17 @@ namespace persistence
 
         PackedGameHeader(const bcgn::UnparsedBcgnGame& game, GameIndexType gameIdx);
 
+        PackedGameHeader(
+            GameIndexType gameIdx,
+            GameResult result,
+            Date date,
+            Eco eco,
+            std::uint16_t plyCount,
+            std::string_view event,
+            std::string_view white,
+            std::string_view black
+        );
+
         [[nodiscard]] const char* data() const;
 
         [[nodiscard]] std::size_t size() const;
@@ -5,15 +5,20 @@
 #include "chess/Eran.h"
 #include "chess/GameClassification.h"
 #include "chess/MoveGenerator.h"
+#include "chess/Pgn.h"
 #include "chess/Position.h"
 #include "chess/San.h"
+#include "chess/Uci.h"
 
 #include "enum/Enum.h"
 
 #include "util/Assert.h"
 
+#include <algorithm>
+#include <cctype>
 #include <map>
 #include <optional>
+#include <stdexcept>
 #include <string>
 #include <string_view>
 #include <vector>
@@ -22,6 +27,47 @@
 
 namespace query
 {
+    namespace
+    {
+        // Rewrites the movetext to the form the PGN move tokenizer expects.
+        // It's padded with whitespace on both ends because the tokenizer
+        // skips the first character, which is a move number in PGN files.
+        // Tabs and carriage returns become spaces and castling written
+        // with zeros is rewritten with letters.
+        [[nodiscard]] std::string normalizeMovetext(std::string_view movetext)
+        {
+            std::string normalized;
+            normalized.reserve(movetext.size() + 2);
+            normalized += ' ';
+
+            std::size_t i = 0;
+            while (i < movetext.size())
+            {
+                const char c = movetext[i];
+                const bool isTokenStart = i == 0 || !std::isdigit(static_cast<unsigned char>(movetext[i - 1]));
+                if (isTokenStart && movetext.substr(i, 5) == "0-0-0")
+                {
+                    normalized += "O-O-O";
+                    i += 5;
+                }
+                else if (isTokenStart && movetext.substr(i, 3) == "0-0")
+                {
+                    normalized += "O-O";
+                    i += 3;
+                }
+                else
+                {
+                    normalized += c == '\t' || c == '\r' ? ' ' : c;
+                    i += 1;
+                }
+            }
+
+            normalized += ' ';
+
+            return normalized;
+        }
+    }
+
     void to_json(nlohmann::json& j, const RootPosition& query)
     {
         j["fen"] = query.fen;
@@ -192,6 +238,20 @@ namespace query
         }
     }
 
+    void to_json(nlohmann::json& j, const ExpansionOptions& opt)
+    {
+        j = nlohmann::json{
+            { "depth", opt.depth },
+            { "min_count", opt.minCount }
+        };
+    }
+
+    void from_json(const nlohmann::json& j, ExpansionOptions& opt)
+    {
+        j["depth"].get_to(opt.depth);
+        opt.minCount = j.value("min_count", std::size_t(0));
+    }
+
     void to_json(nlohmann::json& j, const Request& query)
     {
         j = nlohmann::json{
@@ -226,6 +286,11 @@ namespace query
         {
             j["filters"] = *query.filters;
         }
+
+        if (query.expansion.has_value())
+        {
+            j["expansion"] = *query.expansion;
+        }
     }
 
     void from_json(const nlohmann::json& j, Request& query)
@@ -275,6 +340,11 @@ namespace query
         {
             query.filters = j["filters"];
         }
+
+        if (j.contains("expansion"))
+        {
+            query.expansion = j["expansion"];
+        }
     }
 
     [[nodiscard]] bool Request::isValid() const
@@ -285,6 +355,12 @@ namespace query
         if (levels.empty()) return false;
         if (results.empty()) return false;
 
+        if (expansion.has_value())
+        {
+            if (expansion->depth == 0 || expansion->depth > ExpansionOptions::maxDepth) return false;
+            if (fetchChildrenSelectMask(*this) == SelectMask::None) return false;
+        }
+
         for (auto&& root : positions)
         {
             if (!root.tryGet().has_value())
@@ -458,6 +534,17 @@ namespace query
                 jsonSubresult[eranStr] = entries;
             }
         }
+
+        if (!result.expanded.empty())
+        {
+            auto& jsonExpanded = j["expanded"];
+
+            for (auto&& child : result.expanded)
+            {
+                // The move of the child is already in san.
+                jsonExpanded[*child.position.move] = child;
+            }
+        }
     }
 
     void to_json(nlohmann::json& j, const Response& response)
@@ -468,6 +555,386 @@ namespace query
         };
     }
 
+    void to_json(nlohmann::json& j, const GamesByNameRequest& query)
+    {
+        j = nlohmann::json{
+            { "token", query.token },
+            { query.field == persistence::NameIndexField::Player ? "player" : "event", query.name },
+            { "offset", query.offset },
+            { "limit", query.limit }
+        };
+
+        auto& levels = j["levels"] = nlohmann::json::array();
+        for (auto&& level : query.levels)
+        {
+            levels.emplace_back(toString(level));
+        }
+    }
+
+    void from_json(const nlohmann::json& j, GamesByNameRequest& query)
+    {
+        query.levels.clear();
+
+        j["token"].get_to(query.token);
+
+        if (j.contains("player"))
+        {
+            query.field = persistence::NameIndexField::Player;
+            j["player"].get_to(query.name);
+        }
+        else
+        {
+            query.field = persistence::NameIndexField::Event;
+            j["event"].get_to(query.name);
+        }
+
+        for (auto&& levelStr : j["levels"])
+        {
+            auto levelOpt = fromString<GameLevel>(levelStr);
+            if (levelOpt.has_value())
+            {
+                query.levels.emplace_back(*levelOpt);
+            }
+        }
+
+        query.offset = j.value("offset", std::size_t(0));
+        query.limit = j.value("limit", std::size_t(100));
+    }
+
+    [[nodiscard]] bool GamesByNameRequest::isValid() const
+    {
+        if (levels.empty()) return false;
+        if (limit > maxLimit) return false;
+
+        return true;
+    }
+
+    void to_json(nlohmann::json& j, const GamesByNameResponse& response)
+    {
+        j = nlohmann::json{
+            { "query", response.query },
+            { "num_games", response.numGames }
+        };
+
+        auto& games = j["games"] = nlohmann::json::array();
+        for (auto&& [level, header] : response.games)
+        {
+            auto& game = games.emplace_back(header);
+            game["level"] = toString(level);
+        }
+    }
+
+    void to_json(nlohmann::json& j, const GamesByPositionRequest& query)
+    {
+        j = nlohmann::json{
+            { "token", query.token },
+            { "position", query.position },
+            { "offset", query.offset },
+            { "limit", query.limit }
+        };
+
+        auto& levels = j["levels"] = nlohmann::json::array();
+        for (auto&& level : query.levels)
+        {
+            levels.emplace_back(toString(level));
+        }
+    }
+
+    void from_json(const nlohmann::json& j, GamesByPositionRequest& query)
+    {
+        query.levels.clear();
+
+        j["token"].get_to(query.token);
+        j["position"].get_to(query.position);
+
+        for (auto&& levelStr : j["levels"])
+        {
+            auto levelOpt = fromString<GameLevel>(levelStr);
+            if (levelOpt.has_value())
+            {
+                query.levels.emplace_back(*levelOpt);
+            }
+        }
+
+        query.offset = j.value("offset", std::size_t(0));
+        query.limit = j.value("limit", std::size_t(100));
+    }
+
+    [[nodiscard]] bool GamesByPositionRequest::isValid() const
+    {
+        if (levels.empty()) return false;
+        if (limit > maxLimit) return false;
+        if (!position.tryGet().has_value()) return false;
+
+        return true;
+    }
+
+    void to_json(nlohmann::json& j, const GamesByPositionResponse& response)
+    {
+        j = nlohmann::json{
+            { "query", response.query },
+            { "num_games", response.numGames }
+        };
+
+        auto& games = j["games"] = nlohmann::json::array();
+        for (auto&& [level, header] : response.games)
+        {
+            auto& game = games.emplace_back(header);
+            game["level"] = toString(level);
+        }
+    }
+
+    void to_json(nlohmann::json& j, const MaterialStatsRequest& query)
+    {
+        j = nlohmann::json{
+            { "token", query.token },
+            { "material", query.material }
+        };
+
+        auto& levels = j["levels"] = nlohmann::json::array();
+        for (auto&& level : query.levels)
+        {
+            levels.emplace_back(toString(level));
+        }
+
+        auto& results = j["results"] = nlohmann::json::array();
+        for (auto&& result : query.results)
+        {
+            results.emplace_back(toString(GameResultWordFormat{}, result));
+        }
+    }
+
+    void from_json(const nlohmann::json& j, MaterialStatsRequest& query)
+    {
+        query.levels.clear();
+        query.results.clear();
+
+        j["token"].get_to(query.token);
+        j["material"].get_to(query.material);
+
+        for (auto&& levelStr : j["levels"])
+        {
+            auto levelOpt = fromString<GameLevel>(levelStr);
+            if (levelOpt.has_value())
+            {
+                query.levels.emplace_back(*levelOpt);
+            }
+        }
+
+        for (auto&& resultStr : j["results"])
+        {
+            auto resultOpt = fromString<GameResult>(GameResultWordFormat{}, resultStr);
+            if (resultOpt.has_value())
+            {
+                query.results.emplace_back(*resultOpt);
+            }
+        }
+    }
+
+    [[nodiscard]] bool MaterialStatsRequest::isValid() const
+    {
+        if (levels.empty()) return false;
+        if (results.empty()) return false;
+        if (!persistence::MaterialSignature::fromString(material).has_value()) return false;
+
+        return true;
+    }
+
+    void to_json(nlohmann::json& j, const MaterialStatsResponse& response)
+    {
+        j = nlohmann::json{
+            { "query", response.query },
+            { "material", response.signature.toString() }
+        };
+
+        auto& stats = j["stats"] = nlohmann::json::object();
+        for (auto&& level : response.query.levels)
+        {
+            const auto levelStr = std::string(toString(level));
+            for (auto&& result : response.query.results)
+            {
+                const auto resultStr = std::string(toString(GameResultWordFormat{}, result));
+                const auto& entry = response.stats[level][result];
+                stats[levelStr][resultStr] = nlohmann::json{
+                    { "count", entry.numPositions },
+                    { "num_games", entry.numGames }
+                };
+            }
+        }
+    }
+
+    void to_json(nlohmann::json& j, const NoveltyRequest& query)
+    {
+        j = nlohmann::json{
+            { "token", query.token },
+            { "moves", query.moves },
+            { "select", toString(query.select) }
+        };
+
+        if (query.fen.has_value())
+        {
+            j["fen"] = *query.fen;
+        }
+
+        auto& levels = j["levels"] = nlohmann::json::array();
+        for (auto&& level : query.levels)
+        {
+            levels.emplace_back(toString(level));
+        }
+
+        auto& results = j["results"] = nlohmann::json::array();
+        for (auto&& result : query.results)
+        {
+            results.emplace_back(toString(GameResultWordFormat{}, result));
+        }
+
+        if (query.filters.has_value())
+        {
+            j["filters"] = *query.filters;
+        }
+    }
+
+    void from_json(const nlohmann::json& j, NoveltyRequest& query)
+    {
+        query.levels.clear();
+        query.results.clear();
+
+        j["token"].get_to(query.token);
+        j["moves"].get_to(query.moves);
+
+        if (j.contains("fen"))
+        {
+            query.fen = j["fen"].get<std::string>();
+        }
+        else
+        {
+            query.fen.reset();
+        }
+
+        if (j.contains("select"))
+        {
+            const auto selectOpt = fromString<Select>(j["select"].get<std::string>());
+            if (selectOpt.has_value())
+            {
+                query.select = *selectOpt;
+            }
+        }
+
+        for (auto&& levelStr : j["levels"])
+        {
+            auto levelOpt = fromString<GameLevel>(levelStr);
+            if (levelOpt.has_value())
+            {
+                query.levels.emplace_back(*levelOpt);
+            }
+        }
+
+        for (auto&& resultStr : j["results"])
+        {
+            auto resultOpt = fromString<GameResult>(GameResultWordFormat{}, resultStr);
+            if (resultOpt.has_value())
+            {
+                query.results.emplace_back(*resultOpt);
+            }
+        }
+
+        if (j.contains("filters"))
+        {
+            query.filters = j["filters"];
+        }
+    }
+
+    [[nodiscard]] std::optional<Position> NoveltyRequest::tryGetStartPosition() const
+    {
+        if (fen.has_value())
+        {
+            return Position::tryFromFen(*fen);
+        }
+
+        return Position::startPosition();
+    }
+
+    [[nodiscard]] std::optional<std::vector<Move>> NoveltyRequest::tryGetMoves() const
+    {
+        std::optional<Position> positionOpt = tryGetStartPosition();
+        if (!positionOpt.has_value())
+        {
+            return {};
+        }
+
+        auto& position = *positionOpt;
+
+        const std::string movetext = normalizeMovetext(moves);
+
+        std::vector<Move> parsed;
+        for (auto&& token : pgn::UnparsedGameMoves(movetext))
+        {
+            std::optional<Move> moveOpt = san::trySanToMove(position, token);
+            if (!moveOpt.has_value() || *moveOpt == Move::null())
+            {
+                moveOpt = uci::tryUciToMove(position, token);
+            }
+
+            // The san parser doesn't check legality of every move.
+            if (!moveOpt.has_value() || !position.isMoveLegal(*moveOpt))
+            {
+                return {};
+            }
+
+            position.doMove(*moveOpt);
+            parsed.emplace_back(*moveOpt);
+        }
+
+        return parsed;
+    }
+
+    [[nodiscard]] Request NoveltyRequest::positionRequest() const
+    {
+        Request request{};
+        request.token = token;
+        request.levels = levels;
+        request.results = results;
+        request.fetchingOptions.emplace(select, AdditionalFetchingOptions{ false, false, false, false, false });
+        request.filters = filters;
+        return request;
+    }
+
+    [[nodiscard]] bool NoveltyRequest::isValid() const
+    {
+        if (levels.empty()) return false;
+        if (results.empty()) return false;
+        if (!tryGetStartPosition().has_value()) return false;
+
+        return true;
+    }
+
+    void to_json(nlohmann::json& j, const NoveltyResponse& response)
+    {
+        j = nlohmann::json{
+            { "query", response.query }
+        };
+
+        auto& plies = j["plies"] = nlohmann::json::array();
+        for (std::size_t i = 0; i < response.plies.size(); ++i)
+        {
+            plies.emplace_back(nlohmann::json{
+                { "ply", i },
+                // The start position has no move.
+                { "move", i == 0 ? std::string("--") : response.moves[i - 1] },
+                { "entries", response.plies[i] }
+            });
+        }
+
+        if (response.noveltyPly.has_value())
+        {
+            j["novelty_ply"] = *response.noveltyPly;
+        }
+        else
+        {
+            j["novelty_ply"] = nullptr;
+        }
+    }
+
     [[nodiscard]] SelectMask selectMask(const Request& query)
     {
         SelectMask mask = SelectMask::None;
@@ -536,6 +1003,22 @@ namespace query
         return gatherPositionQueries(query.positions, fetchChildren);
     }
 
+    [[nodiscard]] PositionQueries gatherPositionQueries(const Position& startPosition, const std::vector<Move>& moves)
+    {
+        auto position = startPosition;
+
+        PositionQueries queries;
+        queries.reserve(moves.size() + 1);
+        queries.emplace_back(position, ReverseMove{}, 0, PositionQueryOrigin::Root);
+        for (auto&& move : moves)
+        {
+            const auto rev = position.doMove(move);
+            queries.emplace_back(position, rev, queries.size(), PositionQueryOrigin::Root);
+        }
+
+        return queries;
+    }
+
     [[nodiscard]] std::vector<ResultForRoot> unflatten(PositionQueryResults&& raw, const Request& query, const PositionQueries& individialQueries)
     {
         std::vector<ResultForRoot> results;
@@ -574,6 +1057,126 @@ namespace query
         return results;
     }
 
+    [[nodiscard]] ExpansionLevel rootExpansionLevel(std::vector<ResultForRoot>& results)
+    {
+        ExpansionLevel level;
+        for (auto&& result : results)
+        {
+            const auto positionOpt = result.position.tryGet();
+            if (!positionOpt.has_value()) throw std::runtime_error("Invalid position in query");
+
+            level.nodes.emplace_back(&result);
+            level.positions.emplace_back(*positionOpt);
+        }
+
+        return level;
+    }
+
+    [[nodiscard]] ExpansionLevel expandNextLevel(const Request& query, const ExpansionLevel& level)
+    {
+        ASSERT(query.expansion.has_value());
+        ASSERT(level.nodes.size() == level.positions.size());
+
+        const std::size_t minCount = std::max<std::size_t>(query.expansion->minCount, 1);
+
+        ExpansionLevel next;
+        next.numExpandedNodes = level.numExpandedNodes;
+
+        for (std::size_t i = 0; i < level.nodes.size(); ++i)
+        {
+            auto& node = *level.nodes[i];
+            const auto& position = level.positions[i];
+
+            // A child is expanded if it has enough games in any select.
+            std::map<Move, std::size_t, MoveCompareLess> counts;
+            for (auto&& [select, fetch] : query.fetchingOptions)
+            {
+                if (!fetch.fetchChildren) continue;
+
+                for (auto&& [childMove, childEntries] : node.resultsBySelect[select].children)
+                {
+                    std::size_t count = 0;
+                    for (auto&& [childOrigin, childEntry] : childEntries)
+                    {
+                        count += childEntry.count;
+                    }
+
+                    auto& maxCount = counts[childMove];
+                    maxCount = std::max(maxCount, count);
+                }
+            }
+
+            const std::string fen = position.fen();
+            for (auto&& [move, count] : counts)
+            {
+                if (count < minCount) continue;
+                if (next.numExpandedNodes >= ExpansionOptions::maxNodes) break;
+
+                auto& child = node.expanded.emplace_back(RootPosition{
+                    fen,
+                    san::moveToSan<san::SanSpec::Capture | san::SanSpec::Check | san::SanSpec::Compact>(position, move)
+                });
+
+                for (auto&& [select, fetch] : query.fetchingOptions)
+                {
+                    if (!fetch.fetchChildren) continue;
+
+                    child.resultsBySelect[select].root = node.resultsBySelect[select].children[move];
+                }
+
+                auto childPosition = position;
+                childPosition.doMove(move);
+                next.positions.emplace_back(childPosition);
+
+                next.numExpandedNodes += 1;
+            }
+
+            // The children of this node won't move anymore.
+            for (auto&& child : node.expanded)
+            {
+                next.nodes.emplace_back(&child);
+            }
+        }
+
+        return next;
+    }
+
+    [[nodiscard]] PositionQueries gatherPositionQueries(const ExpansionLevel& level)
+    {
+        PositionQueries queries;
+        for (std::size_t i = 0; i < level.positions.size(); ++i)
+        {
+            const auto& pos = level.positions[i];
+
+            movegen::forEachLegalMove(pos, [&](Move move) {
+                auto posCpy = pos;
+                auto rev = posCpy.doMove(move);
+                queries.emplace_back(posCpy, rev, i, PositionQueryOrigin::Child);
+                });
+        }
+
+        return queries;
+    }
+
+    void unflatten(PositionQueryResults&& raw, const Request& query, const PositionQueries& individialQueries, ExpansionLevel& level)
+    {
+        const std::size_t size = raw.size();
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            auto&& entriesBySelect = raw[i];
+            auto&& [position, reverseMove, rootId, origin] = individialQueries[i];
+
+            ASSERT(origin == PositionQueryOrigin::Child);
+
+            for (auto&& [select, fetch] : query.fetchingOptions)
+            {
+                if (!fetch.fetchChildren) continue;
+
+                level.nodes[rootId]->resultsBySelect[select].children[reverseMove.move] = std::move(entriesBySelect[select]);
+            }
+        }
+    }
+
     GameHeaderDestination::GameHeaderDestination(std::size_t queryId, Select select, GameLevel level, GameResult result, GameHeaderDestination::HeaderMemberPtr headerPtr) :
         queryId(queryId),
         select(select),
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "GameHeader.h"
+#include "MaterialIndex.h"
+#include "NameIndex.h"
 
 #include "chess/GameClassification.h"
 #include "chess/Position.h"
@@ -150,6 +152,28 @@ namespace query
         friend void from_json(const nlohmann::json& j, QueryFilters& filters);
     };
 
+    // Expands the tree of children more than one ply deep.
+    // All children of one depth are queried together.
+    struct ExpansionOptions
+    {
+        static constexpr std::size_t maxDepth = 8;
+
+        // Expanding stops after this many nodes, counted over the whole query.
+        static constexpr std::size_t maxNodes = 10000;
+
+        // The number of plies below the root positions.
+        // 1 is the same as just fetching the children.
+        std::size_t depth = 1;
+
+        // Children with fewer games than this are not expanded.
+        // Children with no games are never expanded.
+        std::size_t minCount = 0;
+
+        friend void to_json(nlohmann::json& j, const ExpansionOptions& opt);
+
+        friend void from_json(const nlohmann::json& j, ExpansionOptions& opt);
+    };
+
     struct Request
     {
         // token can be used to match queries to results by the client
@@ -164,6 +188,9 @@ namespace query
 
         std::optional<QueryFilters> filters;
 
+        // Requires fetching children for at least one select.
+        std::optional<ExpansionOptions> expansion;
+
         friend void to_json(nlohmann::json& j, const Request& query);
 
         friend void from_json(const nlohmann::json& j, Request& query);
@@ -260,6 +287,11 @@ namespace query
         std::map<Select, SelectResult> resultsBySelect;
         RetractionsResult retractionsResults;
 
+        // Children that were expanded, see Request::expansion.
+        // Their position is this position with the move to the child.
+        // The root entries are the same as the entries of the child in this result.
+        std::vector<ResultForRoot> expanded;
+
         ResultForRoot(const RootPosition& pos);
 
         friend void to_json(nlohmann::json& j, const ResultForRoot& result);
@@ -273,6 +305,169 @@ namespace query
         friend void to_json(nlohmann::json& j, const Response& response);
     };
 
+    // Request for the headers of games with a given player or event.
+    // Requires the name index, see persistence::NameIndex.
+    struct GamesByNameRequest
+    {
+        static constexpr std::size_t maxLimit = 1000;
+
+        // token can be used to match queries to results by the client
+        std::string token;
+
+        persistence::NameIndexField field;
+        std::string name;
+
+        // Games of all levels are paginated together, in order of levels
+        // and then game indices.
+        std::vector<GameLevel> levels;
+        std::size_t offset = 0;
+        std::size_t limit = 100;
+
+        friend void to_json(nlohmann::json& j, const GamesByNameRequest& query);
+
+        friend void from_json(const nlohmann::json& j, GamesByNameRequest& query);
+
+        [[nodiscard]] bool isValid() const;
+    };
+
+    struct GamesByNameResponse
+    {
+        GamesByNameRequest query;
+
+        // The number of all matching games, not only of the returned ones.
+        std::size_t numGames = 0;
+
+        std::vector<std::pair<GameLevel, persistence::GameHeader>> games;
+
+        friend void to_json(nlohmann::json& j, const GamesByNameResponse& response);
+    };
+
+    // Request for the headers of games in which a position occurred.
+    // Requires game lists, see persistence/pos_db/GameList.h.
+    struct GamesByPositionRequest
+    {
+        static constexpr std::size_t maxLimit = 1000;
+
+        // token can be used to match queries to results by the client
+        std::string token;
+
+        // If the move is specified only the games in which the
+        // position was reached by this move are returned.
+        RootPosition position;
+
+        // Games of all levels are paginated together, in order of levels
+        // and then game indices (or offsets).
+        std::vector<GameLevel> levels;
+        std::size_t offset = 0;
+        std::size_t limit = 100;
+
+        friend void to_json(nlohmann::json& j, const GamesByPositionRequest& query);
+
+        friend void from_json(const nlohmann::json& j, GamesByPositionRequest& query);
+
+        [[nodiscard]] bool isValid() const;
+    };
+
+    struct GamesByPositionResponse
+    {
+        GamesByPositionRequest query;
+
+        // The number of all matching games, not only of the returned ones.
+        std::size_t numGames = 0;
+
+        std::vector<std::pair<GameLevel, persistence::GameHeader>> games;
+
+        friend void to_json(nlohmann::json& j, const GamesByPositionResponse& response);
+    };
+
+    // Request for the aggregated results of positions with a given material.
+    // Requires the material index, see persistence::MaterialIndex.
+    struct MaterialStatsRequest
+    {
+        // token can be used to match queries to results by the client
+        std::string token;
+
+        // For example "KRPvKR", see persistence::MaterialSignature::fromString.
+        std::string material;
+
+        std::vector<GameLevel> levels;
+        std::vector<GameResult> results;
+
+        friend void to_json(nlohmann::json& j, const MaterialStatsRequest& query);
+
+        friend void from_json(const nlohmann::json& j, MaterialStatsRequest& query);
+
+        [[nodiscard]] bool isValid() const;
+    };
+
+    struct MaterialStatsResponse
+    {
+        MaterialStatsRequest query;
+
+        persistence::MaterialSignature signature;
+
+        // Only the requested levels and results are serialized.
+        persistence::MaterialStatsByLevelAndResult stats;
+
+        friend void to_json(nlohmann::json& j, const MaterialStatsResponse& response);
+    };
+
+    // Request for the entries of every position of a game,
+    // to find the first move that leaves the database.
+    struct NoveltyRequest
+    {
+        static constexpr std::size_t maxPlies = 1000;
+
+        // token can be used to match queries to results by the client
+        std::string token;
+
+        // The position the moves start from. The start position if not specified.
+        std::optional<std::string> fen;
+
+        // Moves in SAN or UCI separated by whitespace. Move numbers, comments,
+        // variations, NAGs and the result are skipped, so PGN movetext can be used as is.
+        std::string moves;
+
+        Select select = Select::All;
+        std::vector<GameLevel> levels;
+        std::vector<GameResult> results;
+
+        std::optional<QueryFilters> filters;
+
+        friend void to_json(nlohmann::json& j, const NoveltyRequest& query);
+
+        friend void from_json(const nlohmann::json& j, NoveltyRequest& query);
+
+        [[nodiscard]] std::optional<Position> tryGetStartPosition() const;
+
+        // Empty if some move can't be parsed or is illegal.
+        // The moves are not checked by isValid, this should be called once
+        // and the result passed along.
+        [[nodiscard]] std::optional<std::vector<Move>> tryGetMoves() const;
+
+        // A request for the positions, with no children or games fetched.
+        [[nodiscard]] Request positionRequest() const;
+
+        [[nodiscard]] bool isValid() const;
+    };
+
+    struct NoveltyResponse
+    {
+        NoveltyRequest query;
+
+        // The moves in SAN.
+        std::vector<std::string> moves;
+
+        // Entries of the position after each ply, the first one is the start position.
+        std::vector<SegregatedEntries> plies;
+
+        // The first ply after which the position has no games, 0 if the start
+        // position has none. Empty if all positions of the game are in the database.
+        std::optional<std::size_t> noveltyPly;
+
+        friend void to_json(nlohmann::json& j, const NoveltyResponse& response);
+    };
+
     enum struct PositionQueryOrigin
     {
         Root,
@@ -405,6 +600,9 @@ namespace query
 
     [[nodiscard]] PositionQueries gatherPositionQueries(const Request& query);
 
+    // One root query for each position of the game, rootId is the ply.
+    [[nodiscard]] PositionQueries gatherPositionQueries(const Position& startPosition, const std::vector<Move>& moves);
+
     // This is the result type to be used by databases' query functions
     // It is flatter, allows easier in memory manipulation.
     using PositionQueryResults = std::vector<EnumArray<Select, SegregatedEntries>>;
@@ -412,6 +610,29 @@ namespace query
 
     [[nodiscard]] std::vector<ResultForRoot> unflatten(PositionQueryResults&& raw, const Request& query, const PositionQueries& individialQueries);
 
+    // Nodes of one depth of the expanded tree, see Request::expansion.
+    struct ExpansionLevel
+    {
+        std::vector<ResultForRoot*> nodes;
+        std::vector<Position> positions;
+
+        // The number of nodes expanded so far, including the previous depths.
+        std::size_t numExpandedNodes = 0;
+    };
+
+    // The roots, with the children already fetched.
+    [[nodiscard]] ExpansionLevel rootExpansionLevel(std::vector<ResultForRoot>& results);
+
+    // Creates the nodes of the next depth from the children of the level's nodes
+    // that have enough games. The nodes take their root entries from the parent.
+    [[nodiscard]] ExpansionLevel expandNextLevel(const Request& query, const ExpansionLevel& level);
+
+    // Queries for the children of all nodes of the level. rootId is the index of the node.
+    [[nodiscard]] PositionQueries gatherPositionQueries(const ExpansionLevel& level);
+
+    // Assigns the children to the level's nodes, like unflatten.
+    void unflatten(PositionQueryResults&& raw, const Request& query, const PositionQueries& individialQueries, ExpansionLevel& level);
+
     struct GameHeaderDestination
     {
         using HeaderMemberPtr = std::optional<persistence::GameHeader> Entry::*;
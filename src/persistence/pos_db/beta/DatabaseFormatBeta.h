@@ -20,6 +20,9 @@ namespace persistence
 
         struct Key
         {
+            // Starts with 8 bytes of the hash, see HashPrefixScan.h.
+            static constexpr bool hasLeadingHashPrefix = true;
+
             // Hash:96, PackedReverseMove:27, GameLevel:2, GameResult:2, padding:1
 
             static constexpr std::size_t levelBits = 2;
@@ -38,14 +41,17 @@ namespace persistence
 
             Key() = default;
 
-            Key(const PositionWithZobrist& pos, const ReverseMove& reverseMove = ReverseMove{})
+            Key(const PositionWithZobrist& pos, const ReverseMove& reverseMove = ReverseMove{}) :
+                Key(pos.zobrist(), PackedReverseMove(reverseMove))
+            {
+            }
+
+            Key(const ZobristKey& zobrist, PackedReverseMove packedReverseMove)
             {
-                const auto zobrist = pos.zobrist();
                 m_hash[0] = zobrist.high >> 32;
                 m_hash[1] = zobrist.high & 0xFFFFFFFFull;
                 m_hash[2] = zobrist.low >> 32;
 
-                auto packedReverseMove = PackedReverseMove(reverseMove);
                 // m_hash[0] is the most significant quad, m_hash[3] is the least significant
                 // We want entries ordered with reverse move to also be ordered by just hash
                 // so we have to modify the lowest bits.
@@ -53,7 +59,12 @@ namespace persistence
             }
 
             Key(const PositionWithZobrist& pos, const ReverseMove& reverseMove, GameLevel level, GameResult result) :
-                Key(pos, reverseMove)
+                Key(pos.zobrist(), PackedReverseMove(reverseMove), level, result)
+            {
+            }
+
+            Key(const ZobristKey& zobrist, PackedReverseMove packedReverseMove, GameLevel level, GameResult result) :
+                Key(zobrist, packedReverseMove)
             {
                 m_hash[3] |=
                     ((ordinal(level) & levelMask) << levelShift)
@@ -387,12 +398,22 @@ namespace persistence
 
         struct Entry
         {
+            // Starts with 8 bytes of the hash, see HashPrefixScan.h.
+            static constexpr bool hasLeadingHashPrefix = true;
+
             using GameIndexType = std::uint32_t;
 
             Entry() = default;
 
             Entry(const EntryConstructionParameters& params) :
-                m_key(params.position, params.reverseMove, params.level, params.result),
+                Entry(params, params.position.zobrist(), PackedReverseMove(params.reverseMove))
+            {
+            }
+
+            // Doesn't look at params.position, so that entries can be
+            // constructed from precomputed keys, see bcgn::BcgnPositionKey.
+            Entry(const EntryConstructionParameters& params, const ZobristKey& zobrist, PackedReverseMove packedReverseMove) :
+                m_key(zobrist, packedReverseMove, params.level, params.result),
                 m_countAndGameOffset(SingleGame{}, params.gameIndexOrOffset)
             {
             }
@@ -18,6 +18,9 @@ namespace persistence
         // Have ranges of mixed values be at most this long
         struct alignas(32) Entry
         {
+            // Starts with 8 bytes of the hash, see HashPrefixScan.h.
+            static constexpr bool hasLeadingHashPrefix = true;
+
             // Hash              : 64
             // Elo diff + Hash   : 40 + 24
             // PackedReverseMove : 27, GameLevel : 2, GameResult : 2, padding : 1
@@ -44,6 +47,26 @@ namespace persistence
 
             static_assert(PackedReverseMove::numBits + levelBits + resultBits <= 32);
 
+            // The entry split into two halves. The key part has everything
+            // needed for comparisons, the payload part only the rest.
+            // Hash part 2 and the lowest 8 bits of elo diff : 32, Packed info : 32
+            struct KeyPart
+            {
+                std::uint64_t hashPart1;
+                std::uint64_t hashPart2AndPackedInfo;
+            };
+
+            struct PayloadPart
+            {
+                // The higher 32 bits of elo diff.
+                std::uint32_t eloDiffHigh;
+                std::uint32_t count;
+                std::uint32_t firstGameIndex;
+                std::uint32_t lastGameIndex;
+            };
+
+            static_assert(sizeof(KeyPart) + sizeof(PayloadPart) == 32);
+
             Entry() :
                 m_hashPart1{},
                 m_eloDiffAndHashPart2(0),
@@ -71,17 +94,22 @@ namespace persistence
             }
 
             Entry(const EntryConstructionParameters& params) :
+                Entry(params, params.position.zobrist(), PackedReverseMove(params.reverseMove))
+            {
+            }
+
+            // Doesn't look at params.position, so that entries can be
+            // constructed from precomputed keys, see bcgn::BcgnPositionKey.
+            Entry(const EntryConstructionParameters& params, const ZobristKey& zobrist, PackedReverseMove packedReverseMove) :
                 m_count(1),
                 m_firstGameIndex(static_cast<std::uint32_t>(params.gameIndexOrOffset)),
                 m_lastGameIndex(static_cast<std::uint32_t>(params.gameIndexOrOffset))
             {
-                const auto zobrist = params.position.zobrist();
                 m_hashPart1 = zobrist.high;
                 m_eloDiffAndHashPart2 =
                     (static_cast<std::uint64_t>(params.eloDiff()) << additionalHashBits)
                     | (zobrist.low & nbitmask<std::uint64_t>[additionalHashBits]);
 
-                auto packedReverseMove = PackedReverseMove(params.reverseMove);
                 // m_hash[0] is the most significant quad, m_hash[3] is the least significant
                 // We want entries ordered with reverse move to also be ordered by just hash
                 // so we have to modify the lowest bits.
@@ -91,6 +119,18 @@ namespace persistence
                     | ((ordinal(params.result) & resultMask) << resultShift);
             }
 
+            Entry(const KeyPart& keyPart, const PayloadPart& payloadPart) :
+                m_hashPart1(keyPart.hashPart1),
+                m_eloDiffAndHashPart2(
+                    (static_cast<std::uint64_t>(payloadPart.eloDiffHigh) << 32)
+                    | (keyPart.hashPart2AndPackedInfo >> 32)),
+                m_packedInfo(static_cast<std::uint32_t>(keyPart.hashPart2AndPackedInfo)),
+                m_count(payloadPart.count),
+                m_firstGameIndex(payloadPart.firstGameIndex),
+                m_lastGameIndex(payloadPart.lastGameIndex)
+            {
+            }
+
             Entry(const Entry&) = default;
             Entry(Entry&&) = default;
             Entry& operator=(const Entry&) = default;
@@ -121,6 +161,24 @@ namespace persistence
                 return *this;
             }
 
+            [[nodiscard]] KeyPart keyPart() const
+            {
+                return KeyPart{
+                    m_hashPart1,
+                    ((m_eloDiffAndHashPart2 & nbitmask<std::uint64_t>[32]) << 32) | m_packedInfo
+                };
+            }
+
+            [[nodiscard]] PayloadPart payloadPart() const
+            {
+                return PayloadPart{
+                    static_cast<std::uint32_t>(m_eloDiffAndHashPart2 >> 32),
+                    m_count,
+                    m_firstGameIndex,
+                    m_lastGameIndex
+                };
+            }
+
             [[nodiscard]] std::uint32_t count() const
             {
                 return m_count;
@@ -0,0 +1,13 @@
+#include "DatabaseFormatDeltaPax.h"
+
+namespace persistence
+{
+    namespace db_delta_pax
+    {
+        template struct persistence::pos_db::OrderedEntrySetPositionDatabase<
+            Key,
+            Entry,
+            Traits
+        >;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "DatabaseFormatDelta.h"
+
+#include "persistence/pos_db/OrderedEntrySetPositionDatabase.h"
+
+#include "util/Assert.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace persistence
+{
+    namespace db_delta_pax
+    {
+        // Same entries as db_delta.
+        using Key = db_delta::Key;
+        using Entry = db_delta::Entry;
+
+        // Each block stores the key parts of all its entries followed by
+        // the payload parts of all its entries. Finding the entries for a position
+        // only touches the keys, the payloads are read only for the matching ones.
+        // The blocks have the same size as the uncompressed entries.
+        struct BlockCodec
+        {
+            static constexpr bool hasKeyColumn = true;
+
+            static void encode(const Entry* entries, std::size_t count, std::vector<std::byte>& out)
+            {
+                ASSERT(count > 0);
+
+                const std::size_t offset = out.size();
+                out.resize(offset + count * sizeof(Entry));
+
+                std::byte* keys = out.data() + offset;
+                std::byte* payloads = keys + count * sizeof(Entry::KeyPart);
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    const auto keyPart = entries[i].keyPart();
+                    const auto payloadPart = entries[i].payloadPart();
+                    std::memcpy(keys + i * sizeof(Entry::KeyPart), &keyPart, sizeof(Entry::KeyPart));
+                    std::memcpy(payloads + i * sizeof(Entry::PayloadPart), &payloadPart, sizeof(Entry::PayloadPart));
+                }
+            }
+
+            static void decode(const std::byte* data, std::size_t size, Entry* out, std::size_t count)
+            {
+                ASSERT(size == count * sizeof(Entry));
+                (void)size;
+
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    out[i] = Entry(readKeyPart(data, i), readPayloadPart(data, count, i));
+                }
+            }
+
+            // Appends to `out` the entries from [from, to) for which pred returns true.
+            // pred is given the entry with only the key part set.
+            template <typename PredT>
+            static void decodeMatching(
+                const std::byte* data,
+                std::size_t size,
+                std::size_t count,
+                std::size_t from,
+                std::size_t to,
+                PredT&& pred,
+                std::vector<Entry>& out
+            )
+            {
+                ASSERT(size == count * sizeof(Entry));
+                ASSERT(from <= to && to <= count);
+                (void)size;
+
+                for (std::size_t i = from; i < to; ++i)
+                {
+                    const auto keyPart = readKeyPart(data, i);
+                    if (!pred(Entry(keyPart, Entry::PayloadPart{})))
+                    {
+                        continue;
+                    }
+
+                    out.emplace_back(keyPart, readPayloadPart(data, count, i));
+                }
+            }
+
+        private:
+            [[nodiscard]] static Entry::KeyPart readKeyPart(const std::byte* data, std::size_t idx)
+            {
+                Entry::KeyPart keyPart;
+                std::memcpy(&keyPart, data + idx * sizeof(Entry::KeyPart), sizeof(Entry::KeyPart));
+                return keyPart;
+            }
+
+            [[nodiscard]] static Entry::PayloadPart readPayloadPart(const std::byte* data, std::size_t count, std::size_t idx)
+            {
+                Entry::PayloadPart payloadPart;
+                std::memcpy(
+                    &payloadPart,
+                    data + count * sizeof(Entry::KeyPart) + idx * sizeof(Entry::PayloadPart),
+                    sizeof(Entry::PayloadPart)
+                );
+                return payloadPart;
+            }
+        };
+
+        struct Traits
+        {
+            static constexpr const char* name = "db_delta_pax";
+
+            using BlockCodecType = BlockCodec;
+
+            static constexpr bool hasDictionaryEncodedHeaders = true;
+
+            static constexpr std::uint64_t maxGames = 1ull << 32ull;
+            static constexpr std::uint64_t maxPositions = 1ull << 40ull;
+            static constexpr std::uint64_t maxInstancesOfSinglePosition = 1ull << 32ull;
+
+            static constexpr bool hasOneWayKey = true;
+            static constexpr std::uint64_t estimatedMaxCollisions = 0;
+            static constexpr std::uint64_t estimatedMaxPositionsWithNoCollisions = maxPositions;
+
+            static constexpr bool hasCount = true;
+
+            static constexpr bool hasEloDiff = true;
+            static constexpr std::uint64_t maxAbsEloDiff = 4000;
+            static constexpr std::uint64_t maxAverageAbsEloDiff = 256;
+
+            static constexpr bool hasWhiteElo = false;
+            static constexpr bool hasBlackElo = false;
+            static constexpr std::uint64_t minElo = 0;
+            static constexpr std::uint64_t maxElo = 0;
+            static constexpr bool hasCountWithElo = false;
+
+            static constexpr bool hasFirstGame = true;
+            static constexpr bool hasLastGame = true;
+
+            static constexpr bool allowsFilteringTranspositions = true;
+            static constexpr bool hasReverseMove = true;
+
+            static constexpr bool allowsFilteringByEloRange = false;
+            static constexpr std::uint64_t eloFilterGranularity = 0;
+
+            static constexpr bool allowsFilteringByMonthRange = false;
+            static constexpr std::uint64_t monthFilterGranularity = 0;
+
+            static constexpr std::uint64_t maxBytesPerPosition = 32;
+            static constexpr std::optional<double> estimatedAverageBytesPerPosition = 26.0;
+
+            static constexpr util::SemanticVersion version{ 1, 0, 0 };
+            static constexpr util::SemanticVersion minimumSupportedVersion{ 1, 0, 0 };
+        };
+
+        using Database = persistence::pos_db::OrderedEntrySetPositionDatabase<
+            Key,
+            Entry,
+            Traits
+        >;
+
+        extern template struct persistence::pos_db::OrderedEntrySetPositionDatabase<
+            Key,
+            Entry,
+            Traits
+        >;
+
+        static_assert(Database::hasCompressedBlocks);
+        static_assert(Database::hasKeyColumn);
+        static_assert(Database::hasDictionaryEncodedHeaders);
+
+        static_assert(Database::hasEloDiff);
+        static_assert(!Database::hasWhiteElo);
+        static_assert(!Database::hasBlackElo);
+        static_assert(!Database::hasCountWithElo);
+        static_assert(Database::hasFirstGameIndex);
+        static_assert(Database::hasLastGameIndex);
+        static_assert(!Database::hasFirstGameOffset);
+        static_assert(!Database::hasLastGameOffset);
+        static_assert(Database::hasReverseMove);
+
+        static_assert(!Database::allowsFilteringByEloRange);
+        static_assert(!Database::allowsFilteringByMonthRange);
+    }
+}
@@ -208,6 +208,9 @@ namespace persistence
 
         struct Key
         {
+            // Starts with 8 bytes of the hash, see HashPrefixScan.h.
+            static constexpr bool hasLeadingHashPrefix = true;
+
             // Hash:72, ReverseMovePerfectHash:20, GameLevel:2, GameResult:2
 
             static constexpr std::size_t levelBits = 2;
@@ -225,6 +228,11 @@ namespace persistence
 
             Key() = default;
 
+            Key(const StorageType& hash) :
+                m_hash(hash)
+            {
+            }
+
             Key(const PositionWithZobrist& pos, const ReverseMove& reverseMove = ReverseMove{})
             {
                 const auto zobrist = pos.zobrist();
@@ -356,6 +364,9 @@ namespace persistence
 
         struct Entry
         {
+            // Starts with 8 bytes of the hash, see HashPrefixScan.h.
+            static constexpr bool hasLeadingHashPrefix = true;
+
             Entry() = default;
 
             Entry(const EntryConstructionParameters& params) :
@@ -364,6 +375,12 @@ namespace persistence
             {
             }
 
+            Entry(const Key& key, std::uint32_t count) :
+                m_key(key),
+                m_count(count)
+            {
+            }
+
             Entry(const Entry&) = default;
             Entry(Entry&&) = default;
             Entry& operator=(const Entry&) = default;
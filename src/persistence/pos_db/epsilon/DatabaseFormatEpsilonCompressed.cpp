@@ -0,0 +1,13 @@
+#include "DatabaseFormatEpsilonCompressed.h"
+
+namespace persistence
+{
+    namespace db_epsilon_compressed
+    {
+        template struct persistence::pos_db::OrderedEntrySetPositionDatabase<
+            Key,
+            Entry,
+            Traits
+        >;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,264 @@
+#pragma once
+
+#include "DatabaseFormatEpsilon.h"
+
+#include "coding/BitStream.h"
+#include "coding/Coding.h"
+
+#include "persistence/pos_db/OrderedEntrySetPositionDatabase.h"
+
+#include "util/ArithmeticUtility.h"
+#include "util/Assert.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace persistence
+{
+    namespace db_epsilon_compressed
+    {
+        // Same entries as db_epsilon.
+        using Key = db_epsilon::Key;
+        using Entry = db_epsilon::Entry;
+
+        // Entries are sorted by the whole key, so we store differences of consecutive keys.
+        // Block layout (bits, most significant first):
+        //   header: the first key (3 x 32 bits), rice parameter k (6 bits)
+        //   the count of the first entry
+        //   then for each following entry:
+        //     1 bit - whether the 64 bit hash prefix is the same as in the previous entry
+        //     if same: low hash part delta - 1, variable length coded
+        //     else: hash prefix delta - 1, rice coded with parameter k
+        //           (quotient elias gamma coded, then k low bits), followed by the raw low hash part
+        //     count - 1, elias gamma coded
+        // Most counts are 1 so they take a single bit.
+        struct BlockCodec
+        {
+            static constexpr std::size_t riceParameterBits = 6;
+
+            // Upper bound of the size of an encoded entry, from the widths of its fields.
+            // When the hash prefix changes the rice coded delta is the longest for k = 0,
+            // when it's elias gamma coded whole.
+            static constexpr std::size_t maxEncodedEntryBits =
+                1
+                + std::max(
+                    bit::CompressedSizeUpperBound<bit::VariableLengthCoding<7>, std::uint32_t>::value,
+                    bit::CompressedSizeUpperBound<bit::EliasGammaCoding, std::uint64_t>::value + 32
+                )
+                + bit::CompressedSizeUpperBound<bit::EliasGammaCoding, std::uint32_t>::value;
+
+            static constexpr std::size_t maxEncodedEntryBytes = (maxEncodedEntryBits + CHAR_BIT - 1) / CHAR_BIT;
+
+            // The first entry of a block, together with the padding
+            // of the block to whole bytes, must fit in the same bound.
+            static_assert(
+                3 * 32 + riceParameterBits
+                + bit::CompressedSizeUpperBound<bit::EliasGammaCoding, std::uint32_t>::value
+                + (CHAR_BIT - 1)
+                <= maxEncodedEntryBits
+            );
+
+            static void encode(const Entry* entries, std::size_t count, std::vector<std::byte>& out)
+            {
+                ASSERT(count > 0);
+
+                const std::size_t k = riceParameter(entries, count);
+
+                bit::BitStream<> bs;
+
+                const auto& firstHash = entries[0].key().hash();
+                bs.writeBits(firstHash[0], 32);
+                bs.writeBits(firstHash[1], 32);
+                bs.writeBits(firstHash[2], 32);
+                bs.writeBits(k, riceParameterBits);
+                bit::EliasGammaCoding{}.compress(bs, entries[0].count() - 1u);
+
+                for (std::size_t i = 1; i < count; ++i)
+                {
+                    const auto& prevHash = entries[i - 1].key().hash();
+                    const auto& hash = entries[i].key().hash();
+
+                    const std::uint64_t prevPrefix = hashPrefix(prevHash);
+                    const std::uint64_t prefix = hashPrefix(hash);
+
+                    ASSERT(prefix >= prevPrefix);
+
+                    if (prefix == prevPrefix)
+                    {
+                        ASSERT(hash[2] > prevHash[2]);
+
+                        bs.writeBit(true);
+                        bit::VariableLengthCoding<7>{}.compress(bs, hash[2] - prevHash[2] - 1u);
+                    }
+                    else
+                    {
+                        const std::uint64_t delta = prefix - prevPrefix - 1u;
+
+                        bs.writeBit(false);
+                        bit::EliasGammaCoding{}.compress(bs, delta >> k);
+                        bs.writeBits(delta, k);
+                        bs.writeBits(hash[2], 32);
+                    }
+
+                    bit::EliasGammaCoding{}.compress(bs, entries[i].count() - 1u);
+                }
+
+                const std::size_t offset = out.size();
+                out.resize(offset + bs.numBytes());
+                bs.getBytes(out.data() + offset);
+            }
+
+            static void decode(const std::byte* data, std::size_t size, Entry* out, std::size_t count)
+            {
+                ASSERT(count > 0);
+
+                bit::BitStream<> bs;
+                bs.setBytes(data, size);
+                bit::BitStreamSequentialReader<bit::BitStream<>> reader(bs);
+
+                Key::StorageType hash;
+                hash[0] = static_cast<std::uint32_t>(reader.readBits(32));
+                hash[1] = static_cast<std::uint32_t>(reader.readBits(32));
+                hash[2] = static_cast<std::uint32_t>(reader.readBits(32));
+                const std::size_t k = static_cast<std::size_t>(reader.readBits(riceParameterBits));
+                out[0] = Entry(Key(hash), readCount(reader));
+
+                std::uint64_t prefix = hashPrefix(hash);
+                for (std::size_t i = 1; i < count; ++i)
+                {
+                    if (reader.readBit())
+                    {
+                        hash[2] += bit::VariableLengthCoding<7>{}.decompress(reader, util::meta::Type<std::uint32_t>{}) + 1u;
+                    }
+                    else
+                    {
+                        std::uint64_t delta = bit::EliasGammaCoding{}.decompress(reader, util::meta::Type<std::uint64_t>{}) << k;
+                        delta |= reader.readBits(k);
+
+                        prefix += delta + 1u;
+                        hash[0] = static_cast<std::uint32_t>(prefix >> 32);
+                        hash[1] = static_cast<std::uint32_t>(prefix);
+                        hash[2] = static_cast<std::uint32_t>(reader.readBits(32));
+                    }
+
+                    out[i] = Entry(Key(hash), readCount(reader));
+                }
+            }
+
+        private:
+            [[nodiscard]] static std::uint64_t hashPrefix(const Key::StorageType& hash)
+            {
+                return (static_cast<std::uint64_t>(hash[0]) << 32) | hash[1];
+            }
+
+            template <typename ReaderT>
+            [[nodiscard]] static std::uint32_t readCount(ReaderT& reader)
+            {
+                return bit::EliasGammaCoding{}.decompress(reader, util::meta::Type<std::uint32_t>{}) + 1u;
+            }
+
+            // For geometrically distributed values the optimal rice parameter
+            // is close to log2 of their mean.
+            [[nodiscard]] static std::size_t riceParameter(const Entry* entries, std::size_t count)
+            {
+                // Averaging the deltas directly could overflow.
+                // The first and the last prefix bound their sum.
+                std::size_t numDeltas = 0;
+                for (std::size_t i = 1; i < count; ++i)
+                {
+                    if (hashPrefix(entries[i].key().hash()) != hashPrefix(entries[i - 1].key().hash()))
+                    {
+                        numDeltas += 1;
+                    }
+                }
+
+                if (numDeltas == 0)
+                {
+                    return 0;
+                }
+
+                const std::uint64_t span =
+                    hashPrefix(entries[count - 1].key().hash())
+                    - hashPrefix(entries[0].key().hash());
+                const std::uint64_t mean = span / numDeltas;
+
+                return mean > 1 ? floorLog2(mean) : 0;
+            }
+        };
+
+        struct Traits
+        {
+            static constexpr const char* name = "db_epsilon_compressed";
+
+            using BlockCodecType = BlockCodec;
+
+            static constexpr std::uint64_t maxGames = 1ull << 32ull;
+            static constexpr std::uint64_t maxPositions = 1ull << 40ull;
+            static constexpr std::uint64_t maxInstancesOfSinglePosition = 1ull << 32ull;
+
+            static constexpr bool hasOneWayKey = true;
+            static constexpr std::uint64_t estimatedMaxCollisions = 100;
+            static constexpr std::uint64_t estimatedMaxPositionsWithNoCollisions = 80'000'000'000ull;
+
+            static constexpr bool hasCount = true;
+
+            static constexpr bool hasEloDiff = false;
+            static constexpr std::uint64_t maxAbsEloDiff = 0;
+            static constexpr std::uint64_t maxAverageAbsEloDiff = 0;
+
+            static constexpr bool hasWhiteElo = false;
+            static constexpr bool hasBlackElo = false;
+            static constexpr std::uint64_t minElo = 0;
+            static constexpr std::uint64_t maxElo = 0;
+            static constexpr bool hasCountWithElo = false;
+
+            static constexpr bool hasFirstGame = false;
+            static constexpr bool hasLastGame = false;
+
+            static constexpr bool allowsFilteringTranspositions = true;
+            static constexpr bool hasReverseMove = true;
+
+            static constexpr bool allowsFilteringByEloRange = false;
+            static constexpr std::uint64_t eloFilterGranularity = 0;
+
+            static constexpr bool allowsFilteringByMonthRange = false;
+            static constexpr std::uint64_t monthFilterGranularity = 0;
+
+            static constexpr std::uint64_t maxBytesPerPosition = BlockCodec::maxEncodedEntryBytes;
+            static constexpr std::optional<double> estimatedAverageBytesPerPosition = 9.0;
+
+            static constexpr util::SemanticVersion version{ 1, 0, 0 };
+            static constexpr util::SemanticVersion minimumSupportedVersion{ 1, 0, 0 };
+        };
+
+        using Database = persistence::pos_db::OrderedEntrySetPositionDatabase<
+            Key,
+            Entry,
+            Traits
+        >;
+
+        extern template struct persistence::pos_db::OrderedEntrySetPositionDatabase<
+            Key,
+            Entry,
+            Traits
+        >;
+
+        static_assert(Database::hasCompressedBlocks);
+
+        static_assert(!Database::hasEloDiff);
+        static_assert(!Database::hasWhiteElo);
+        static_assert(!Database::hasBlackElo);
+        static_assert(!Database::hasCountWithElo);
+        static_assert(!Database::hasFirstGameIndex);
+        static_assert(!Database::hasLastGameIndex);
+        static_assert(!Database::hasFirstGameOffset);
+        static_assert(!Database::hasLastGameOffset);
+        static_assert(Database::hasReverseMove);
+
+        static_assert(!Database::allowsFilteringByEloRange);
+        static_assert(!Database::allowsFilteringByMonthRange);
+    }
+}
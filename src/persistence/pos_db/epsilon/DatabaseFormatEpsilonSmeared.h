@@ -214,6 +214,9 @@ namespace persistence
 
         struct SmearedEntry
         {
+            // Starts with 8 bytes of the hash, see HashPrefixScan.h.
+            static constexpr bool hasLeadingHashPrefix = true;
+
             /*
                 - 64 bits hash
 
@@ -181,29 +181,23 @@ namespace lookup
     }();
 }
 
+// The index of the n-th (counting from 0) set bit. v must have more than n set bits.
+// The popcounts of all bytes up to each one are computed at once and compared to n,
+// so only the byte with the bit is looked up. None of it depends on n before the compare.
 inline int nthSetBitIndex(std::uint64_t v, std::uint64_t n)
 {
-    std::uint64_t shift = 0;
-
-    std::uint64_t p = intrin::popcount(v & 0xFFFFFFFFull);
-    std::uint64_t pmask = static_cast<std::uint64_t>(p > n) - 1ull;
-    v >>= 32 & pmask;
-    shift += 32 & pmask;
-    n -= p & pmask;
-
-    p = intrin::popcount(v & 0xFFFFull);
-    pmask = static_cast<std::uint64_t>(p > n) - 1ull;
-    v >>= 16 & pmask;
-    shift += 16 & pmask;
-    n -= p & pmask;
-
-    p = intrin::popcount(v & 0xFFull);
-    pmask = static_cast<std::uint64_t>(p > n) - 1ull;
-    shift += 8 & pmask;
-    v >>= 8 & pmask;
-    n -= p & pmask;
-
-    return static_cast<int>(lookup::nthSetBitIndex[v & 0xFFull][n] + shift);
+    constexpr std::uint64_t lowBytes = 0x0101010101010101ull;
+    constexpr std::uint64_t highBits = 0x8080808080808080ull;
+
+    std::uint64_t sums = v - ((v >> 1) & 0x5555555555555555ull);
+    sums = (sums & 0x3333333333333333ull) + ((sums >> 2) & 0x3333333333333333ull);
+    sums = ((sums + (sums >> 4)) & 0x0F0F0F0F0F0F0F0Full) * lowBytes;
+
+    // The bytes up to which there are at most n set bits precede the one with the bit.
+    const std::uint64_t shift = intrin::popcount((((n * lowBytes) | highBits) - sums) & highBits) * 8ull;
+    const std::uint64_t nthInByte = n - (((sums << 8) >> shift) & 0xFFull);
+
+    return static_cast<int>(lookup::nthSetBitIndex[(v >> shift) & 0xFFull][nthInByte] + shift);
 }
 
 namespace util
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "util/Assert.h"
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace util
+{
+    // Keeps at most `capacity` values, when full the least recently
+    // used one is dropped to make space for a new one.
+    // Capacity of 0 disables caching.
+    template <typename KeyT, typename ValueT>
+    struct LruCache
+    {
+        LruCache(std::size_t capacity) :
+            m_capacity(capacity)
+        {
+        }
+
+        LruCache(const LruCache&) = delete;
+        LruCache(LruCache&&) noexcept = default;
+
+        LruCache& operator=(const LruCache&) = delete;
+        LruCache& operator=(LruCache&&) noexcept = default;
+
+        [[nodiscard]] std::size_t capacity() const
+        {
+            return m_capacity;
+        }
+
+        [[nodiscard]] std::size_t size() const
+        {
+            return m_values.size();
+        }
+
+        // Returns nullptr if the value is not cached.
+        // The pointer is valid until the next insert or clear.
+        [[nodiscard]] const ValueT* get(const KeyT& key)
+        {
+            auto it = m_positions.find(key);
+            if (it == m_positions.end())
+            {
+                return nullptr;
+            }
+
+            m_values.splice(m_values.begin(), m_values, it->second);
+            return &it->second->second;
+        }
+
+        void insert(const KeyT& key, ValueT value)
+        {
+            if (m_capacity == 0)
+            {
+                return;
+            }
+
+            auto it = m_positions.find(key);
+            if (it != m_positions.end())
+            {
+                it->second->second = std::move(value);
+                m_values.splice(m_values.begin(), m_values, it->second);
+                return;
+            }
+
+            if (m_values.size() == m_capacity)
+            {
+                m_positions.erase(m_values.back().first);
+                m_values.pop_back();
+            }
+
+            m_values.emplace_front(key, std::move(value));
+            m_positions.emplace(key, m_values.begin());
+
+            ASSERT(m_values.size() == m_positions.size());
+        }
+
+        void clear()
+        {
+            m_values.clear();
+            m_positions.clear();
+        }
+
+    private:
+        std::size_t m_capacity;
+
+        // The most recently used at the front.
+        std::list<std::pair<KeyT, ValueT>> m_values;
+        std::unordered_map<KeyT, typename std::list<std::pair<KeyT, ValueT>>::iterator> m_positions;
+    };
+}
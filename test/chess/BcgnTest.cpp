@@ -5,7 +5,11 @@
 #include "chess/MoveGenerator.h"
 
 #include <cstdlib>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
 
 void testBcgnWriter(int seed, std::string filename, bcgn::BcgnFileHeader header, int numGames, bcgn::BcgnFileWriter::FileOpenMode mode = bcgn::BcgnFileWriter::FileOpenMode::Truncate)
 {
@@ -67,11 +71,11 @@ void testBcgnWriter(int seed, std::string filename, bcgn::BcgnFileHeader header,
     }
 }
 
-void testBcgnReader(int seed, std::string filename, bcgn::BcgnFileHeader header, int numGames, bcgn::BcgnFileWriter::FileOpenMode mode = bcgn::BcgnFileWriter::FileOpenMode::Truncate)
+void testBcgnReader(int seed, std::string filename, bcgn::BcgnFileHeader header, int numGames, bcgn::BcgnFileReader::ReadMode readMode = bcgn::BcgnFileReader::ReadMode::Buffered)
 {
     srand(seed);
 
-    bcgn::BcgnFileReader reader(filename);
+    bcgn::BcgnFileReader reader(filename, bcgn::traits::minBufferSize, readMode);
 
     int i = 0;
     for (auto& game : reader)
@@ -153,6 +157,8 @@ TEST_CASE("BCGN reader and writer", "[bcgn]")
         testBcgnWriter(seed, "test_out/test_v0_c0_ac0.bcgn", header, numGames);
         std::cerr << "read test_out/test_v0_c0_ac0.bcgn\n";
         testBcgnReader(seed, "test_out/test_v0_c0_ac0.bcgn", header, numGames);
+        std::cerr << "read mapped test_out/test_v0_c0_ac0.bcgn\n";
+        testBcgnReader(seed, "test_out/test_v0_c0_ac0.bcgn", header, numGames, bcgn::BcgnFileReader::ReadMode::MemoryMapped);
     }
 
     {
@@ -165,6 +171,22 @@ TEST_CASE("BCGN reader and writer", "[bcgn]")
         testBcgnWriter(seed, "test_out/test_v0_c1_ac0.bcgn", header, numGames);
         std::cerr << "read test_out/test_v0_c1_ac0.bcgn\n";
         testBcgnReader(seed, "test_out/test_v0_c1_ac0.bcgn", header, numGames);
+        std::cerr << "read mapped test_out/test_v0_c1_ac0.bcgn\n";
+        testBcgnReader(seed, "test_out/test_v0_c1_ac0.bcgn", header, numGames, bcgn::BcgnFileReader::ReadMode::MemoryMapped);
+    }
+
+    {
+        auto header = bcgn::BcgnFileHeader{};
+        header.auxCompression = bcgn::BcgnAuxCompression::None;
+        header.compressionLevel = bcgn::BcgnCompressionLevel::Level_2;
+        header.version = bcgn::BcgnVersion::Version_0;
+        header.isHeaderless = false;
+        std::cerr << "write test_out/test_v0_c2_ac0.bcgn\n";
+        testBcgnWriter(seed, "test_out/test_v0_c2_ac0.bcgn", header, numGames);
+        std::cerr << "read test_out/test_v0_c2_ac0.bcgn\n";
+        testBcgnReader(seed, "test_out/test_v0_c2_ac0.bcgn", header, numGames);
+        std::cerr << "read mapped test_out/test_v0_c2_ac0.bcgn\n";
+        testBcgnReader(seed, "test_out/test_v0_c2_ac0.bcgn", header, numGames, bcgn::BcgnFileReader::ReadMode::MemoryMapped);
     }
 
     {
@@ -177,6 +199,8 @@ TEST_CASE("BCGN reader and writer", "[bcgn]")
         testBcgnWriter(seed, "test_out/test_v0_c0_ac0_headerless.bcgn", header, numGames);
         std::cerr << "read test_out/test_v0_c0_ac0_headerless.bcgn\n";
         testBcgnReader(seed, "test_out/test_v0_c0_ac0_headerless.bcgn", header, numGames);
+        std::cerr << "read mapped test_out/test_v0_c0_ac0_headerless.bcgn\n";
+        testBcgnReader(seed, "test_out/test_v0_c0_ac0_headerless.bcgn", header, numGames, bcgn::BcgnFileReader::ReadMode::MemoryMapped);
     }
 
     {
@@ -189,6 +213,22 @@ TEST_CASE("BCGN reader and writer", "[bcgn]")
         testBcgnWriter(seed, "test_out/test_v0_c1_ac0_headerless.bcgn", header, numGames);
         std::cerr << "read test_out/test_v0_c1_ac0_headerless.bcgn\n";
         testBcgnReader(seed, "test_out/test_v0_c1_ac0_headerless.bcgn", header, numGames);
+        std::cerr << "read mapped test_out/test_v0_c1_ac0_headerless.bcgn\n";
+        testBcgnReader(seed, "test_out/test_v0_c1_ac0_headerless.bcgn", header, numGames, bcgn::BcgnFileReader::ReadMode::MemoryMapped);
+    }
+
+    {
+        auto header = bcgn::BcgnFileHeader{};
+        header.auxCompression = bcgn::BcgnAuxCompression::None;
+        header.compressionLevel = bcgn::BcgnCompressionLevel::Level_2;
+        header.version = bcgn::BcgnVersion::Version_0;
+        header.isHeaderless = true;
+        std::cerr << "write test_out/test_v0_c2_ac0_headerless.bcgn\n";
+        testBcgnWriter(seed, "test_out/test_v0_c2_ac0_headerless.bcgn", header, numGames);
+        std::cerr << "read test_out/test_v0_c2_ac0_headerless.bcgn\n";
+        testBcgnReader(seed, "test_out/test_v0_c2_ac0_headerless.bcgn", header, numGames);
+        std::cerr << "read mapped test_out/test_v0_c2_ac0_headerless.bcgn\n";
+        testBcgnReader(seed, "test_out/test_v0_c2_ac0_headerless.bcgn", header, numGames, bcgn::BcgnFileReader::ReadMode::MemoryMapped);
     }
 
     {
@@ -201,4 +241,289 @@ TEST_CASE("BCGN reader and writer", "[bcgn]")
         std::cerr << "append test_out/test_append.bcgn\n";
         testBcgnWriter(seed, "test_out/test_append.bcgn", header, numGames, bcgn::BcgnFileWriter::FileOpenMode::Append);
     }
-}
\ No newline at end of file
+}
+static std::vector<int> readRounds(bcgn::BcgnFileReader& reader)
+{
+    std::vector<int> rounds;
+    for (auto& game : reader)
+    {
+        rounds.emplace_back(game.gameHeader().round());
+    }
+    return rounds;
+}
+
+TEST_CASE("BCGN game offset directory", "[bcgn]")
+{
+    constexpr int numGames = 256 * 8 + 100;
+    constexpr int seed = 12345;
+
+    const std::string path = "test_out/test_offset_directory.bcgn";
+
+    auto header = bcgn::BcgnFileHeader{};
+    header.compressionLevel = bcgn::BcgnCompressionLevel::Level_1;
+    header.hasGameOffsetDirectory = true;
+    testBcgnWriter(seed, path, header, numGames);
+    testBcgnReader(seed, path, header, numGames);
+
+    for (auto readMode : { bcgn::BcgnFileReader::ReadMode::Buffered, bcgn::BcgnFileReader::ReadMode::MemoryMapped })
+    {
+        bcgn::BcgnFileReader reader(path, bcgn::traits::minBufferSize, readMode);
+        REQUIRE(reader.hasGameOffsetDirectory());
+        REQUIRE(reader.numGames() == numGames);
+
+        // Rounds are the game indices.
+        for (int gameIdx : { 0, 1, 255, 256, 257, 1000, numGames - 1, numGames })
+        {
+            reader.seekToGame(gameIdx);
+            const auto rounds = readRounds(reader);
+            REQUIRE(rounds.size() == numGames - gameIdx);
+            for (std::size_t i = 0; i < rounds.size(); ++i)
+            {
+                REQUIRE(rounds[i] == gameIdx + i);
+            }
+        }
+
+        for (std::size_t n : { 1, 3, 7, 100 })
+        {
+            const auto ranges = reader.splitIntoRanges(n);
+            REQUIRE(!ranges.empty());
+            REQUIRE(ranges.size() <= n);
+
+            std::size_t nextGameIdx = 0;
+            for (auto&& range : ranges)
+            {
+                REQUIRE(range.firstGameIdx == nextGameIdx);
+
+                bcgn::BcgnFileReader rangeReader(path, bcgn::traits::minBufferSize, readMode);
+                rangeReader.setRange(range);
+                const auto rounds = readRounds(rangeReader);
+                REQUIRE(rounds.size() == range.numGames);
+                for (std::size_t i = 0; i < rounds.size(); ++i)
+                {
+                    REQUIRE(rounds[i] == range.firstGameIdx + i);
+                }
+
+                nextGameIdx += range.numGames;
+            }
+            REQUIRE(nextGameIdx == numGames);
+        }
+    }
+
+    // The directory is updated when appending.
+    testBcgnWriter(seed, path, header, numGames, bcgn::BcgnFileWriter::FileOpenMode::Append);
+    {
+        bcgn::BcgnFileReader reader(path);
+        REQUIRE(reader.hasGameOffsetDirectory());
+        REQUIRE(reader.numGames() == 2 * numGames);
+
+        reader.seekToGame(numGames + 5);
+        REQUIRE(readRounds(reader).front() == 5);
+    }
+
+    // And rebuilt when it's missing.
+    std::filesystem::remove(bcgn::BcgnGameOffsetDirectory::pathFor(path));
+    {
+        bcgn::BcgnFileReader reader(path);
+        REQUIRE(!reader.hasGameOffsetDirectory());
+    }
+    testBcgnWriter(seed, path, header, numGames, bcgn::BcgnFileWriter::FileOpenMode::Append);
+    {
+        bcgn::BcgnFileReader reader(path);
+        REQUIRE(reader.hasGameOffsetDirectory());
+        REQUIRE(reader.numGames() == 3 * numGames);
+
+        reader.seekToGame(2 * numGames + 300);
+        REQUIRE(readRounds(reader).front() == 300);
+    }
+}
+
+TEST_CASE("BCGN aux compression", "[bcgn]")
+{
+    constexpr int numGames = 1000;
+    constexpr int seed = 12345;
+
+    const std::string path = "test_out/test_aux_compression.bcgn";
+    const std::string uncompressedPath = "test_out/test_aux_compression_none.bcgn";
+
+    for (auto compressionLevel : { bcgn::BcgnCompressionLevel::Level_0, bcgn::BcgnCompressionLevel::Level_1, bcgn::BcgnCompressionLevel::Level_2 })
+    {
+        auto header = bcgn::BcgnFileHeader{};
+        header.compressionLevel = compressionLevel;
+        testBcgnWriter(seed, uncompressedPath, header, numGames);
+
+        header.auxCompression = bcgn::BcgnAuxCompression::Zstd;
+        testBcgnWriter(seed, path, header, numGames);
+        testBcgnReader(seed, path, header, numGames);
+        testBcgnReader(seed, path, header, numGames, bcgn::BcgnFileReader::ReadMode::MemoryMapped);
+
+        REQUIRE(std::filesystem::file_size(path) < std::filesystem::file_size(uncompressedPath));
+    }
+
+    // Each writer ends with its own block. The existing file decides the aux compression.
+    auto header = bcgn::BcgnFileHeader{};
+    header.compressionLevel = bcgn::BcgnCompressionLevel::Level_2;
+    testBcgnWriter(seed, path, header, numGames, bcgn::BcgnFileWriter::FileOpenMode::Append);
+    testBcgnWriter(seed, path, header, numGames, bcgn::BcgnFileWriter::FileOpenMode::Append);
+
+    for (int i = 0; i < 2; ++i)
+    {
+        if (i == 1)
+        {
+            // The block index is rebuilt when it's missing.
+            std::filesystem::remove(bcgn::BcgnBlockIndex::pathFor(path));
+        }
+
+        for (auto readMode : { bcgn::BcgnFileReader::ReadMode::Buffered, bcgn::BcgnFileReader::ReadMode::MemoryMapped })
+        {
+            bcgn::BcgnFileReader reader(path, bcgn::traits::minBufferSize, readMode);
+            REQUIRE(!reader.hasGameOffsetDirectory());
+            REQUIRE(reader.numGames() == 3 * numGames);
+            REQUIRE(readRounds(reader).size() == 3 * numGames);
+
+            for (std::size_t n : { 1, 2, 3, 10 })
+            {
+                const auto ranges = reader.splitIntoRanges(n);
+                REQUIRE(ranges.size() == std::min<std::size_t>(n, 3));
+
+                std::size_t nextGameIdx = 0;
+                for (auto&& range : ranges)
+                {
+                    REQUIRE(range.firstGameIdx == nextGameIdx);
+
+                    bcgn::BcgnFileReader rangeReader(path, bcgn::traits::minBufferSize, readMode);
+                    rangeReader.setRange(range);
+                    const auto rounds = readRounds(rangeReader);
+                    REQUIRE(rounds.size() == range.numGames);
+                    for (std::size_t j = 0; j < rounds.size(); ++j)
+                    {
+                        REQUIRE(rounds[j] == (range.firstGameIdx + j) % numGames);
+                    }
+
+                    nextGameIdx += range.numGames;
+                }
+                REQUIRE(nextGameIdx == 3 * numGames);
+            }
+        }
+    }
+
+    header.auxCompression = bcgn::BcgnAuxCompression::Zstd;
+    header.hasGameOffsetDirectory = true;
+    REQUIRE_THROWS(bcgn::BcgnFileWriter(path, header));
+}
+
+TEST_CASE("BCGN corrupted blocks", "[bcgn]")
+{
+    constexpr int numGames = 100;
+    constexpr int seed = 12345;
+
+    const std::string path = "test_out/test_corrupted_blocks.bcgn";
+
+    auto header = bcgn::BcgnFileHeader{};
+    header.compressionLevel = bcgn::BcgnCompressionLevel::Level_1;
+    header.auxCompression = bcgn::BcgnAuxCompression::Zstd;
+
+    // The size of the file doesn't change, so the block index stays valid
+    // and only the reader of the blocks sees the corrupted header.
+    auto setCompressedLength = [&path](std::uint32_t length) {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(bcgn::traits::bcgnFileHeaderLength);
+        for (int i = 3; i >= 0; --i)
+        {
+            file.put(static_cast<char>(length >> (i * 8)));
+        }
+    };
+
+    testBcgnWriter(seed, path, header, numGames);
+    const auto numCompressedBytes = std::filesystem::file_size(path) - bcgn::traits::bcgnFileHeaderLength - bcgn::traits::auxCompressionBlockHeaderLength;
+
+    for (auto readMode : { bcgn::BcgnFileReader::ReadMode::Buffered, bcgn::BcgnFileReader::ReadMode::MemoryMapped })
+    {
+        {
+            // Cut short at the end of the file.
+            setCompressedLength(static_cast<std::uint32_t>(numCompressedBytes + 1));
+            bcgn::BcgnFileReader reader(path, bcgn::traits::minBufferSize, readMode);
+            REQUIRE_THROWS(readRounds(reader));
+        }
+
+        {
+            // Longer than any valid block.
+            setCompressedLength(0xFFFFFFFFu);
+            bcgn::BcgnFileReader reader(path, bcgn::traits::minBufferSize, readMode);
+            REQUIRE_THROWS(readRounds(reader));
+        }
+
+        {
+            setCompressedLength(static_cast<std::uint32_t>(numCompressedBytes));
+            bcgn::BcgnFileReader reader(path, bcgn::traits::minBufferSize, readMode);
+            REQUIRE(readRounds(reader).size() == numGames);
+        }
+    }
+}
+
+TEST_CASE("BCGN blocks are decompressed in parallel and read in order", "[bcgn]")
+{
+    constexpr int numGamesPerBlock = 20;
+    constexpr int numBlocks = 40;
+    constexpr int seed = 12345;
+
+    const std::string path = "test_out/test_many_blocks.bcgn";
+
+    auto header = bcgn::BcgnFileHeader{};
+    header.compressionLevel = bcgn::BcgnCompressionLevel::Level_1;
+    header.auxCompression = bcgn::BcgnAuxCompression::Zstd;
+
+    // Each writer ends with its own block.
+    testBcgnWriter(seed, path, header, numGamesPerBlock);
+    for (int i = 1; i < numBlocks; ++i)
+    {
+        testBcgnWriter(seed, path, header, numGamesPerBlock, bcgn::BcgnFileWriter::FileOpenMode::Append);
+    }
+
+    for (auto readMode : { bcgn::BcgnFileReader::ReadMode::Buffered, bcgn::BcgnFileReader::ReadMode::MemoryMapped })
+    {
+        bcgn::BcgnFileReader reader(path, bcgn::traits::minBufferSize, readMode);
+        const auto rounds = readRounds(reader);
+        REQUIRE(rounds.size() == numBlocks * numGamesPerBlock);
+        for (std::size_t i = 0; i < rounds.size(); ++i)
+        {
+            REQUIRE(rounds[i] == static_cast<int>(i % numGamesPerBlock));
+        }
+    }
+
+    // Breaks the zstd frame of a block in the middle. The blocks before it are still read.
+    constexpr int corruptedBlockIdx = 25;
+    {
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        std::uint64_t offset = bcgn::traits::bcgnFileHeaderLength;
+        for (int i = 0; i < corruptedBlockIdx; ++i)
+        {
+            file.seekg(offset);
+            std::uint32_t compressedLength = 0;
+            for (int j = 0; j < 4; ++j)
+            {
+                compressedLength = (compressedLength << 8) | static_cast<unsigned char>(file.get());
+            }
+            offset += bcgn::traits::auxCompressionBlockHeaderLength + compressedLength;
+        }
+
+        file.seekp(offset + bcgn::traits::auxCompressionBlockHeaderLength);
+        file.put(0);
+        file.put(0);
+        file.put(0);
+        file.put(0);
+    }
+
+    for (auto readMode : { bcgn::BcgnFileReader::ReadMode::Buffered, bcgn::BcgnFileReader::ReadMode::MemoryMapped })
+    {
+        bcgn::BcgnFileReader reader(path, bcgn::traits::minBufferSize, readMode);
+        std::size_t numGamesRead = 0;
+        REQUIRE_THROWS([&]() {
+            for (auto& game : reader)
+            {
+                REQUIRE(game.gameHeader().round() == numGamesRead % numGamesPerBlock);
+                ++numGamesRead;
+            }
+        }());
+        REQUIRE(numGamesRead == corruptedBlockIdx * numGamesPerBlock);
+    }
+}
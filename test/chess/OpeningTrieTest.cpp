@@ -0,0 +1,88 @@
+#include "catch2/catch.hpp"
+
+#include "chess/Chess.h"
+#include "chess/OpeningTrie.h"
+#include "chess/Position.h"
+#include "chess/San.h"
+
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    using MoveResult = pgn::OpeningTrie::MoveResult;
+
+    // Plays the game through the trie and checks every position
+    // against plain decoding. Returns the results of doMove.
+    [[nodiscard]] std::vector<MoveResult> playGame(pgn::OpeningTrie& trie, const std::vector<std::string_view>& sans)
+    {
+        std::vector<MoveResult> results;
+
+        auto cursor = trie.root();
+        PositionWithZobrist position = PositionWithZobrist::startPosition();
+        ReverseMove reverseMove{};
+
+        PositionWithZobrist expectedPosition = PositionWithZobrist::startPosition();
+
+        for (auto san : sans)
+        {
+            const auto result = trie.doMove(cursor, position, reverseMove, san);
+            results.emplace_back(result);
+
+            const Move move = san::sanToMove(expectedPosition, san);
+            if (move == Move::null())
+            {
+                REQUIRE(result == MoveResult::Illegal);
+                break;
+            }
+
+            const ReverseMove expectedReverseMove = expectedPosition.doMove(move);
+            REQUIRE(position == expectedPosition);
+            REQUIRE(position.zobrist() == expectedPosition.zobrist());
+            REQUIRE(reverseMove == expectedReverseMove);
+        }
+
+        return results;
+    }
+}
+
+TEST_CASE("Opening trie", "[chess][opening_trie]")
+{
+    using R = MoveResult;
+
+    const std::vector<std::string_view> ruyLopez = { "e4", "e5", "Nf3", "Nc6", "Bb5", "a6" };
+    const std::vector<std::string_view> italian = { "e4", "e5", "Nf3", "Nc6", "Bc4", "Bc5", "O-O" };
+    const std::vector<std::string_view> illegal = { "e4", "e5", "Nd4", "Nc6" };
+
+    SECTION("Shared prefixes are cached")
+    {
+        pgn::OpeningTrie trie(1024 * 1024, 20);
+        REQUIRE(trie.root().isValid());
+        REQUIRE(trie.numNodes() == 1);
+
+        REQUIRE(playGame(trie, ruyLopez) == std::vector<R>(6, R::Decoded));
+        REQUIRE(trie.numNodes() == 7);
+
+        REQUIRE(playGame(trie, italian) == std::vector<R>{ R::Cached, R::Cached, R::Cached, R::Cached, R::Decoded, R::Decoded, R::Decoded });
+        REQUIRE(trie.numNodes() == 10);
+
+        REQUIRE(playGame(trie, ruyLopez) == std::vector<R>(6, R::Cached));
+
+        REQUIRE(playGame(trie, illegal) == std::vector<R>{ R::Cached, R::Cached, R::Illegal });
+        REQUIRE(trie.numNodes() == 10);
+    }
+
+    SECTION("Growth is limited by plies and memory")
+    {
+        pgn::OpeningTrie shallow(1024 * 1024, 2);
+        REQUIRE(playGame(shallow, ruyLopez) == std::vector<R>(6, R::Decoded));
+        REQUIRE(playGame(shallow, italian) == std::vector<R>{ R::Cached, R::Cached, R::Decoded, R::Decoded, R::Decoded, R::Decoded, R::Decoded });
+        REQUIRE(shallow.numNodes() == 3);
+
+        pgn::OpeningTrie small(0, 20);
+        REQUIRE(!small.root().isValid());
+        REQUIRE(playGame(small, ruyLopez) == std::vector<R>(6, R::Decoded));
+        REQUIRE(playGame(small, ruyLopez) == std::vector<R>(6, R::Decoded));
+        REQUIRE(small.numNodes() == 0);
+    }
+}
@@ -0,0 +1,107 @@
+#include "catch2/catch.hpp"
+
+#include "chess/PgnScan.h"
+
+#include "intrin/Intrinsics.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+
+namespace
+{
+    // Movetext-like characters with frequent new lines and parentheses.
+    [[nodiscard]] std::string makeText(std::size_t size, std::uint64_t seed)
+    {
+        static constexpr std::string_view alphabet = "abcdefgh12345678NBRQKx+=. \n(){};";
+
+        std::mt19937_64 rng(seed);
+
+        std::string text(size, ' ');
+        for (auto& c : text)
+        {
+            const std::size_t r = rng() % 64;
+            c = r < alphabet.size() ? alphabet[r] : r < alphabet.size() + 4 ? '\n' : 'e';
+        }
+
+        return text;
+    }
+
+    [[nodiscard]] const char* findEmptyLineNaive(const char* begin, const char* end)
+    {
+        const std::string_view sv(begin, end - begin);
+        const std::size_t idx = sv.find("\n\n");
+        return idx == std::string_view::npos ? end : begin + idx;
+    }
+
+    [[nodiscard]] const char* findVariationEventNaive(const char* begin, const char* end)
+    {
+        const std::string_view sv(begin, end - begin);
+        const std::size_t idx = sv.find_first_of("(){;");
+        return idx == std::string_view::npos ? end : begin + idx;
+    }
+}
+
+TEST_CASE("Pgn scan finds empty lines", "[chess][pgn_scan]")
+{
+    for (std::size_t size : { 0, 1, 2, 31, 32, 33, 63, 64, 65, 100, 1000 })
+    {
+        for (std::uint64_t seed = 0; seed < 20; ++seed)
+        {
+            const std::string text = makeText(size, size * 100 + seed);
+
+            // Every suffix so that the matches land on all offsets within a chunk.
+            for (std::size_t offset = 0; offset <= std::min<std::size_t>(size, 40); ++offset)
+            {
+                const char* begin = text.data() + offset;
+                const char* end = text.data() + text.size();
+
+                const char* expected = findEmptyLineNaive(begin, end);
+                REQUIRE(pgn::scan::detail::findEmptyLineScalar(begin, end) == expected);
+                REQUIRE(pgn::scan::findEmptyLine(begin, end) == expected);
+                if (intrin::hasAvx2())
+                {
+                    REQUIRE(pgn::scan::detail::findEmptyLineAvx2(begin, end) == expected);
+                }
+            }
+        }
+    }
+
+    SECTION("New lines on a chunk boundary")
+    {
+        std::string text(64, 'a');
+        text[31] = '\n';
+        text[32] = '\n';
+        REQUIRE(pgn::scan::findEmptyLine(text.data(), text.data() + text.size()) == text.data() + 31);
+
+        // The second new line is outside of the range.
+        REQUIRE(pgn::scan::findEmptyLine(text.data(), text.data() + 32) == text.data() + 32);
+    }
+}
+
+TEST_CASE("Pgn scan finds variation events", "[chess][pgn_scan]")
+{
+    for (std::size_t size : { 0, 1, 31, 32, 33, 64, 65, 100, 1000 })
+    {
+        for (std::uint64_t seed = 0; seed < 20; ++seed)
+        {
+            const std::string text = makeText(size, size * 100 + seed + 7);
+
+            for (std::size_t offset = 0; offset <= std::min<std::size_t>(size, 40); ++offset)
+            {
+                const char* begin = text.data() + offset;
+                const char* end = text.data() + text.size();
+
+                const char* expected = findVariationEventNaive(begin, end);
+                REQUIRE(pgn::scan::detail::findVariationEventScalar(begin, end) == expected);
+                REQUIRE(pgn::scan::findVariationEvent(begin, end) == expected);
+                if (intrin::hasAvx2())
+                {
+                    REQUIRE(pgn::scan::detail::findVariationEventAvx2(begin, end) == expected);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,238 @@
+#include "catch2/catch.hpp"
+
+#include "chess/Pgn.h"
+
+#include "external_storage/External.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    struct ReadGame
+    {
+        std::string event;
+        std::vector<std::string> moves;
+        std::optional<GameResult> result;
+    };
+
+    [[nodiscard]] std::vector<ReadGame> readGames(const std::filesystem::path& path, pgn::LazyPgnFileReader::ReadMode mode)
+    {
+        std::vector<ReadGame> games;
+
+        pgn::LazyPgnFileReader reader(path, 0, mode);
+        REQUIRE(reader.isOpen());
+
+        for (auto& game : reader)
+        {
+            auto& readGame = games.emplace_back();
+            readGame.event = game.tag("Event");
+            for (auto&& san : game.moves())
+            {
+                readGame.moves.emplace_back(san);
+            }
+            readGame.result = game.result();
+        }
+
+        return games;
+    }
+
+    void writeFile(const std::filesystem::path& path, const std::string& contents)
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << contents;
+    }
+}
+
+TEST_CASE("Memory mapped PGN reader", "[chess][pgn]")
+{
+    using ReadMode = pgn::LazyPgnFileReader::ReadMode;
+
+    const auto path = std::filesystem::temp_directory_path() / ext::uniquePath();
+
+    const std::string games =
+        "\n"
+        "[Event \"a\"]\n"
+        "[Result \"1-0\"]\n"
+        "\n"
+        "1. e4 {main} e5 2. Qh5 Nc6 3. Bc4 Nf6 4. Qxf7# 1-0\n"
+        "\n"
+        "\n"
+        "[Event \"b\"]\n"
+        "[Result \"1/2-1/2\"]\n"
+        "\n"
+        "1. d4 d5\n"
+        "2. c4 1/2-1/2\n"
+        "\n";
+
+    SECTION("Terminated games")
+    {
+        writeFile(path, games);
+
+        const auto mapped = readGames(path, ReadMode::MemoryMapped);
+        REQUIRE(mapped.size() == 2);
+        REQUIRE(mapped[0].event == "a");
+        REQUIRE(mapped[0].moves == std::vector<std::string>{ "e4", "e5", "Qh5", "Nc6", "Bc4", "Nf6", "Qxf7#" });
+        REQUIRE(mapped[0].result == GameResult::WhiteWin);
+        REQUIRE(mapped[1].event == "b");
+        REQUIRE(mapped[1].moves == std::vector<std::string>{ "d4", "d5", "c4" });
+        REQUIRE(mapped[1].result == GameResult::Draw);
+
+        const auto buffered = readGames(path, ReadMode::Buffered);
+        REQUIRE(buffered.size() == mapped.size());
+        for (std::size_t i = 0; i < mapped.size(); ++i)
+        {
+            REQUIRE(buffered[i].event == mapped[i].event);
+            REQUIRE(buffered[i].moves == mapped[i].moves);
+            REQUIRE(buffered[i].result == mapped[i].result);
+        }
+    }
+
+    SECTION("The last game ends with the file")
+    {
+        for (const std::string end : { "\n", "" })
+        {
+            writeFile(path, games + "[Event \"c\"]\n\n1. e4 c5 0-1" + end);
+
+            const auto mapped = readGames(path, ReadMode::MemoryMapped);
+            REQUIRE(mapped.size() == 3);
+            REQUIRE(mapped[2].event == "c");
+            REQUIRE(mapped[2].moves == std::vector<std::string>{ "e4", "c5" });
+        }
+    }
+
+    SECTION("Carriage returns switch to buffered reading")
+    {
+        std::string crlfGames;
+        for (char c : games)
+        {
+            if (c == '\n')
+            {
+                crlfGames += '\r';
+            }
+            crlfGames += c;
+        }
+
+        // Starting with the first game or in the middle of the file.
+        for (const std::string contents : { crlfGames, games + crlfGames, crlfGames + games })
+        {
+            writeFile(path, contents);
+
+            const auto mapped = readGames(path, ReadMode::MemoryMapped);
+            const auto buffered = readGames(path, ReadMode::Buffered);
+            REQUIRE(mapped.size() == buffered.size());
+            for (std::size_t i = 0; i < mapped.size(); ++i)
+            {
+                REQUIRE(mapped[i].event == buffered[i].event);
+                REQUIRE(mapped[i].moves == buffered[i].moves);
+                REQUIRE(mapped[i].result == buffered[i].result);
+            }
+        }
+    }
+
+    SECTION("Empty file")
+    {
+        writeFile(path, "");
+
+        REQUIRE(readGames(path, ReadMode::MemoryMapped).empty());
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("Single pass tag decoding", "[chess][pgn]")
+{
+    const std::string_view tagSection =
+        "[Event \"Some event\"]\n"
+        "[Site \"Some site\"]\n"
+        "[White \"white player\"]\n"
+        "[Black \"black player\"]\n"
+        "[UTCDate \"2019.01.02\"]\n"
+        "[Date \"2020.03.04\"]\n"
+        "[Result \"0-1\"]\n"
+        "[ECO \"B12\"]\n"
+        "[WhiteElo \"2400\"]\n"
+        "[BlackElo \"2500\"]\n"
+        "[Round \"7\"]\n"
+        "[PlyCount \"2\"]\n"
+        "[FEN \"k7/8/8/8/8/8/8/K7 w - - 0 1\"]\n";
+
+    const pgn::UnparsedGame game(tagSection, "1. Kb1 Kb8 0-1");
+
+    const auto all = game.parseTags<pgn::TagSet::All>();
+    REQUIRE(all.event() == game.tag("Event"));
+    REQUIRE(all.white() == "white player");
+    REQUIRE(all.black() == "black player");
+    REQUIRE(all.site() == game.tag("Site"));
+    REQUIRE(all.site() == "Some site");
+    REQUIRE(all.date() == game.date());
+    REQUIRE(all.date() == Date(2020, 3, 4));
+    REQUIRE(all.result() == game.result());
+    REQUIRE(all.eco() == game.eco());
+    REQUIRE(all.whiteElo() == game.whiteElo());
+    REQUIRE(all.blackElo() == game.blackElo());
+    REQUIRE(all.round() == game.round());
+    REQUIRE(all.plyCount() == game.plyCount());
+    REQUIRE(all.hasCustomStartPosition());
+    REQUIRE(all.startPosition() == game.startPosition());
+
+    // Tags that are not selected are not decoded.
+    const auto positions = game.parseTags<pgn::TagSet::Positions>();
+    REQUIRE(positions.result() == GameResult::BlackWin);
+    REQUIRE(positions.whiteElo() == 2400);
+    REQUIRE(positions.event().empty());
+    REQUIRE(positions.site().empty());
+    REQUIRE(positions.eco() == Eco('A', 0));
+    REQUIRE(positions.plyCount(123) == 123);
+
+    // UTCDate is used when Date is missing, Elo with less than 3 digits is unknown.
+    const pgn::UnparsedGame other("[UTCDate \"2019.01.02\"]\n[WhiteElo \"12\"]\n", "1-0");
+    const auto otherTags = other.parseTags<pgn::TagSet::All>();
+    REQUIRE(otherTags.date() == Date(2019, 1, 2));
+    REQUIRE(otherTags.whiteElo() == 0);
+    REQUIRE(!otherTags.result().has_value());
+    REQUIRE(!otherTags.hasCustomStartPosition());
+}
+
+TEST_CASE("Repeated tags use the first occurrence", "[chess][pgn]")
+{
+    const std::string_view tagSection =
+        "[White \"first white\"]\n"
+        "[Result \"1-0\"]\n"
+        "[UTCDate \"2019.01.02\"]\n"
+        "[White \"second white\"]\n"
+        "[Result \"0-1\"]\n"
+        "[UTCDate \"2018.05.06\"]\n"
+        "[Black \"black player\"]\n";
+
+    const pgn::UnparsedGame game(tagSection, "1-0");
+
+    const auto tags = game.parseTags<pgn::TagSet::All>();
+    REQUIRE(tags.white() == "first white");
+    REQUIRE(tags.white() == game.tag("White"));
+    REQUIRE(tags.result() == GameResult::WhiteWin);
+    REQUIRE(tags.date() == Date(2019, 1, 2));
+    REQUIRE(tags.black() == "black player");
+
+    const auto header = game.parseTags<pgn::TagSet::Header>();
+    REQUIRE(header.white() == "first white");
+    REQUIRE(header.result() == GameResult::WhiteWin);
+}
+
+TEST_CASE("Comments in variations", "[chess][pgn]")
+{
+    // A variation may end right after a comment and ';' comments may contain parentheses.
+    const std::string moveSection =
+        "1. e4 (1. d4 {closed}) e5 2. Nf3 (2. Nc3 ; line comment (with a parenthesis\n"
+        "2... Nf6) Nc6 (2... d6 {a (comment}) 3. Bb5 1-0\n";
+
+    std::vector<std::string> moves;
+    for (auto&& san : pgn::UnparsedGameMoves(moveSection))
+    {
+        moves.emplace_back(san);
+    }
+
+    REQUIRE(moves == std::vector<std::string>{ "e4", "e5", "Nf3", "Nc6", "Bb5" });
+}
@@ -0,0 +1,253 @@
+#include "catch2/catch.hpp"
+
+#include "chess/Bcgn.h"
+#include "chess/MoveGenerator.h"
+#include "chess/PgnToBcgn.h"
+#include "chess/Position.h"
+#include "chess/San.h"
+
+#include "external_storage/External.h"
+
+#include <filesystem>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    struct GeneratedGame
+    {
+        std::string white;
+        std::vector<Move> moves;
+    };
+
+    // Writes random games, enough for the conversion to use many batches.
+    [[nodiscard]] std::vector<GeneratedGame> writeRandomPgn(const std::filesystem::path& path, std::size_t numGames)
+    {
+        std::mt19937_64 rng(1234);
+        std::vector<GeneratedGame> games;
+
+        std::ofstream file(path, std::ios::binary);
+        for (std::size_t i = 0; i < numGames; ++i)
+        {
+            auto& game = games.emplace_back();
+            game.white = "player" + std::to_string(i);
+
+            file << "[Event \"event\"]\n";
+            file << "[Site \"site\"]\n";
+            file << "[White \"" << game.white << "\"]\n";
+            file << "[Black \"black\"]\n";
+            file << "[Result \"1/2-1/2\"]\n";
+            file << "[WhiteElo \"2000\"]\n";
+            file << "\n";
+
+            Position pos = Position::startPosition();
+            for (std::size_t ply = 0; ply < 60; ++ply)
+            {
+                const auto legalMoves = movegen::generateLegalMoves(pos);
+                if (legalMoves.empty())
+                {
+                    break;
+                }
+
+                const Move move = legalMoves[rng() % legalMoves.size()];
+                if (ply % 2 == 0)
+                {
+                    file << (ply / 2 + 1) << ". ";
+                }
+                file << san::moveToSan<san::SanSpec::Capture | san::SanSpec::Check | san::SanSpec::Compact>(pos, move) << ' ';
+
+                game.moves.emplace_back(move);
+                pos.doMove(move);
+            }
+            file << "1/2-1/2\n\n";
+        }
+
+        return games;
+    }
+
+    [[nodiscard]] std::string readFile(const std::filesystem::path& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    void readAndCompare(const std::vector<std::filesystem::path>& paths, const std::vector<GeneratedGame>& expected)
+    {
+        std::size_t i = 0;
+        for (auto&& path : paths)
+        {
+            bcgn::BcgnFileReader reader(path);
+            REQUIRE(reader.isOpen());
+
+            for (auto& game : reader)
+            {
+                REQUIRE(i < expected.size());
+
+                const auto header = game.gameHeader();
+                REQUIRE(header.whitePlayer() == expected[i].white);
+                REQUIRE(header.blackPlayer() == "black");
+                REQUIRE(header.site() == "site");
+                REQUIRE(header.whiteElo() == 2000);
+                REQUIRE(game.result() == GameResult::Draw);
+
+                REQUIRE(game.numPlies() == expected[i].moves.size());
+                Position pos = game.startPosition();
+                auto moves = game.moves();
+                for (auto&& move : expected[i].moves)
+                {
+                    REQUIRE(moves.next(pos) == move);
+                    pos.doMove(move);
+                }
+
+                ++i;
+            }
+        }
+
+        REQUIRE(i == expected.size());
+    }
+}
+
+TEST_CASE("Parallel PGN to BCGN conversion", "[bcgn][pgn_to_bcgn]")
+{
+    const auto dir = std::filesystem::temp_directory_path() / ext::uniquePath();
+    std::filesystem::create_directories(dir);
+
+    const auto pgnPath = dir / "games.pgn";
+    const auto games = writeRandomPgn(pgnPath, 6000);
+
+    for (auto [compressionLevel, auxCompression] : {
+        std::pair{ bcgn::BcgnCompressionLevel::Level_0, bcgn::BcgnAuxCompression::None },
+        std::pair{ bcgn::BcgnCompressionLevel::Level_2, bcgn::BcgnAuxCompression::None },
+        std::pair{ bcgn::BcgnCompressionLevel::Level_2, bcgn::BcgnAuxCompression::Zstd } })
+    {
+        bcgn::PgnToBcgnConversionParams params{};
+        params.header.compressionLevel = compressionLevel;
+        params.header.auxCompression = auxCompression;
+
+        params.numThreads = 1;
+        const auto single = bcgn::convertPgnToBcgn(pgnPath, dir / "single.bcgn", params);
+        REQUIRE(single.numGames == games.size());
+        REQUIRE(single.outputPaths == std::vector<std::filesystem::path>{ dir / "single.bcgn" });
+        readAndCompare(single.outputPaths, games);
+
+        // The order of games doesn't depend on the number of threads.
+        params.numThreads = 4;
+        const auto parallel = bcgn::convertPgnToBcgn(pgnPath, dir / "parallel.bcgn", params);
+        REQUIRE(parallel.numGames == games.size());
+        REQUIRE(readFile(dir / "parallel.bcgn") == readFile(dir / "single.bcgn"));
+
+        params.numThreads = 3;
+        params.maxShardSize = 256 * 1024;
+        const auto sharded = bcgn::convertPgnToBcgn(pgnPath, dir / "sharded.bcgn", params);
+        REQUIRE(sharded.numGames == games.size());
+        REQUIRE(sharded.outputPaths.size() > 1);
+        REQUIRE(sharded.outputPaths[0] == dir / "sharded_0.bcgn");
+        for (auto&& path : sharded.outputPaths)
+        {
+            REQUIRE(std::filesystem::file_size(path) <= params.maxShardSize + bcgn::traits::bcgnFileHeaderLength);
+        }
+        readAndCompare(sharded.outputPaths, games);
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("PGN to BCGN conversion with position keys", "[bcgn][pgn_to_bcgn]")
+{
+    const auto dir = std::filesystem::temp_directory_path() / ext::uniquePath();
+    std::filesystem::create_directories(dir);
+
+    const auto pgnPath = dir / "games.pgn";
+    const auto games = writeRandomPgn(pgnPath, 3000);
+
+    bcgn::PgnToBcgnConversionParams params{};
+    params.header.compressionLevel = bcgn::BcgnCompressionLevel::Level_2;
+    params.writePositionKeys = true;
+    params.numThreads = 3;
+    params.maxShardSize = 128 * 1024;
+    const auto sharded = bcgn::convertPgnToBcgn(pgnPath, dir / "sharded.bcgn", params);
+    REQUIRE(sharded.outputPaths.size() > 1);
+
+    std::size_t i = 0;
+    for (auto&& path : sharded.outputPaths)
+    {
+        auto keys = bcgn::BcgnPositionKeyFileReader::open(path);
+        REQUIRE(keys.has_value());
+
+        bcgn::BcgnFileReader reader(path);
+        std::size_t numGamesInShard = 0;
+        for (auto& game : reader)
+        {
+            REQUIRE(i < games.size());
+
+            const auto& gameKeys = keys->nextGame();
+            REQUIRE(gameKeys.size() == game.numPlies() + 1);
+
+            PositionWithZobrist pos = game.startPositionWithZobrist();
+            REQUIRE(gameKeys[0].zobrist == pos.zobrist());
+            REQUIRE(gameKeys[0].packedReverseMove.packed() == PackedReverseMove(ReverseMove{}).packed());
+            for (std::size_t j = 0; j < games[i].moves.size(); ++j)
+            {
+                const ReverseMove reverseMove = pos.doMove(games[i].moves[j]);
+                REQUIRE(gameKeys[j + 1].zobrist == pos.zobrist());
+                REQUIRE(gameKeys[j + 1].packedReverseMove.packed() == PackedReverseMove(reverseMove).packed());
+            }
+
+            ++numGamesInShard;
+            ++i;
+        }
+
+        REQUIRE(keys->numGames() == numGamesInShard);
+    }
+    REQUIRE(i == games.size());
+
+    // Keys no longer match a file that was changed afterwards.
+    {
+        const auto path = sharded.outputPaths[0];
+        std::unique_ptr<FILE, decltype(&std::fclose)> file(std::fopen(path.string().c_str(), "ab"), &std::fclose);
+        REQUIRE(file != nullptr);
+        REQUIRE(std::fputc(0, file.get()) == 0);
+    }
+    REQUIRE(!bcgn::BcgnPositionKeyFileReader::open(sharded.outputPaths[0]).has_value());
+    REQUIRE(!bcgn::BcgnPositionKeyFileReader::open(dir / "games.pgn").has_value());
+
+    // Nor a file rewritten with the same size.
+    {
+        const auto path = sharded.outputPaths[1];
+        const auto size = std::filesystem::file_size(path);
+        REQUIRE(bcgn::BcgnPositionKeyFileReader::open(path).has_value());
+
+        std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(bcgn::traits::bcgnFileHeaderLength + 10);
+        const char c = static_cast<char>(file.get());
+        file.seekp(bcgn::traits::bcgnFileHeaderLength + 10);
+        file.put(static_cast<char>(c ^ 1));
+        file.close();
+
+        REQUIRE(std::filesystem::file_size(path) == size);
+        REQUIRE(!bcgn::BcgnPositionKeyFileReader::open(path).has_value());
+    }
+
+    params.mode = bcgn::BcgnFileWriter::FileOpenMode::Append;
+    params.maxShardSize = 0;
+    REQUIRE_THROWS(bcgn::convertPgnToBcgn(pgnPath, dir / "single.bcgn", params));
+
+    // Keys are only written when asked for, and old ones don't survive the conversion.
+    params.mode = bcgn::BcgnFileWriter::FileOpenMode::Truncate;
+    params.maxShardSize = 128 * 1024;
+    params.writePositionKeys = false;
+    const auto withoutKeys = bcgn::convertPgnToBcgn(pgnPath, dir / "sharded.bcgn", params);
+    REQUIRE(withoutKeys.outputPaths == sharded.outputPaths);
+    for (auto&& path : withoutKeys.outputPaths)
+    {
+        REQUIRE(!std::filesystem::exists(bcgn::BcgnPositionKeyFileReader::pathFor(path)));
+    }
+
+    std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,152 @@
+#include "catch2/catch.hpp"
+
+#include "external_storage/External.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+namespace
+{
+    [[nodiscard]] std::vector<std::uint64_t> makeSortedValues(std::size_t count, std::uint64_t seed)
+    {
+        std::mt19937_64 rng(seed);
+        std::uniform_int_distribution<std::uint64_t> dist(0, count * 4);
+
+        std::vector<std::uint64_t> values(count);
+        for (auto& v : values)
+        {
+            v = dist(rng);
+        }
+        std::sort(values.begin(), values.end());
+
+        return values;
+    }
+
+    void checkEytzingerMatchesRangeIndex(const std::vector<std::uint64_t>& values, std::size_t granularity)
+    {
+        const auto index = ext::makeIndex(values, granularity, std::less<>{});
+        const auto eytzinger = ext::EytzingerRangeIndex<std::uint64_t, std::less<>>(index);
+
+        REQUIRE(eytzinger.size() == index.size());
+
+        // Every value in the data, every value in between and some past the ends.
+        for (std::uint64_t key = 0; key <= values.back() + 2; ++key)
+        {
+            const auto [a0, b0] = index.equal_range(key);
+            const auto [a1, b1] = eytzinger.equal_range(key);
+
+            REQUIRE(a0.it == a1.it);
+            REQUIRE(b0.it == b1.it);
+
+            if (a0.it != b0.it)
+            {
+                REQUIRE(a0.value == a1.value);
+                REQUIRE(b0.value == b1.value);
+            }
+        }
+    }
+}
+
+TEST_CASE("Eytzinger range index", "[ext][index]")
+{
+    for (std::size_t granularity : { 1u, 2u, 7u, 64u })
+    {
+        // Various sizes to exercise both full and partial last levels of the tree.
+        for (std::size_t count : { 1u, 2u, 3u, 15u, 16u, 17u, 1000u, 4321u })
+        {
+            checkEytzingerMatchesRangeIndex(makeSortedValues(count, count * 31 + granularity), granularity);
+        }
+    }
+
+    {
+        // Long runs of equal values produce ranges longer than the granularity.
+        std::vector<std::uint64_t> values;
+        for (std::uint64_t v = 10; v < 20; ++v)
+        {
+            values.insert(values.end(), v * 3, v * 2);
+        }
+        checkEytzingerMatchesRangeIndex(values, 4);
+    }
+}
+
+TEST_CASE("Radix index", "[ext][index]")
+{
+    auto identity = [](std::uint64_t v) { return v; };
+
+    for (std::size_t numBits : { 0u, 1u, 4u, 10u })
+    {
+        for (std::size_t count : { 0u, 1u, 2u, 17u, 1000u, 4321u })
+        {
+            std::mt19937_64 rng(count * 31 + numBits);
+            std::vector<std::uint64_t> values(count);
+            for (auto& v : values)
+            {
+                v = rng();
+            }
+            std::sort(values.begin(), values.end());
+
+            const auto radix = ext::makeRadixIndex(values.begin(), values.end(), numBits, identity);
+
+            REQUIRE(radix.numBits() == numBits);
+            REQUIRE(radix.numBuckets() == (std::size_t(1) << numBits));
+            REQUIRE(radix.data()[radix.size() - 1] == count);
+
+            // Each bucket contains exactly the values with its most significant bits.
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                const auto [a, b] = radix.equal_range(values[i]);
+                REQUIRE(a <= i);
+                REQUIRE(i < b);
+                REQUIRE(radix.bucketOf(values[a]) == radix.bucketOf(values[i]));
+                REQUIRE(radix.bucketOf(values[b - 1]) == radix.bucketOf(values[i]));
+                if (a > 0) REQUIRE(radix.bucketOf(values[a - 1]) < radix.bucketOf(values[i]));
+                if (b < count) REQUIRE(radix.bucketOf(values[b]) > radix.bucketOf(values[i]));
+            }
+
+            for (std::size_t coarseBits = 0; coarseBits < numBits; ++coarseBits)
+            {
+                const auto coarse = radix.coarsened(coarseBits);
+                const auto expected = ext::makeRadixIndex(values.begin(), values.end(), coarseBits, identity);
+                REQUIRE(coarse.numBits() == coarseBits);
+                REQUIRE(std::equal(coarse.data(), coarse.data() + coarse.size(), expected.data(), expected.data() + expected.size()));
+            }
+        }
+    }
+}
+
+TEST_CASE("Mapped range index", "[ext][index]")
+{
+    using IndexType = ext::RangeIndex<std::uint64_t, std::less<>>;
+    using MappedIndexType = ext::RangeIndex<std::uint64_t, std::less<>, ext::MappedSpan<IndexType::EntryType>>;
+
+    const auto values = makeSortedValues(4321, 123);
+    const auto index = ext::makeIndex(values, 7, std::less<>{});
+
+    const auto path = std::filesystem::temp_directory_path() / ext::uniquePath();
+    (void)ext::writeFile(path, index.data(), index.size());
+
+    {
+        const MappedIndexType mapped{ ext::MappedSpan<IndexType::EntryType>(path) };
+
+        REQUIRE(mapped.size() == index.size());
+
+        // Not charged with the size of the file, the pages can be dropped at any time.
+        REQUIRE(mapped.memoryUsage() == ext::MappedSpan<IndexType::EntryType>::nominalMemoryUsage);
+        REQUIRE(index.memoryUsage() == index.size() * sizeof(IndexType::EntryType));
+
+        for (std::uint64_t key = 0; key <= values.back() + 2; ++key)
+        {
+            const auto [a0, b0] = index.equal_range(key);
+            const auto [a1, b1] = mapped.equal_range(key);
+
+            REQUIRE(a0.it == a1.it);
+            REQUIRE(b0.it == b1.it);
+        }
+    }
+
+    // The mapping is released with the index so the file can be removed.
+    REQUIRE(std::filesystem::remove(path));
+}
\ No newline at end of file
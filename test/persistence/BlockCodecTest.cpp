@@ -0,0 +1,265 @@
+#include "catch2/catch.hpp"
+
+#include "persistence/pos_db/delta/DatabaseFormatDeltaPax.h"
+#include "persistence/pos_db/epsilon/DatabaseFormatEpsilonCompressed.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <vector>
+
+namespace
+{
+    using persistence::db_epsilon_compressed::BlockCodec;
+    using persistence::db_epsilon_compressed::Entry;
+    using persistence::db_epsilon_compressed::Key;
+
+    [[nodiscard]] std::vector<Entry> makeSortedEntries(std::size_t count, std::uint64_t seed)
+    {
+        std::mt19937_64 rng(seed);
+
+        std::vector<Entry> entries;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const std::uint64_t prefix = rng();
+            Key::StorageType hash{
+                static_cast<std::uint32_t>(prefix >> 32),
+                static_cast<std::uint32_t>(prefix),
+                static_cast<std::uint32_t>(rng())
+            };
+
+            // Some positions are repeated with different low parts.
+            const std::size_t numVariants = rng() % 4 == 0 ? 1 + rng() % 5 : 1;
+            for (std::size_t j = 0; j < numVariants; ++j)
+            {
+                hash[2] += static_cast<std::uint32_t>(rng() % 100000);
+                const std::uint32_t entryCount = rng() % 8 == 0 ? static_cast<std::uint32_t>(rng()) : 1u;
+                entries.emplace_back(Key(hash), std::max<std::uint32_t>(entryCount, 1u));
+            }
+        }
+
+        std::sort(entries.begin(), entries.end(), Entry::CompareLessFull{});
+        entries.erase(std::unique(entries.begin(), entries.end(), Entry::CompareEqualFull{}), entries.end());
+
+        return entries;
+    }
+
+    void checkRoundTrip(const std::vector<Entry>& entries, std::size_t blockSize)
+    {
+        std::vector<std::byte> compressed;
+        std::vector<std::size_t> offsets{ 0 };
+        for (std::size_t i = 0; i < entries.size(); i += blockSize)
+        {
+            const std::size_t count = std::min(blockSize, entries.size() - i);
+            BlockCodec::encode(entries.data() + i, count, compressed);
+            offsets.emplace_back(compressed.size());
+        }
+
+        for (std::size_t block = 0; block + 1 < offsets.size(); ++block)
+        {
+            const std::size_t first = block * blockSize;
+            const std::size_t count = std::min(blockSize, entries.size() - first);
+
+            std::vector<Entry> decoded(count);
+            BlockCodec::decode(compressed.data() + offsets[block], offsets[block + 1] - offsets[block], decoded.data(), count);
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                REQUIRE(Entry::CompareEqualFull{}(decoded[i], entries[first + i]));
+                REQUIRE(decoded[i].count() == entries[first + i].count());
+            }
+        }
+    }
+}
+
+TEST_CASE("Epsilon block codec round trip", "[persistence][block_codec]")
+{
+    for (std::uint64_t seed = 0; seed < 8; ++seed)
+    {
+        const auto entries = makeSortedEntries(1000 + seed * 777, seed);
+
+        checkRoundTrip(entries, 1);
+        checkRoundTrip(entries, 7);
+        checkRoundTrip(entries, 256);
+        checkRoundTrip(entries, entries.size());
+    }
+}
+
+TEST_CASE("Epsilon block codec extreme values", "[persistence][block_codec]")
+{
+    std::vector<Entry> entries;
+    entries.emplace_back(Key(Key::StorageType{ 0u, 0u, 0u }), 1u);
+    entries.emplace_back(Key(Key::StorageType{ 0u, 0u, 1u }), 0xFFFFFFFFu);
+    entries.emplace_back(Key(Key::StorageType{ 0u, 1u, 0u }), 1u);
+    entries.emplace_back(Key(Key::StorageType{ 0u, 1u, 0xFFFFFFFFu }), 2u);
+    entries.emplace_back(Key(Key::StorageType{ 0xFFFFFFFFu, 0xFFFFFFFEu, 5u }), 1u);
+    entries.emplace_back(Key(Key::StorageType{ 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu }), 3u);
+
+    checkRoundTrip(entries, entries.size());
+    checkRoundTrip(entries, 2);
+}
+
+TEST_CASE("Epsilon block codec worst case size", "[persistence][block_codec]")
+{
+    using persistence::db_epsilon_compressed::Traits;
+
+    constexpr std::uint32_t maxCount = 0xFFFFFFFFu;
+
+    std::vector<std::vector<Entry>> blocks;
+
+    // The largest delta of the hash prefix.
+    blocks.push_back({
+        Entry(Key(Key::StorageType{ 0u, 0u, 0xFFFFFFFFu }), maxCount),
+        Entry(Key(Key::StorageType{ 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu }), maxCount)
+    });
+
+    // The largest delta of the low hash part.
+    blocks.push_back({
+        Entry(Key(Key::StorageType{ 7u, 7u, 0u }), maxCount),
+        Entry(Key(Key::StorageType{ 7u, 7u, 0xFFFFFFFFu }), maxCount)
+    });
+
+    // One large delta of the hash prefix makes the rice parameter
+    // large for all others. Then the smallest deltas take the most.
+    {
+        std::vector<Entry> entries;
+        for (std::uint32_t i = 0; i < 255; ++i)
+        {
+            entries.emplace_back(Key(Key::StorageType{ 0u, i, 0xFFFFFFFFu }), maxCount);
+        }
+        entries.emplace_back(Key(Key::StorageType{ 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu }), maxCount);
+        blocks.push_back(entries);
+    }
+
+    for (auto&& entries : blocks)
+    {
+        std::vector<std::byte> compressed;
+        BlockCodec::encode(entries.data(), entries.size(), compressed);
+        REQUIRE(compressed.size() <= entries.size() * Traits::maxBytesPerPosition);
+
+        checkRoundTrip(entries, entries.size());
+    }
+
+    // A single entry with the header.
+    {
+        std::vector<Entry> entries{ Entry(Key(Key::StorageType{ 0xFFFFFFFFu, 0xFFFFFFFFu, 0xFFFFFFFFu }), maxCount) };
+
+        std::vector<std::byte> compressed;
+        BlockCodec::encode(entries.data(), entries.size(), compressed);
+        REQUIRE(compressed.size() <= Traits::maxBytesPerPosition);
+    }
+}
+
+TEST_CASE("Epsilon block codec compresses", "[persistence][block_codec]")
+{
+    const auto entries = makeSortedEntries(100000, 42);
+
+    std::vector<std::byte> compressed;
+    for (std::size_t i = 0; i < entries.size(); i += 256)
+    {
+        BlockCodec::encode(entries.data() + i, std::min<std::size_t>(256, entries.size() - i), compressed);
+    }
+
+    // The keys are much sparser than in real files.
+    REQUIRE(compressed.size() < entries.size() * sizeof(Entry) * 3 / 5);
+}
+
+namespace
+{
+    [[nodiscard]] std::vector<persistence::db_delta_pax::Entry> makeDeltaEntries(std::size_t count, std::uint64_t seed)
+    {
+        using persistence::db_delta_pax::Entry;
+
+        std::mt19937_64 rng(seed);
+
+        std::vector<Entry> entries;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const Entry::KeyPart keyPart{ rng() % (count / 4 + 1), rng() };
+            const Entry::PayloadPart payloadPart{
+                static_cast<std::uint32_t>(rng()),
+                static_cast<std::uint32_t>(rng()),
+                static_cast<std::uint32_t>(rng()),
+                static_cast<std::uint32_t>(rng())
+            };
+            entries.emplace_back(keyPart, payloadPart);
+        }
+
+        std::sort(entries.begin(), entries.end(), Entry::CompareLessFull{});
+
+        return entries;
+    }
+
+    [[nodiscard]] bool isSameDeltaEntry(const persistence::db_delta_pax::Entry& lhs, const persistence::db_delta_pax::Entry& rhs)
+    {
+        return
+            lhs.keyPart().hashPart1 == rhs.keyPart().hashPart1
+            && lhs.keyPart().hashPart2AndPackedInfo == rhs.keyPart().hashPart2AndPackedInfo
+            && lhs.payloadPart().eloDiffHigh == rhs.payloadPart().eloDiffHigh
+            && lhs.count() == rhs.count()
+            && lhs.firstGameIndex() == rhs.firstGameIndex()
+            && lhs.lastGameIndex() == rhs.lastGameIndex();
+    }
+}
+
+TEST_CASE("Delta pax block codec round trip", "[persistence][block_codec]")
+{
+    using persistence::db_delta_pax::BlockCodec;
+    using persistence::db_delta_pax::Entry;
+
+    const auto entries = makeDeltaEntries(1000, 7);
+
+    for (std::size_t blockSize : { std::size_t(1), std::size_t(7), std::size_t(1024) })
+    {
+        for (std::size_t i = 0; i < entries.size(); i += blockSize)
+        {
+            const std::size_t count = std::min(blockSize, entries.size() - i);
+
+            std::vector<std::byte> block;
+            BlockCodec::encode(entries.data() + i, count, block);
+            REQUIRE(block.size() == count * sizeof(Entry));
+
+            std::vector<Entry> decoded(count);
+            BlockCodec::decode(block.data(), block.size(), decoded.data(), count);
+            for (std::size_t j = 0; j < count; ++j)
+            {
+                REQUIRE(isSameDeltaEntry(decoded[j], entries[i + j]));
+            }
+        }
+    }
+}
+
+TEST_CASE("Delta pax block codec decodes only matching entries", "[persistence][block_codec]")
+{
+    using persistence::db_delta_pax::BlockCodec;
+    using persistence::db_delta_pax::Entry;
+
+    const auto entries = makeDeltaEntries(1000, 13);
+
+    std::vector<std::byte> block;
+    BlockCodec::encode(entries.data(), entries.size(), block);
+
+    const std::size_t from = 100;
+    const std::size_t to = 900;
+    for (std::size_t k = from; k < to; k += 37)
+    {
+        const Entry& key = entries[k];
+        auto pred = [&key](const Entry& entry) {
+            return Entry::CompareEqualWithoutReverseMove{}(entry, key);
+        };
+
+        std::vector<Entry> matching;
+        BlockCodec::decodeMatching(block.data(), block.size(), entries.size(), from, to, pred, matching);
+
+        std::vector<Entry> expected;
+        std::copy_if(entries.begin() + from, entries.begin() + to, std::back_inserter(expected), pred);
+
+        REQUIRE(!matching.empty());
+        REQUIRE(matching.size() == expected.size());
+        for (std::size_t i = 0; i < expected.size(); ++i)
+        {
+            REQUIRE(isSameDeltaEntry(matching[i], expected[i]));
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,618 @@
+#include "catch2/catch.hpp"
+
+#include "persistence/pos_db/Database.h"
+#include "persistence/pos_db/Query.h"
+#include "persistence/pos_db/delta/DatabaseFormatDelta.h"
+
+#include "chess/Bcgn.h"
+#include "chess/GameClassification.h"
+#include "chess/MoveGenerator.h"
+#include "chess/PgnToBcgn.h"
+#include "chess/Position.h"
+#include "chess/San.h"
+
+#include "external_storage/External.h"
+
+#include "Configuration.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "json/json.hpp"
+
+namespace
+{
+    struct GeneratedGames
+    {
+        std::string pgn;
+
+        // Some of the positions that occurred in the games.
+        std::vector<std::string> fens;
+    };
+
+    // Games of random legal moves.
+    [[nodiscard]] GeneratedGames generateGames(std::size_t numGames, std::size_t maxPlies, std::uint64_t seed)
+    {
+        static constexpr const char* results[] = { "1-0", "0-1", "1/2-1/2" };
+
+        std::mt19937_64 rng(seed);
+
+        GeneratedGames games;
+        for (std::size_t i = 0; i < numGames; ++i)
+        {
+            const char* result = results[rng() % 3];
+
+            games.pgn += "[Event \"Game " + std::to_string(i) + "\"]\n";
+            games.pgn += "[White \"w" + std::to_string(rng() % 50) + "\"]\n";
+            games.pgn += "[Black \"b" + std::to_string(rng() % 50) + "\"]\n";
+            games.pgn += "[Date \"2020.0" + std::to_string(1 + rng() % 9) + ".15\"]\n";
+            games.pgn += "[WhiteElo \"" + std::to_string(1500 + rng() % 1000) + "\"]\n";
+            games.pgn += "[BlackElo \"" + std::to_string(1500 + rng() % 1000) + "\"]\n";
+            games.pgn += std::string("[Result \"") + result + "\"]\n\n";
+
+            Position pos = Position::startPosition();
+            for (std::size_t ply = 0; ply < maxPlies; ++ply)
+            {
+                const auto moves = movegen::generateLegalMoves(pos);
+                if (moves.empty())
+                {
+                    break;
+                }
+
+                const Move move = moves[rng() % moves.size()];
+                if (ply % 2 == 0)
+                {
+                    games.pgn += std::to_string(ply / 2 + 1) + ". ";
+                }
+                games.pgn += san::moveToSan<san::SanSpec::Full>(pos, move) + ' ';
+                pos.doMove(move);
+
+                if (ply % 13 == 5)
+                {
+                    games.fens.emplace_back(pos.fen());
+                }
+            }
+
+            games.pgn += std::string(result) + "\n\n";
+        }
+
+        return games;
+    }
+
+    void writeFile(const std::filesystem::path& path, const std::string& contents)
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << contents;
+    }
+
+    [[nodiscard]] query::Request makeRequest(const std::vector<std::string>& fens)
+    {
+        query::Request request;
+        request.token = "test";
+        for (auto&& fen : fens)
+        {
+            request.positions.emplace_back(query::RootPosition{ fen, std::nullopt });
+        }
+        request.levels = { GameLevel::Human, GameLevel::Engine, GameLevel::Server };
+        request.results = { GameResult::WhiteWin, GameResult::BlackWin, GameResult::Draw };
+        request.fetchingOptions[query::Select::Continuations] = { true, true, true, false, false };
+        request.fetchingOptions[query::Select::Transpositions] = { true, false, false, false, false };
+        return request;
+    }
+
+    [[nodiscard]] std::size_t totalCount(const query::SegregatedEntries& entries)
+    {
+        std::size_t count = 0;
+        for (auto&& [origin, entry] : entries)
+        {
+            count += entry.count;
+        }
+        return count;
+    }
+
+    // Nodes below the roots, by depth, depth 1 being the children of a root.
+    void collectExpanded(const query::ResultForRoot& node, std::size_t depth, std::vector<std::vector<const query::ResultForRoot*>>& nodesByDepth)
+    {
+        for (auto&& child : node.expanded)
+        {
+            if (nodesByDepth.size() <= depth)
+            {
+                nodesByDepth.resize(depth + 1);
+            }
+            nodesByDepth[depth].emplace_back(&child);
+            collectExpanded(child, depth + 1, nodesByDepth);
+        }
+    }
+
+    [[nodiscard]] std::size_t numChildrenWithAtLeast(const query::ResultForRoot& node, std::size_t minCount)
+    {
+        std::size_t num = 0;
+        for (auto&& [move, entries] : node.resultsBySelect.at(query::Select::Continuations).children)
+        {
+            if (totalCount(entries) >= std::max<std::size_t>(minCount, 1))
+            {
+                num += 1;
+            }
+        }
+        return num;
+    }
+}
+
+TEST_CASE("Eytzinger index gives the same query results", "[persistence][query]")
+{
+    using persistence::db_delta::Database;
+
+    const auto dir = std::filesystem::temp_directory_path() / ext::uniquePath();
+    std::filesystem::create_directories(dir);
+    const auto pgnPath = dir / "games.pgn";
+    const auto dbPath = dir / "db";
+
+    // A few times more positions than index_granularity so that the index has many ranges.
+    const auto games = generateGames(400, 80, 26);
+    writeFile(pgnPath, games.pgn);
+
+    {
+        Database db(dbPath);
+        (void)db.import({ persistence::ImportableFile(pgnPath, GameLevel::Human) }, 16 * 1024 * 1024);
+        db.flush();
+    }
+
+    const auto request = makeRequest(games.fens);
+    REQUIRE(request.isValid());
+
+    nlohmann::json expected;
+    {
+        Database db(dbPath);
+        const auto response = db.executeQuery(request);
+        REQUIRE(response.results.size() == games.fens.size());
+        for (auto&& result : response.results)
+        {
+            REQUIRE(totalCount(result.resultsBySelect.at(query::Select::Continuations).root) + totalCount(result.resultsBySelect.at(query::Select::Transpositions).root) > 0);
+        }
+        expected = response;
+    }
+
+    // Files opened from now on get the Eytzinger index.
+    cfg::Configuration::patch({ { "persistence", { { "db_delta", { { "eytzinger_index", true } } } } } });
+    {
+        Database db(dbPath);
+        const nlohmann::json actual = db.executeQuery(request);
+
+        // Not expanded by Catch on failure, the responses are large.
+        const bool isSame = actual == expected;
+        REQUIRE(isSame);
+    }
+    cfg::Configuration::patch({ { "persistence", { { "db_delta", { { "eytzinger_index", false } } } } } });
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Material index is built on import when enabled", "[persistence][query]")
+{
+    using persistence::db_delta::Database;
+
+    const auto dir = std::filesystem::temp_directory_path() / ext::uniquePath();
+    std::filesystem::create_directories(dir);
+    const auto pgnPath = dir / "games.pgn";
+    const auto dbPath = dir / "db";
+
+    const std::size_t numGames = 100;
+    const auto games = generateGames(numGames, 60, 39);
+    writeFile(pgnPath, games.pgn);
+
+    query::MaterialStatsRequest request;
+    request.token = "test";
+    request.material = "KQRRBBNNPPPPPPPPvKQRRBBNNPPPPPPPP";
+    request.levels = { GameLevel::Human, GameLevel::Engine, GameLevel::Server };
+    request.results = { GameResult::WhiteWin, GameResult::BlackWin, GameResult::Draw };
+    REQUIRE(request.isValid());
+
+    cfg::Configuration::patch({ { "persistence", { { "material_index", true } } } });
+    {
+        Database db(dbPath);
+        (void)db.import({ persistence::ImportableFile(pgnPath, GameLevel::Human) }, 16 * 1024 * 1024);
+        db.flush();
+    }
+    {
+        Database db(dbPath);
+        const auto response = db.queryMaterialStats(request);
+
+        // Every game starts with all the pieces.
+        std::uint64_t numGamesWithMaterial = 0;
+        std::uint64_t numPositionsWithMaterial = 0;
+        for (GameResult result : request.results)
+        {
+            REQUIRE(response.stats[GameLevel::Engine][result].numGames == 0);
+            REQUIRE(response.stats[GameLevel::Server][result].numGames == 0);
+
+            numGamesWithMaterial += response.stats[GameLevel::Human][result].numGames;
+            numPositionsWithMaterial += response.stats[GameLevel::Human][result].numPositions;
+        }
+        REQUIRE(numGamesWithMaterial == numGames);
+        REQUIRE(numPositionsWithMaterial > numGames);
+    }
+    cfg::Configuration::patch({ { "persistence", { { "material_index", false } } } });
+
+    {
+        // The index would not be updated on import anymore.
+        Database db(dbPath);
+        REQUIRE(!std::filesystem::exists(dbPath / "material_index"));
+        REQUIRE_THROWS(db.queryMaterialStats(request));
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Opening trie gives the same query results", "[persistence][query]")
+{
+    using persistence::db_delta::Database;
+
+    const auto dir = std::filesystem::temp_directory_path() / ext::uniquePath();
+    std::filesystem::create_directories(dir);
+    const auto pgnPath = dir / "games.pgn";
+    const auto dbPath = dir / "db";
+    const auto dbWithTriePath = dir / "db_with_trie";
+
+    const auto games = generateGames(200, 60, 45);
+    writeFile(pgnPath, games.pgn);
+
+    persistence::ImportStats stats;
+    {
+        Database db(dbPath);
+        stats = db.import({ persistence::ImportableFile(pgnPath, GameLevel::Human) }, 16 * 1024 * 1024);
+        db.flush();
+    }
+    REQUIRE(stats.openingTrieHitRate() == 0.0);
+
+    cfg::Configuration::patch({ { "persistence", { { "opening_trie", true } } } });
+    persistence::ImportStats statsWithTrie;
+    {
+        Database db(dbWithTriePath);
+        statsWithTrie = db.import({ persistence::ImportableFile(pgnPath, GameLevel::Human) }, 16 * 1024 * 1024);
+        db.flush();
+    }
+    cfg::Configuration::patch({ { "persistence", { { "opening_trie", false } } } });
+
+    // The games share the first moves, which are then taken from the trie.
+    REQUIRE(statsWithTrie.total().numPositions == stats.total().numPositions);
+    REQUIRE(statsWithTrie.total().numCachedPositions > 0);
+    REQUIRE(statsWithTrie.openingTrieHitRate() > 0.0);
+    REQUIRE(statsWithTrie.openingTrieHitRate() < 1.0);
+    REQUIRE(nlohmann::json(statsWithTrie)["opening_trie_hit_rate"].get<double>() == statsWithTrie.openingTrieHitRate());
+
+    const auto request = makeRequest(games.fens);
+    nlohmann::json expected;
+    {
+        Database db(dbPath);
+        expected = db.executeQuery(request);
+    }
+    {
+        Database db(dbWithTriePath);
+        const nlohmann::json actual = db.executeQuery(request);
+
+        // Not expanded by Catch on failure, the responses are large.
+        const bool isSame = actual == expected;
+        REQUIRE(isSame);
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Importing position keys gives the same query results", "[persistence][query]")
+{
+    using persistence::db_delta::Database;
+
+    const auto dir = std::filesystem::temp_directory_path() / ext::uniquePath();
+    std::filesystem::create_directories(dir);
+    const auto pgnPath = dir / "games.pgn";
+    const auto bcgnPath = dir / "games.bcgn";
+    const auto bcgnWithKeysPath = dir / "games_with_keys.bcgn";
+
+    const auto games = generateGames(200, 60, 50);
+    writeFile(pgnPath, games.pgn);
+
+    bcgn::PgnToBcgnConversionParams params{};
+    params.header.compressionLevel = bcgn::BcgnCompressionLevel::Level_2;
+    (void)bcgn::convertPgnToBcgn(pgnPath, bcgnPath, params);
+    params.writePositionKeys = true;
+    (void)bcgn::convertPgnToBcgn(pgnPath, bcgnWithKeysPath, params);
+    REQUIRE(!bcgn::BcgnPositionKeyFileReader::open(bcgnPath).has_value());
+    REQUIRE(bcgn::BcgnPositionKeyFileReader::open(bcgnWithKeysPath).has_value());
+
+    auto fens = games.fens;
+    fens.emplace_back(Position::startPosition().fen());
+    const auto request = makeRequest(fens);
+    REQUIRE(request.isValid());
+
+    auto queryImported = [&](const std::filesystem::path& path, const std::string& name) {
+        Database db(dir / name);
+        (void)db.import({ persistence::ImportableFile(path, GameLevel::Human) }, 16 * 1024 * 1024);
+        db.flush();
+        return nlohmann::json(db.executeQuery(request));
+    };
+
+    // The material index is disabled so the keys are used.
+    const auto expected = queryImported(bcgnPath, "db");
+    {
+        const auto actual = queryImported(bcgnWithKeysPath, "db_keys");
+
+        // Not expanded by Catch on failure, the responses are large.
+        const bool isSame = actual == expected;
+        REQUIRE(isSame);
+    }
+
+    // Clear the zobrist key of the start position of the first game.
+    {
+        std::fstream file(bcgn::BcgnPositionKeyFileReader::pathFor(bcgnWithKeysPath), std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp(bcgn::traits::positionKeyFileHeaderLength + 2);
+        for (int i = 0; i < 16; ++i)
+        {
+            file.put(0);
+        }
+    }
+    {
+        // Proves that the positions come from the keys.
+        const auto actual = queryImported(bcgnWithKeysPath, "db_corrupted_keys");
+        const bool isSame = actual == expected;
+        REQUIRE(!isSame);
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Importing BCGN ranges in parallel gives the same query results", "[persistence][query]")
+{
+    using persistence::db_delta::Database;
+
+    const auto dir = std::filesystem::temp_directory_path() / ext::uniquePath();
+    std::filesystem::create_directories(dir);
+    const auto pgnPath = dir / "games.pgn";
+    const auto bcgnPath = dir / "games.bcgn";
+
+    // The skipped game shifts the indices of the games after it.
+    auto games = generateGames(1000, 40, 51);
+    games.pgn += "[Event \"Unfinished\"]\n[Result \"*\"]\n\n1. e4 e5 *\n\n";
+    games.pgn += generateGames(100, 40, 52).pgn;
+    writeFile(pgnPath, games.pgn);
+
+    bcgn::PgnToBcgnConversionParams params{};
+    params.header.compressionLevel = bcgn::BcgnCompressionLevel::Level_2;
+    params.header.hasGameOffsetDirectory = true;
+    (void)bcgn::convertPgnToBcgn(pgnPath, bcgnPath, params);
+    REQUIRE(bcgn::BcgnFileReader(bcgnPath).splitIntoRanges(4).size() > 1);
+
+    auto fens = games.fens;
+    fens.emplace_back(Position::startPosition().fen());
+    const auto request = makeRequest(fens);
+    REQUIRE(request.isValid());
+
+    auto queryImported = [&](const std::string& name, std::size_t numThreads) {
+        cfg::Configuration::patch({ { "persistence", { { "bcgn_import_threads", numThreads } } } });
+        Database db(dir / name);
+        const auto stats = db.import({ persistence::ImportableFile(bcgnPath, GameLevel::Human) }, 16 * 1024 * 1024);
+        db.flush();
+        REQUIRE(stats.total().numGames == 1100);
+        REQUIRE(stats.total().numSkippedGames == 1);
+        return nlohmann::json(db.executeQuery(request));
+    };
+
+    const auto expected = queryImported("db", 1);
+    const auto actual = queryImported("db_parallel", 4);
+    cfg::Configuration::patch({ { "persistence", { { "bcgn_import_threads", 0 } } } });
+
+    // Not expanded by Catch on failure, the responses are large.
+    const bool isSame = actual == expected;
+    REQUIRE(isSame);
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Expanded children are the same as queried directly", "[persistence][query]")
+{
+    using persistence::db_delta::Database;
+
+    const auto dir = std::filesystem::temp_directory_path() / ext::uniquePath();
+    std::filesystem::create_directories(dir);
+    const auto pgnPath = dir / "games.pgn";
+    const auto dbPath = dir / "db";
+
+    const auto games = generateGames(400, 80, 40);
+    writeFile(pgnPath, games.pgn);
+
+    Database db(dbPath);
+    (void)db.import({ persistence::ImportableFile(pgnPath, GameLevel::Human) }, 16 * 1024 * 1024);
+    db.flush();
+
+    auto makeExpansionRequest = [](const std::vector<std::string>& fens, std::size_t depth, std::size_t minCount) {
+        query::Request request;
+        request.token = "test";
+        for (auto&& fen : fens)
+        {
+            request.positions.emplace_back(query::RootPosition{ fen, std::nullopt });
+        }
+        request.levels = { GameLevel::Human, GameLevel::Engine, GameLevel::Server };
+        request.results = { GameResult::WhiteWin, GameResult::BlackWin, GameResult::Draw };
+        request.fetchingOptions[query::Select::Continuations] = { true, false, false, false, false };
+        request.expansion = query::ExpansionOptions{ depth, minCount };
+        return request;
+    };
+
+    SECTION("Children with enough games are expanded")
+    {
+        const std::size_t depth = 3;
+        const std::size_t minCount = 2;
+        const auto request = makeExpansionRequest({ Position::startPosition().fen() }, depth, minCount);
+        REQUIRE(request.isValid());
+
+        const auto response = db.executeQuery(request);
+        REQUIRE(response.results.size() == 1);
+
+        const auto& root = response.results[0];
+
+        std::vector<std::vector<const query::ResultForRoot*>> nodesByDepth;
+        collectExpanded(root, 1, nodesByDepth);
+
+        // Nodes of the last depth have their children but are not expanded further.
+        REQUIRE(nodesByDepth.size() == depth);
+        REQUIRE(nodesByDepth[1].size() == numChildrenWithAtLeast(root, minCount));
+        std::size_t numAtDepth2 = 0;
+        for (auto&& node : nodesByDepth[1])
+        {
+            REQUIRE(node->expanded.size() == numChildrenWithAtLeast(*node, minCount));
+            numAtDepth2 += node->expanded.size();
+        }
+        REQUIRE(nodesByDepth[2].size() == numAtDepth2);
+        REQUIRE(numAtDepth2 > 0);
+
+        // Each node holds the same entries as a query for its position.
+        std::vector<const query::ResultForRoot*> nodes;
+        for (auto&& nodesAtDepth : nodesByDepth)
+        {
+            nodes.insert(nodes.end(), nodesAtDepth.begin(), nodesAtDepth.end());
+        }
+
+        query::Request direct = makeExpansionRequest({}, 1, 0);
+        direct.expansion.reset();
+        for (auto&& node : nodes)
+        {
+            direct.positions.emplace_back(node->position);
+        }
+        const auto directResponse = db.executeQuery(direct);
+        REQUIRE(directResponse.results.size() == nodes.size());
+        for (std::size_t i = 0; i < nodes.size(); ++i)
+        {
+            nlohmann::json expanded = *nodes[i];
+            expanded.erase("expanded");
+            const nlohmann::json queried = directResponse.results[i];
+
+            const bool isSame = expanded == queried;
+            REQUIRE(isSame);
+        }
+    }
+
+    SECTION("The depth is limited")
+    {
+        auto request = makeExpansionRequest({ Position::startPosition().fen() }, query::ExpansionOptions::maxDepth + 1, 0);
+        REQUIRE(!request.isValid());
+
+        request.expansion->depth = query::ExpansionOptions::maxDepth;
+        REQUIRE(request.isValid());
+
+        const auto response = db.executeQuery(request);
+
+        // Every game is longer than the maximum depth.
+        std::vector<std::vector<const query::ResultForRoot*>> nodesByDepth;
+        collectExpanded(response.results[0], 1, nodesByDepth);
+        REQUIRE(nodesByDepth.size() == query::ExpansionOptions::maxDepth);
+        for (auto&& node : nodesByDepth.back())
+        {
+            REQUIRE(node->expanded.empty());
+            REQUIRE(!node->resultsBySelect.at(query::Select::Continuations).children.empty());
+        }
+    }
+
+    SECTION("The number of nodes is limited over the whole query")
+    {
+        // Most of the positions are reached by one game, which
+        // gives about 7 nodes for each of them at the maximum depth.
+        REQUIRE(games.fens.size() * 5 > query::ExpansionOptions::maxNodes);
+        const auto request = makeExpansionRequest(games.fens, query::ExpansionOptions::maxDepth, 0);
+        REQUIRE(request.isValid());
+
+        const auto response = db.executeQuery(request);
+
+        std::size_t numNodes = 0;
+        for (auto&& result : response.results)
+        {
+            std::vector<std::vector<const query::ResultForRoot*>> nodesByDepth;
+            collectExpanded(result, 1, nodesByDepth);
+            for (auto&& nodesAtDepth : nodesByDepth)
+            {
+                numNodes += nodesAtDepth.size();
+            }
+        }
+        REQUIRE(numNodes == query::ExpansionOptions::maxNodes);
+    }
+
+    SECTION("Retractions are only fetched for the roots")
+    {
+        auto request = makeExpansionRequest({ games.fens[0], games.fens[1] }, 2, 0);
+        request.retractionsFetchingOptions = query::AdditionalRetractionsFetchingOptions{ false, false };
+        REQUIRE(request.isValid());
+
+        auto notExpanded = request;
+        notExpanded.expansion.reset();
+
+        const auto response = db.executeQuery(request);
+        const auto responseNotExpanded = db.executeQuery(notExpanded);
+        REQUIRE(response.results.size() == 2);
+
+        for (std::size_t i = 0; i < 2; ++i)
+        {
+            const auto& result = response.results[i];
+            REQUIRE(!result.retractionsResults.retractions.empty());
+            REQUIRE(!result.expanded.empty());
+
+            const nlohmann::json json = result;
+            const nlohmann::json jsonNotExpanded = responseNotExpanded.results[i];
+            const bool isSame = json.at("retractions") == jsonNotExpanded.at("retractions");
+            REQUIRE(isSame);
+
+            for (auto&& child : result.expanded)
+            {
+                REQUIRE(child.retractionsResults.retractions.empty());
+            }
+        }
+    }
+
+    std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Novelty request movetext", "[persistence][query]")
+{
+    const auto parse = [](const std::string& movetext) {
+        query::NoveltyRequest request{};
+        request.moves = movetext;
+        return request.tryGetMoves();
+    };
+
+    const auto toSan = [](std::optional<std::vector<Move>> movesOpt) {
+        REQUIRE(movesOpt.has_value());
+
+        std::vector<std::string> sans;
+        Position position = Position::startPosition();
+        for (auto&& move : *movesOpt)
+        {
+            sans.emplace_back(san::moveToSan<san::SanSpec::Capture | san::SanSpec::Check | san::SanSpec::Compact>(position, move));
+            position.doMove(move);
+        }
+        return sans;
+    };
+
+    REQUIRE(toSan(parse("")).empty());
+    REQUIRE(toSan(parse("e4 e5")) == std::vector<std::string>{ "e4", "e5" });
+    REQUIRE(toSan(parse("e2e4 e7e5 g1f3")) == std::vector<std::string>{ "e4", "e5", "Nf3" });
+    REQUIRE(toSan(parse("1.e4\te5\r\n2.Nf3!? Nc6 $1 *")) == std::vector<std::string>{ "e4", "e5", "Nf3", "Nc6" });
+
+    // Castling may be written with zeros.
+    REQUIRE(toSan(parse("1. e4 e5 2. Nf3 Nc6 3. Bc4 Nf6 4. 0-0 Bc5 1-0"))[6] == "O-O");
+    REQUIRE(toSan(parse("1. d4 d5 2. Nc3 Nc6 3. Bf4 Bf5 4. Qd2 Qd7 5. 0-0-0 0-0-0 0-1"))
+        == std::vector<std::string>{ "d4", "d5", "Nc3", "Nc6", "Bf4", "Bf5", "Qd2", "Qd7", "O-O-O", "O-O-O" });
+
+    // Comments and variations are skipped, including ';' comments inside variations.
+    REQUIRE(toSan(parse(
+        "1. e4 {best by test} (1. d4 ; a comment with ) in it\n"
+        "1... d5) e5 (1... c5 {sicilian}) 2. Nf3 ; to the end of line\n"
+        "2... Nc6 1/2-1/2"
+    )) == std::vector<std::string>{ "e4", "e5", "Nf3", "Nc6" });
+
+    REQUIRE(!parse("1. e4 e4").has_value());
+    REQUIRE(!parse("1. e5").has_value());
+    REQUIRE(!parse("1. 0-0").has_value());
+}
@@ -0,0 +1,161 @@
+#include "catch2/catch.hpp"
+
+#include "persistence/pos_db/DictionaryGameHeaderStorage.h"
+
+#include "chess/GameClassification.h"
+#include "chess/Pgn.h"
+
+#include "external_storage/External.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    [[nodiscard]] std::string makeTags(const std::string& event, const std::string& white, const std::string& black, const std::string& result)
+    {
+        return
+            "[Event \"" + event + "\"]\n"
+            "[White \"" + white + "\"]\n"
+            "[Black \"" + black + "\"]\n"
+            "[Date \"2020.01.02\"]\n"
+            "[ECO \"B12\"]\n"
+            "[Result \"" + result + "\"]\n";
+    }
+}
+
+TEST_CASE("Dictionary game header storage", "[persistence][header]")
+{
+    using StorageType = persistence::DictionaryGameHeaderStorage<std::uint32_t>;
+
+    const auto path = std::filesystem::temp_directory_path() / ext::uniquePath();
+
+    const std::vector<std::string> tags = {
+        makeTags("Rated Blitz game", "alice", "bob", "1-0"),
+        makeTags("Rated Blitz game", "bob", "carol", "0-1"),
+        makeTags("Rated Bullet game", "alice", "carol", "1/2-1/2"),
+        makeTags("Rated Blitz game", "carol", "alice", "1-0")
+    };
+
+    std::vector<persistence::HeaderEntryLocation> locations;
+
+    {
+        StorageType storage(path);
+        for (std::size_t i = 0; i < tags.size(); ++i)
+        {
+            const pgn::UnparsedGame game(tags[i], "");
+            locations.emplace_back(storage.addGame(game, static_cast<std::uint16_t>(10 + i)));
+        }
+        storage.flush();
+
+        // Two events and three players.
+        REQUIRE(storage.numStrings() == 5);
+        REQUIRE(storage.numGames() == tags.size());
+    }
+
+    {
+        // The dictionary is loaded back.
+        StorageType storage(path);
+        REQUIRE(storage.numStrings() == 5);
+
+        const auto headers = storage.queryByIndices({ 3, 0, 3, 1 });
+        REQUIRE(headers.size() == 4);
+
+        REQUIRE(headers[0].gameIdx() == 3);
+        REQUIRE(headers[0].event() == "Rated Blitz game");
+        REQUIRE(headers[0].white() == "carol");
+        REQUIRE(headers[0].black() == "alice");
+        REQUIRE(headers[0].result() == GameResult::WhiteWin);
+        REQUIRE(headers[0].plyCount() == 13);
+        REQUIRE(headers[0].date().year() == 2020);
+        REQUIRE(headers[0].date().month() == 1);
+        REQUIRE(headers[0].date().day() == 2);
+        REQUIRE(headers[0].eco().toString() == "B12");
+
+        REQUIRE(headers[1].gameIdx() == 0);
+        REQUIRE(headers[1].white() == "alice");
+        REQUIRE(headers[1].black() == "bob");
+
+        REQUIRE(headers[2].gameIdx() == 3);
+        REQUIRE(headers[3].gameIdx() == 1);
+        REQUIRE(headers[3].result() == GameResult::BlackWin);
+
+        const auto byOffsets = storage.queryByOffsets({ locations[2].offset });
+        REQUIRE(byOffsets.size() == 1);
+        REQUIRE(byOffsets[0].gameIdx() == 2);
+        REQUIRE(byOffsets[0].event() == "Rated Bullet game");
+        REQUIRE(byOffsets[0].result() == GameResult::Draw);
+
+        // Only new strings are added to the dictionary.
+        const std::string newTags = makeTags("Rated Bullet game", "dave", "bob", "0-1");
+        const pgn::UnparsedGame game(newTags, "");
+        storage.addGame(game, 0);
+        REQUIRE(storage.numStrings() == 6);
+        REQUIRE(storage.queryByIndices({ 4 })[0].white() == "dave");
+
+        storage.clear();
+        REQUIRE(storage.numGames() == 0);
+        REQUIRE(storage.numStrings() == 0);
+    }
+
+    std::filesystem::remove_all(path);
+}
+
+TEST_CASE("Dictionary game header records have no uninitialized bytes", "[persistence][header]")
+{
+    using StorageType = persistence::DictionaryGameHeaderStorage<std::uint32_t>;
+    using RecordType = StorageType::Record;
+
+    // Bytes of the record that don't belong to any member.
+    std::vector<bool> isPadding(sizeof(RecordType), true);
+    auto markMember = [&isPadding](std::size_t offset, std::size_t size) {
+        for (std::size_t i = offset; i < offset + size; ++i)
+        {
+            isPadding[i] = false;
+        }
+    };
+    markMember(offsetof(RecordType, gameIdx), sizeof(RecordType::gameIdx));
+    markMember(offsetof(RecordType, event), sizeof(RecordType::event));
+    markMember(offsetof(RecordType, white), sizeof(RecordType::white));
+    markMember(offsetof(RecordType, black), sizeof(RecordType::black));
+    markMember(offsetof(RecordType, date), sizeof(RecordType::date));
+    markMember(offsetof(RecordType, eco), sizeof(RecordType::eco));
+    markMember(offsetof(RecordType, plyCount), sizeof(RecordType::plyCount));
+    markMember(offsetof(RecordType, result), sizeof(RecordType::result));
+    REQUIRE(std::count(isPadding.begin(), isPadding.end(), true) == sizeof(RecordType::reserved));
+
+    const auto path = std::filesystem::temp_directory_path() / ext::uniquePath();
+
+    {
+        StorageType storage(path);
+        for (std::size_t i = 0; i < 100; ++i)
+        {
+            const std::string tags = makeTags("Event " + std::to_string(i % 7), "white", "black", "1-0");
+            const pgn::UnparsedGame game(tags, "");
+            (void)storage.addGame(game, static_cast<std::uint16_t>(i));
+        }
+        storage.flush();
+    }
+
+    std::vector<char> data(std::filesystem::file_size(path / StorageType::recordsPath));
+    {
+        std::ifstream file(path / StorageType::recordsPath, std::ios::binary);
+        file.read(data.data(), data.size());
+    }
+    REQUIRE(data.size() == 100 * sizeof(RecordType));
+
+    for (std::size_t i = 0; i < data.size(); ++i)
+    {
+        if (isPadding[i % sizeof(RecordType)])
+        {
+            REQUIRE(data[i] == 0);
+        }
+    }
+
+    std::filesystem::remove_all(path);
+}
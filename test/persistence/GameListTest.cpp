@@ -0,0 +1,123 @@
+#include "catch2/catch.hpp"
+
+#include "persistence/pos_db/GameList.h"
+#include "persistence/pos_db/beta/DatabaseFormatBeta.h"
+
+#include "chess/Chess.h"
+#include "chess/GameClassification.h"
+#include "chess/Zobrist.h"
+
+#include "external_storage/External.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+TEST_CASE("Game lists are encoded and decoded", "[persistence][game_list]")
+{
+    const std::vector<std::vector<std::uint64_t>> lists{
+        { 0 },
+        { 7 },
+        { 0, 1, 2, 3 },
+        { 5, 1000, 1001, 1ull << 40, (1ull << 40) + 3 },
+        { 123456789 }
+    };
+
+    // Lists are appended one after another.
+    std::vector<std::byte> data;
+    std::vector<std::size_t> offsets;
+    for (auto&& games : lists)
+    {
+        offsets.emplace_back(data.size());
+        persistence::GameListCoding::encode(games, data);
+    }
+    offsets.emplace_back(data.size());
+
+    for (std::size_t i = 0; i < lists.size(); ++i)
+    {
+        std::vector<std::uint64_t> games{ 42 };
+        persistence::GameListCoding::decode(data.data() + offsets[i], offsets[i + 1] - offsets[i], games);
+
+        // Decoded games are appended.
+        REQUIRE(games.size() == lists[i].size() + 1);
+        REQUIRE(games[0] == 42);
+        REQUIRE(std::vector<std::uint64_t>(games.begin() + 1, games.end()) == lists[i]);
+    }
+
+    SECTION("Close games take little space")
+    {
+        std::vector<std::uint64_t> games;
+        for (std::uint64_t i = 0; i < 1000; ++i)
+        {
+            games.emplace_back(1000000 + i * 3);
+        }
+
+        std::vector<std::byte> encoded;
+        persistence::GameListCoding::encode(games, encoded);
+        REQUIRE(encoded.size() < 1000);
+    }
+}
+
+TEST_CASE("Game lists are normalized", "[persistence][game_list]")
+{
+    std::vector<std::uint64_t> games{ 5, 3, 5, 1, 3, 9 };
+    persistence::normalizeGameList(games);
+    REQUIRE(games == std::vector<std::uint64_t>{ 1, 3, 5, 9 });
+}
+
+TEST_CASE("Game lists of data files are merged", "[persistence][game_list]")
+{
+    using Database = persistence::db_beta::Database;
+    using Key = persistence::db_beta::Key;
+
+    const auto dir = std::filesystem::temp_directory_path() / ext::uniquePath();
+    std::filesystem::create_directories(dir);
+
+    auto makeKey = [](std::uint64_t hash, GameLevel level) {
+        return Key(ZobristKey{ hash, 0 }, PackedReverseMove(ReverseMove{}), level, GameResult::WhiteWin);
+    };
+
+    // Only the game lists are written, the data files themselves are not needed.
+    {
+        Database::GameListWriter writer(dir / "0");
+        writer.append(makeKey(1, GameLevel::Human), { 0, 4 });
+        writer.append(makeKey(3, GameLevel::Human), { 1 });
+        writer.append(makeKey(3, GameLevel::Engine), { 2 });
+        writer.finish();
+    }
+    {
+        Database::GameListWriter writer(dir / "1");
+        writer.append(makeKey(2, GameLevel::Human), { 10 });
+        writer.append(makeKey(3, GameLevel::Human), { 1, 11 });
+        writer.finish();
+    }
+
+    Database::mergeGameListsOfDataFiles({ dir / "0", dir / "1" }, dir / "2");
+    REQUIRE(Database::hasGameListsOfDataFile(dir / "2"));
+
+    // The lists of equal keys are united.
+    const std::vector<std::pair<Key, std::vector<std::uint64_t>>> expected{
+        { makeKey(1, GameLevel::Human), { 0, 4 } },
+        { makeKey(2, GameLevel::Human), { 10 } },
+        { makeKey(3, GameLevel::Human), { 1, 11 } },
+        { makeKey(3, GameLevel::Engine), { 2 } }
+    };
+
+    Database::GameListReader reader(dir / "2");
+    for (auto&& [key, games] : expected)
+    {
+        REQUIRE(!reader.isEnd());
+        REQUIRE(Database::KeyCompareEqualFull{}(reader.key(), key));
+
+        std::vector<std::uint64_t> actual;
+        reader.readGames(actual);
+        REQUIRE(actual == games);
+
+        reader.next();
+    }
+    REQUIRE(reader.isEnd());
+
+    std::filesystem::remove_all(dir);
+}
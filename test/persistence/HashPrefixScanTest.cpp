@@ -0,0 +1,75 @@
+#include "catch2/catch.hpp"
+
+#include "intrin/Intrinsics.h"
+
+#include "persistence/pos_db/HashPrefixScan.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+    // Makes `count` elements, each `stride` bytes, with about a quarter having the given prefix.
+    [[nodiscard]] std::vector<std::byte> makeElements(std::size_t stride, std::size_t count, std::uint64_t prefix, std::uint64_t seed)
+    {
+        std::mt19937_64 rng(seed);
+
+        std::vector<std::byte> data(stride * count);
+        for (auto& b : data)
+        {
+            b = static_cast<std::byte>(rng());
+        }
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            std::uint64_t value = prefix;
+            if (rng() % 4 != 0)
+            {
+                // Differs in a single random bit.
+                value ^= 1ull << (rng() % 64);
+            }
+
+            std::memcpy(data.data() + i * stride, &value, sizeof(value));
+        }
+
+        return data;
+    }
+}
+
+TEST_CASE("Hash prefix scan finds all matching elements", "[persistence][hash_prefix_scan]")
+{
+    const std::uint64_t prefix = 0x0123456789ABCDEFull;
+
+    for (std::size_t stride : { 8, 12, 16, 20, 24, 32, 40 })
+    {
+        for (std::size_t count : { 0, 1, 3, 4, 5, 7, 8, 1000, 1027 })
+        {
+            const auto data = makeElements(stride, count, prefix, stride * 10000 + count);
+
+            std::vector<std::size_t> expected;
+            persistence::detail::findHashPrefixesScalar(data.data(), stride, count, prefix, expected);
+
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                std::uint64_t value;
+                std::memcpy(&value, data.data() + i * stride, sizeof(value));
+                const bool isExpected = std::find(expected.begin(), expected.end(), i) != expected.end();
+                REQUIRE((value == prefix) == isExpected);
+            }
+
+            std::vector<std::size_t> found;
+            persistence::findHashPrefixes(data.data(), stride, count, prefix, found);
+            REQUIRE(found == expected);
+
+            if (intrin::hasAvx2())
+            {
+                std::vector<std::size_t> foundAvx2;
+                persistence::detail::findHashPrefixesAvx2(data.data(), stride, count, prefix, foundAvx2);
+                REQUIRE(foundAvx2 == expected);
+            }
+        }
+    }
+}
\ No newline at end of file
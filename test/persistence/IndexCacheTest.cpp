@@ -0,0 +1,87 @@
+#include "catch2/catch.hpp"
+
+#include "persistence/pos_db/IndexCache.h"
+
+#include "util/MemoryAmount.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    struct FakeIndex
+    {
+        std::size_t id;
+        std::size_t size;
+
+        [[nodiscard]] std::size_t memoryUsage() const
+        {
+            return size;
+        }
+    };
+}
+
+TEST_CASE("Index cache eviction", "[persistence][index_cache]")
+{
+    auto& cache = persistence::IndexCache::instance();
+    const auto oldBudget = cache.memoryBudget();
+    cache.setMemoryBudget(MemoryAmount::bytes(300));
+
+    const auto statsBefore = cache.stats();
+
+    std::vector<std::size_t> numLoads(4, 0);
+    std::vector<persistence::CachedIndex<FakeIndex>> indexes;
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        indexes.emplace_back([i, &numLoads]() {
+            numLoads[i] += 1;
+            return FakeIndex{ i, 100 };
+        });
+    }
+
+    REQUIRE(cache.stats().numRegistered == statsBefore.numRegistered + 4);
+    REQUIRE(cache.stats().numResident == statsBefore.numResident);
+
+    // Nothing is loaded until used.
+    REQUIRE(numLoads == std::vector<std::size_t>{ 0, 0, 0, 0 });
+
+    REQUIRE(indexes[0].get()->id == 0);
+    auto held = indexes[1].get();
+    REQUIRE(held->id == 1);
+    REQUIRE(indexes[2].get()->id == 2);
+    REQUIRE(cache.stats().residentBytes == 300);
+
+    // 0 becomes the most recently used, so 1 is evicted when 3 is loaded.
+    REQUIRE(indexes[0].get()->id == 0);
+    REQUIRE(indexes[3].get()->id == 3);
+
+    // An index in use stays valid after eviction.
+    REQUIRE(held->id == 1);
+    held.reset();
+
+    REQUIRE(numLoads == std::vector<std::size_t>{ 1, 1, 1, 1 });
+    REQUIRE(cache.stats().residentBytes == 300);
+    REQUIRE(cache.stats().numEvictions == statsBefore.numEvictions + 1);
+
+    // 1 is loaded again, evicting 2.
+    REQUIRE(indexes[1].get()->id == 1);
+    REQUIRE(numLoads == std::vector<std::size_t>{ 1, 2, 1, 1 });
+
+    const auto stats = cache.stats();
+    REQUIRE(stats.numLoads == statsBefore.numLoads + 5);
+    REQUIRE(stats.numReloads == statsBefore.numReloads + 1);
+    REQUIRE(stats.numHits == statsBefore.numHits + 1);
+    REQUIRE(stats.numResident == statsBefore.numResident + 3);
+
+    // Shrinking the budget evicts immediately, except for the most recent one.
+    cache.setMemoryBudget(MemoryAmount::bytes(0));
+    REQUIRE(cache.stats().numResident == 1);
+    REQUIRE(cache.stats().residentBytes == 100);
+
+    indexes.clear();
+    REQUIRE(cache.stats().numRegistered == statsBefore.numRegistered);
+    REQUIRE(cache.stats().residentBytes == 0);
+
+    cache.setMemoryBudget(oldBudget);
+}
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "catch2/catch.hpp"
+
+#include "persistence/pos_db/MaterialIndex.h"
+
+#include "chess/Chess.h"
+#include "chess/GameClassification.h"
+#include "chess/Position.h"
+
+#include "external_storage/External.h"
+
+#include <filesystem>
+
+TEST_CASE("Material signatures", "[persistence][material_index]")
+{
+    using persistence::MaterialSignature;
+
+    const auto start = MaterialSignature::fromBoard(Position::startPosition());
+    REQUIRE(start.toString() == "KQRRBBNNPPPPPPPPvKQRRBBNNPPPPPPPP");
+    REQUIRE(start.count(Piece(PieceType::Pawn, Color::White)) == 8);
+    REQUIRE(start.count(Piece(PieceType::Queen, Color::Black)) == 1);
+    REQUIRE(MaterialSignature::fromString(start.toString()) == start);
+
+    const auto krp = MaterialSignature::fromBoard(Position::fromFen("8/8/4k3/8/2r5/8/3PK3/R7 w - - 0 1"));
+    REQUIRE(krp.toString() == "KRPvKR");
+
+    // Pieces may be in any order.
+    REQUIRE(MaterialSignature::fromString("KRPvKR") == krp);
+    REQUIRE(MaterialSignature::fromString("PRKvRK") == krp);
+    REQUIRE(MaterialSignature::fromString("KvK").has_value());
+    REQUIRE(MaterialSignature::fromString("KvK") != krp);
+
+    REQUIRE(!MaterialSignature::fromString("KRP").has_value());
+    REQUIRE(!MaterialSignature::fromString("RPvKR").has_value());
+    REQUIRE(!MaterialSignature::fromString("KKvK").has_value());
+    REQUIRE(!MaterialSignature::fromString("KXvK").has_value());
+    REQUIRE(!MaterialSignature::fromString("KvKvK").has_value());
+
+    REQUIRE(MaterialSignature::fromBits(krp.bits()) == krp);
+}
+
+TEST_CASE("Material index", "[persistence][material_index]")
+{
+    using persistence::MaterialIndex;
+    using persistence::MaterialSignature;
+
+    const auto path = std::filesystem::temp_directory_path() / ext::uniquePath();
+
+    const auto krpVsKr = Position::fromFen("8/8/4k3/8/2r5/8/3PK3/R7 w - - 0 1");
+    const auto krpVsKr2 = Position::fromFen("8/8/4k3/8/2r5/3P4/4K3/R7 b - - 0 1");
+    const auto krVsKr = Position::fromFen("8/8/4k3/8/8/8/4K3/R1r5 w - - 0 1");
+    const auto krVsK = Position::fromFen("8/8/4k3/8/8/8/4K3/R7 b - - 0 1");
+
+    const auto krp = *MaterialSignature::fromString("KRPvKR");
+    const auto kr = *MaterialSignature::fromString("KRvKR");
+    const auto krk = *MaterialSignature::fromString("KRvK");
+
+    {
+        MaterialIndex index(path);
+        REQUIRE(index.numSignatures() == 0);
+
+        index.beginGame(GameLevel::Human, GameResult::WhiteWin);
+        index.addPosition(krpVsKr);
+        index.addPosition(krpVsKr2);
+        index.addPosition(krVsKr);
+        index.addPosition(krVsK);
+        index.endGame();
+
+        index.beginGame(GameLevel::Engine, GameResult::Draw);
+        index.addPosition(krpVsKr);
+        index.addPosition(krVsKr);
+        index.addPosition(krVsKr);
+        index.endGame();
+
+        index.flush();
+    }
+
+    MaterialIndex index(path);
+    REQUIRE(index.numSignatures() == 3);
+
+    const auto krpStats = index.stats(krp);
+    REQUIRE(krpStats[GameLevel::Human][GameResult::WhiteWin].numPositions == 2);
+    REQUIRE(krpStats[GameLevel::Human][GameResult::WhiteWin].numGames == 1);
+    REQUIRE(krpStats[GameLevel::Engine][GameResult::Draw].numPositions == 1);
+    REQUIRE(krpStats[GameLevel::Engine][GameResult::Draw].numGames == 1);
+    REQUIRE(krpStats[GameLevel::Server][GameResult::Draw].numGames == 0);
+
+    const auto krStats = index.stats(kr);
+    REQUIRE(krStats[GameLevel::Engine][GameResult::Draw].numPositions == 2);
+    REQUIRE(krStats[GameLevel::Engine][GameResult::Draw].numGames == 1);
+
+    REQUIRE(index.stats(krk)[GameLevel::Human][GameResult::WhiteWin].numGames == 1);
+    REQUIRE(index.stats(*MaterialSignature::fromString("KvK"))[GameLevel::Human][GameResult::WhiteWin].numGames == 0);
+
+    // The file is kept so that the index is known to exist.
+    index.clear();
+    REQUIRE(index.numSignatures() == 0);
+    REQUIRE(std::filesystem::exists(path));
+    REQUIRE(MaterialIndex(path).numSignatures() == 0);
+
+    std::filesystem::remove(path);
+}
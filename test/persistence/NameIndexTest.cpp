@@ -0,0 +1,155 @@
+#include "catch2/catch.hpp"
+
+#include "persistence/pos_db/IndexedGameHeaderStorage.h"
+#include "persistence/pos_db/NameIndex.h"
+
+#include "chess/Pgn.h"
+
+#include "external_storage/External.h"
+
+#include "Configuration.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+    struct FakeHeader
+    {
+        std::string m_event;
+        std::string m_white;
+        std::string m_black;
+
+        [[nodiscard]] std::string_view event() const { return m_event; }
+        [[nodiscard]] std::string_view white() const { return m_white; }
+        [[nodiscard]] std::string_view black() const { return m_black; }
+    };
+
+    struct FakeHeaderStorage
+    {
+        std::vector<FakeHeader> headers;
+
+        [[nodiscard]] std::uint64_t numGames() const
+        {
+            return headers.size();
+        }
+
+        [[nodiscard]] std::vector<FakeHeader> queryByIndicesUncached(const std::vector<std::uint64_t>& indices) const
+        {
+            std::vector<FakeHeader> result;
+            for (auto idx : indices)
+            {
+                result.emplace_back(headers[idx]);
+            }
+            return result;
+        }
+    };
+}
+
+TEST_CASE("Name index", "[persistence][name_index]")
+{
+    using persistence::NameIndex;
+    using persistence::NameIndexField;
+
+    const auto path = std::filesystem::temp_directory_path() / ext::uniquePath();
+
+    REQUIRE(NameIndex::normalize("  Magnus Carlsen\t") == "magnus carlsen");
+    REQUIRE(NameIndex::normalize("DrNykterstein") == "drnykterstein");
+    REQUIRE(NameIndex::normalize("   ").empty());
+
+    {
+        NameIndex index(path);
+        REQUIRE(index.numGames() == 0);
+
+        // Large gaps between games of a name take more than one byte.
+        for (std::uint64_t i = 0; i < 1000; ++i)
+        {
+            const std::string white = i % 300 == 0 ? "Alice" : "bob";
+            index.add(i, "Rated Blitz", white, "carol");
+        }
+        index.add(1000, "Rated Bullet", "dave", "dave");
+        index.flush();
+
+        REQUIRE(index.numGames() == 1001);
+    }
+
+    NameIndex index(path);
+    REQUIRE(index.numGames() == 1001);
+
+    REQUIRE(index.countGames(NameIndexField::Player, "alice") == 4);
+    REQUIRE(index.findGames(NameIndexField::Player, " ALICE ", 0, 10) == std::vector<std::uint64_t>{ 0, 300, 600, 900 });
+    REQUIRE(index.findGames(NameIndexField::Player, "alice", 1, 2) == std::vector<std::uint64_t>{ 300, 600 });
+    REQUIRE(index.findGames(NameIndexField::Player, "alice", 4, 2).empty());
+
+    REQUIRE(index.countGames(NameIndexField::Player, "carol") == 1000);
+    REQUIRE(index.findGames(NameIndexField::Player, "carol", 998, 10) == std::vector<std::uint64_t>{ 998, 999 });
+
+    // A player playing both sides is counted once.
+    REQUIRE(index.countGames(NameIndexField::Player, "dave") == 1);
+
+    // Players and events are separate.
+    REQUIRE(index.countGames(NameIndexField::Event, "rated bullet") == 1);
+    REQUIRE(index.countGames(NameIndexField::Player, "rated bullet") == 0);
+    REQUIRE(index.countGames(NameIndexField::Event, "dave") == 0);
+    REQUIRE(index.countGames(NameIndexField::Player, "eve") == 0);
+
+    SECTION("Update from header storage")
+    {
+        FakeHeaderStorage storage;
+        storage.headers.resize(1001);
+        storage.headers.push_back(FakeHeader{ "Rated Blitz", "eve", "Alice" });
+        storage.headers.push_back(FakeHeader{ "Rated Blitz", "alice", "eve" });
+
+        index.update(storage);
+        REQUIRE(index.numGames() == 1003);
+        REQUIRE(index.findGames(NameIndexField::Player, "alice", 3, 10) == std::vector<std::uint64_t>{ 900, 1001, 1002 });
+        REQUIRE(index.countGames(NameIndexField::Player, "eve") == 2);
+
+        // Storage with fewer games means it was cleared, the index is rebuilt.
+        storage.headers.resize(2);
+        index.update(storage);
+        REQUIRE(index.numGames() == 2);
+        REQUIRE(index.countGames(NameIndexField::Player, "alice") == 0);
+    }
+
+    index.clear();
+    REQUIRE(index.numNames() == 0);
+    REQUIRE(!std::filesystem::exists(path));
+}
+
+TEST_CASE("Name index update does not fill the header cache", "[persistence][name_index]")
+{
+    using persistence::NameIndexField;
+    using StorageType = persistence::IndexedGameHeaderStorage<persistence::PackedGameHeader32>;
+
+    const auto path = std::filesystem::temp_directory_path() / ext::uniquePath();
+
+    {
+        StorageType storage(path);
+        for (int i = 0; i < 10; ++i)
+        {
+            const std::string tags = "[White \"alice\"]\n[Black \"bob\"]\n[Result \"1-0\"]\n";
+            storage.addGame(pgn::UnparsedGame(tags, ""), 0);
+        }
+        storage.flush();
+    }
+
+    // The index is built from the stored headers when enabled later.
+    cfg::Configuration::patch({ { "persistence", { { "name_index", true } } } });
+
+    {
+        StorageType storage(path);
+        REQUIRE(storage.countGamesByName(NameIndexField::Player, "alice") == 10);
+        REQUIRE(storage.numCachedHeaders() == 0);
+
+        REQUIRE(storage.queryByIndices({ 0, 1 }).size() == 2);
+        REQUIRE(storage.numCachedHeaders() == 2);
+    }
+
+    cfg::Configuration::patch({ { "persistence", { { "name_index", false } } } });
+
+    std::filesystem::remove_all(path);
+}
@@ -0,0 +1,43 @@
+#include "catch2/catch.hpp"
+
+#include "util/LruCache.h"
+
+#include <string>
+
+TEST_CASE("LRU cache drops the least recently used value", "[util][lru_cache]")
+{
+    util::LruCache<int, std::string> cache(2);
+
+    REQUIRE(cache.get(1) == nullptr);
+
+    cache.insert(1, "a");
+    cache.insert(2, "b");
+    REQUIRE(cache.size() == 2);
+    REQUIRE(*cache.get(1) == "a");
+
+    // 2 is now the least recently used.
+    cache.insert(3, "c");
+    REQUIRE(cache.size() == 2);
+    REQUIRE(cache.get(2) == nullptr);
+    REQUIRE(*cache.get(1) == "a");
+    REQUIRE(*cache.get(3) == "c");
+
+    // Inserting an existing key replaces the value and makes it the most recently used.
+    cache.insert(1, "d");
+    cache.insert(4, "e");
+    REQUIRE(cache.get(3) == nullptr);
+    REQUIRE(*cache.get(1) == "d");
+    REQUIRE(*cache.get(4) == "e");
+
+    cache.clear();
+    REQUIRE(cache.size() == 0);
+    REQUIRE(cache.get(1) == nullptr);
+}
+
+TEST_CASE("LRU cache with no capacity stores nothing", "[util][lru_cache]")
+{
+    util::LruCache<int, int> cache(0);
+    cache.insert(1, 1);
+    REQUIRE(cache.size() == 0);
+    REQUIRE(cache.get(1) == nullptr);
+}